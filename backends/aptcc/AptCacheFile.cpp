@@ -24,9 +24,16 @@
 #include "OpPackageKitProgress.h"
 
 #include <apt-pkg/algorithms.h>
+#include <apt-pkg/configuration.h>
+#include <sys/stat.h>
 #include <sstream>
 #include <cstdio>
 
+// the cache kept between read only jobs
+static GMutex sharedLock;
+static AptCacheFile *sharedCache = 0;
+static std::string sharedStamp;
+
 AptCacheFile::AptCacheFile(PkBackendJob *job) :
     m_packageRecords(0),
     m_job(job)
@@ -57,6 +64,97 @@ void AptCacheFile::Close()
     _error->Discard();
 }
 
+void AptCacheFile::setJob(PkBackendJob *job)
+{
+    m_job = job;
+}
+
+// appends the mtime of path, or 0 if it does not exist
+static void stamp_add(std::stringstream &stamp, const std::string &path)
+{
+    struct stat buf;
+
+    if (stat(path.c_str(), &buf) != 0) {
+        stamp << ":0";
+        return;
+    }
+    stamp << ':' << buf.st_mtim.tv_sec << '.' << buf.st_mtim.tv_nsec;
+}
+
+std::string AptCacheFile::databaseStamp()
+{
+    struct stat status;
+    struct stat lists;
+    std::stringstream stamp;
+
+    // dpkg rewrites the status file, apt-get update renames new
+    // index files into the lists directory
+    if (stat(_config->FindFile("Dir::State::status").c_str(), &status) != 0 ||
+        stat(_config->FindDir("Dir::State::Lists").c_str(), &lists) != 0) {
+        return std::string();
+    }
+    stamp << status.st_mtim.tv_sec << '.' << status.st_mtim.tv_nsec << ':'
+          << lists.st_mtim.tv_sec << '.' << lists.st_mtim.tv_nsec;
+
+    // the enabled repositories and the pinning decide the candidates,
+    // adding or removing a file changes the mtime of its directory
+    stamp_add(stamp, _config->FindFile("Dir::Etc::sourcelist"));
+    stamp_add(stamp, _config->FindDir("Dir::Etc::sourceparts"));
+    stamp_add(stamp, _config->FindFile("Dir::Etc::preferences"));
+    stamp_add(stamp, _config->FindDir("Dir::Etc::preferencesparts"));
+    return stamp.str();
+}
+
+AptCacheFile* AptCacheFile::takeShared(PkBackendJob *job, const std::string &stamp)
+{
+    AptCacheFile *cache = 0;
+    AptCacheFile *stale = 0;
+
+    g_mutex_lock(&sharedLock);
+    if (sharedCache != 0 && !stamp.empty() && sharedStamp == stamp) {
+        cache = sharedCache;
+    } else {
+        stale = sharedCache;
+    }
+    sharedCache = 0;
+    g_mutex_unlock(&sharedLock);
+
+    delete stale;
+    if (cache != 0) {
+        g_debug("Reusing the package cache");
+        cache->setJob(job);
+    }
+    return cache;
+}
+
+void AptCacheFile::releaseShared(AptCacheFile *cache, const std::string &stamp)
+{
+    AptCacheFile *old;
+
+    // nothing may report to the finished job
+    cache->setJob(0);
+
+    g_mutex_lock(&sharedLock);
+    old = sharedCache;
+    sharedCache = cache;
+    sharedStamp = stamp;
+    g_mutex_unlock(&sharedLock);
+
+    delete old;
+}
+
+void AptCacheFile::dropShared()
+{
+    AptCacheFile *old;
+
+    g_mutex_lock(&sharedLock);
+    old = sharedCache;
+    sharedCache = 0;
+    g_mutex_unlock(&sharedLock);
+
+    delete old;
+}
+
 bool AptCacheFile::BuildCaches(bool withLock)
 {
     OpPackageKitProgress progress(m_job);
@@ -426,7 +524,13 @@ std::string AptCacheFile::getShortDescription(const pkgCache::VerIterator &ver)
 
 std::string AptCacheFile::getLongDescription(const pkgCache::VerIterator &ver)
 {
-    if (ver.end() || ver.FileList().end() || GetPkgRecords() == 0) {
+    return getLongDescription(ver, GetPkgRecords());
+}
+
+std::string AptCacheFile::getLongDescription(const pkgCache::VerIterator &ver,
+                                             pkgRecords *records)
+{
+    if (ver.end() || ver.FileList().end() || records == 0) {
         return string();
     }
 
@@ -439,7 +543,7 @@ std::string AptCacheFile::getLongDescription(const pkgCache::VerIterator &ver)
     if (df.end()) {
         return string();
     } else {
-        return m_packageRecords->Lookup(df).LongDesc();
+        return records->Lookup(df).LongDesc();
     }
 }
 
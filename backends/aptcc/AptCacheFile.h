@@ -23,6 +23,8 @@
 #include <apt-pkg/cachefile.h>
 #include <pk-backend.h>
 
+#include <string>
+
 class pkgProblemResolver;
 class AptCacheFile : public pkgCacheFile
 {
@@ -40,6 +42,35 @@ public:
       */
     void Close();
 
+    /**
+      * Changes the job that progress and errors are reported to
+      */
+    void setJob(PkBackendJob *job);
+
+    /**
+      * @returns a value that changes when dpkg or a cache refresh changes
+      * the package database, or an empty string if it can't be read
+      */
+    static std::string databaseStamp();
+
+    /**
+      * Takes the read only cache kept by a previous job if the package
+      * database is still at @stamp, the cache must be given back with
+      * releaseShared() when the job is done
+      * @returns the warm cache or 0 if it has to be opened again
+      */
+    static AptCacheFile* takeShared(PkBackendJob *job, const std::string &stamp);
+
+    /**
+      * Keeps a read only cache opened at @stamp for the next query
+      */
+    static void releaseShared(AptCacheFile *cache, const std::string &stamp);
+
+    /**
+      * Closes the kept cache, e.g. before a transaction changes the system
+      */
+    static void dropShared();
+
     /**
       * Build caches
       */
@@ -121,6 +152,13 @@ public:
      */
     std::string getLongDescription(const pkgCache::VerIterator &ver);
 
+    /** \return the long description string corresponding to the given
+     *  version, read with the given records parser so that it can be
+     *  used from several threads at once.
+     */
+    std::string getLongDescription(const pkgCache::VerIterator &ver,
+                                   pkgRecords *records);
+
     /** \return a short description string corresponding to the given
      *  version.
      */
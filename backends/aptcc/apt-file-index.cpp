@@ -0,0 +1,449 @@
+/* apt-file-index.cpp - Index of the files owned by installed packages
+ *
+ * Copyright (c) 2014 Daniel Nicoletti <dantti12@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#include "apt-file-index.h"
+
+#include <sys/stat.h>
+#include <dirent.h>
+#include <string.h>
+
+#include <algorithm>
+#include <fstream>
+#include <map>
+
+#include "apt-utils.h"
+
+// bump this if the layout changes
+#define APT_FILE_INDEX_MAGIC    "PKAFIDX2"
+
+// set on packages that ship a .desktop file
+#define APT_FILE_INDEX_DESKTOP  (1 << 0)
+
+/*
+ * The file is laid out as:
+ *   header
+ *   packages[nPackages]      sorted by name
+ *   entries[nEntries]        grouped by package
+ *   byPath[nEntries]         entry indexes sorted by path
+ *   byBasename[nEntries]     entry indexes sorted by basename
+ *   pool[poolSize]           NUL terminated strings
+ * The index is only ever read by the machine that wrote it, so everything
+ * is in host byte order.
+ */
+struct AptFileIndexHeader {
+    char magic[8];
+    guint64 statusMtime;
+    guint32 nPackages;
+    guint32 nEntries;
+    guint32 poolSize;
+    guint32 reserved;
+};
+
+struct AptFileIndexPackage {
+    guint64 mtime;
+    guint64 size;
+    guint32 name;
+    guint32 firstEntry;
+    guint32 nEntries;
+    guint32 flags;
+};
+
+struct AptFileIndexEntry {
+    guint32 path;
+    guint32 basename;
+    guint32 package;
+};
+
+static guint64 stat_mtime(const struct stat &buf)
+{
+    return (guint64) buf.st_mtim.tv_sec * G_GUINT64_CONSTANT(1000000000) +
+           buf.st_mtim.tv_nsec;
+}
+
+static guint32 pool_add(string &pool, const char *str, size_t len)
+{
+    guint32 offset = pool.size();
+    pool.append(str, len);
+    pool.push_back('\0');
+    return offset;
+}
+
+static void entry_add(string &pool,
+                      vector<AptFileIndexEntry> &entries,
+                      guint32 package,
+                      const char *path,
+                      size_t len)
+{
+    AptFileIndexEntry entry;
+    const char *slash = (const char *) memrchr(path, '/', len);
+
+    entry.path = pool_add(pool, path, len);
+    entry.basename = entry.path + (slash == NULL ? 0 : slash - path + 1);
+    entry.package = package;
+    entries.push_back(entry);
+}
+
+struct AptFileIndexCompare {
+    const char *pool;
+    const vector<AptFileIndexEntry> *entries;
+    bool byBasename;
+
+    bool operator()(guint32 a, guint32 b) const {
+        const AptFileIndexEntry &ea = (*entries)[a];
+        const AptFileIndexEntry &eb = (*entries)[b];
+        if (byBasename) {
+            return strcmp(pool + ea.basename, pool + eb.basename) < 0;
+        }
+        return strcmp(pool + ea.path, pool + eb.path) < 0;
+    }
+};
+
+AptFileIndex::AptFileIndex(const string &indexFile,
+                           const string &infoDir,
+                           const string &statusFile) :
+    m_indexFile(indexFile),
+    m_infoDir(infoDir),
+    m_statusFile(statusFile),
+    m_mapped(0),
+    m_data(0),
+    m_size(0),
+    m_listsRead(0)
+{
+}
+
+AptFileIndex::~AptFileIndex()
+{
+    close();
+}
+
+bool AptFileIndex::open()
+{
+    struct stat buf;
+
+    if (stat(m_statusFile.c_str(), &buf) != 0) {
+        g_debug("Failed to stat %s", m_statusFile.c_str());
+        return false;
+    }
+
+    m_listsRead = 0;
+    if (load() && header()->statusMtime == stat_mtime(buf)) {
+        return true;
+    }
+    return rebuild(stat_mtime(buf));
+}
+
+vector<string> AptFileIndex::lookup(const char *value) const
+{
+    vector<string> names;
+    if (m_data == 0 || value == 0 || value[0] == '\0') {
+        return names;
+    }
+
+    // files are only ever searched by full path or by basename
+    bool byBasename = value[0] != '/';
+    guint32 n = header()->nEntries;
+    guint32 lo = 0;
+    guint32 hi = n;
+    while (lo < hi) {
+        guint32 mid = lo + (hi - lo) / 2;
+        if (strcmp(key(mid, byBasename), value) < 0) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+
+    for (; lo < n && strcmp(key(lo, byBasename), value) == 0; ++lo) {
+        guint32 package = entries()[sorted(byBasename)[lo]].package;
+        if (package >= header()->nPackages) {
+            continue;
+        }
+        string name = str(packages()[package].name);
+        if (find(names.begin(), names.end(), name) == names.end()) {
+            names.push_back(name);
+        }
+    }
+    return names;
+}
+
+bool AptFileIndex::hasDesktopFile(const char *name, const char *arch) const
+{
+    // Multi-Arch: same packages have their arch in the .list file name
+    string qualified = string(name) + ":" + arch;
+    const AptFileIndexPackage *pkg = findPackage(qualified.c_str());
+    if (pkg == 0) {
+        pkg = findPackage(name);
+    }
+    return pkg != 0 && (pkg->flags & APT_FILE_INDEX_DESKTOP);
+}
+
+guint AptFileIndex::listsRead() const
+{
+    return m_listsRead;
+}
+
+bool AptFileIndex::load()
+{
+    GError *error = NULL;
+
+    close();
+    m_mapped = g_mapped_file_new(m_indexFile.c_str(), FALSE, &error);
+    if (m_mapped == NULL) {
+        g_debug("Failed to map %s: %s", m_indexFile.c_str(), error->message);
+        g_error_free(error);
+        return false;
+    }
+    m_data = g_mapped_file_get_contents(m_mapped);
+    m_size = g_mapped_file_get_length(m_mapped);
+    if (!check()) {
+        g_debug("Ignoring invalid %s", m_indexFile.c_str());
+        close();
+        return false;
+    }
+    return true;
+}
+
+bool AptFileIndex::rebuild(guint64 statusMtime)
+{
+    DIR *dp;
+    struct dirent *dirp;
+    struct stat buf;
+    GError *error = NULL;
+    AptFileIndexHeader head;
+    map<string, guint32> previous;
+    vector<string> names;
+    vector<AptFileIndexPackage> pkgs;
+    vector<AptFileIndexEntry> ents;
+    vector<guint32> byPath;
+    vector<guint32> byBasename;
+    string pool;
+    string line;
+
+    // the stale index tells us which .list files we can skip
+    for (guint32 i = 0; m_data != 0 && i < header()->nPackages; ++i) {
+        previous[str(packages()[i].name)] = i;
+    }
+
+    if (!(dp = opendir(m_infoDir.c_str()))) {
+        g_debug("Error opening %s", m_infoDir.c_str());
+        return false;
+    }
+
+    while ((dirp = readdir(dp)) != NULL) {
+        string name(dirp->d_name);
+        if (ends_with(name, ".list")) {
+            names.push_back(name.substr(0, name.size() - 5));
+        }
+    }
+    closedir(dp);
+
+    // packages are looked up by name with a binary search
+    sort(names.begin(), names.end());
+
+    for (vector<string>::const_iterator name = names.begin(); name != names.end(); ++name) {
+        string f = m_infoDir + *name + ".list";
+        if (stat(f.c_str(), &buf) != 0) {
+            continue;
+        }
+
+        AptFileIndexPackage pkg;
+        memset(&pkg, 0, sizeof(pkg));
+        pkg.mtime = stat_mtime(buf);
+        pkg.size = buf.st_size;
+        pkg.name = pool_add(pool, name->c_str(), name->size());
+        pkg.firstEntry = ents.size();
+
+        map<string, guint32>::const_iterator it = previous.find(*name);
+        if (it != previous.end() &&
+            packages()[it->second].mtime == pkg.mtime &&
+            packages()[it->second].size == pkg.size) {
+            const AptFileIndexPackage &old = packages()[it->second];
+            pkg.flags = old.flags;
+            for (guint32 i = 0; i < old.nEntries; ++i) {
+                guint32 idx = old.firstEntry + i;
+                if (idx >= header()->nEntries) {
+                    break;
+                }
+                const char *path = str(entries()[idx].path);
+                entry_add(pool, ents, pkgs.size(), path, strlen(path));
+            }
+        } else {
+            ifstream in(f.c_str());
+            if (!in != 0) {
+                continue;
+            }
+            while (getline(in, line)) {
+                if (!line.empty()) {
+                    entry_add(pool, ents, pkgs.size(), line.c_str(), line.size());
+                }
+                if (ends_with(line, ".desktop")) {
+                    pkg.flags |= APT_FILE_INDEX_DESKTOP;
+                }
+            }
+            m_listsRead++;
+        }
+        pkg.nEntries = ents.size() - pkg.firstEntry;
+        pkgs.push_back(pkg);
+    }
+
+    AptFileIndexCompare compare;
+    compare.pool = pool.data();
+    compare.entries = &ents;
+    for (guint32 i = 0; i < ents.size(); ++i) {
+        byPath.push_back(i);
+    }
+    byBasename = byPath;
+    compare.byBasename = false;
+    sort(byPath.begin(), byPath.end(), compare);
+    compare.byBasename = true;
+    sort(byBasename.begin(), byBasename.end(), compare);
+
+    memset(&head, 0, sizeof(head));
+    memcpy(head.magic, APT_FILE_INDEX_MAGIC, sizeof(head.magic));
+    head.statusMtime = statusMtime;
+    head.nPackages = pkgs.size();
+    head.nEntries = ents.size();
+    head.poolSize = pool.size();
+
+    close();
+    m_buffer.clear();
+    m_buffer.append((const char *) &head, sizeof(head));
+    if (!pkgs.empty()) {
+        m_buffer.append((const char *) &pkgs[0], pkgs.size() * sizeof(AptFileIndexPackage));
+    }
+    if (!ents.empty()) {
+        m_buffer.append((const char *) &ents[0], ents.size() * sizeof(AptFileIndexEntry));
+        m_buffer.append((const char *) &byPath[0], byPath.size() * sizeof(guint32));
+        m_buffer.append((const char *) &byBasename[0], byBasename.size() * sizeof(guint32));
+    }
+    m_buffer.append(pool);
+    m_data = m_buffer.data();
+    m_size = m_buffer.size();
+    g_debug("Indexed %u files of %u packages, %u .list files read",
+            head.nEntries, head.nPackages, m_listsRead);
+
+    // the index is still usable from memory if it cannot be saved
+    gchar *dirname = g_path_get_dirname(m_indexFile.c_str());
+    g_mkdir_with_parents(dirname, 0755);
+    g_free(dirname);
+    if (!g_file_set_contents(m_indexFile.c_str(), m_data, m_size, &error)) {
+        g_debug("Failed to save %s: %s", m_indexFile.c_str(), error->message);
+        g_error_free(error);
+    }
+    return true;
+}
+
+void AptFileIndex::close()
+{
+    if (m_mapped != 0) {
+        g_mapped_file_unref(m_mapped);
+        m_mapped = 0;
+    }
+    m_buffer.clear();
+    m_data = 0;
+    m_size = 0;
+}
+
+bool AptFileIndex::check() const
+{
+    if (m_data == 0 || m_size < sizeof(AptFileIndexHeader)) {
+        return false;
+    }
+
+    const AptFileIndexHeader *head = header();
+    if (memcmp(head->magic, APT_FILE_INDEX_MAGIC, sizeof(head->magic)) != 0) {
+        return false;
+    }
+
+    guint64 size = sizeof(AptFileIndexHeader);
+    size += (guint64) head->nPackages * sizeof(AptFileIndexPackage);
+    size += (guint64) head->nEntries * sizeof(AptFileIndexEntry);
+    size += (guint64) head->nEntries * sizeof(guint32) * 2;
+    size += head->poolSize;
+    if (size != m_size) {
+        return false;
+    }
+
+    // every string lookup relies on the pool being terminated
+    return head->poolSize == 0 || m_data[m_size - 1] == '\0';
+}
+
+const AptFileIndexPackage *AptFileIndex::findPackage(const char *name) const
+{
+    if (m_data == 0) {
+        return 0;
+    }
+
+    guint32 lo = 0;
+    guint32 hi = header()->nPackages;
+    while (lo < hi) {
+        guint32 mid = lo + (hi - lo) / 2;
+        int cmp = strcmp(str(packages()[mid].name), name);
+        if (cmp == 0) {
+            return packages() + mid;
+        } else if (cmp < 0) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return 0;
+}
+
+const char *AptFileIndex::str(guint32 offset) const
+{
+    if (offset >= header()->poolSize) {
+        return "";
+    }
+    return m_data + m_size - header()->poolSize + offset;
+}
+
+const char *AptFileIndex::key(guint32 position, bool byBasename) const
+{
+    guint32 idx = sorted(byBasename)[position];
+    if (idx >= header()->nEntries) {
+        return "";
+    }
+    if (byBasename) {
+        return str(entries()[idx].basename);
+    }
+    return str(entries()[idx].path);
+}
+
+const AptFileIndexHeader *AptFileIndex::header() const
+{
+    return (const AptFileIndexHeader *) m_data;
+}
+
+const AptFileIndexPackage *AptFileIndex::packages() const
+{
+    return (const AptFileIndexPackage *) (m_data + sizeof(AptFileIndexHeader));
+}
+
+const AptFileIndexEntry *AptFileIndex::entries() const
+{
+    return (const AptFileIndexEntry *) (packages() + header()->nPackages);
+}
+
+const guint32 *AptFileIndex::sorted(bool byBasename) const
+{
+    const guint32 *byPath = (const guint32 *) (entries() + header()->nEntries);
+    return byBasename ? byPath + header()->nEntries : byPath;
+}
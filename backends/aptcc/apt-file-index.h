@@ -0,0 +1,101 @@
+/* apt-file-index.h - Index of the files owned by installed packages
+ *
+ * Copyright (c) 2014 Daniel Nicoletti <dantti12@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#ifndef APT_FILE_INDEX_H
+#define APT_FILE_INDEX_H
+
+#include <glib.h>
+
+#include <string>
+#include <vector>
+
+#define DPKG_STATUS_FILE     "/var/lib/dpkg/status"
+#define DPKG_INFO_DIR        "/var/lib/dpkg/info/"
+#define APTCC_FILE_INDEX     "/var/cache/PackageKit/aptcc/files.index"
+
+using namespace std;
+
+struct AptFileIndexHeader;
+struct AptFileIndexPackage;
+struct AptFileIndexEntry;
+
+/**
+  * A path to package name index built from the dpkg .list files.
+  *
+  * The index is a single file that is mapped read only, with the entries
+  * sorted both by full path and by basename so that lookups are a binary
+  * search. It is tagged with the mtime of the dpkg status file, and when
+  * that changes only the .list files whose mtime changed are read again.
+  * It also records which packages ship a .desktop file.
+  */
+class AptFileIndex
+{
+public:
+    AptFileIndex(const string &indexFile = APTCC_FILE_INDEX,
+                 const string &infoDir = DPKG_INFO_DIR,
+                 const string &statusFile = DPKG_STATUS_FILE);
+    ~AptFileIndex();
+
+    /**
+      * Maps the index, updating it first if dpkg changed anything
+      * @returns false if neither the index nor the .list files could be read
+      */
+    bool open();
+
+    /**
+      * Finds the packages owning a file, matching the full path if
+      * @value starts with a '/' and the basename otherwise
+      */
+    vector<string> lookup(const char *value) const;
+
+    /**
+      * @returns true if the installed package ships a .desktop file
+      */
+    bool hasDesktopFile(const char *name, const char *arch) const;
+
+    /**
+      * @returns the number of .list files that were read by the last open()
+      */
+    guint listsRead() const;
+
+private:
+    bool load();
+    bool rebuild(guint64 statusMtime);
+    void close();
+    bool check() const;
+    const AptFileIndexPackage *findPackage(const char *name) const;
+    const char *str(guint32 offset) const;
+    const char *key(guint32 position, bool byBasename) const;
+    const AptFileIndexHeader *header() const;
+    const AptFileIndexPackage *packages() const;
+    const AptFileIndexEntry *entries() const;
+    const guint32 *sorted(bool byBasename) const;
+
+    string m_indexFile;
+    string m_infoDir;
+    string m_statusFile;
+    GMappedFile *m_mapped;
+    string m_buffer;
+    const char *m_data;
+    gsize m_size;
+    guint m_listsRead;
+};
+
+#endif
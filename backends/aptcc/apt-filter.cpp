@@ -0,0 +1,180 @@
+/* apt-filter.cpp - Filters compiled to bitmask tests
+ *
+ * Copyright (c) 2014 Daniel Nicoletti <dantti12@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#include "apt-filter.h"
+
+#include "apt-utils.h"
+
+#include <apt-pkg/configuration.h>
+
+#include <string.h>
+
+static bool name_ends_with(const char *name, const char *end)
+{
+    size_t nameLen = strlen(name);
+    size_t endLen = strlen(end);
+    return nameLen >= endLen && memcmp(name + nameLen - endLen, end, endLen) == 0;
+}
+
+const SectionInfo &SectionCache::lookup(const char *section)
+{
+    map<const char *, SectionInfo>::const_iterator it = m_sections.find(section);
+    if (it != m_sections.end()) {
+        return it->second;
+    }
+
+    string str = section == NULL ? "" : section;
+    string name, component;
+
+    size_t found;
+    found = str.find_last_of("/");
+    name = str.substr(found + 1);
+    if (found == str.npos) {
+        component = "main";
+    } else {
+        component = str.substr(0, found);
+    }
+
+    SectionInfo info;
+    info.group = get_enum_group(name);
+    info.attributes = 0;
+    if (name == "devel" || name == "libdevel") {
+        info.attributes |= Devel;
+    }
+    if (name == "x11" || name == "gnome" || name == "kde" || name == "graphics") {
+        info.attributes |= Gui;
+    }
+    // Must be in main and universe to be free
+    if (component == "main" || component == "universe") {
+        info.attributes |= Free;
+    }
+    if (component.empty() ||
+            component == "main" ||
+            component == "restricted" ||
+            component == "unstable" ||
+            component == "testing") {
+        info.attributes |= SupportedComponent;
+    }
+
+    return m_sections[section] = info;
+}
+
+PkgFilter::PkgFilter(PkBitfield filters, bool isMultiArch) :
+    m_filters(filters),
+    m_required(0),
+    m_forbidden(0),
+    m_checkArch(false),
+    m_checkDevel(false),
+    m_checkSupported(false)
+{
+    if (pk_bitfield_contain(filters, PK_FILTER_ENUM_NOT_INSTALLED)) {
+        m_forbidden |= Installed;
+    }
+    if (pk_bitfield_contain(filters, PK_FILTER_ENUM_INSTALLED)) {
+        m_required |= Installed;
+    }
+
+    // if we are on multiarch check also the arch filter
+    if (isMultiArch && pk_bitfield_contain(filters, PK_FILTER_ENUM_ARCH)) {
+        m_checkArch = true;
+        m_nativeArch = _config->Find("APT::Architecture");
+        m_required |= NativeArch;
+    }
+
+    if (pk_bitfield_contain(filters, PK_FILTER_ENUM_DEVELOPMENT)) {
+        m_checkDevel = true;
+        m_required |= SectionCache::Devel;
+    } else if (pk_bitfield_contain(filters, PK_FILTER_ENUM_NOT_DEVELOPMENT)) {
+        m_checkDevel = true;
+        m_forbidden |= SectionCache::Devel;
+    }
+
+    if (pk_bitfield_contain(filters, PK_FILTER_ENUM_GUI)) {
+        m_required |= SectionCache::Gui;
+    } else if (pk_bitfield_contain(filters, PK_FILTER_ENUM_NOT_GUI)) {
+        m_forbidden |= SectionCache::Gui;
+    }
+
+    if (pk_bitfield_contain(filters, PK_FILTER_ENUM_FREE)) {
+        m_required |= SectionCache::Free;
+    } else if (pk_bitfield_contain(filters, PK_FILTER_ENUM_NOT_FREE)) {
+        m_forbidden |= SectionCache::Free;
+    }
+
+    if (pk_bitfield_contain(filters, PK_FILTER_ENUM_SUPPORTED)) {
+        m_checkSupported = true;
+        m_required |= Supported;
+    } else if (pk_bitfield_contain(filters, PK_FILTER_ENUM_NOT_SUPPORTED)) {
+        m_checkSupported = true;
+        m_forbidden |= Supported;
+    }
+
+    // We do not support checking if it is an Application
+    // if NOT installed
+    if (pk_bitfield_contain(filters, PK_FILTER_ENUM_APPLICATION) ||
+            pk_bitfield_contain(filters, PK_FILTER_ENUM_NOT_APPLICATION)) {
+        m_required |= Installed;
+    }
+}
+
+PkBitfield PkgFilter::filters() const
+{
+    return m_filters;
+}
+
+guint PkgFilter::attributes(const pkgCache::VerIterator &ver)
+{
+    const pkgCache::PkgIterator &pkg = ver.ParentPkg();
+    guint ret = m_sections.lookup(ver.Section()).attributes;
+
+    if (pkg->CurrentState == pkgCache::State::Installed && pkg.CurrentVer() == ver) {
+        ret |= Installed;
+    }
+
+    if (m_checkArch) {
+        const char *arch = ver.Arch();
+        if (strcmp(arch, "all") == 0 || m_nativeArch.compare(arch) == 0) {
+            ret |= NativeArch;
+        }
+    }
+
+    if (m_checkDevel) {
+        if (name_ends_with(pkg.Name(), "-dev") || name_ends_with(pkg.Name(), "-dbg")) {
+            ret |= SectionCache::Devel;
+        }
+    }
+
+    // Check if package is officially supported by the current distribution
+    if (m_checkSupported && (ret & SectionCache::SupportedComponent)) {
+        const char *origin = ver.FileList().File().Origin();
+        if (origin != NULL &&
+                (strcmp(origin, "Debian") == 0 || strcmp(origin, "Ubuntu") == 0)) {
+            ret |= Supported;
+        }
+    }
+
+    return ret;
+}
+
+bool PkgFilter::matches(const pkgCache::VerIterator &ver)
+{
+    guint attrs = attributes(ver);
+    return (attrs & m_required) == m_required && (attrs & m_forbidden) == 0;
+}
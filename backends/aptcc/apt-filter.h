@@ -0,0 +1,102 @@
+/* apt-filter.h - Filters compiled to bitmask tests
+ *
+ * Copyright (c) 2014 Daniel Nicoletti <dantti12@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#ifndef APT_FILTER_H
+#define APT_FILTER_H
+
+#include <apt-pkg/pkgcache.h>
+#include <packagekit-glib2/packagekit.h>
+
+#include <map>
+#include <string>
+
+using namespace std;
+
+/**
+  * What can be told about a package from its section string
+  */
+struct SectionInfo
+{
+    PkGroupEnum group;
+    guint attributes;
+};
+
+/**
+  * Maps section strings to their attributes.
+  *
+  * Section strings are stored only once in the package cache, so the
+  * cache is keyed by their address and each section is parsed once.
+  */
+class SectionCache
+{
+public:
+    enum {
+        Devel              = 1 << 0,
+        Gui                = 1 << 1,
+        Free               = 1 << 2,
+        SupportedComponent = 1 << 3
+    };
+
+    const SectionInfo &lookup(const char *section);
+
+private:
+    map<const char *, SectionInfo> m_sections;
+};
+
+/**
+  * A PkBitfield compiled once into the attributes a package must have
+  * and the ones it must not have.
+  *
+  * The application filters need the dpkg file list, so they are not
+  * checked here, only that the package is installed.
+  */
+class PkgFilter
+{
+public:
+    PkgFilter(PkBitfield filters, bool isMultiArch);
+
+    PkBitfield filters() const;
+
+    /**
+      * @returns true if the version passed the filters
+      */
+    bool matches(const pkgCache::VerIterator &ver);
+
+private:
+    enum {
+        // the first bits are the SectionCache ones
+        Installed  = 1 << 8,
+        NativeArch = 1 << 9,
+        Supported  = 1 << 10
+    };
+
+    guint attributes(const pkgCache::VerIterator &ver);
+
+    PkBitfield m_filters;
+    guint m_required;
+    guint m_forbidden;
+    bool m_checkArch;
+    bool m_checkDevel;
+    bool m_checkSupported;
+    string m_nativeArch;
+    SectionCache m_sections;
+};
+
+#endif
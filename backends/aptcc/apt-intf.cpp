@@ -36,10 +36,13 @@
 #include <sys/fcntl.h>
 #include <pty.h>
 
+#include <algorithm>
 #include <fstream>
 #include <dirent.h>
 
 #include "AptCacheFile.h"
+#include "apt-file-index.h"
+#include "apt-filter.h"
 #include "apt-utils.h"
 #include "matcher.h"
 #include "gstMatcher.h"
@@ -50,12 +53,253 @@
 
 #define RAMFS_MAGIC     0x858458f6
 
+// below this many packages per shard a scan is not worth a thread
+#define SCAN_SHARD_MIN_PACKAGES 2000
+
+/**
+  * Decides what a scan over the whole package cache outputs for each
+  * package. Every shard of a scan runs on its own clone() with its own
+  * records parser.
+  */
+class PkgScanner
+{
+public:
+    PkgScanner(bool needsRecords = false) : m_needsRecords(needsRecords) {}
+    virtual ~PkgScanner() {}
+
+    virtual PkgScanner* clone() const = 0;
+
+    virtual void scan(AptCacheFile *cache,
+                      pkgRecords *records,
+                      const pkgCache::PkgIterator &pkg,
+                      PkgList &output) = 0;
+
+    bool needsRecords() const { return m_needsRecords; }
+
+private:
+    bool m_needsRecords;
+};
+
+// counts the shards of a scan that are still running
+struct PkgScanPending
+{
+    GMutex mutex;
+    GCond cond;
+    guint count;
+};
+
+struct PkgScanShard
+{
+    AptCacheFile *cache;
+    PkgScanner *scanner;
+    const bool *cancel;
+    vector<pkgCache::Package*>::const_iterator begin;
+    vector<pkgCache::Package*>::const_iterator end;
+    PkgList output;
+    PkgScanPending *pending;
+};
+
+static GThreadPool *scanPool = 0;
+
+static void scan_shard(PkgScanShard *shard)
+{
+    pkgCache *cache = shard->cache->GetPkgCache();
+    pkgRecords *records = 0;
+
+    // regexec() serializes the callers of a compiled pattern and the
+    // records parsers keep a read position, so shards share neither
+    PkgScanner *scanner = shard->scanner->clone();
+    if (scanner->needsRecords()) {
+        records = new pkgRecords(*cache);
+    }
+
+    for (vector<pkgCache::Package*>::const_iterator it = shard->begin;
+         it != shard->end; ++it) {
+        if (*shard->cancel) {
+            break;
+        }
+        scanner->scan(shard->cache,
+                      records,
+                      pkgCache::PkgIterator(*cache, *it),
+                      shard->output);
+    }
+
+    delete records;
+    delete scanner;
+}
+
+static void scan_shard_pool(gpointer data, gpointer)
+{
+    PkgScanShard *shard = static_cast<PkgScanShard*>(data);
+    scan_shard(shard);
+
+    g_mutex_lock(&shard->pending->mutex);
+    if (--shard->pending->count == 0) {
+        g_cond_signal(&shard->pending->cond);
+    }
+    g_mutex_unlock(&shard->pending->mutex);
+}
+
+// adds the packages providing a virtual package
+static void add_providers(AptCacheFile *cache,
+                          const pkgCache::PkgIterator &pkg,
+                          PkgList &output)
+{
+    for (pkgCache::PrvIterator Prv = pkg.ProvidesList(); Prv.end() == false; ++Prv) {
+        const pkgCache::VerIterator &ownerVer = cache->findVer(Prv.OwnerPkg());
+
+        // check to see if the provided package isn't virtual too
+        if (ownerVer.end() == false) {
+            // we add the package now because we will need to
+            // remove duplicates later anyway
+            output.push_back(ownerVer);
+        }
+    }
+}
+
+class PackageScanner : public PkgScanner
+{
+public:
+    PkgScanner* clone() const { return new PackageScanner(); }
+
+    void scan(AptCacheFile *cache, pkgRecords *, const pkgCache::PkgIterator &pkg, PkgList &output) {
+        // Don't insert virtual packages as they don't have all kinds of info
+        const pkgCache::VerIterator &ver = cache->findVer(pkg);
+        if (ver.end() == false) {
+            output.push_back(ver);
+        }
+    }
+};
+
+class GroupScanner : public PkgScanner
+{
+public:
+    GroupScanner(const vector<PkGroupEnum> &groups) : m_groups(groups) {}
+
+    PkgScanner* clone() const { return new GroupScanner(m_groups); }
+
+    void scan(AptCacheFile *cache, pkgRecords *, const pkgCache::PkgIterator &pkg, PkgList &output) {
+        // Ignore virtual packages
+        const pkgCache::VerIterator &ver = cache->findVer(pkg);
+        if (ver.end() == true) {
+            return;
+        }
+
+        PkGroupEnum group = m_sections.lookup(pkg.VersionList().Section()).group;
+        if (find(m_groups.begin(), m_groups.end(), group) != m_groups.end()) {
+            output.push_back(ver);
+        }
+    }
+
+private:
+    const vector<PkGroupEnum> &m_groups;
+    SectionCache m_sections;
+};
+
+class NameScanner : public PkgScanner
+{
+public:
+    NameScanner(const string &search) : m_search(search), m_matcher(search) {}
+
+    PkgScanner* clone() const { return new NameScanner(m_search); }
+
+    bool hasError() const { return m_matcher.hasError(); }
+
+    void scan(AptCacheFile *cache, pkgRecords *, const pkgCache::PkgIterator &pkg, PkgList &output) {
+        if (!m_matcher.matches(pkg.Name())) {
+            return;
+        }
+
+        // Don't insert virtual packages instead add what it provides
+        const pkgCache::VerIterator &ver = cache->findVer(pkg);
+        if (ver.end() == false) {
+            output.push_back(ver);
+        } else {
+            add_providers(cache, pkg, output);
+        }
+    }
+
+private:
+    string m_search;
+    Matcher m_matcher;
+};
+
+class DetailsScanner : public PkgScanner
+{
+public:
+    DetailsScanner(const string &search) : PkgScanner(true), m_search(search), m_matcher(search) {}
+
+    PkgScanner* clone() const { return new DetailsScanner(m_search); }
+
+    bool hasError() const { return m_matcher.hasError(); }
+
+    void scan(AptCacheFile *cache, pkgRecords *records, const pkgCache::PkgIterator &pkg, PkgList &output) {
+        const pkgCache::VerIterator &ver = cache->findVer(pkg);
+        if (ver.end() == false) {
+            if (m_matcher.matches(pkg.Name()) ||
+                    m_matcher.matches(cache->getLongDescription(ver, records))) {
+                // The package matched
+                output.push_back(ver);
+            }
+        } else if (m_matcher.matches(pkg.Name())) {
+            // The package is virtual and MATCHED the name
+            // Don't insert virtual packages instead add what it provides
+            add_providers(cache, pkg, output);
+        }
+    }
+
+private:
+    string m_search;
+    Matcher m_matcher;
+};
+
+/**
+  * The clones share the GstMatcher, which is only read while scanning:
+  * its caps are never changed after they were parsed, and
+  * gst_caps_can_intersect() is safe on caps shared between threads.
+  * A matcher per clone can't be used as each one would gst_deinit().
+  */
+class CodecScanner : public PkgScanner
+{
+public:
+    CodecScanner(const GstMatcher &matcher) : PkgScanner(true), m_matcher(matcher) {}
+
+    PkgScanner* clone() const { return new CodecScanner(m_matcher); }
+
+    void scan(AptCacheFile *cache, pkgRecords *records, const pkgCache::PkgIterator &pkg, PkgList &output) {
+        // TODO search in updates packages
+        // Ignore virtual packages
+        pkgCache::VerIterator ver = cache->findVer(pkg);
+        if (ver.end() == true) {
+            ver = cache->findCandidateVer(pkg);
+            if (ver.end() == true) {
+                return;
+            }
+        }
+
+        pkgCache::VerFileIterator vf = ver.FileList();
+        pkgRecords::Parser &rec = records->Lookup(vf);
+        const char *start, *stop;
+        rec.GetRec(start, stop);
+        string record(start, stop - start);
+        if (m_matcher.matches(record)) {
+            output.push_back(ver);
+        }
+    }
+
+private:
+    const GstMatcher &m_matcher;
+};
+
 AptIntf::AptIntf(PkBackendJob *job) :
     m_job(job),
     m_cancel(false),
     m_terminalTimeout(120),
     m_lastSubProgress(0),
-    m_cache(0)
+    m_cache(0),
+    m_sharedCache(false),
+    m_filter(0),
+    m_fileIndex(0)
 {
     m_cancel = false;
 
@@ -63,6 +307,112 @@ AptIntf::AptIntf(PkBackendJob *job) :
     m_restartStat.st_mtime = 0;
 }
 
+/**
+  * Roles that only read the package cache, without marking anything
+  * in the dependency cache, can share it with the next job
+  */
+static bool role_can_share_cache(PkRoleEnum role)
+{
+    switch (role) {
+    case PK_ROLE_ENUM_DEPENDS_ON:
+    case PK_ROLE_ENUM_GET_DETAILS:
+    case PK_ROLE_ENUM_GET_FILES:
+    case PK_ROLE_ENUM_GET_PACKAGES:
+    case PK_ROLE_ENUM_REQUIRED_BY:
+    case PK_ROLE_ENUM_RESOLVE:
+    case PK_ROLE_ENUM_SEARCH_DETAILS:
+    case PK_ROLE_ENUM_SEARCH_FILE:
+    case PK_ROLE_ENUM_SEARCH_GROUP:
+    case PK_ROLE_ENUM_SEARCH_NAME:
+    case PK_ROLE_ENUM_WHAT_PROVIDES:
+        return true;
+    default:
+        return false;
+    }
+}
+
+void AptIntf::createScanPool()
+{
+    // the first shard of a scan runs on the job thread
+    gint threads = MAX((gint) g_get_num_processors() - 1, 1);
+    GError *error = NULL;
+
+    scanPool = g_thread_pool_new(scan_shard_pool, NULL, threads, TRUE, &error);
+    if (scanPool == NULL) {
+        g_warning("failed to start the scan threads: %s", error->message);
+        g_error_free(error);
+    }
+}
+
+void AptIntf::freeScanPool()
+{
+    if (scanPool != NULL) {
+        g_thread_pool_free(scanPool, TRUE, TRUE);
+        scanPool = 0;
+    }
+}
+
+PkgList AptIntf::scanPackages(PkgScanner &scanner)
+{
+    PkgList output;
+    vector<pkgCache::Package*> packages;
+    pkgCache *cache = m_cache->GetPkgCache();
+
+    // make sure nothing is built lazily from the shards
+    m_cache->GetDepCache();
+
+    // Ignore packages that exist only due to dependencies.
+    packages.reserve(cache->HeaderP->PackageCount);
+    for (pkgCache::PkgIterator pkg = cache->PkgBegin(); !pkg.end(); ++pkg) {
+        if (pkg.VersionList().end() && pkg.ProvidesList().end()) {
+            continue;
+        }
+        packages.push_back(&(*pkg));
+    }
+
+    guint nShards = MIN((guint) g_get_num_processors(),
+                        packages.size() / SCAN_SHARD_MIN_PACKAGES);
+    if (scanPool == NULL) {
+        nShards = 1;
+    }
+    nShards = MAX(nShards, 1);
+
+    PkgScanPending pending;
+    g_mutex_init(&pending.mutex);
+    g_cond_init(&pending.cond);
+    pending.count = nShards - 1;
+
+    vector<PkgScanShard> shards(nShards);
+    for (guint i = 0; i < nShards; ++i) {
+        shards[i].cache = m_cache;
+        shards[i].scanner = &scanner;
+        shards[i].cancel = &m_cancel;
+        shards[i].begin = packages.begin() + packages.size() * i / nShards;
+        shards[i].end = packages.begin() + packages.size() * (i + 1) / nShards;
+        shards[i].pending = &pending;
+    }
+
+    // the first shard runs on this thread, the others on the pool
+    for (guint i = 1; i < nShards; ++i) {
+        g_thread_pool_push(scanPool, &shards[i], NULL);
+    }
+    scan_shard(&shards[0]);
+
+    g_mutex_lock(&pending.mutex);
+    while (pending.count > 0) {
+        g_cond_wait(&pending.cond, &pending.mutex);
+    }
+    g_mutex_unlock(&pending.mutex);
+    g_cond_clear(&pending.cond);
+    g_mutex_clear(&pending.mutex);
+
+    // merge in shard order so the result doesn't depend on the timing
+    for (guint i = 0; i < nShards; ++i) {
+        output.insert(output.end(), shards[i].output.begin(), shards[i].output.end());
+    }
+    return output;
+}
+
 bool AptIntf::init()
 {
     gchar *locale;
@@ -126,6 +476,20 @@ bool AptIntf::init()
         withLock = !simulate;
     }
 
+    // Queries reuse the cache of the previous query if nothing changed,
+    // transactions always open it again with the lock held
+    bool shareCache = !withLock && role_can_share_cache(role);
+    if (shareCache) {
+        m_cacheStamp = AptCacheFile::databaseStamp();
+        m_cache = AptCacheFile::takeShared(m_job, m_cacheStamp);
+        if (m_cache) {
+            m_sharedCache = true;
+            return true;
+        }
+    } else if (withLock) {
+        AptCacheFile::dropShared();
+    }
+
     // Create the AptCacheFile class to search for packages
     m_cache = new AptCacheFile(m_job);
 
@@ -147,7 +511,16 @@ bool AptIntf::init()
     }
 
     // Check if there are half-installed packages and if we can fix them
-    return m_cache->CheckDeps(AllowBroken);
+    if (!m_cache->CheckDeps(AllowBroken)) {
+        return false;
+    }
+
+    // A cache with corrections for half-installed packages marked in it
+    // is not a clean starting point for the next query
+    m_sharedCache = shareCache && !m_cacheStamp.empty() &&
+                    m_cache->GetDepCache()->InstCount() == 0 &&
+                    m_cache->GetDepCache()->DelCount() == 0;
+    return true;
 }
 
 AptIntf::~AptIntf()
@@ -171,7 +544,20 @@ AptIntf::~AptIntf()
         }
     }
 
-    delete m_cache;
+    delete m_filter;
+    delete m_fileIndex;
+
+    // the job may have changed candidates or marked packages
+    // after the cache was opened
+    if (m_sharedCache) {
+        m_sharedCache = m_cache->GetDepCache()->InstCount() == 0 &&
+                        m_cache->GetDepCache()->DelCount() == 0;
+    }
+    if (m_sharedCache) {
+        AptCacheFile::releaseShared(m_cache, m_cacheStamp);
+    } else {
+        delete m_cache;
+    }
 }
 
 void AptIntf::cancel()
@@ -194,131 +580,28 @@ bool AptIntf::cancelled() const
 bool AptIntf::matchPackage(const pkgCache::VerIterator &ver, PkBitfield filters)
 {
     if (filters != 0) {
-        const pkgCache::PkgIterator &pkg = ver.ParentPkg();
-        bool installed = false;
-
-        // Check if the package is installed
-        if (pkg->CurrentState == pkgCache::State::Installed && pkg.CurrentVer() == ver) {
-            installed = true;
+        // compile the filters once, jobs almost always use the same ones
+        if (m_filter == 0 || m_filter->filters() != filters) {
+            delete m_filter;
+            m_filter = new PkgFilter(filters, m_isMultiArch);
         }
 
-        // if we are on multiarch check also the arch filter
-        if (m_isMultiArch && pk_bitfield_contain(filters, PK_FILTER_ENUM_ARCH)/* && !installed*/) {
-            // don't emit the package if it does not match
-            // the native architecture
-            if (strcmp(ver.Arch(), "all") != 0 &&
-                    strcmp(ver.Arch(), _config->Find("APT::Architecture").c_str()) != 0) {
-                return false;
-            }
-        }
-
-        std::string str = ver.Section() == NULL ? "" : ver.Section();
-        std::string section, component;
-
-        size_t found;
-        found = str.find_last_of("/");
-        section = str.substr(found + 1);
-        if(found == str.npos) {
-            component = "main";
-        } else {
-            component = str.substr(0, found);
-        }
-
-        if (pk_bitfield_contain(filters, PK_FILTER_ENUM_NOT_INSTALLED) && installed) {
-            return false;
-        } else if (pk_bitfield_contain(filters, PK_FILTER_ENUM_INSTALLED) && !installed) {
+        if (!m_filter->matches(ver)) {
             return false;
         }
 
-        if (pk_bitfield_contain(filters, PK_FILTER_ENUM_DEVELOPMENT)) {
-            // if ver.end() means unknow
-            // strcmp will be true when it's different than devel
-            std::string pkgName = pkg.Name();
-            if (!ends_with(pkgName, "-dev") &&
-                    !ends_with(pkgName, "-dbg") &&
-                    section.compare("devel") &&
-                    section.compare("libdevel")) {
-                return false;
-            }
-        } else if (pk_bitfield_contain(filters, PK_FILTER_ENUM_NOT_DEVELOPMENT)) {
-            std::string pkgName = pkg.Name();
-            if (ends_with(pkgName, "-dev") ||
-                    ends_with(pkgName, "-dbg") ||
-                    !section.compare("devel") ||
-                    !section.compare("libdevel")) {
-                return false;
-            }
-        }
-
-        if (pk_bitfield_contain(filters, PK_FILTER_ENUM_GUI)) {
-            // if ver.end() means unknow
-            // strcmp will be true when it's different than x11
-            if (section.compare("x11") && section.compare("gnome") &&
-                    section.compare("kde") && section.compare("graphics")) {
-                return false;
-            }
-        } else if (pk_bitfield_contain(filters, PK_FILTER_ENUM_NOT_GUI)) {
-            if (!section.compare("x11") || !section.compare("gnome") ||
-                    !section.compare("kde") || !section.compare("graphics")) {
-                return false;
-            }
-        }
-
-        if (pk_bitfield_contain(filters, PK_FILTER_ENUM_FREE)) {
-            if (component.compare("main") != 0 &&
-                    component.compare("universe") != 0) {
-                // Must be in main and universe to be free
-                return false;
-            }
-        } else if (pk_bitfield_contain(filters, PK_FILTER_ENUM_NOT_FREE)) {
-            if (component.compare("main") == 0 ||
-                    component.compare("universe") == 0) {
-                // Must not be in main or universe to be free
-                return false;
-            }
-        }
-
-        // Check for supported packages
-        if (pk_bitfield_contain(filters, PK_FILTER_ENUM_SUPPORTED)) {
-            if (!packageIsSupported(ver, component)) {
-                return false;
-            }
-        } else if (pk_bitfield_contain(filters, PK_FILTER_ENUM_NOT_SUPPORTED)) {
-            if (packageIsSupported(ver, component)) {
-                return false;
-            }
-        }
-
         // Check for applications, if they have files with .desktop
+        // the filter already made sure the package is installed and
+        // the file index answers without reading the .list file
         if (pk_bitfield_contain(filters, PK_FILTER_ENUM_APPLICATION)) {
-            // We do not support checking if it is an Application
-            // if NOT installed
-            if (!installed || !isApplication(ver)) {
+            if (!isApplication(ver)) {
                 return false;
             }
         } else if (pk_bitfield_contain(filters, PK_FILTER_ENUM_NOT_APPLICATION)) {
-            // We do not support checking if it is an Application
-            // if NOT installed
-            if (!installed || isApplication(ver)) {
-                return false;
-            }
-        }
-
-        // TODO test this one..
-#if 0
-        // I couldn'tfind any packages with the metapackages component, and I
-        // think the check is the wrong way around; PK_FILTER_ENUM_COLLECTIONS
-        // is for virtual group packages -- hughsie
-        if (pk_bitfield_contain(filters, PK_FILTER_ENUM_COLLECTIONS)) {
-            if (!component.compare("metapackages")) {
-                return false;
-            }
-        } else if (pk_bitfield_contain(filters, PK_FILTER_ENUM_NOT_COLLECTIONS)) {
-            if (component.compare("metapackages")) {
+            if (isApplication(ver)) {
                 return false;
             }
         }
-#endif
     }
     return true;
 }
@@ -337,6 +620,9 @@ PkgList AptIntf::filterPackages(const PkgList &packages, PkBitfield filters)
 
         // This filter is more complex so we filter it after the list has shrink
         if (pk_bitfield_contain(filters, PK_FILTER_ENUM_DOWNLOADED) && ret.size() > 0) {
+            // it changes candidate versions, which no mark count shows,
+            // so the cache is not a clean starting point for the next query
+            m_sharedCache = false;
             PkgList downloaded;
 
             pkgProblemResolver Fix(*m_cache);
@@ -502,43 +788,14 @@ void AptIntf::emitUpdates(PkgList &output, PkBitfield filters)
 // search packages which provide a codec (specified in "values")
 void AptIntf::providesCodec(PkgList &output, gchar **values)
 {
-    GstMatcher *matcher = new GstMatcher(values);
-    if (!matcher->hasMatches()) {
+    GstMatcher matcher(values);
+    if (!matcher.hasMatches()) {
         return;
     }
 
-    for (pkgCache::PkgIterator pkg = m_cache->GetPkgCache()->PkgBegin(); !pkg.end(); ++pkg) {
-        if (m_cancel) {
-            delete matcher;
-            break;
-        }
-
-        // Ignore packages that exist only due to dependencies.
-        if (pkg.VersionList().end() && pkg.ProvidesList().end()) {
-            continue;
-        }
-
-        // TODO search in updates packages
-        // Ignore virtual packages
-        pkgCache::VerIterator ver = m_cache->findVer(pkg);
-        if (ver.end() == true) {
-            ver = m_cache->findCandidateVer(pkg);
-            if (ver.end() == true) {
-                continue;
-            }
-        }
-
-        pkgCache::VerFileIterator vf = ver.FileList();
-        pkgRecords::Parser &rec = m_cache->GetPkgRecords()->Lookup(vf);
-        const char *start, *stop;
-        rec.GetRec(start, stop);
-        string record(start, stop - start);
-        if (matcher->matches(record)) {
-            output.push_back(ver);
-        }
-    }
-
-    delete matcher;
+    CodecScanner scanner(matcher);
+    const PkgList &found = scanPackages(scanner);
+    output.insert(output.end(), found.begin(), found.end());
 }
 
 // search packages which provide the libraries specified in "values"
@@ -1033,25 +1290,8 @@ PkgList AptIntf::getPackages()
 {
     pk_backend_job_set_status(m_job, PK_STATUS_ENUM_QUERY);
 
-    PkgList output;
-    output.reserve(m_cache->GetPkgCache()->HeaderP->PackageCount);
-    for (pkgCache::PkgIterator pkg = m_cache->GetPkgCache()->PkgBegin(); !pkg.end(); ++pkg) {
-        if (m_cancel) {
-            break;
-        }
-
-        // Ignore packages that exist only due to dependencies.
-        if(pkg.VersionList().end() && pkg.ProvidesList().end()) {
-            continue;
-        }
-
-        // Don't insert virtual packages as they don't have all kinds of info
-        const pkgCache::VerIterator &ver = m_cache->findVer(pkg);
-        if (ver.end() == false) {
-            output.push_back(ver);
-        }
-    }
-    return output;
+    PackageScanner scanner;
+    return scanPackages(scanner);
 }
 
 PkgList AptIntf::getPackagesFromRepo(SourcesList::SourceRecord *&rec)
@@ -1135,179 +1375,60 @@ PkgList AptIntf::getPackagesFromGroup(gchar **values)
 
     pk_backend_job_set_allow_cancel(m_job, true);
 
-    for (pkgCache::PkgIterator pkg = m_cache->GetPkgCache()->PkgBegin(); !pkg.end(); ++pkg) {
-        if (m_cancel) {
-            break;
-        }
-        // Ignore packages that exist only due to dependencies.
-        if (pkg.VersionList().end() && pkg.ProvidesList().end()) {
-            continue;
-        }
-
-        // Ignore virtual packages
-        const pkgCache::VerIterator &ver = m_cache->findVer(pkg);
-        if (ver.end() == false) {
-            string section = pkg.VersionList().Section() == NULL ? "" : pkg.VersionList().Section();
-
-            size_t found;
-            found = section.find_last_of("/");
-            section = section.substr(found + 1);
-
-            // Don't insert virtual packages instead add what it provides
-            for (vector<PkGroupEnum>::const_iterator it = groups.begin();
-                 it != groups.end();
-                 ++it) {
-                if (*it == get_enum_group(section)) {
-                    output.push_back(ver);
-                    break;
-                }
-            }
-        }
-    }
-    return output;
+    GroupScanner scanner(groups);
+    return scanPackages(scanner);
 }
 
 PkgList AptIntf::searchPackageName(gchar *search)
 {
     PkgList output;
 
-    Matcher *matcher = new Matcher(search);
-    if (matcher->hasError()) {
+    NameScanner scanner(search);
+    if (scanner.hasError()) {
         g_debug("Regex compilation error");
-        delete matcher;
         return output;
     }
 
-    for (pkgCache::PkgIterator pkg = m_cache->GetPkgCache()->PkgBegin(); !pkg.end(); ++pkg) {
-        if (m_cancel) {
-            break;
-        }
-        // Ignore packages that exist only due to dependencies.
-        if (pkg.VersionList().end() && pkg.ProvidesList().end()) {
-            continue;
-        }
-
-        if (matcher->matches(pkg.Name())) {
-            // Don't insert virtual packages instead add what it provides
-            const pkgCache::VerIterator &ver = m_cache->findVer(pkg);
-            if (ver.end() == false) {
-                output.push_back(ver);
-            } else {
-                // iterate over the provides list
-                for (pkgCache::PrvIterator Prv = pkg.ProvidesList(); Prv.end() == false; ++Prv) {
-                    const pkgCache::VerIterator &ownerVer = m_cache->findVer(Prv.OwnerPkg());
-
-                    // check to see if the provided package isn't virtual too
-                    if (ownerVer.end() == false) {
-                        // we add the package now because we will need to
-                        // remove duplicates later anyway
-                        output.push_back(ownerVer);
-                    }
-                }
-            }
-        }
-    }
-    return output;
+    return scanPackages(scanner);
 }
 
 PkgList AptIntf::searchPackageDetails(gchar *search)
 {
     PkgList output;
 
-    Matcher *matcher = new Matcher(search);
-    if (matcher->hasError()) {
+    DetailsScanner scanner(search);
+    if (scanner.hasError()) {
         g_debug("Regex compilation error");
-        delete matcher;
         return output;
     }
 
-    for (pkgCache::PkgIterator pkg = m_cache->GetPkgCache()->PkgBegin(); !pkg.end(); ++pkg) {
-        if (m_cancel) {
-            break;
-        }
-        // Ignore packages that exist only due to dependencies.
-        if (pkg.VersionList().end() && pkg.ProvidesList().end()) {
-            continue;
-        }
-
-        const pkgCache::VerIterator &ver = m_cache->findVer(pkg);
-        if (ver.end() == false) {
-            if (matcher->matches(pkg.Name()) ||
-                    matcher->matches((*m_cache).getLongDescription(ver))) {
-                // The package matched
-                output.push_back(ver);
-            }
-        } else if (matcher->matches(pkg.Name())) {
-            // The package is virtual and MATCHED the name
-            // Don't insert virtual packages instead add what it provides
-
-            // iterate over the provides list
-            for (pkgCache::PrvIterator Prv = pkg.ProvidesList(); Prv.end() == false; ++Prv) {
-                const pkgCache::VerIterator &ownerVer = m_cache->findVer(Prv.OwnerPkg());
-
-                // check to see if the provided package isn't virtual too
-                if (ownerVer.end() == false) {
-                    // we add the package now because we will need to
-                    // remove duplicates later anyway
-                    output.push_back(ownerVer);
-                }
-            }
-        }
-    }
-    return output;
+    return scanPackages(scanner);
 }
 
-// used to return files it reads, using the info from the files in /var/lib/dpkg/info/
+// used to return files it reads, using the index of the files in /var/lib/dpkg/info/
 PkgList AptIntf::searchPackageFiles(gchar **values)
 {
     PkgList output;
     vector<string> packages;
-    regex_t re;
-    gchar *search;
-    gchar *values_str;
 
-    values_str = g_strjoinv("$|^", values);
-    search = g_strdup_printf("^%s$",
-                             values_str);
-    g_free(values_str);
-    if(regcomp(&re, search, REG_NOSUB) != 0) {
-        g_debug("Regex compilation error");
-        g_free(search);
+    AptFileIndex index;
+    if (!index.open()) {
+        g_debug ("Error opening the file index\n");
         return output;
     }
-    g_free(search);
 
-    DIR *dp;
-    struct dirent *dirp;
-    if (!(dp = opendir("/var/lib/dpkg/info/"))) {
-        g_debug ("Error opening /var/lib/dpkg/info/\n");
-        regfree(&re);
-        return output;
-    }
-
-    string line;
-    while ((dirp = readdir(dp)) != NULL) {
+    for (guint i = 0; values[i] != NULL; ++i) {
         if (m_cancel) {
             break;
         }
-        if (ends_with(dirp->d_name, ".list")) {
-            string f = "/var/lib/dpkg/info/" + string(dirp->d_name);
-            ifstream in(f.c_str());
-            if (!in != 0) {
-                continue;
-            }
-            while (!in.eof()) {
-                getline(in, line);
-                if (regexec(&re, line.c_str(), (size_t)0, NULL, 0) == 0) {
-                    string file(dirp->d_name);
-                    packages.push_back(file.erase(file.size() - 5, file.size()));
-                    break;
-                }
+        const vector<string> &owners = index.lookup(values[i]);
+        for (vector<string>::const_iterator it = owners.begin();
+             it != owners.end(); ++it) {
+            if (find(packages.begin(), packages.end(), *it) == packages.end()) {
+                packages.push_back(*it);
             }
         }
     }
-    closedir(dp);
-    regfree(&re);
 
     // Resolve the package names now
     for (vector<string>::const_iterator it = packages.begin();
@@ -1455,43 +1576,19 @@ void AptIntf::providesMimeType(PkgList &output, gchar **values)
 
 bool AptIntf::isApplication(const pkgCache::VerIterator &ver)
 {
-    bool ret = false;
-    gchar *fileName;
-    string line;
-
-    if (m_isMultiArch) {
-        fileName = g_strdup_printf("/var/lib/dpkg/info/%s:%s.list",
-                                   ver.ParentPkg().Name(),
-                                   ver.Arch());
-        if (!FileExists(fileName)) {
-            g_free(fileName);
-            // if the file was not found try without the arch field
-            fileName = g_strdup_printf("/var/lib/dpkg/info/%s.list",
-                                       ver.ParentPkg().Name());
-        }
-    } else {
-        fileName = g_strdup_printf("/var/lib/dpkg/info/%s.list",
-                                   ver.ParentPkg().Name());
-    }
-
-    if (FileExists(fileName)) {
-        ifstream in(fileName);
-        if (!in != 0) {
-            g_free(fileName);
-            return false;
-        }
+    return fileIndex()->hasDesktopFile(ver.ParentPkg().Name(), ver.Arch());
+}
 
-        while (in.eof() == false) {
-            getline(in, line);
-            if (ends_with(line, ".desktop")) {
-                ret = true;
-                break;
-            }
+AptFileIndex* AptIntf::fileIndex()
+{
+    // an index that failed to open has no packages
+    if (m_fileIndex == 0) {
+        m_fileIndex = new AptFileIndex;
+        if (!m_fileIndex->open()) {
+            g_debug("Error opening the file index");
         }
     }
-
-    g_free(fileName);
-    return ret;
+    return m_fileIndex;
 }
 
 // used to emit files it reads the info directly from the files
@@ -1545,41 +1642,6 @@ void AptIntf::emitPackageFiles(const gchar *pi)
     }
 }
 
-/**
-  * Check if package is officially supported by the current distribution
-  */
-bool AptIntf::packageIsSupported(const pkgCache::VerIterator &verIter, string component)
-{
-    string origin;
-    if (!verIter.end()) {
-        pkgCache::VerFileIterator vf = verIter.FileList();
-        origin = vf.File().Origin() == NULL ? "" : vf.File().Origin();
-    }
-
-    if (component.empty()) {
-        component = "main";
-    }
-
-    // Get a fetcher
-    AcqPackageKitStatus Stat(this, m_job);
-    pkgAcquire fetcher;
-    fetcher.Setup(&Stat);
-
-    PkBitfield flags = pk_backend_job_get_transaction_flags(m_job);
-    bool trusted = checkTrusted(fetcher, flags);
-
-    if ((origin.compare("Debian") == 0) || (origin.compare("Ubuntu") == 0))  {
-        if ((component.compare("main") == 0 ||
-             component.compare("restricted") == 0 ||
-             component.compare("unstable") == 0 ||
-             component.compare("testing") == 0) && trusted) {
-            return true;
-        }
-    }
-
-    return false;
-}
-
 bool AptIntf::checkTrusted(pkgAcquire &fetcher, PkBitfield flags)
 {
     string UntrustedList;
@@ -41,6 +41,9 @@
 class pkgProblemResolver;
 class Matcher;
 class AptCacheFile;
+class PkgScanner;
+class PkgFilter;
+class AptFileIndex;
 class AptIntf
 {
 public:
@@ -51,6 +54,17 @@ public:
     void cancel();
     bool cancelled() const;
 
+    /**
+      * Starts the threads the package scans are split over, they are
+      * kept for as long as the backend is loaded
+      */
+    static void createScanPool();
+
+    /**
+      * Stops the scan threads, when the backend is destroyed
+      */
+    static void freeScanPool();
+
     /**
      * Tries to find a package with the given packageId
      * @returns pkgCache::VerIterator, if .end() is true the package could not be found
@@ -245,17 +259,28 @@ public:
 
 private:
     bool checkTrusted(pkgAcquire &fetcher, PkBitfield flags);
-    bool packageIsSupported(const pkgCache::VerIterator &verIter, string component);
     bool isApplication(const pkgCache::VerIterator &verIter);
+    AptFileIndex* fileIndex();
 
     /**
      *  interprets dpkg status fd
      */
     void updateInterface(int readFd, int writeFd);
+
+    /**
+     *  Runs the scanner over all packages that don't only exist due to
+     *  dependencies, split in shards over the available cores
+     *  @returns what the scanner found, in package cache order
+     */
+    PkgList scanPackages(PkgScanner &scanner);
     PkgList checkChangedPackages(bool emitChanged);
     pkgCache::VerIterator findTransactionPackage(const std::string &name);
 
     AptCacheFile *m_cache;
+    bool       m_sharedCache;
+    string     m_cacheStamp;
+    PkgFilter *m_filter;
+    AptFileIndex *m_fileIndex;
     PkBackendJob  *m_job;
     bool       m_cancel;
     struct stat m_restartStat;
@@ -116,9 +116,9 @@ GstMatcher::~GstMatcher()
     }
 }
 
-bool GstMatcher::matches(string record)
+bool GstMatcher::matches(const string &record) const
 {
-    for (vector<Match>::iterator i = m_matches.begin(); i != m_matches.end(); ++i) {
+    for (vector<Match>::const_iterator i = m_matches.begin(); i != m_matches.end(); ++i) {
         // Tries to find "Gstreamer-version: xxx"
         if (record.find(i->version) != string::npos) {
             size_t found;
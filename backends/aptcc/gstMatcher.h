@@ -42,7 +42,7 @@ public:
     GstMatcher(gchar **values);
     ~GstMatcher();
 
-    bool matches(string record);
+    bool matches(const string &record) const;
     bool hasMatches() const;
 
 private:
@@ -92,6 +92,8 @@ void pk_backend_initialize(GKeyFile *conf, PkBackend *backend)
     spawn = pk_backend_spawn_new(conf);
 //     pk_backend_spawn_set_job(spawn, backend);
     pk_backend_spawn_set_name(spawn, "aptcc");
+
+    AptIntf::createScanPool();
 }
 
 /**
@@ -100,6 +102,20 @@ void pk_backend_initialize(GKeyFile *conf, PkBackend *backend)
 void pk_backend_destroy(PkBackend *backend)
 {
     g_debug("APTcc being destroyed");
+    AptCacheFile::dropShared();
+    AptIntf::freeScanPool();
+}
+
+/**
+ * pk_backend_get_database_stamp:
+ */
+gchar* pk_backend_get_database_stamp(PkBackend *backend)
+{
+    const std::string &stamp = AptCacheFile::databaseStamp();
+    if (stamp.empty()) {
+        return NULL;
+    }
+    return g_strdup(stamp.c_str());
 }
 
 /**
@@ -994,6 +1010,11 @@ static void backend_repo_manager_thread(PkBackendJob *job, GVariant *params, gpo
                        &enabled);
     }
 
+    // the next query must not see the repositories as they were
+    if (role != PK_ROLE_ENUM_GET_REPO_LIST) {
+        AptCacheFile::dropShared();
+    }
+
     SourcesList _lst;
     if (_lst.ReadSources() == false) {
         _error->
@@ -883,19 +883,26 @@ zypp_get_package_by_id (const gchar *package_id)
 		return sat::Solvable::noSolvable;
 	}
 
-	gchar **id_parts = pk_package_id_split(package_id);
-	const gchar *arch = id_parts[PK_PACKAGE_ID_ARCH];
-	if (!arch)
-		arch = "noarch";
-	bool want_source = !g_strcmp0 (arch, "source");
+	// look at the sections in place rather than splitting the id
+	PkPackageIdView view;
+	pk_package_id_view_init (&view, package_id);
+
+	guint len;
+	const gchar *field = pk_package_id_view_get_field (&view, PK_PACKAGE_ID_NAME, &len);
+	const string name (field, len);
+	field = pk_package_id_view_get_field (&view, PK_PACKAGE_ID_ARCH, &len);
+	const string arch (field, len);
+	bool want_source = pk_package_id_view_field_equal (&view, PK_PACKAGE_ID_ARCH, "source");
+	const gchar *data = pk_package_id_view_get_field (&view, PK_PACKAGE_ID_DATA, &len);
+	bool want_installed = len >= 9 && !strncmp (data, "installed", 9);
 	
 	sat::Solvable package;
 
 	ResPool pool = ResPool::instance();
 
 	// Iterate over the resolvables and mark the one we want to check its dependencies
-	for (ResPool::byName_iterator it = pool.byNameBegin (id_parts[PK_PACKAGE_ID_NAME]);
-	     it != pool.byNameEnd (id_parts[PK_PACKAGE_ID_NAME]); ++it) {
+	for (ResPool::byName_iterator it = pool.byNameBegin (name);
+	     it != pool.byNameEnd (name); ++it) {
 		
 		sat::Solvable pkg = it->satSolvable();
 		//MIL << "match " << package_id << " " << pkg << endl;
@@ -905,27 +912,27 @@ zypp_get_package_by_id (const gchar *package_id)
 			continue;
 		}
 
-		if (!want_source && (isKind<SrcPackage>(pkg) || g_strcmp0 (pkg.arch().c_str(), arch))) {
+		if (!want_source && (isKind<SrcPackage>(pkg) || arch != pkg.arch().c_str())) {
 			//MIL << "not a matching arch\n";
 			continue;
 		}
 
 		const string &ver = pkg.edition ().asString();
-		if (g_strcmp0 (ver.c_str (), id_parts[PK_PACKAGE_ID_VERSION])) {
+		if (!pk_package_id_view_field_equal (&view, PK_PACKAGE_ID_VERSION, ver.c_str ())) {
 			//MIL << "not a matching version\n";
 			continue;
 		}
 
 		if (!pkg.isSystem()) {
-			if (!strncmp(id_parts[PK_PACKAGE_ID_DATA], "installed", 9)) {
+			if (want_installed) {
 				//MIL << "pkg is not installed\n";
 				continue;
 			}
-			if (g_strcmp0(pkg.repository().alias().c_str(), id_parts[PK_PACKAGE_ID_DATA])) {
+			if (!pk_package_id_view_field_equal (&view, PK_PACKAGE_ID_DATA, pkg.repository().alias().c_str())) {
 				//MIL << "repo does not match\n";
 				continue;
 			}
-		} else if (strncmp(id_parts[PK_PACKAGE_ID_DATA], "installed", 9)) {
+		} else if (!want_installed) {
 			//MIL << "pkg installed\n";
 			continue;
 		}
@@ -935,7 +942,6 @@ zypp_get_package_by_id (const gchar *package_id)
 		break;
 	}
 
-	g_strfreev (id_parts);
 	return package;
 }
 
@@ -51,6 +51,7 @@ typedef struct {
 	PkProgressBar	*progressbar;
 	PkTaskText	*task;
 	gboolean	 is_console;
+	gboolean	 is_streaming;
 	gint		 retval;
 	PkBitfield	 filters;
 	guint		 defered_status_id;
@@ -96,21 +97,17 @@ static void
 pk_console_package_cb (PkPackage *package, PkConsoleCtx *ctx)
 {
 	PkInfoEnum info;
-	const gchar *package_id;
 	_cleanup_free_ gchar *info_pad = NULL;
 	_cleanup_free_ gchar *printable = NULL;
 	_cleanup_free_ gchar *printable_pad = NULL;
-	_cleanup_strv_free_ gchar **split = NULL;
 
 	/* ignore finished */
 	info = pk_package_get_info (package);
 	if (info == PK_INFO_ENUM_FINISHED)
 		return;
 
-	/* split */
-	package_id = pk_package_get_id (package);
-	split = pk_package_id_split (package_id);
-	if (split == NULL)
+	/* the package keeps the split sections already */
+	if (pk_package_get_name (package) == NULL)
 		return;
 
 	/* make these all the same length */
@@ -118,10 +115,10 @@ pk_console_package_cb (PkPackage *package, PkConsoleCtx *ctx)
 
 	/* create printable */
 	printable = g_strdup_printf ("%s-%s.%s (%s)",
-				     split[PK_PACKAGE_ID_NAME],
-				     split[PK_PACKAGE_ID_VERSION],
-				     split[PK_PACKAGE_ID_ARCH],
-				     split[PK_PACKAGE_ID_DATA]);
+				     pk_package_get_name (package),
+				     pk_package_get_version (package),
+				     pk_package_get_arch (package),
+				     pk_package_get_data (package));
 
 	/* don't pretty print */
 	if (!ctx->is_console) {
@@ -672,6 +669,17 @@ pk_console_progress_cb (PkProgress *progress, PkProgressType type, gpointer data
 	}
 }
 
+/**
+ * pk_console_item_cb:
+ **/
+static void
+pk_console_item_cb (PkClient *client, PkSource *item, gpointer data)
+{
+	PkConsoleCtx *ctx = (PkConsoleCtx *) data;
+	if (PK_IS_PACKAGE (item))
+		pk_console_package_cb (PK_PACKAGE (item), ctx);
+}
+
 /**
  * pk_console_finished_cb:
  **/
@@ -693,7 +701,7 @@ pk_console_finished_cb (GObject *object, GAsyncResult *res, gpointer data)
 	/* no more progress */
 	if (ctx->is_console) {
 		pk_progress_bar_end (ctx->progressbar);
-	} else {
+	} else if (!ctx->is_streaming) {
 		/* TRANSLATORS: the results from the transaction */
 		g_print ("%s\n", _("Results:"));
 	}
@@ -1652,6 +1660,7 @@ main (int argc, char *argv[])
 	PkBitfield groups;
 	gchar *text;
 	_cleanup_error_free_ GError *error = NULL;
+	_cleanup_free_ gchar *cache_filename = NULL;
 	_cleanup_free_ gchar *filter = NULL;
 	_cleanup_free_ gchar *options_help = NULL;
 	_cleanup_free_ gchar *summary = NULL;
@@ -1770,6 +1779,13 @@ main (int argc, char *argv[])
 		      "only-trusted", !allow_untrusted,
 		      NULL);
 
+	/* answer repeated queries without starting a transaction */
+	cache_filename = g_build_filename (g_get_user_cache_dir (),
+					   "PackageKit",
+					   "metadata.cache",
+					   NULL);
+	pk_client_set_metadata_cache_file (PK_CLIENT (ctx->task), cache_filename);
+
 	/* set the proxy */
 	ret = pk_console_set_proxy (ctx, &error);
 	if (!ret) {
@@ -2241,6 +2257,13 @@ main (int argc, char *argv[])
 					      pk_console_finished_cb, ctx);
 
 	} else if (strcmp (mode, "get-packages") == 0) {
+		/* print each package as it arrives rather than keeping them
+		 * all around, unless the progress bar is using the terminal */
+		if (!ctx->is_console) {
+			ctx->is_streaming = TRUE;
+			pk_client_set_item_callback (PK_CLIENT (ctx->task),
+						     pk_console_item_cb, ctx, NULL);
+		}
 		pk_task_get_packages_async (PK_TASK (ctx->task),
 					    ctx->filters,
 					    ctx->cancellable,
@@ -0,0 +1,14 @@
+#!/bin/sh
+# Licensed under the GNU General Public License Version 2
+# This program is free software; you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation; either version 2 of the License, or
+# (at your option) any later version.
+
+# print the wall clock time in microseconds so the reader can work out
+# how long it took for each line to be processed
+for i in `seq 1 10`
+do
+	sleep 0.1
+	printf "timestamp\t%s\n" `date +%s%N | cut -b1-16`
+done
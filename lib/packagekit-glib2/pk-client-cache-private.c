@@ -0,0 +1,261 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: t; c-basic-offset: 8 -*-
+ *
+ * Copyright (C) 2014 Richard Hughes <richard@hughsie.com>
+ *
+ * Licensed under the GNU Lesser General Public License Version 2.1
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+/*
+ * The client cache keeps the signals of successful queries such as Resolve
+ * in a single file in the users cache directory, tagged with the value of
+ * the daemon CacheGeneration property at the time of the query. The file is
+ * a serialized #GVariant, so a lookup is just a mmap() and a scan of the
+ * keys, and the stored signals are fed through the same decoder as the
+ * signals of a live transaction.
+ */
+
+#include "config.h"
+
+#include <glib.h>
+#include <glib/gstdio.h>
+
+#include "src/pk-cleanup.h"
+
+#include "pk-client-cache-private.h"
+
+/* bump this if the file layout or the meaning of the keys changes */
+#define PK_CLIENT_CACHE_VERSION		1
+
+/* (version, generation, [(key, signals)]), oldest entry first */
+#define PK_CLIENT_CACHE_TYPE		"(uta(sv))"
+
+/* the oldest entry is dropped when we get to this size */
+#define PK_CLIENT_CACHE_MAX_ITEMS	128
+
+/**
+ * pk_client_cache_role_is_cacheable:
+ *
+ * Only queries that never change the system and whose output only depends
+ * on the package database can be answered from the cache.
+ **/
+gboolean
+pk_client_cache_role_is_cacheable (PkRoleEnum role)
+{
+	return role == PK_ROLE_ENUM_RESOLVE ||
+	       role == PK_ROLE_ENUM_SEARCH_NAME ||
+	       role == PK_ROLE_ENUM_GET_DETAILS;
+}
+
+/**
+ * pk_client_cache_get_key:
+ **/
+gchar *
+pk_client_cache_get_key (PkRoleEnum role,
+			 PkBitfield filters,
+			 const gchar *locale,
+			 gchar **values)
+{
+	GString *key;
+	guint i;
+
+	key = g_string_new (pk_role_enum_to_string (role));
+	g_string_append_printf (key, "\n%" G_GUINT64_FORMAT "\n%s",
+				filters, locale != NULL ? locale : "C");
+	for (i = 0; values != NULL && values[i] != NULL; i++)
+		g_string_append_printf (key, "\n%s", values[i]);
+	return g_string_free (key, FALSE);
+}
+
+/**
+ * pk_client_cache_load:
+ *
+ * Return value: the cache contents if they are valid for @generation, or %NULL
+ **/
+static GVariant *
+pk_client_cache_load (const gchar *filename, guint64 generation)
+{
+	GVariant *data;
+	guint32 version;
+	guint64 generation_file;
+	GMappedFile *mapped;
+	_cleanup_bytes_unref_ GBytes *bytes = NULL;
+	_cleanup_error_free_ GError *error = NULL;
+
+	mapped = g_mapped_file_new (filename, FALSE, &error);
+	if (mapped == NULL) {
+		if (!g_error_matches (error, G_FILE_ERROR, G_FILE_ERROR_NOENT))
+			g_debug ("failed to map %s: %s", filename, error->message);
+		return NULL;
+	}
+
+	/* the file may have been written by anything, so don't trust it */
+	bytes = g_mapped_file_get_bytes (mapped);
+	g_mapped_file_unref (mapped);
+	data = g_variant_new_from_bytes (G_VARIANT_TYPE (PK_CLIENT_CACHE_TYPE),
+					 bytes, FALSE);
+	g_variant_ref_sink (data);
+	g_variant_get (data, "(ut@a(sv))", &version, &generation_file, NULL);
+	if (version != PK_CLIENT_CACHE_VERSION || generation_file != generation) {
+		g_variant_unref (data);
+		return NULL;
+	}
+	return data;
+}
+
+/**
+ * pk_client_cache_signals_valid:
+ *
+ * Only the signals that are recorded can be in the file, and the decoder
+ * trusts them to have the type the daemon emits.
+ **/
+static gboolean
+pk_client_cache_signals_valid (GVariant *signals)
+{
+	GVariantIter iter;
+	GVariant *parameters;
+	const gchar *signal_name;
+	const gchar *type;
+
+	g_variant_iter_init (&iter, signals);
+	while (g_variant_iter_next (&iter, "(&sv)", &signal_name, &parameters)) {
+		if (g_strcmp0 (signal_name, "Package") == 0)
+			type = "(uss)";
+		else if (g_strcmp0 (signal_name, "Packages") == 0)
+			type = "(a(uss))";
+		else if (g_strcmp0 (signal_name, "Details") == 0)
+			type = "(a{sv})";
+		else
+			type = NULL;
+		if (type == NULL ||
+		    !g_variant_is_of_type (parameters, G_VARIANT_TYPE (type))) {
+			g_debug ("ignoring cached %s signal of type %s",
+				 signal_name, g_variant_get_type_string (parameters));
+			g_variant_unref (parameters);
+			return FALSE;
+		}
+		g_variant_unref (parameters);
+	}
+	return TRUE;
+}
+
+/**
+ * pk_client_cache_lookup:
+ * @filename: the cache file
+ * @generation: the current value of the daemon CacheGeneration property
+ * @key: the key from pk_client_cache_get_key()
+ *
+ * Return value: (transfer full): the recorded signals of type a(sv), or %NULL
+ **/
+GVariant *
+pk_client_cache_lookup (const gchar *filename,
+			guint64 generation,
+			const gchar *key)
+{
+	GVariantIter iter;
+	GVariant *signals;
+	const gchar *key_tmp;
+	_cleanup_variant_unref_ GVariant *data = NULL;
+	_cleanup_variant_unref_ GVariant *entries = NULL;
+
+	g_return_val_if_fail (filename != NULL, NULL);
+	g_return_val_if_fail (key != NULL, NULL);
+
+	data = pk_client_cache_load (filename, generation);
+	if (data == NULL)
+		return NULL;
+	entries = g_variant_get_child_value (data, 2);
+	g_variant_iter_init (&iter, entries);
+	while (g_variant_iter_next (&iter, "(&sv)", &key_tmp, &signals)) {
+		if (g_strcmp0 (key_tmp, key) == 0 &&
+		    g_variant_is_of_type (signals, G_VARIANT_TYPE ("a(sv)")) &&
+		    pk_client_cache_signals_valid (signals))
+			return signals;
+		g_variant_unref (signals);
+	}
+	return NULL;
+}
+
+/**
+ * pk_client_cache_add:
+ * @filename: the cache file
+ * @generation: the value of the daemon CacheGeneration property when the
+ *  query was started
+ * @key: the key from pk_client_cache_get_key()
+ * @signals: the signals of a successful query, of type a(sv)
+ * @error: A #GError or %NULL
+ *
+ * Saves the signals so that an identical query can be answered without
+ * asking the daemon. Entries from other generations are dropped.
+ *
+ * Return value: %TRUE if the cache file was written
+ **/
+gboolean
+pk_client_cache_add (const gchar *filename,
+		     guint64 generation,
+		     const gchar *key,
+		     GVariant *signals,
+		     GError **error)
+{
+	GVariantBuilder builder;
+	GVariantIter iter;
+	GVariant *entry;
+	const gchar *key_tmp;
+	guint i;
+	guint skip = 0;
+	_cleanup_free_ gchar *dirname = NULL;
+	_cleanup_variant_unref_ GVariant *data = NULL;
+	_cleanup_variant_unref_ GVariant *data_new = NULL;
+	_cleanup_variant_unref_ GVariant *entries = NULL;
+
+	g_return_val_if_fail (filename != NULL, FALSE);
+	g_return_val_if_fail (key != NULL, FALSE);
+	g_return_val_if_fail (signals != NULL, FALSE);
+
+	/* keep the newest entries of the same generation */
+	g_variant_builder_init (&builder, G_VARIANT_TYPE ("a(sv)"));
+	data = pk_client_cache_load (filename, generation);
+	if (data != NULL) {
+		entries = g_variant_get_child_value (data, 2);
+		if (g_variant_n_children (entries) >= PK_CLIENT_CACHE_MAX_ITEMS)
+			skip = g_variant_n_children (entries) - PK_CLIENT_CACHE_MAX_ITEMS + 1;
+		g_variant_iter_init (&iter, entries);
+		for (i = 0; (entry = g_variant_iter_next_value (&iter)) != NULL; i++) {
+			g_variant_get_child (entry, 0, "&s", &key_tmp);
+			if (i >= skip && g_strcmp0 (key_tmp, key) != 0)
+				g_variant_builder_add_value (&builder, entry);
+			g_variant_unref (entry);
+		}
+	}
+	g_variant_builder_add (&builder, "(s@v)", key,
+			       g_variant_new_variant (signals));
+	data_new = g_variant_new ("(uta(sv))",
+				  PK_CLIENT_CACHE_VERSION,
+				  generation,
+				  &builder);
+	g_variant_ref_sink (data_new);
+
+	/* replace atomically, as other clients may have it mapped */
+	dirname = g_path_get_dirname (filename);
+	if (g_mkdir_with_parents (dirname, 0700) != 0) {
+		g_set_error (error, 1, 0, "failed to create %s", dirname);
+		return FALSE;
+	}
+	return g_file_set_contents (filename,
+				    g_variant_get_data (data_new),
+				    g_variant_get_size (data_new),
+				    error);
+}
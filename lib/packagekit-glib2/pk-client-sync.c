@@ -29,12 +29,12 @@
 #include <packagekit-glib2/pk-progress.h>
 
 #include "pk-client-sync.h"
+#include "pk-sync-loop-private.h"
 
 /* tiny helper to help us do the async operation */
 typedef struct {
 	GError		**error;
-	GMainContext	*context;
-	GMainLoop	*loop;
+	PkSyncLoop	*loop;
 	PkResults	*results;
 	PkProgress	*progress;
 } PkClientHelper;
@@ -51,7 +51,7 @@ pk_client_generic_finish_sync (PkClient *client, GAsyncResult *res, PkClientHelp
 		helper->results = g_object_ref (G_OBJECT(results));
 		g_object_unref (results);
 	}
-	g_main_loop_quit (helper->loop);
+	pk_sync_loop_quit (helper->loop);
 }
 
 /**
@@ -87,25 +87,19 @@ pk_client_resolve (PkClient *client, PkBitfield filters, gchar **packages, GCanc
 
 	/* create temp object */
 	memset (&helper, 0, sizeof (PkClientHelper));
-	helper.context = g_main_context_new ();
-	helper.loop = g_main_loop_new (helper.context, FALSE);
+	helper.loop = pk_sync_loop_acquire ();
 	helper.error = error;
 
-	g_main_context_push_thread_default (helper.context);
-
 	/* run async method */
 	pk_client_resolve_async (client, filters, packages, cancellable, progress_callback, progress_user_data,
 				 (GAsyncReadyCallback) pk_client_generic_finish_sync, &helper);
 
-	g_main_loop_run (helper.loop);
+	pk_sync_loop_run (helper.loop);
 
 	results = helper.results;
 
-	g_main_context_pop_thread_default (helper.context);
-
-	/* free temp object */
-	g_main_loop_unref (helper.loop);
-	g_main_context_unref (helper.context);
+	/* give back temp loop */
+	pk_sync_loop_release (helper.loop);
 
 	return results;
 }
@@ -142,25 +136,19 @@ pk_client_search_names (PkClient *client, PkBitfield filters, gchar **values, GC
 
 	/* create temp object */
 	memset (&helper, 0, sizeof (PkClientHelper));
-	helper.context = g_main_context_new ();
-	helper.loop = g_main_loop_new (helper.context, FALSE);
+	helper.loop = pk_sync_loop_acquire ();
 	helper.error = error;
 
-	g_main_context_push_thread_default (helper.context);
-
 	/* run async method */
 	pk_client_search_names_async (client, filters, values, cancellable, progress_callback, progress_user_data,
 				     (GAsyncReadyCallback) pk_client_generic_finish_sync, &helper);
 
-	g_main_loop_run (helper.loop);
+	pk_sync_loop_run (helper.loop);
 
 	results = helper.results;
 
-	g_main_context_pop_thread_default (helper.context);
-
-	/* free temp object */
-	g_main_loop_unref (helper.loop);
-	g_main_context_unref (helper.context);
+	/* give back temp loop */
+	pk_sync_loop_release (helper.loop);
 
 	return results;
 }
@@ -198,25 +186,19 @@ pk_client_search_details (PkClient *client, PkBitfield filters, gchar **values,
 
 	/* create temp object */
 	memset (&helper, 0, sizeof (PkClientHelper));
-	helper.context = g_main_context_new ();
-	helper.loop = g_main_loop_new (helper.context, FALSE);
+	helper.loop = pk_sync_loop_acquire ();
 	helper.error = error;
 
-	g_main_context_push_thread_default (helper.context);
-
 	/* run async method */
 	pk_client_search_details_async (client, filters, values, cancellable, progress_callback, progress_user_data,
 					(GAsyncReadyCallback) pk_client_generic_finish_sync, &helper);
 
-	g_main_loop_run (helper.loop);
+	pk_sync_loop_run (helper.loop);
 
 	results = helper.results;
 
-	g_main_context_pop_thread_default (helper.context);
-
-	/* free temp object */
-	g_main_loop_unref (helper.loop);
-	g_main_context_unref (helper.context);
+	/* give back temp loop */
+	pk_sync_loop_release (helper.loop);
 
 	return results;
 }
@@ -252,25 +234,19 @@ pk_client_search_groups (PkClient *client, PkBitfield filters, gchar **values, G
 
 	/* create temp object */
 	memset (&helper, 0, sizeof (PkClientHelper));
-	helper.context = g_main_context_new ();
-	helper.loop = g_main_loop_new (helper.context, FALSE);
+	helper.loop = pk_sync_loop_acquire ();
 	helper.error = error;
 
-	g_main_context_push_thread_default (helper.context);
-
 	/* run async method */
 	pk_client_search_groups_async (client, filters, values, cancellable, progress_callback, progress_user_data,
 				      (GAsyncReadyCallback) pk_client_generic_finish_sync, &helper);
 
-	g_main_loop_run (helper.loop);
+	pk_sync_loop_run (helper.loop);
 
 	results = helper.results;
 
-	g_main_context_pop_thread_default (helper.context);
-
-	/* free temp object */
-	g_main_loop_unref (helper.loop);
-	g_main_context_unref (helper.context);
+	/* give back temp loop */
+	pk_sync_loop_release (helper.loop);
 
 	return results;
 }
@@ -306,25 +282,19 @@ pk_client_search_files (PkClient *client, PkBitfield filters, gchar **values, GC
 
 	/* create temp object */
 	memset (&helper, 0, sizeof (PkClientHelper));
-	helper.context = g_main_context_new ();
-	helper.loop = g_main_loop_new (helper.context, FALSE);
+	helper.loop = pk_sync_loop_acquire ();
 	helper.error = error;
 
-	g_main_context_push_thread_default (helper.context);
-
 	/* run async method */
 	pk_client_search_files_async (client, filters, values, cancellable, progress_callback, progress_user_data,
 				     (GAsyncReadyCallback) pk_client_generic_finish_sync, &helper);
 
-	g_main_loop_run (helper.loop);
+	pk_sync_loop_run (helper.loop);
 
 	results = helper.results;
 
-	g_main_context_pop_thread_default (helper.context);
-
-	/* free temp object */
-	g_main_loop_unref (helper.loop);
-	g_main_context_unref (helper.context);
+	/* give back temp loop */
+	pk_sync_loop_release (helper.loop);
 
 	return results;
 }
@@ -360,25 +330,19 @@ pk_client_get_details (PkClient *client, gchar **package_ids, GCancellable *canc
 
 	/* create temp object */
 	memset (&helper, 0, sizeof (PkClientHelper));
-	helper.context = g_main_context_new ();
-	helper.loop = g_main_loop_new (helper.context, FALSE);
+	helper.loop = pk_sync_loop_acquire ();
 	helper.error = error;
 
-	g_main_context_push_thread_default (helper.context);
-
 	/* run async method */
 	pk_client_get_details_async (client, package_ids, cancellable, progress_callback, progress_user_data,
 				     (GAsyncReadyCallback) pk_client_generic_finish_sync, &helper);
 
-	g_main_loop_run (helper.loop);
+	pk_sync_loop_run (helper.loop);
 
 	results = helper.results;
 
-	g_main_context_pop_thread_default (helper.context);
-
-	/* free temp object */
-	g_main_loop_unref (helper.loop);
-	g_main_context_unref (helper.context);
+	/* give back temp loop */
+	pk_sync_loop_release (helper.loop);
 
 	return results;
 }
@@ -415,26 +379,20 @@ pk_client_get_details_local (PkClient *client, gchar **files, GCancellable *canc
 
 	/* create temp object */
 	memset (&helper, 0, sizeof (PkClientHelper));
-	helper.context = g_main_context_new ();
-	helper.loop = g_main_loop_new (helper.context, FALSE);
+	helper.loop = pk_sync_loop_acquire ();
 	helper.error = error;
 
-	g_main_context_push_thread_default (helper.context);
-
 	/* run async method */
 	pk_client_get_details_local_async (client, files, cancellable,
 					   progress_callback, progress_user_data,
 					   (GAsyncReadyCallback) pk_client_generic_finish_sync, &helper);
 
-	g_main_loop_run (helper.loop);
+	pk_sync_loop_run (helper.loop);
 
 	results = helper.results;
 
-	g_main_context_pop_thread_default (helper.context);
-
-	/* free temp object */
-	g_main_loop_unref (helper.loop);
-	g_main_context_unref (helper.context);
+	/* give back temp loop */
+	pk_sync_loop_release (helper.loop);
 
 	return results;
 }
@@ -471,26 +429,20 @@ pk_client_get_files_local (PkClient *client, gchar **files, GCancellable *cancel
 
 	/* create temp object */
 	memset (&helper, 0, sizeof (PkClientHelper));
-	helper.context = g_main_context_new ();
-	helper.loop = g_main_loop_new (helper.context, FALSE);
+	helper.loop = pk_sync_loop_acquire ();
 	helper.error = error;
 
-	g_main_context_push_thread_default (helper.context);
-
 	/* run async method */
 	pk_client_get_files_local_async (client, files, cancellable,
 					 progress_callback, progress_user_data,
 					 (GAsyncReadyCallback) pk_client_generic_finish_sync, &helper);
 
-	g_main_loop_run (helper.loop);
+	pk_sync_loop_run (helper.loop);
 
 	results = helper.results;
 
-	g_main_context_pop_thread_default (helper.context);
-
-	/* free temp object */
-	g_main_loop_unref (helper.loop);
-	g_main_context_unref (helper.context);
+	/* give back temp loop */
+	pk_sync_loop_release (helper.loop);
 
 	return results;
 }
@@ -526,25 +478,19 @@ pk_client_get_update_detail (PkClient *client, gchar **package_ids, GCancellable
 
 	/* create temp object */
 	memset (&helper, 0, sizeof (PkClientHelper));
-	helper.context = g_main_context_new ();
-	helper.loop = g_main_loop_new (helper.context, FALSE);
+	helper.loop = pk_sync_loop_acquire ();
 	helper.error = error;
 
-	g_main_context_push_thread_default (helper.context);
-
 	/* run async method */
 	pk_client_get_update_detail_async (client, package_ids, cancellable, progress_callback, progress_user_data,
 					   (GAsyncReadyCallback) pk_client_generic_finish_sync, &helper);
 
-	g_main_loop_run (helper.loop);
+	pk_sync_loop_run (helper.loop);
 
 	results = helper.results;
 
-	g_main_context_pop_thread_default (helper.context);
-
-	/* free temp object */
-	g_main_loop_unref (helper.loop);
-	g_main_context_unref (helper.context);
+	/* give back temp loop */
+	pk_sync_loop_release (helper.loop);
 
 	return results;
 }
@@ -580,25 +526,19 @@ pk_client_download_packages (PkClient *client, gchar **package_ids, const gchar
 
 	/* create temp object */
 	memset (&helper, 0, sizeof (PkClientHelper));
-	helper.context = g_main_context_new ();
-	helper.loop = g_main_loop_new (helper.context, FALSE);
+	helper.loop = pk_sync_loop_acquire ();
 	helper.error = error;
 
-	g_main_context_push_thread_default (helper.context);
-
 	/* run async method */
 	pk_client_download_packages_async (client, package_ids, directory, cancellable, progress_callback, progress_user_data,
 					   (GAsyncReadyCallback) pk_client_generic_finish_sync, &helper);
 
-	g_main_loop_run (helper.loop);
+	pk_sync_loop_run (helper.loop);
 
 	results = helper.results;
 
-	g_main_context_pop_thread_default (helper.context);
-
-	/* free temp object */
-	g_main_loop_unref (helper.loop);
-	g_main_context_unref (helper.context);
+	/* give back temp loop */
+	pk_sync_loop_release (helper.loop);
 
 	return results;
 }
@@ -633,25 +573,19 @@ pk_client_get_updates (PkClient *client, PkBitfield filters, GCancellable *cance
 
 	/* create temp object */
 	memset (&helper, 0, sizeof (PkClientHelper));
-	helper.context = g_main_context_new ();
-	helper.loop = g_main_loop_new (helper.context, FALSE);
+	helper.loop = pk_sync_loop_acquire ();
 	helper.error = error;
 
-	g_main_context_push_thread_default (helper.context);
-
 	/* run async method */
 	pk_client_get_updates_async (client, filters, cancellable, progress_callback, progress_user_data,
 				     (GAsyncReadyCallback) pk_client_generic_finish_sync, &helper);
 
-	g_main_loop_run (helper.loop);
+	pk_sync_loop_run (helper.loop);
 
 	results = helper.results;
 
-	g_main_context_pop_thread_default (helper.context);
-
-	/* free temp object */
-	g_main_loop_unref (helper.loop);
-	g_main_context_unref (helper.context);
+	/* give back temp loop */
+	pk_sync_loop_release (helper.loop);
 
 	return results;
 }
@@ -686,25 +620,19 @@ pk_client_get_old_transactions (PkClient *client, guint number, GCancellable *ca
 
 	/* create temp object */
 	memset (&helper, 0, sizeof (PkClientHelper));
-	helper.context = g_main_context_new ();
-	helper.loop = g_main_loop_new (helper.context, FALSE);
+	helper.loop = pk_sync_loop_acquire ();
 	helper.error = error;
 
-	g_main_context_push_thread_default (helper.context);
-
 	/* run async method */
 	pk_client_get_old_transactions_async (client, number, cancellable, progress_callback, progress_user_data,
 					      (GAsyncReadyCallback) pk_client_generic_finish_sync, &helper);
 
-	g_main_loop_run (helper.loop);
+	pk_sync_loop_run (helper.loop);
 
 	results = helper.results;
 
-	g_main_context_pop_thread_default (helper.context);
-
-	/* free temp object */
-	g_main_loop_unref (helper.loop);
-	g_main_context_unref (helper.context);
+	/* give back temp loop */
+	pk_sync_loop_release (helper.loop);
 
 	return results;
 }
@@ -741,25 +669,19 @@ pk_client_depends_on (PkClient *client, PkBitfield filters, gchar **package_ids,
 
 	/* create temp object */
 	memset (&helper, 0, sizeof (PkClientHelper));
-	helper.context = g_main_context_new ();
-	helper.loop = g_main_loop_new (helper.context, FALSE);
+	helper.loop = pk_sync_loop_acquire ();
 	helper.error = error;
 
-	g_main_context_push_thread_default (helper.context);
-
 	/* run async method */
 	pk_client_depends_on_async (client, filters, package_ids, recursive, cancellable, progress_callback, progress_user_data,
 				     (GAsyncReadyCallback) pk_client_generic_finish_sync, &helper);
 
-	g_main_loop_run (helper.loop);
+	pk_sync_loop_run (helper.loop);
 
 	results = helper.results;
 
-	g_main_context_pop_thread_default (helper.context);
-
-	/* free temp object */
-	g_main_loop_unref (helper.loop);
-	g_main_context_unref (helper.context);
+	/* give back temp loop */
+	pk_sync_loop_release (helper.loop);
 
 	return results;
 }
@@ -794,25 +716,19 @@ pk_client_get_packages (PkClient *client, PkBitfield filters, GCancellable *canc
 
 	/* create temp object */
 	memset (&helper, 0, sizeof (PkClientHelper));
-	helper.context = g_main_context_new ();
-	helper.loop = g_main_loop_new (helper.context, FALSE);
+	helper.loop = pk_sync_loop_acquire ();
 	helper.error = error;
 
-	g_main_context_push_thread_default (helper.context);
-
 	/* run async method */
 	pk_client_get_packages_async (client, filters, cancellable, progress_callback, progress_user_data,
 				      (GAsyncReadyCallback) pk_client_generic_finish_sync, &helper);
 
-	g_main_loop_run (helper.loop);
+	pk_sync_loop_run (helper.loop);
 
 	results = helper.results;
 
-	g_main_context_pop_thread_default (helper.context);
-
-	/* free temp object */
-	g_main_loop_unref (helper.loop);
-	g_main_context_unref (helper.context);
+	/* give back temp loop */
+	pk_sync_loop_release (helper.loop);
 
 	return results;
 }
@@ -849,25 +765,19 @@ pk_client_required_by (PkClient *client, PkBitfield filters, gchar **package_ids
 
 	/* create temp object */
 	memset (&helper, 0, sizeof (PkClientHelper));
-	helper.context = g_main_context_new ();
-	helper.loop = g_main_loop_new (helper.context, FALSE);
+	helper.loop = pk_sync_loop_acquire ();
 	helper.error = error;
 
-	g_main_context_push_thread_default (helper.context);
-
 	/* run async method */
 	pk_client_required_by_async (client, filters, package_ids, recursive, cancellable, progress_callback, progress_user_data,
 				      (GAsyncReadyCallback) pk_client_generic_finish_sync, &helper);
 
-	g_main_loop_run (helper.loop);
+	pk_sync_loop_run (helper.loop);
 
 	results = helper.results;
 
-	g_main_context_pop_thread_default (helper.context);
-
-	/* free temp object */
-	g_main_loop_unref (helper.loop);
-	g_main_context_unref (helper.context);
+	/* give back temp loop */
+	pk_sync_loop_release (helper.loop);
 
 	return results;
 }
@@ -908,25 +818,19 @@ pk_client_what_provides (PkClient *client,
 
 	/* create temp object */
 	memset (&helper, 0, sizeof (PkClientHelper));
-	helper.context = g_main_context_new ();
-	helper.loop = g_main_loop_new (helper.context, FALSE);
+	helper.loop = pk_sync_loop_acquire ();
 	helper.error = error;
 
-	g_main_context_push_thread_default (helper.context);
-
 	/* run async method */
 	pk_client_what_provides_async (client, filters, values, cancellable, progress_callback, progress_user_data,
 				       (GAsyncReadyCallback) pk_client_generic_finish_sync, &helper);
 
-	g_main_loop_run (helper.loop);
+	pk_sync_loop_run (helper.loop);
 
 	results = helper.results;
 
-	g_main_context_pop_thread_default (helper.context);
-
-	/* free temp object */
-	g_main_loop_unref (helper.loop);
-	g_main_context_unref (helper.context);
+	/* give back temp loop */
+	pk_sync_loop_release (helper.loop);
 
 	return results;
 }
@@ -961,25 +865,19 @@ pk_client_get_distro_upgrades (PkClient *client, GCancellable *cancellable,
 
 	/* create temp object */
 	memset (&helper, 0, sizeof (PkClientHelper));
-	helper.context = g_main_context_new ();
-	helper.loop = g_main_loop_new (helper.context, FALSE);
+	helper.loop = pk_sync_loop_acquire ();
 	helper.error = error;
 
-	g_main_context_push_thread_default (helper.context);
-
 	/* run async method */
 	pk_client_get_distro_upgrades_async (client, cancellable, progress_callback, progress_user_data,
 					     (GAsyncReadyCallback) pk_client_generic_finish_sync, &helper);
 
-	g_main_loop_run (helper.loop);
+	pk_sync_loop_run (helper.loop);
 
 	results = helper.results;
 
-	g_main_context_pop_thread_default (helper.context);
-
-	/* free temp object */
-	g_main_loop_unref (helper.loop);
-	g_main_context_unref (helper.context);
+	/* give back temp loop */
+	pk_sync_loop_release (helper.loop);
 
 	return results;
 }
@@ -1014,25 +912,19 @@ pk_client_get_files (PkClient *client, gchar **package_ids, GCancellable *cancel
 
 	/* create temp object */
 	memset (&helper, 0, sizeof (PkClientHelper));
-	helper.context = g_main_context_new ();
-	helper.loop = g_main_loop_new (helper.context, FALSE);
+	helper.loop = pk_sync_loop_acquire ();
 	helper.error = error;
 
-	g_main_context_push_thread_default (helper.context);
-
 	/* run async method */
 	pk_client_get_files_async (client, package_ids, cancellable, progress_callback, progress_user_data,
 				   (GAsyncReadyCallback) pk_client_generic_finish_sync, &helper);
 
-	g_main_loop_run (helper.loop);
+	pk_sync_loop_run (helper.loop);
 
 	results = helper.results;
 
-	g_main_context_pop_thread_default (helper.context);
-
-	/* free temp object */
-	g_main_loop_unref (helper.loop);
-	g_main_context_unref (helper.context);
+	/* give back temp loop */
+	pk_sync_loop_release (helper.loop);
 
 	return results;
 }
@@ -1066,23 +958,19 @@ pk_client_get_categories (PkClient *client, GCancellable *cancellable,
 
 	/* create temp object */
 	memset (&helper, 0, sizeof (PkClientHelper));
-	helper.context = g_main_context_new ();
-	helper.loop = g_main_loop_new (helper.context, FALSE);
+	helper.loop = pk_sync_loop_acquire ();
 	helper.error = error;
 
 	/* run async method */
 	pk_client_get_categories_async (client, cancellable, progress_callback, progress_user_data,
 					(GAsyncReadyCallback) pk_client_generic_finish_sync, &helper);
 
-	g_main_loop_run (helper.loop);
+	pk_sync_loop_run (helper.loop);
 
 	results = helper.results;
 
-	g_main_context_pop_thread_default (helper.context);
-
-	/* free temp object */
-	g_main_loop_unref (helper.loop);
-	g_main_context_unref (helper.context);
+	/* give back temp loop */
+	pk_sync_loop_release (helper.loop);
 
 	return results;
 }
@@ -1129,12 +1017,9 @@ pk_client_remove_packages (PkClient *client,
 
 	/* create temp object */
 	memset (&helper, 0, sizeof (PkClientHelper));
-	helper.context = g_main_context_new ();
-	helper.loop = g_main_loop_new (helper.context, FALSE);
+	helper.loop = pk_sync_loop_acquire ();
 	helper.error = error;
 
-	g_main_context_push_thread_default (helper.context);
-
 	/* run async method */
 	pk_client_remove_packages_async (client,
 					 transaction_flags,
@@ -1147,15 +1032,12 @@ pk_client_remove_packages (PkClient *client,
 					 (GAsyncReadyCallback) pk_client_generic_finish_sync,
 					 &helper);
 
-	g_main_loop_run (helper.loop);
+	pk_sync_loop_run (helper.loop);
 
 	results = helper.results;
 
-	g_main_context_pop_thread_default (helper.context);
-
-	/* free temp object */
-	g_main_loop_unref (helper.loop);
-	g_main_context_unref (helper.context);
+	/* give back temp loop */
+	pk_sync_loop_release (helper.loop);
 
 	return results;
 }
@@ -1193,25 +1075,19 @@ pk_client_refresh_cache (PkClient *client, gboolean force, GCancellable *cancell
 
 	/* create temp object */
 	memset (&helper, 0, sizeof (PkClientHelper));
-	helper.context = g_main_context_new ();
-	helper.loop = g_main_loop_new (helper.context, FALSE);
+	helper.loop = pk_sync_loop_acquire ();
 	helper.error = error;
 
-	g_main_context_push_thread_default (helper.context);
-
 	/* run async method */
 	pk_client_refresh_cache_async (client, force, cancellable, progress_callback, progress_user_data,
 				       (GAsyncReadyCallback) pk_client_generic_finish_sync, &helper);
 
-	g_main_loop_run (helper.loop);
+	pk_sync_loop_run (helper.loop);
 
 	results = helper.results;
 
-	g_main_context_pop_thread_default (helper.context);
-
-	/* free temp object */
-	g_main_loop_unref (helper.loop);
-	g_main_context_unref (helper.context);
+	/* give back temp loop */
+	pk_sync_loop_release (helper.loop);
 
 	return results;
 }
@@ -1252,25 +1128,19 @@ pk_client_install_packages (PkClient *client,
 
 	/* create temp object */
 	memset (&helper, 0, sizeof (PkClientHelper));
-	helper.context = g_main_context_new ();
-	helper.loop = g_main_loop_new (helper.context, FALSE);
+	helper.loop = pk_sync_loop_acquire ();
 	helper.error = error;
 
-	g_main_context_push_thread_default (helper.context);
-
 	/* run async method */
 	pk_client_install_packages_async (client, transaction_flags, package_ids, cancellable, progress_callback, progress_user_data,
 					  (GAsyncReadyCallback) pk_client_generic_finish_sync, &helper);
 
-	g_main_loop_run (helper.loop);
+	pk_sync_loop_run (helper.loop);
 
 	results = helper.results;
 
-	g_main_context_pop_thread_default (helper.context);
-
-	/* free temp object */
-	g_main_loop_unref (helper.loop);
-	g_main_context_unref (helper.context);
+	/* give back temp loop */
+	pk_sync_loop_release (helper.loop);
 
 	return results;
 }
@@ -1307,25 +1177,19 @@ pk_client_install_signature (PkClient *client, PkSigTypeEnum type, const gchar *
 
 	/* create temp object */
 	memset (&helper, 0, sizeof (PkClientHelper));
-	helper.context = g_main_context_new ();
-	helper.loop = g_main_loop_new (helper.context, FALSE);
+	helper.loop = pk_sync_loop_acquire ();
 	helper.error = error;
 
-	g_main_context_push_thread_default (helper.context);
-
 	/* run async method */
 	pk_client_install_signature_async (client, type, key_id, package_id, cancellable, progress_callback, progress_user_data,
 					   (GAsyncReadyCallback) pk_client_generic_finish_sync, &helper);
 
-	g_main_loop_run (helper.loop);
+	pk_sync_loop_run (helper.loop);
 
 	results = helper.results;
 
-	g_main_context_pop_thread_default (helper.context);
-
-	/* free temp object */
-	g_main_loop_unref (helper.loop);
-	g_main_context_unref (helper.context);
+	/* give back temp loop */
+	pk_sync_loop_release (helper.loop);
 
 	return results;
 }
@@ -1366,25 +1230,19 @@ pk_client_update_packages (PkClient *client,
 
 	/* create temp object */
 	memset (&helper, 0, sizeof (PkClientHelper));
-	helper.context = g_main_context_new ();
-	helper.loop = g_main_loop_new (helper.context, FALSE);
+	helper.loop = pk_sync_loop_acquire ();
 	helper.error = error;
 
-	g_main_context_push_thread_default (helper.context);
-
 	/* run async method */
 	pk_client_update_packages_async (client, transaction_flags, package_ids, cancellable, progress_callback, progress_user_data,
 					 (GAsyncReadyCallback) pk_client_generic_finish_sync, &helper);
 
-	g_main_loop_run (helper.loop);
+	pk_sync_loop_run (helper.loop);
 
 	results = helper.results;
 
-	g_main_context_pop_thread_default (helper.context);
-
-	/* free temp object */
-	g_main_loop_unref (helper.loop);
-	g_main_context_unref (helper.context);
+	/* give back temp loop */
+	pk_sync_loop_release (helper.loop);
 
 	return results;
 }
@@ -1426,23 +1284,19 @@ pk_client_install_files (PkClient *client,
 
 	/* create temp object */
 	memset (&helper, 0, sizeof (PkClientHelper));
-	helper.context = g_main_context_new ();
-	helper.loop = g_main_loop_new (helper.context, FALSE);
+	helper.loop = pk_sync_loop_acquire ();
 	helper.error = error;
 
-	g_main_context_push_thread_default (helper.context);
-
 	/* run async method */
 	pk_client_install_files_async (client, transaction_flags, files, cancellable, progress_callback, progress_user_data,
 				       (GAsyncReadyCallback) pk_client_generic_finish_sync, &helper);
 
-	g_main_loop_run (helper.loop);
+	pk_sync_loop_run (helper.loop);
 
 	results = helper.results;
 
-	/* free temp object */
-	g_main_loop_unref (helper.loop);
-	g_main_context_unref (helper.context);
+	/* give back temp loop */
+	pk_sync_loop_release (helper.loop);
 
 	return results;
 }
@@ -1477,25 +1331,19 @@ pk_client_accept_eula (PkClient *client, const gchar *eula_id, GCancellable *can
 
 	/* create temp object */
 	memset (&helper, 0, sizeof (PkClientHelper));
-	helper.context = g_main_context_new ();
-	helper.loop = g_main_loop_new (helper.context, FALSE);
+	helper.loop = pk_sync_loop_acquire ();
 	helper.error = error;
 
-	g_main_context_push_thread_default (helper.context);
-
 	/* run async method */
 	pk_client_accept_eula_async (client, eula_id, cancellable, progress_callback, progress_user_data,
 				     (GAsyncReadyCallback) pk_client_generic_finish_sync, &helper);
 
-	g_main_loop_run (helper.loop);
+	pk_sync_loop_run (helper.loop);
 
 	results = helper.results;
 
-	g_main_context_pop_thread_default (helper.context);
-
-	/* free temp object */
-	g_main_loop_unref (helper.loop);
-	g_main_context_unref (helper.context);
+	/* give back temp loop */
+	pk_sync_loop_release (helper.loop);
 
 	return results;
 }
@@ -1530,25 +1378,19 @@ pk_client_get_repo_list (PkClient *client, PkBitfield filters, GCancellable *can
 
 	/* create temp object */
 	memset (&helper, 0, sizeof (PkClientHelper));
-	helper.context = g_main_context_new ();
-	helper.loop = g_main_loop_new (helper.context, FALSE);
+	helper.loop = pk_sync_loop_acquire ();
 	helper.error = error;
 
-	g_main_context_push_thread_default (helper.context);
-
 	/* run async method */
 	pk_client_get_repo_list_async (client, filters, cancellable, progress_callback, progress_user_data,
 				       (GAsyncReadyCallback) pk_client_generic_finish_sync, &helper);
 
-	g_main_loop_run (helper.loop);
+	pk_sync_loop_run (helper.loop);
 
 	results = helper.results;
 
-	g_main_context_pop_thread_default (helper.context);
-
-	/* free temp object */
-	g_main_loop_unref (helper.loop);
-	g_main_context_unref (helper.context);
+	/* give back temp loop */
+	pk_sync_loop_release (helper.loop);
 
 	return results;
 }
@@ -1584,25 +1426,19 @@ pk_client_repo_enable (PkClient *client, const gchar *repo_id, gboolean enabled,
 
 	/* create temp object */
 	memset (&helper, 0, sizeof (PkClientHelper));
-	helper.context = g_main_context_new ();
-	helper.loop = g_main_loop_new (helper.context, FALSE);
+	helper.loop = pk_sync_loop_acquire ();
 	helper.error = error;
 
-	g_main_context_push_thread_default (helper.context);
-
 	/* run async method */
 	pk_client_repo_enable_async (client, repo_id, enabled, cancellable, progress_callback, progress_user_data,
 				     (GAsyncReadyCallback) pk_client_generic_finish_sync, &helper);
 
-	g_main_loop_run (helper.loop);
+	pk_sync_loop_run (helper.loop);
 
 	results = helper.results;
 
-	g_main_context_pop_thread_default (helper.context);
-
-	/* free temp object */
-	g_main_loop_unref (helper.loop);
-	g_main_context_unref (helper.context);
+	/* give back temp loop */
+	pk_sync_loop_release (helper.loop);
 
 	return results;
 }
@@ -1640,25 +1476,19 @@ pk_client_repo_set_data (PkClient *client, const gchar *repo_id, const gchar *pa
 
 	/* create temp object */
 	memset (&helper, 0, sizeof (PkClientHelper));
-	helper.context = g_main_context_new ();
-	helper.loop = g_main_loop_new (helper.context, FALSE);
+	helper.loop = pk_sync_loop_acquire ();
 	helper.error = error;
 
-	g_main_context_push_thread_default (helper.context);
-
 	/* run async method */
 	pk_client_repo_set_data_async (client, repo_id, parameter, value, cancellable, progress_callback, progress_user_data,
 				       (GAsyncReadyCallback) pk_client_generic_finish_sync, &helper);
 
-	g_main_loop_run (helper.loop);
+	pk_sync_loop_run (helper.loop);
 
 	results = helper.results;
 
-	g_main_context_pop_thread_default (helper.context);
-
-	/* free temp object */
-	g_main_loop_unref (helper.loop);
-	g_main_context_unref (helper.context);
+	/* give back temp loop */
+	pk_sync_loop_release (helper.loop);
 
 	return results;
 }
@@ -1701,12 +1531,9 @@ pk_client_repo_remove (PkClient *client,
 
 	/* create temp object */
 	memset (&helper, 0, sizeof (PkClientHelper));
-	helper.context = g_main_context_new ();
-	helper.loop = g_main_loop_new (helper.context, FALSE);
+	helper.loop = pk_sync_loop_acquire ();
 	helper.error = error;
 
-	g_main_context_push_thread_default (helper.context);
-
 	/* run async method */
 	pk_client_repo_remove_async (client,
 				     transaction_flags,
@@ -1718,15 +1545,12 @@ pk_client_repo_remove (PkClient *client,
 				     (GAsyncReadyCallback) pk_client_generic_finish_sync,
 				     &helper);
 
-	g_main_loop_run (helper.loop);
+	pk_sync_loop_run (helper.loop);
 
 	results = helper.results;
 
-	g_main_context_pop_thread_default (helper.context);
-
-	/* free temp object */
-	g_main_loop_unref (helper.loop);
-	g_main_context_unref (helper.context);
+	/* give back temp loop */
+	pk_sync_loop_release (helper.loop);
 
 	return results;
 }
@@ -1769,12 +1593,9 @@ pk_client_repair_system (PkClient *client,
 
 	/* create temp object */
 	memset (&helper, 0, sizeof (PkClientHelper));
-	helper.context = g_main_context_new ();
-	helper.loop = g_main_loop_new (helper.context, FALSE);
+	helper.loop = pk_sync_loop_acquire ();
 	helper.error = error;
 
-	g_main_context_push_thread_default (helper.context);
-
 	/* run async method */
 	pk_client_repair_system_async (client,
 				       transaction_flags,
@@ -1784,15 +1605,12 @@ pk_client_repair_system (PkClient *client,
 				       (GAsyncReadyCallback) pk_client_generic_finish_sync,
 				       &helper);
 
-	g_main_loop_run (helper.loop);
+	pk_sync_loop_run (helper.loop);
 
 	results = helper.results;
 
-	g_main_context_pop_thread_default (helper.context);
-
-	/* free temp object */
-	g_main_loop_unref (helper.loop);
-	g_main_context_unref (helper.context);
+	/* give back temp loop */
+	pk_sync_loop_release (helper.loop);
 
 	return results;
 }
@@ -1827,25 +1645,19 @@ pk_client_adopt (PkClient *client, const gchar *transaction_id, GCancellable *ca
 
 	/* create temp object */
 	memset (&helper, 0, sizeof (PkClientHelper));
-	helper.context = g_main_context_new ();
-	helper.loop = g_main_loop_new (helper.context, FALSE);
+	helper.loop = pk_sync_loop_acquire ();
 	helper.error = error;
 
-	g_main_context_push_thread_default (helper.context);
-
 	/* run async method */
 	pk_client_adopt_async (client, transaction_id, cancellable, progress_callback, progress_user_data,
 			       (GAsyncReadyCallback) pk_client_generic_finish_sync, &helper);
 
-	g_main_loop_run (helper.loop);
+	pk_sync_loop_run (helper.loop);
 
 	results = helper.results;
 
-	g_main_context_pop_thread_default (helper.context);
-
-	/* free temp object */
-	g_main_loop_unref (helper.loop);
-	g_main_context_unref (helper.context);
+	/* give back temp loop */
+	pk_sync_loop_release (helper.loop);
 
 	return results;
 }
@@ -1862,7 +1674,7 @@ pk_client_get_progress_finish_sync (PkClient *client, GAsyncResult *res, PkClien
 		helper->progress = g_object_ref (G_OBJECT(progress));
 		g_object_unref (progress);
 	}
-	g_main_loop_quit (helper->loop);
+	pk_sync_loop_quit (helper->loop);
 }
 
 /**
@@ -1892,25 +1704,19 @@ pk_client_get_progress (PkClient *client, const gchar *transaction_id, GCancella
 
 	/* create temp object */
 	memset (&helper, 0, sizeof (PkClientHelper));
-	helper.context = g_main_context_new ();
-	helper.loop = g_main_loop_new (helper.context, FALSE);
+	helper.loop = pk_sync_loop_acquire ();
 	helper.error = error;
 
-	g_main_context_push_thread_default (helper.context);
-
 	/* run async method */
 	pk_client_get_progress_async (client, transaction_id, cancellable,
 				      (GAsyncReadyCallback) pk_client_get_progress_finish_sync, &helper);
 
-	g_main_loop_run (helper.loop);
+	pk_sync_loop_run (helper.loop);
 
 	progress = helper.progress;
 
-	g_main_context_pop_thread_default (helper.context);
-
-	/* free temp object */
-	g_main_loop_unref (helper.loop);
-	g_main_context_unref (helper.context);
+	/* give back temp loop */
+	pk_sync_loop_release (helper.loop);
 
 	return progress;
 }
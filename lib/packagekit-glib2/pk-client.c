@@ -47,6 +47,11 @@
 #include <packagekit-glib2/pk-package-id.h>
 #include <packagekit-glib2/pk-package-ids.h>
 
+#include "pk-client-cache-private.h"
+#include "pk-client-private.h"
+#include "pk-progress-private.h"
+#include "pk-source-private.h"
+
 static void     pk_client_finalize	(GObject     *object);
 
 #define PK_CLIENT_GET_PRIVATE(o) (G_TYPE_INSTANCE_GET_PRIVATE ((o), PK_TYPE_CLIENT, PkClientPrivate))
@@ -62,12 +67,19 @@ struct _PkClientPrivate
 {
 	GDBusConnection		*connection;
 	GPtrArray		*calls;
+	GMutex			 calls_lock;	/* sync calls may come from any thread */
 	PkControl		*control;
 	gchar			*locale;
 	gboolean		 background;
 	gboolean		 interactive;
 	gboolean		 idle;
 	guint			 cache_age;
+	PkClientItemCallback	 item_callback;
+	gpointer		 item_user_data;
+	GDestroyNotify		 item_destroy;
+	guint			 progress_interval;
+	gboolean		 progress_by_type;
+	gchar			*cache_filename;
 };
 
 enum {
@@ -121,6 +133,10 @@ typedef struct {
 	PkSigTypeEnum			 type;
 	guint				 refcount;
 	PkClientHelper			*client_helper;
+	gchar				*cache_filename;
+	gchar				*cache_key;
+	guint64				 cache_generation;
+	GPtrArray			*cache_signals;
 } PkClientState;
 
 static void
@@ -171,7 +187,7 @@ pk_client_get_property (GObject *object, guint prop_id, GValue *value, GParamSpe
 		g_value_set_boolean (value, priv->interactive);
 		break;
 	case PROP_IDLE:
-		g_value_set_boolean (value, priv->idle);
+		g_value_set_boolean (value, pk_client_get_idle (client));
 		break;
 	case PROP_CACHE_AGE:
 		g_value_set_uint (value, priv->cache_age);
@@ -396,6 +412,35 @@ pk_client_percentage_to_signed (guint percentage)
 	return (gint) percentage;
 }
 
+/**
+ * pk_client_state_progress_notify:
+ **/
+static void
+pk_client_state_progress_notify (PkClientState *state, PkProgressType type)
+{
+	pk_progress_dispatch (state->progress, type,
+			      state->progress_callback,
+			      state->progress_user_data);
+}
+
+/**
+ * pk_client_progress_new:
+ **/
+static PkProgress *
+pk_client_progress_new (PkClient *client)
+{
+	PkProgress *progress;
+
+	/* replaying signals does not need a client */
+	progress = pk_progress_new ();
+	if (client == NULL)
+		return progress;
+	pk_progress_set_coalesce_policy (progress,
+					 client->priv->progress_interval,
+					 client->priv->progress_by_type);
+	return progress;
+}
+
 /**
  * pk_client_set_property_value:
  **/
@@ -411,11 +456,8 @@ pk_client_set_property_value (PkClientState *state,
 	if (g_strcmp0 (key, "Role") == 0) {
 		ret = pk_progress_set_role (state->progress,
 					    g_variant_get_uint32 (value));
-		if (ret && state->progress_callback != NULL) {
-			state->progress_callback (state->progress,
-						  PK_PROGRESS_TYPE_ROLE,
-						  state->progress_user_data);
-		}
+		if (ret)
+			pk_client_state_progress_notify (state, PK_PROGRESS_TYPE_ROLE);
 		return;
 	}
 
@@ -423,11 +465,8 @@ pk_client_set_property_value (PkClientState *state,
 	if (g_strcmp0 (key, "Status") == 0) {
 		ret = pk_progress_set_status (state->progress,
 					      g_variant_get_uint32 (value));
-		if (ret && state->progress_callback != NULL) {
-			state->progress_callback (state->progress,
-						  PK_PROGRESS_TYPE_STATUS,
-						  state->progress_user_data);
-		}
+		if (ret)
+			pk_client_state_progress_notify (state, PK_PROGRESS_TYPE_STATUS);
 		return;
 	}
 
@@ -440,11 +479,8 @@ pk_client_set_property_value (PkClientState *state,
 			return;
 		ret = pk_progress_set_package_id (state->progress,
 						  package_id);
-		if (ret && state->progress_callback != NULL) {
-			state->progress_callback (state->progress,
-						  PK_PROGRESS_TYPE_PACKAGE_ID,
-						  state->progress_user_data);
-		}
+		if (ret)
+			pk_client_state_progress_notify (state, PK_PROGRESS_TYPE_PACKAGE_ID);
 		return;
 	}
 
@@ -452,11 +488,8 @@ pk_client_set_property_value (PkClientState *state,
 	if (g_strcmp0 (key, "Percentage") == 0) {
 		ret = pk_progress_set_percentage (state->progress,
 						  pk_client_percentage_to_signed (g_variant_get_uint32 (value)));
-		if (ret && state->progress_callback != NULL) {
-			state->progress_callback (state->progress,
-						  PK_PROGRESS_TYPE_PERCENTAGE,
-						  state->progress_user_data);
-		}
+		if (ret)
+			pk_client_state_progress_notify (state, PK_PROGRESS_TYPE_PERCENTAGE);
 		return;
 	}
 
@@ -464,11 +497,8 @@ pk_client_set_property_value (PkClientState *state,
 	if (g_strcmp0 (key, "AllowCancel") == 0) {
 		ret = pk_progress_set_allow_cancel (state->progress,
 						  g_variant_get_boolean (value));
-		if (ret && state->progress_callback != NULL) {
-			state->progress_callback (state->progress,
-						  PK_PROGRESS_TYPE_ALLOW_CANCEL,
-						  state->progress_user_data);
-		}
+		if (ret)
+			pk_client_state_progress_notify (state, PK_PROGRESS_TYPE_ALLOW_CANCEL);
 		return;
 	}
 
@@ -476,11 +506,8 @@ pk_client_set_property_value (PkClientState *state,
 	if (g_strcmp0 (key, "CallerActive") == 0) {
 		ret = pk_progress_set_caller_active (state->progress,
 						  g_variant_get_boolean (value));
-		if (ret && state->progress_callback != NULL) {
-			state->progress_callback (state->progress,
-						  PK_PROGRESS_TYPE_CALLER_ACTIVE,
-						  state->progress_user_data);
-		}
+		if (ret)
+			pk_client_state_progress_notify (state, PK_PROGRESS_TYPE_CALLER_ACTIVE);
 		return;
 	}
 
@@ -488,11 +515,8 @@ pk_client_set_property_value (PkClientState *state,
 	if (g_strcmp0 (key, "ElapsedTime") == 0) {
 		ret = pk_progress_set_elapsed_time (state->progress,
 						  g_variant_get_uint32 (value));
-		if (ret && state->progress_callback != NULL) {
-			state->progress_callback (state->progress,
-						  PK_PROGRESS_TYPE_ELAPSED_TIME,
-						  state->progress_user_data);
-		}
+		if (ret)
+			pk_client_state_progress_notify (state, PK_PROGRESS_TYPE_ELAPSED_TIME);
 		return;
 	}
 
@@ -500,11 +524,8 @@ pk_client_set_property_value (PkClientState *state,
 	if (g_strcmp0 (key, "RemainingTime") == 0) {
 		ret = pk_progress_set_elapsed_time (state->progress,
 						    g_variant_get_uint32 (value));
-		if (ret && state->progress_callback != NULL) {
-			state->progress_callback (state->progress,
-						  PK_PROGRESS_TYPE_REMAINING_TIME,
-						  state->progress_user_data);
-		}
+		if (ret)
+			pk_client_state_progress_notify (state, PK_PROGRESS_TYPE_REMAINING_TIME);
 		return;
 	}
 
@@ -512,11 +533,8 @@ pk_client_set_property_value (PkClientState *state,
 	if (g_strcmp0 (key, "Speed") == 0) {
 		ret = pk_progress_set_speed (state->progress,
 					     g_variant_get_uint32 (value));
-		if (ret && state->progress_callback != NULL) {
-			state->progress_callback (state->progress,
-						  PK_PROGRESS_TYPE_SPEED,
-						  state->progress_user_data);
-		}
+		if (ret)
+			pk_client_state_progress_notify (state, PK_PROGRESS_TYPE_SPEED);
 		return;
 	}
 
@@ -524,11 +542,8 @@ pk_client_set_property_value (PkClientState *state,
 	if (g_strcmp0 (key, "DownloadSizeRemaining") == 0) {
 		ret = pk_progress_set_download_size_remaining (state->progress,
 							       g_variant_get_uint64 (value));
-		if (ret && state->progress_callback != NULL) {
-			state->progress_callback (state->progress,
-						  PK_PROGRESS_TYPE_DOWNLOAD_SIZE_REMAINING,
-						  state->progress_user_data);
-		}
+		if (ret)
+			pk_client_state_progress_notify (state, PK_PROGRESS_TYPE_DOWNLOAD_SIZE_REMAINING);
 		return;
 	}
 
@@ -536,11 +551,8 @@ pk_client_set_property_value (PkClientState *state,
 	if (g_strcmp0 (key, "TransactionFlags") == 0) {
 		ret = pk_progress_set_transaction_flags (state->progress,
 							 g_variant_get_uint64 (value));
-		if (ret && state->progress_callback != NULL) {
-			state->progress_callback (state->progress,
-						  PK_PROGRESS_TYPE_TRANSACTION_FLAGS,
-						  state->progress_user_data);
-		}
+		if (ret)
+			pk_client_state_progress_notify (state, PK_PROGRESS_TYPE_TRANSACTION_FLAGS);
 		return;
 	}
 
@@ -548,11 +560,8 @@ pk_client_set_property_value (PkClientState *state,
 	if (g_strcmp0 (key, "Uid") == 0) {
 		ret = pk_progress_set_uid (state->progress,
 						  g_variant_get_uint32 (value));
-		if (ret && state->progress_callback != NULL) {
-			state->progress_callback (state->progress,
-						  PK_PROGRESS_TYPE_UID,
-						  state->progress_user_data);
-		}
+		if (ret)
+			pk_client_state_progress_notify (state, PK_PROGRESS_TYPE_UID);
 		return;
 	}
 
@@ -607,38 +616,71 @@ pk_client_cancellable_cancel_cb (GCancellable *cancellable, PkClientState *state
 }
 
 /**
- * pk_client_state_remove:
+ * pk_client_remove_call:
+ *
+ * Stops tracking a call, which may happen on any thread.
  **/
-static void
-pk_client_state_remove (PkClient *client, PkClientState *state)
+void
+pk_client_remove_call (PkClient *client, gpointer call)
 {
-	gboolean is_idle;
-	g_ptr_array_remove (client->priv->calls, state);
+	gboolean changed = FALSE;
 
-	/* has the idle state changed? */
-	is_idle = (client->priv->calls->len == 0);
-	if (is_idle != client->priv->idle) {
-		client->priv->idle = is_idle;
-		g_object_notify (G_OBJECT(client), "idle");
+	g_mutex_lock (&client->priv->calls_lock);
+	g_ptr_array_remove (client->priv->calls, call);
+	if (client->priv->calls->len == 0 && !client->priv->idle) {
+		client->priv->idle = TRUE;
+		changed = TRUE;
 	}
+	g_mutex_unlock (&client->priv->calls_lock);
+
+	/* only the call that changed the idle state notifies */
+	if (changed)
+		g_object_notify (G_OBJECT(client), "idle");
 }
 
 /**
- * pk_client_state_add:
+ * pk_client_add_call:
+ *
+ * Tracks a call in flight, which may happen on any thread.
  **/
-static void
-pk_client_state_add (PkClient *client, PkClientState *state)
+void
+pk_client_add_call (PkClient *client, gpointer call)
 {
-	gboolean is_idle;
+	gboolean changed = FALSE;
 
-	g_ptr_array_add (client->priv->calls, state);
+	g_mutex_lock (&client->priv->calls_lock);
+	g_ptr_array_add (client->priv->calls, call);
+	if (client->priv->idle) {
+		client->priv->idle = FALSE;
+		changed = TRUE;
+	}
+	g_mutex_unlock (&client->priv->calls_lock);
 
-	/* has the idle state changed? */
-	is_idle = (client->priv->calls->len == 0);
-	if (is_idle != client->priv->idle) {
-		client->priv->idle = is_idle;
+	/* only the call that changed the idle state notifies */
+	if (changed)
 		g_object_notify (G_OBJECT(client), "idle");
-	}
+}
+
+/**
+ * pk_client_state_cache_save:
+ **/
+static void
+pk_client_state_cache_save (PkClientState *state)
+{
+	GVariant *signals;
+	_cleanup_error_free_ GError *error = NULL;
+
+	signals = g_variant_new_array (G_VARIANT_TYPE ("(sv)"),
+				       (GVariant **) state->cache_signals->pdata,
+				       state->cache_signals->len);
+	g_variant_ref_sink (signals);
+	if (!pk_client_cache_add (state->cache_filename,
+				  state->cache_generation,
+				  state->cache_key,
+				  signals,
+				  &error))
+		g_warning ("failed to save %s: %s", state->cache_filename, error->message);
+	g_variant_unref (signals);
 }
 
 /**
@@ -650,13 +692,12 @@ pk_client_state_finish (PkClientState *state, const GError *error)
 	gboolean ret;
 	_cleanup_error_free_ GError *error_local = NULL;
 
-	/* force finished (if not already set) so clients can update the UI's */
+	/* send anything still held back by the coalescing policy, then
+	 * force finished (if not already set) so clients can update the UI's */
+	pk_progress_dispatch_flush (state->progress);
 	ret = pk_progress_set_status (state->progress, PK_STATUS_ENUM_FINISHED);
-	if (ret && state->progress_callback != NULL) {
-		state->progress_callback (state->progress,
-					  PK_PROGRESS_TYPE_STATUS,
-					  state->progress_user_data);
-	}
+	if (ret)
+		pk_client_state_progress_notify (state, PK_PROGRESS_TYPE_STATUS);
 
 	if (state->cancellable_id > 0) {
 		g_cancellable_disconnect (state->cancellable_client,
@@ -678,6 +719,11 @@ pk_client_state_finish (PkClientState *state, const GError *error)
 	if (state->proxy_props != NULL)
 		g_object_unref (G_OBJECT (state->proxy_props));
 
+	/* save for the next identical query */
+	if (state->ret && state->cache_signals != NULL &&
+	    pk_results_get_exit_code (state->results) == PK_EXIT_ENUM_SUCCESS)
+		pk_client_state_cache_save (state);
+
 	if (state->ret) {
 		g_simple_async_result_set_op_res_gpointer (state->res,
 							   g_object_ref (state->results),
@@ -694,7 +740,7 @@ pk_client_state_finish (PkClientState *state, const GError *error)
 	}
 
 	/* remove from list */
-	pk_client_state_remove (state->client, state);
+	pk_client_remove_call (state->client, state);
 
 	/* complete */
 	g_simple_async_result_complete_in_idle (state->res);
@@ -713,6 +759,10 @@ pk_client_state_finish (PkClientState *state, const GError *error)
 	g_free (state->transaction_id);
 	g_strfreev (state->files);
 	g_strfreev (state->package_ids);
+	g_free (state->cache_filename);
+	g_free (state->cache_key);
+	if (state->cache_signals != NULL)
+		g_ptr_array_unref (state->cache_signals);
 	/* results will no exists if the CreateTransaction fails */
 	if (state->results != NULL)
 		g_object_unref (state->results);
@@ -746,6 +796,104 @@ pk_client_properties_changed_cb (GDBusProxy *proxy,
 	}
 }
 
+/* the D-Bus signals a transaction can emit */
+typedef enum {
+	PK_CLIENT_SIGNAL_UNKNOWN,
+	PK_CLIENT_SIGNAL_FINISHED,
+	PK_CLIENT_SIGNAL_PACKAGE,
+	PK_CLIENT_SIGNAL_PACKAGES,
+	PK_CLIENT_SIGNAL_DETAILS,
+	PK_CLIENT_SIGNAL_UPDATE_DETAIL,
+	PK_CLIENT_SIGNAL_TRANSACTION,
+	PK_CLIENT_SIGNAL_DISTRO_UPGRADE,
+	PK_CLIENT_SIGNAL_REQUIRE_RESTART,
+	PK_CLIENT_SIGNAL_CATEGORY,
+	PK_CLIENT_SIGNAL_FILES,
+	PK_CLIENT_SIGNAL_REPO_SIGNATURE_REQUIRED,
+	PK_CLIENT_SIGNAL_EULA_REQUIRED,
+	PK_CLIENT_SIGNAL_REPO_DETAIL,
+	PK_CLIENT_SIGNAL_ERROR_CODE,
+	PK_CLIENT_SIGNAL_MEDIA_CHANGE_REQUIRED,
+	PK_CLIENT_SIGNAL_ITEM_PROGRESS,
+	PK_CLIENT_SIGNAL_DESTROY,
+	PK_CLIENT_SIGNAL_LAST
+} PkClientSignal;
+
+static const PkEnumMatch enum_signal[] = {
+	{PK_CLIENT_SIGNAL_UNKNOWN,			"Unknown"},	/* fall though value */
+	{PK_CLIENT_SIGNAL_FINISHED,			"Finished"},
+	{PK_CLIENT_SIGNAL_PACKAGE,			"Package"},
+	{PK_CLIENT_SIGNAL_PACKAGES,			"Packages"},
+	{PK_CLIENT_SIGNAL_DETAILS,			"Details"},
+	{PK_CLIENT_SIGNAL_UPDATE_DETAIL,		"UpdateDetail"},
+	{PK_CLIENT_SIGNAL_TRANSACTION,			"Transaction"},
+	{PK_CLIENT_SIGNAL_DISTRO_UPGRADE,		"DistroUpgrade"},
+	{PK_CLIENT_SIGNAL_REQUIRE_RESTART,		"RequireRestart"},
+	{PK_CLIENT_SIGNAL_CATEGORY,			"Category"},
+	{PK_CLIENT_SIGNAL_FILES,			"Files"},
+	{PK_CLIENT_SIGNAL_REPO_SIGNATURE_REQUIRED,	"RepoSignatureRequired"},
+	{PK_CLIENT_SIGNAL_EULA_REQUIRED,		"EulaRequired"},
+	{PK_CLIENT_SIGNAL_REPO_DETAIL,			"RepoDetail"},
+	{PK_CLIENT_SIGNAL_ERROR_CODE,			"ErrorCode"},
+	{PK_CLIENT_SIGNAL_MEDIA_CHANGE_REQUIRED,	"MediaChangeRequired"},
+	{PK_CLIENT_SIGNAL_ITEM_PROGRESS,		"ItemProgress"},
+	{PK_CLIENT_SIGNAL_DESTROY,			"Destroy"},
+	{0, NULL}
+};
+
+/**
+ * pk_client_signal_from_string:
+ *
+ * Looks up a signal name using a hash built once for the whole process,
+ * rather than comparing the name against every signal in turn.
+ **/
+static PkClientSignal
+pk_client_signal_from_string (const gchar *signal_name)
+{
+	static GHashTable *hash = NULL;
+	gpointer value;
+
+	if (g_once_init_enter (&hash)) {
+		GHashTable *tmp;
+		guint i;
+		tmp = g_hash_table_new (g_str_hash, g_str_equal);
+		for (i = 1; enum_signal[i].string != NULL; i++) {
+			g_hash_table_insert (tmp,
+					     (gpointer) enum_signal[i].string,
+					     GUINT_TO_POINTER (enum_signal[i].value));
+		}
+		g_once_init_leave (&hash, tmp);
+	}
+	if (!g_hash_table_lookup_extended (hash, signal_name, NULL, &value))
+		return PK_CLIENT_SIGNAL_UNKNOWN;
+	return GPOINTER_TO_UINT (value);
+}
+
+/**
+ * pk_client_state_stream_item:
+ *
+ * Return value: %TRUE if the item was handed to the item callback and
+ * should not be added to the results
+ */
+static gboolean
+pk_client_state_stream_item (PkClientState *state, gpointer item)
+{
+	PkClientPrivate *priv;
+
+	if (state->client == NULL)
+		return FALSE;
+	priv = state->client->priv;
+	if (priv->item_callback == NULL)
+		return FALSE;
+
+	/* PkTask needs the simulated packages to ask the user */
+	if (pk_bitfield_contain (state->transaction_flags,
+				 PK_TRANSACTION_FLAG_ENUM_SIMULATE))
+		return FALSE;
+	priv->item_callback (state->client, PK_SOURCE (item), priv->item_user_data);
+	return TRUE;
+}
+
 /**
  * pk_client_signal_package:
  */
@@ -765,15 +913,18 @@ pk_client_signal_package (PkClientState *state,
 		g_warning ("failed to set package id for %s", package_id);
 		return;
 	}
-	g_object_set (package,
-		      "info", info_enum,
-		      "summary", summary,
-		      "role", state->role,
-		      "transaction-id", state->transaction_id,
-		      NULL);
+
+	/* nothing can be connected to ::notify yet, so skip the GObject
+	 * property machinery which dominates when receiving many packages */
+	pk_package_set_info (package, info_enum);
+	pk_package_set_summary (package, summary);
+	pk_source_set_transaction (PK_SOURCE (package),
+				   state->role,
+				   state->transaction_id);
 
 	/* add to results */
-	if (state->results != NULL && info_enum != PK_INFO_ENUM_FINISHED)
+	if (state->results != NULL && info_enum != PK_INFO_ENUM_FINISHED &&
+	    !pk_client_state_stream_item (state, package))
 		pk_results_add_package (state->results, package);
 
 	/* only emit progress for verb packages */
@@ -790,17 +941,11 @@ pk_client_signal_package (PkClientState *state,
 	case PK_INFO_ENUM_DECOMPRESSING:
 	case PK_INFO_ENUM_FINISHED:
 		ret = pk_progress_set_package_id (state->progress, package_id);
-		if (state->progress_callback != NULL && ret) {
-			state->progress_callback (state->progress,
-						  PK_PROGRESS_TYPE_PACKAGE_ID,
-						  state->progress_user_data);
-		}
+		if (ret)
+			pk_client_state_progress_notify (state, PK_PROGRESS_TYPE_PACKAGE_ID);
 		ret = pk_progress_set_package (state->progress, package);
-		if (state->progress_callback != NULL && ret) {
-			state->progress_callback (state->progress,
-						  PK_PROGRESS_TYPE_PACKAGE,
-						  state->progress_user_data);
-		}
+		if (ret)
+			pk_client_state_progress_notify (state, PK_PROGRESS_TYPE_PACKAGE);
 		break;
 	default:
 		break;
@@ -879,11 +1024,8 @@ pk_client_copy_progress_cb (goffset current_num_bytes, goffset total_num_bytes,
 
 	/* save status */
 	ret = pk_progress_set_status (state->progress, PK_STATUS_ENUM_COPY_FILES);
-	if (state->progress_callback != NULL && ret) {
-		state->progress_callback (state->progress,
-					  PK_PROGRESS_TYPE_STATUS,
-					  state->progress_user_data);
-	}
+	if (ret)
+		pk_client_state_progress_notify (state, PK_PROGRESS_TYPE_STATUS);
 
 	/* calculate percentage */
 	if (total_num_bytes > 0)
@@ -891,11 +1033,8 @@ pk_client_copy_progress_cb (goffset current_num_bytes, goffset total_num_bytes,
 
 	/* save percentage */
 	ret = pk_progress_set_percentage (state->progress, percentage);
-	if (state->progress_callback != NULL && ret) {
-		state->progress_callback (state->progress,
-					  PK_PROGRESS_TYPE_PERCENTAGE,
-					  state->progress_user_data);
-	}
+	if (ret)
+		pk_client_state_progress_notify (state, PK_PROGRESS_TYPE_PERCENTAGE);
 }
 
 /**
@@ -980,11 +1119,8 @@ pk_client_copy_downloaded (PkClientState *state)
 
 	/* save percentage */
 	ret = pk_progress_set_percentage (state->progress, -1);
-	if (state->progress_callback != NULL && ret) {
-		state->progress_callback (state->progress,
-					  PK_PROGRESS_TYPE_PERCENTAGE,
-					  state->progress_user_data);
-	}
+	if (ret)
+		pk_client_state_progress_notify (state, PK_PROGRESS_TYPE_PERCENTAGE);
 
 	/* do the copies pipelined */
 	for (i = 0; i < len; i++) {
@@ -1065,8 +1201,20 @@ pk_client_signal_cb (GDBusProxy *proxy,
 	guint tmp_uint;
 	guint tmp_uint2;
 	guint tmp_uint3;
+	PkClientSignal signal_kind;
 
-	if (g_strcmp0 (signal_name, "Finished") == 0) {
+	signal_kind = pk_client_signal_from_string (signal_name);
+
+	/* keep what is needed to answer the same query again */
+	if (state->cache_signals != NULL &&
+	    (signal_kind == PK_CLIENT_SIGNAL_PACKAGE ||
+	     signal_kind == PK_CLIENT_SIGNAL_PACKAGES ||
+	     signal_kind == PK_CLIENT_SIGNAL_DETAILS)) {
+		g_ptr_array_add (state->cache_signals,
+				 g_variant_ref_sink (g_variant_new ("(sv)", signal_name, parameters)));
+	}
+
+	if (signal_kind == PK_CLIENT_SIGNAL_FINISHED) {
 		g_variant_get (parameters,
 			       "(uu)",
 			       &tmp_uint2,
@@ -1076,7 +1224,7 @@ pk_client_signal_cb (GDBusProxy *proxy,
 					   tmp_uint);
 		return;
 	}
-	if (g_strcmp0 (signal_name, "Package") == 0) {
+	if (signal_kind == PK_CLIENT_SIGNAL_PACKAGE) {
 		g_variant_get (parameters,
 			       "(u&s&s)",
 			       &tmp_uint,
@@ -1088,7 +1236,23 @@ pk_client_signal_cb (GDBusProxy *proxy,
 					  tmp_str[2]);
 		return;
 	}
-	if (g_strcmp0 (signal_name, "Details") == 0) {
+	if (signal_kind == PK_CLIENT_SIGNAL_PACKAGES) {
+		GVariantIter *iter;
+		g_variant_get (parameters, "(a(uss))", &iter);
+		while (g_variant_iter_next (iter,
+					    "(u&s&s)",
+					    &tmp_uint,
+					    &tmp_str[1],
+					    &tmp_str[2])) {
+			pk_client_signal_package (state,
+						  tmp_uint,
+						  tmp_str[1],
+						  tmp_str[2]);
+		}
+		g_variant_iter_free (iter);
+		return;
+	}
+	if (signal_kind == PK_CLIENT_SIGNAL_DETAILS) {
 		gchar *key;
 		GVariantIter *dictionary;
 		GVariant *value;
@@ -1097,6 +1261,7 @@ pk_client_signal_cb (GDBusProxy *proxy,
 
 		if (g_variant_is_of_type (parameters, G_VARIANT_TYPE ("(a{sv})"))) {
 			g_variant_get_child (parameters, 0, "a{sv}", &dictionary);
+			g_object_freeze_notify (G_OBJECT (item));
 			while (g_variant_iter_loop (dictionary, "{sv}", &key, &value)) {
 				if (g_strcmp0 (key, "group") == 0)
 					g_object_set (item, "group", g_variant_get_uint32 (value), NULL);
@@ -1105,6 +1270,7 @@ pk_client_signal_cb (GDBusProxy *proxy,
 				else
 					g_object_set (item, key, g_variant_get_string (value, NULL), NULL);
 			}
+			g_object_thaw_notify (G_OBJECT (item));
 			g_variant_iter_free (dictionary);
 		} else {
 			guint64 tmp_uint64;
@@ -1127,10 +1293,11 @@ pk_client_signal_cb (GDBusProxy *proxy,
 				      "transaction-id", state->transaction_id,
 				      NULL);
 		}
-		pk_results_add_details (state->results, item);
+		if (!pk_client_state_stream_item (state, item))
+			pk_results_add_details (state->results, item);
 		return;
 	}
-	if (g_strcmp0 (signal_name, "UpdateDetail") == 0) {
+	if (signal_kind == PK_CLIENT_SIGNAL_UPDATE_DETAIL) {
 		_cleanup_object_unref_ PkUpdateDetail *item = NULL;
 		g_variant_get (parameters,
 			       "(&s^a&s^a&s^a&s^a&s^a&su&s&su&s&s)",
@@ -1163,10 +1330,11 @@ pk_client_signal_cb (GDBusProxy *proxy,
 			      "role", state->role,
 			      "transaction-id", state->transaction_id,
 			      NULL);
-		pk_results_add_update_detail (state->results, item);
+		if (!pk_client_state_stream_item (state, item))
+			pk_results_add_update_detail (state->results, item);
 		return;
 	}
-	if (g_strcmp0 (signal_name, "Transaction") == 0) {
+	if (signal_kind == PK_CLIENT_SIGNAL_TRANSACTION) {
 		_cleanup_object_unref_ PkTransactionPast *item = NULL;
 		g_variant_get (parameters,
 			       "(&o&sbuu&su&s)",
@@ -1191,10 +1359,11 @@ pk_client_signal_cb (GDBusProxy *proxy,
 			      "PkSource::role", state->role,
 			      "transaction-id", state->transaction_id,
 			      NULL);
-		pk_results_add_transaction (state->results, item);
+		if (!pk_client_state_stream_item (state, item))
+			pk_results_add_transaction (state->results, item);
 		return;
 	}
-	if (g_strcmp0 (signal_name, "DistroUpgrade") == 0) {
+	if (signal_kind == PK_CLIENT_SIGNAL_DISTRO_UPGRADE) {
 		_cleanup_object_unref_ PkDistroUpgrade *item = NULL;
 		g_variant_get (parameters,
 			       "(u&s&s)",
@@ -1209,10 +1378,11 @@ pk_client_signal_cb (GDBusProxy *proxy,
 			      "role", state->role,
 			      "transaction-id", state->transaction_id,
 			      NULL);
-		pk_results_add_distro_upgrade (state->results, item);
+		if (!pk_client_state_stream_item (state, item))
+			pk_results_add_distro_upgrade (state->results, item);
 		return;
 	}
-	if (g_strcmp0 (signal_name, "RequireRestart") == 0) {
+	if (signal_kind == PK_CLIENT_SIGNAL_REQUIRE_RESTART) {
 		_cleanup_object_unref_ PkRequireRestart *item = NULL;
 		g_variant_get (parameters,
 			       "(u&s)",
@@ -1228,7 +1398,7 @@ pk_client_signal_cb (GDBusProxy *proxy,
 		pk_results_add_require_restart (state->results, item);
 		return;
 	}
-	if (g_strcmp0 (signal_name, "Category") == 0) {
+	if (signal_kind == PK_CLIENT_SIGNAL_CATEGORY) {
 		_cleanup_object_unref_ PkCategory *item = NULL;
 		g_variant_get (parameters,
 			       "(&s&s&s&s&s)",
@@ -1247,10 +1417,11 @@ pk_client_signal_cb (GDBusProxy *proxy,
 			      "role", state->role,
 			      "transaction-id", state->transaction_id,
 			      NULL);
-		pk_results_add_category (state->results, item);
+		if (!pk_client_state_stream_item (state, item))
+			pk_results_add_category (state->results, item);
 		return;
 	}
-	if (g_strcmp0 (signal_name, "Files") == 0) {
+	if (signal_kind == PK_CLIENT_SIGNAL_FILES) {
 		gchar **files;
 		_cleanup_object_unref_ PkFiles *item = NULL;
 		g_variant_get (parameters,
@@ -1264,10 +1435,11 @@ pk_client_signal_cb (GDBusProxy *proxy,
 			      "role", state->role,
 			      "transaction-id", state->transaction_id,
 			      NULL);
-		pk_results_add_files (state->results, item);
+		if (!pk_client_state_stream_item (state, item))
+			pk_results_add_files (state->results, item);
 		return;
 	}
-	if (g_strcmp0 (signal_name, "RepoSignatureRequired") == 0) {
+	if (signal_kind == PK_CLIENT_SIGNAL_REPO_SIGNATURE_REQUIRED) {
 		_cleanup_object_unref_ PkRepoSignatureRequired *item = NULL;
 		g_variant_get (parameters,
 			       "(&s&s&s&s&s&s&su)",
@@ -1295,7 +1467,7 @@ pk_client_signal_cb (GDBusProxy *proxy,
 		pk_results_add_repo_signature_required (state->results, item);
 		return;
 	}
-	if (g_strcmp0 (signal_name, "EulaRequired") == 0) {
+	if (signal_kind == PK_CLIENT_SIGNAL_EULA_REQUIRED) {
 		_cleanup_object_unref_ PkEulaRequired *item = NULL;
 		g_variant_get (parameters,
 			       "(&s&s&s&s)",
@@ -1315,7 +1487,7 @@ pk_client_signal_cb (GDBusProxy *proxy,
 		pk_results_add_eula_required (state->results, item);
 		return;
 	}
-	if (g_strcmp0 (signal_name, "RepoDetail") == 0) {
+	if (signal_kind == PK_CLIENT_SIGNAL_REPO_DETAIL) {
 		_cleanup_object_unref_ PkRepoDetail *item = NULL;
 		g_variant_get (parameters,
 			       "(&s&sb)",
@@ -1330,10 +1502,11 @@ pk_client_signal_cb (GDBusProxy *proxy,
 			      "role", state->role,
 			      "transaction-id", state->transaction_id,
 			      NULL);
-		pk_results_add_repo_detail (state->results, item);
+		if (!pk_client_state_stream_item (state, item))
+			pk_results_add_repo_detail (state->results, item);
 		return;
 	}
-	if (g_strcmp0 (signal_name, "ErrorCode") == 0) {
+	if (signal_kind == PK_CLIENT_SIGNAL_ERROR_CODE) {
 		_cleanup_object_unref_ PkError *item = NULL;
 		g_variant_get (parameters,
 			       "(u&s)",
@@ -1349,7 +1522,7 @@ pk_client_signal_cb (GDBusProxy *proxy,
 		pk_results_set_error_code (state->results, item);
 		return;
 	}
-	if (g_strcmp0 (signal_name, "MediaChangeRequired") == 0) {
+	if (signal_kind == PK_CLIENT_SIGNAL_MEDIA_CHANGE_REQUIRED) {
 		_cleanup_object_unref_ PkMediaChangeRequired *item = NULL;
 		g_variant_get (parameters,
 			       "(u&s&s)",
@@ -1367,7 +1540,7 @@ pk_client_signal_cb (GDBusProxy *proxy,
 		pk_results_add_media_change_required (state->results, item);
 		return;
 	}
-	if (g_strcmp0 (signal_name, "ItemProgress") == 0) {
+	if (signal_kind == PK_CLIENT_SIGNAL_ITEM_PROGRESS) {
 		_cleanup_object_unref_ PkItemProgress *item = NULL;
 		g_variant_get (parameters,
 			       "(&suu)",
@@ -1383,17 +1556,58 @@ pk_client_signal_cb (GDBusProxy *proxy,
 			      NULL);
 		ret = pk_progress_set_item_progress (state->progress,
 						     item);
-		if (ret && state->progress_callback != NULL) {
-			state->progress_callback (state->progress,
-						  PK_PROGRESS_TYPE_ITEM_PROGRESS,
-						  state->progress_user_data);
-		}
+		if (ret)
+			pk_client_state_progress_notify (state, PK_PROGRESS_TYPE_ITEM_PROGRESS);
 		return;
 	}
-	if (g_strcmp0 (signal_name, "Destroy") == 0)
+	if (signal_kind == PK_CLIENT_SIGNAL_DESTROY)
 		return;
 }
 
+/**
+ * pk_client_replay_signals:
+ * @client: (allow-none): a #PkClient whose item callback is used, or %NULL
+ * @role: the role of the recorded transaction
+ * @transaction_id: the transaction ID of the recorded transaction
+ * @signals: the recorded signals, of type a(sv)
+ *
+ * Feeds recorded transaction signals through the same decoder that is used
+ * for a live transaction, without needing a daemon.
+ *
+ * Return value: (transfer full): the results
+ **/
+PkResults *
+pk_client_replay_signals (PkClient *client,
+			  PkRoleEnum role,
+			  const gchar *transaction_id,
+			  GVariant *signals)
+{
+	GVariantIter iter;
+	GVariant *parameters;
+	PkClientState *state;
+	PkResults *results;
+	const gchar *signal_name;
+
+	state = g_slice_new0 (PkClientState);
+	state->client = client;
+	state->role = role;
+	state->transaction_id = g_strdup (transaction_id);
+	state->progress = pk_client_progress_new (client);
+	state->results = pk_results_new ();
+	g_variant_iter_init (&iter, signals);
+	while (g_variant_iter_next (&iter, "(&sv)", &signal_name, &parameters)) {
+		/* there is no method call to complete */
+		if (pk_client_signal_from_string (signal_name) != PK_CLIENT_SIGNAL_FINISHED)
+			pk_client_signal_cb (NULL, NULL, signal_name, parameters, state);
+		g_variant_unref (parameters);
+	}
+	results = state->results;
+	g_object_unref (state->progress);
+	g_free (state->transaction_id);
+	g_slice_free (PkClientState, state);
+	return results;
+}
+
 /**
  * pk_client_proxy_connect:
  **/
@@ -1458,11 +1672,8 @@ pk_client_set_role (PkClientState *state, PkRoleEnum role)
 	pk_progress_set_transaction_flags (state->progress,
 					   state->transaction_flags);
 	ret = pk_progress_set_role (state->progress, role);
-	if (ret && state->progress_callback != NULL) {
-		state->progress_callback (state->progress,
-					  PK_PROGRESS_TYPE_ROLE,
-					  state->progress_user_data);
-	}
+	if (ret)
+		pk_client_state_progress_notify (state, PK_PROGRESS_TYPE_ROLE);
 	return;
 }
 
@@ -2025,6 +2236,10 @@ pk_client_get_proxy_cb (GObject *object,
 				pk_client_bool_to_string (state->client->priv->interactive));
 	g_ptr_array_add (array, hint);
 
+	/* we can decode ::Packages */
+	hint = g_strdup ("batch-packages=true");
+	g_ptr_array_add (array, hint);
+
 	/* cache-age */
 	if (state->client->priv->cache_age > 0) {
 		hint = g_strdup_printf ("cache-age=%u",
@@ -2054,7 +2269,9 @@ pk_client_get_proxy_cb (GObject *object,
 			   state);
 
 	/* track state */
+	g_mutex_lock (&state->client->priv->calls_lock);
 	g_ptr_array_add (state->client->priv->calls, state);
+	g_mutex_unlock (&state->client->priv->calls_lock);
 }
 
 /**
@@ -2086,6 +2303,141 @@ pk_client_get_tid_cb (GObject *object, GAsyncResult *res, PkClientState *state)
 				  state);
 }
 
+/**
+ * pk_client_get_tid_start:
+ **/
+static void
+pk_client_get_tid_start (PkClientState *state)
+{
+	pk_control_get_tid_async (state->client->priv->control,
+				  state->cancellable_client,
+				  (GAsyncReadyCallback) pk_client_get_tid_cb,
+				  state);
+}
+
+/**
+ * pk_client_cache_replay:
+ **/
+static void
+pk_client_cache_replay (PkClientState *state, GVariant *signals)
+{
+	GVariantIter iter;
+	GVariant *parameters;
+	const gchar *signal_name;
+
+	g_debug ("using cached results for %s", pk_role_enum_to_string (state->role));
+	state->results = pk_results_new ();
+	g_object_set (state->results,
+		      "role", state->role,
+		      "progress", state->progress,
+		      "transaction-flags", state->transaction_flags,
+		      NULL);
+	g_variant_iter_init (&iter, signals);
+	while (g_variant_iter_next (&iter, "(&sv)", &signal_name, &parameters)) {
+		pk_client_signal_cb (NULL, NULL, signal_name, parameters, state);
+		g_variant_unref (parameters);
+	}
+	pk_results_set_exit_code (state->results, PK_EXIT_ENUM_SUCCESS);
+	state->ret = TRUE;
+	pk_client_state_finish (state, NULL);
+}
+
+/**
+ * pk_client_cache_generation_cb:
+ **/
+static void
+pk_client_cache_generation_cb (GObject *object, GAsyncResult *res, PkClientState *state)
+{
+	_cleanup_error_free_ GError *error = NULL;
+	_cleanup_variant_unref_ GVariant *generation = NULL;
+	_cleanup_variant_unref_ GVariant *signals = NULL;
+	_cleanup_variant_unref_ GVariant *value = NULL;
+
+	/* an older daemon, so just ask it */
+	value = g_dbus_connection_call_finish (G_DBUS_CONNECTION (object), res, &error);
+	if (value == NULL) {
+		g_debug ("failed to get CacheGeneration: %s", error->message);
+		pk_client_get_tid_start (state);
+		return;
+	}
+	g_variant_get (value, "(v)", &generation);
+	if (!g_variant_is_of_type (generation, G_VARIANT_TYPE_UINT64)) {
+		pk_client_get_tid_start (state);
+		return;
+	}
+	state->cache_generation = g_variant_get_uint64 (generation);
+
+	/* answer from the cache */
+	signals = pk_client_cache_lookup (state->cache_filename,
+					  state->cache_generation,
+					  state->cache_key);
+	if (signals != NULL) {
+		pk_client_cache_replay (state, signals);
+		return;
+	}
+
+	/* record the query for next time */
+	state->cache_signals = g_ptr_array_new_with_free_func ((GDestroyNotify) g_variant_unref);
+	pk_client_get_tid_start (state);
+}
+
+/**
+ * pk_client_cache_bus_cb:
+ **/
+static void
+pk_client_cache_bus_cb (GObject *object, GAsyncResult *res, PkClientState *state)
+{
+	_cleanup_error_free_ GError *error = NULL;
+	_cleanup_object_unref_ GDBusConnection *connection = NULL;
+
+	connection = g_bus_get_finish (res, &error);
+	if (connection == NULL) {
+		pk_client_state_finish (state, error);
+		return;
+	}
+	g_dbus_connection_call (connection,
+				PK_DBUS_SERVICE,
+				PK_DBUS_PATH,
+				"org.freedesktop.DBus.Properties",
+				"Get",
+				g_variant_new ("(ss)",
+					       PK_DBUS_INTERFACE,
+					       "CacheGeneration"),
+				G_VARIANT_TYPE ("(v)"),
+				G_DBUS_CALL_FLAGS_NONE,
+				PK_CLIENT_DBUS_METHOD_TIMEOUT,
+				state->cancellable_client,
+				(GAsyncReadyCallback) pk_client_cache_generation_cb,
+				state);
+}
+
+/**
+ * pk_client_query_start:
+ *
+ * Starts a read-only query, answering it from the metadata cache if the
+ * daemon has not changed the package database since it was saved.
+ **/
+static void
+pk_client_query_start (PkClientState *state, gchar **values)
+{
+	PkClientPrivate *priv = state->client->priv;
+
+	if (priv->cache_filename == NULL ||
+	    !pk_client_cache_role_is_cacheable (state->role)) {
+		pk_client_get_tid_start (state);
+		return;
+	}
+	state->cache_filename = g_strdup (priv->cache_filename);
+	state->cache_key = pk_client_cache_get_key (state->role,
+						    state->filters,
+						    priv->locale,
+						    values);
+	g_bus_get (G_BUS_TYPE_SYSTEM,
+		   state->cancellable_client,
+		   (GAsyncReadyCallback) pk_client_cache_bus_cb,
+		   state);
+}
+
 /**
  * pk_client_generic_finish:
  * @client: a valid #PkClient instance
@@ -2163,7 +2515,7 @@ pk_client_resolve_async (PkClient *client, PkBitfield filters, gchar **packages,
 	state->package_ids = g_strdupv (packages);
 	state->progress_callback = progress_callback;
 	state->progress_user_data = progress_user_data;
-	state->progress = pk_progress_new ();
+	state->progress = pk_client_progress_new (client);
 
 	/* check not already cancelled */
 	if (cancellable != NULL &&
@@ -2175,11 +2527,8 @@ pk_client_resolve_async (PkClient *client, PkBitfield filters, gchar **packages,
 	/* identify */
 	pk_client_set_role (state, state->role);
 
-	/* get tid */
-	pk_control_get_tid_async (client->priv->control,
-				  cancellable,
-				  (GAsyncReadyCallback) pk_client_get_tid_cb,
-				  state);
+	/* get tid, unless the metadata cache has the answer */
+	pk_client_query_start (state, state->package_ids);
 }
 
 /**
@@ -2230,7 +2579,7 @@ pk_client_search_names_async (PkClient *client, PkBitfield filters, gchar **valu
 	state->search = g_strdupv (values);
 	state->progress_callback = progress_callback;
 	state->progress_user_data = progress_user_data;
-	state->progress = pk_progress_new ();
+	state->progress = pk_client_progress_new (client);
 
 	/* check not already cancelled */
 	if (cancellable != NULL &&
@@ -2242,11 +2591,8 @@ pk_client_search_names_async (PkClient *client, PkBitfield filters, gchar **valu
 	/* identify */
 	pk_client_set_role (state, state->role);
 
-	/* get tid */
-	pk_control_get_tid_async (client->priv->control,
-				  cancellable,
-				  (GAsyncReadyCallback) pk_client_get_tid_cb,
-				  state);
+	/* get tid, unless the metadata cache has the answer */
+	pk_client_query_start (state, state->search);
 }
 
 /**
@@ -2298,7 +2644,7 @@ pk_client_search_details_async (PkClient *client, PkBitfield filters, gchar **va
 	state->search = g_strdupv (values);
 	state->progress_callback = progress_callback;
 	state->progress_user_data = progress_user_data;
-	state->progress = pk_progress_new ();
+	state->progress = pk_client_progress_new (client);
 
 	/* check not already cancelled */
 	if (cancellable != NULL &&
@@ -2364,7 +2710,7 @@ pk_client_search_groups_async (PkClient *client, PkBitfield filters, gchar **val
 	state->search = g_strdupv (values);
 	state->progress_callback = progress_callback;
 	state->progress_user_data = progress_user_data;
-	state->progress = pk_progress_new ();
+	state->progress = pk_client_progress_new (client);
 
 	/* check not already cancelled */
 	if (cancellable != NULL &&
@@ -2430,7 +2776,7 @@ pk_client_search_files_async (PkClient *client, PkBitfield filters, gchar **valu
 	state->search = g_strdupv (values);
 	state->progress_callback = progress_callback;
 	state->progress_user_data = progress_user_data;
-	state->progress = pk_progress_new ();
+	state->progress = pk_client_progress_new (client);
 
 	/* check not already cancelled */
 	if (cancellable != NULL &&
@@ -2496,7 +2842,7 @@ pk_client_get_details_async (PkClient *client, gchar **package_ids, GCancellable
 	state->package_ids = g_strdupv (package_ids);
 	state->progress_callback = progress_callback;
 	state->progress_user_data = progress_user_data;
-	state->progress = pk_progress_new ();
+	state->progress = pk_client_progress_new (client);
 
 	/* check not already cancelled */
 	if (cancellable != NULL &&
@@ -2508,11 +2854,8 @@ pk_client_get_details_async (PkClient *client, gchar **package_ids, GCancellable
 	/* identify */
 	pk_client_set_role (state, state->role);
 
-	/* get tid */
-	pk_control_get_tid_async (client->priv->control,
-				  cancellable,
-				  (GAsyncReadyCallback) pk_client_get_tid_cb,
-				  state);
+	/* get tid, unless the metadata cache has the answer */
+	pk_client_query_start (state, state->package_ids);
 }
 
 /**
@@ -2561,7 +2904,7 @@ pk_client_get_details_local_async (PkClient *client, gchar **files, GCancellable
 	}
 	state->progress_callback = progress_callback;
 	state->progress_user_data = progress_user_data;
-	state->progress = pk_progress_new ();
+	state->progress = pk_client_progress_new (client);
 	state->files = pk_client_convert_real_paths (files, &error);
 	if (state->files == NULL) {
 		pk_client_state_finish (state, error);
@@ -2631,7 +2974,7 @@ pk_client_get_files_local_async (PkClient *client, gchar **files, GCancellable *
 	}
 	state->progress_callback = progress_callback;
 	state->progress_user_data = progress_user_data;
-	state->progress = pk_progress_new ();
+	state->progress = pk_client_progress_new (client);
 	state->files = pk_client_convert_real_paths (files, &error);
 	if (state->files == NULL) {
 		pk_client_state_finish (state, error);
@@ -2702,7 +3045,7 @@ pk_client_get_update_detail_async (PkClient *client, gchar **package_ids, GCance
 	state->package_ids = g_strdupv (package_ids);
 	state->progress_callback = progress_callback;
 	state->progress_user_data = progress_user_data;
-	state->progress = pk_progress_new ();
+	state->progress = pk_client_progress_new (client);
 
 	/* check not already cancelled */
 	if (cancellable != NULL &&
@@ -2769,7 +3112,7 @@ pk_client_download_packages_async (PkClient *client, gchar **package_ids, const
 	state->directory = g_strdup (directory);
 	state->progress_callback = progress_callback;
 	state->progress_user_data = progress_user_data;
-	state->progress = pk_progress_new ();
+	state->progress = pk_client_progress_new (client);
 
 	/* check not already cancelled */
 	if (cancellable != NULL &&
@@ -2833,7 +3176,7 @@ pk_client_get_updates_async (PkClient *client, PkBitfield filters, GCancellable
 	state->filters = filters;
 	state->progress_callback = progress_callback;
 	state->progress_user_data = progress_user_data;
-	state->progress = pk_progress_new ();
+	state->progress = pk_client_progress_new (client);
 
 	/* check not already cancelled */
 	if (cancellable != NULL &&
@@ -2897,7 +3240,7 @@ pk_client_get_old_transactions_async (PkClient *client, guint number, GCancellab
 	state->number = number;
 	state->progress_callback = progress_callback;
 	state->progress_user_data = progress_user_data;
-	state->progress = pk_progress_new ();
+	state->progress = pk_client_progress_new (client);
 
 	/* check not already cancelled */
 	if (cancellable != NULL &&
@@ -2966,7 +3309,7 @@ pk_client_depends_on_async (PkClient *client, PkBitfield filters, gchar **packag
 	state->package_ids = g_strdupv (package_ids);
 	state->progress_callback = progress_callback;
 	state->progress_user_data = progress_user_data;
-	state->progress = pk_progress_new ();
+	state->progress = pk_client_progress_new (client);
 
 	/* check not already cancelled */
 	if (cancellable != NULL &&
@@ -3030,7 +3373,7 @@ pk_client_get_packages_async (PkClient *client, PkBitfield filters, GCancellable
 	state->filters = filters;
 	state->progress_callback = progress_callback;
 	state->progress_user_data = progress_user_data;
-	state->progress = pk_progress_new ();
+	state->progress = pk_client_progress_new (client);
 
 	/* check not already cancelled */
 	if (cancellable != NULL &&
@@ -3099,7 +3442,7 @@ pk_client_required_by_async (PkClient *client, PkBitfield filters, gchar **packa
 	state->package_ids = g_strdupv (package_ids);
 	state->progress_callback = progress_callback;
 	state->progress_user_data = progress_user_data;
-	state->progress = pk_progress_new ();
+	state->progress = pk_client_progress_new (client);
 
 	/* check not already cancelled */
 	if (cancellable != NULL &&
@@ -3170,7 +3513,7 @@ pk_client_what_provides_async (PkClient *client,
 	state->search = g_strdupv (values);
 	state->progress_callback = progress_callback;
 	state->progress_user_data = progress_user_data;
-	state->progress = pk_progress_new ();
+	state->progress = pk_client_progress_new (client);
 
 	/* check not already cancelled */
 	if (cancellable != NULL &&
@@ -3233,7 +3576,7 @@ pk_client_get_distro_upgrades_async (PkClient *client, GCancellable *cancellable
 	}
 	state->progress_callback = progress_callback;
 	state->progress_user_data = progress_user_data;
-	state->progress = pk_progress_new ();
+	state->progress = pk_client_progress_new (client);
 
 	/* check not already cancelled */
 	if (cancellable != NULL &&
@@ -3298,7 +3641,7 @@ pk_client_get_files_async (PkClient *client, gchar **package_ids, GCancellable *
 	state->package_ids = g_strdupv (package_ids);
 	state->progress_callback = progress_callback;
 	state->progress_user_data = progress_user_data;
-	state->progress = pk_progress_new ();
+	state->progress = pk_client_progress_new (client);
 
 	/* check not already cancelled */
 	if (cancellable != NULL &&
@@ -3360,7 +3703,7 @@ pk_client_get_categories_async (PkClient *client, GCancellable *cancellable,
 	}
 	state->progress_callback = progress_callback;
 	state->progress_user_data = progress_user_data;
-	state->progress = pk_progress_new ();
+	state->progress = pk_client_progress_new (client);
 
 	/* check not already cancelled */
 	if (cancellable != NULL &&
@@ -3440,7 +3783,7 @@ pk_client_remove_packages_async (PkClient *client,
 	state->package_ids = g_strdupv (package_ids);
 	state->progress_callback = progress_callback;
 	state->progress_user_data = progress_user_data;
-	state->progress = pk_progress_new ();
+	state->progress = pk_client_progress_new (client);
 
 	/* check not already cancelled */
 	if (cancellable != NULL &&
@@ -3507,7 +3850,7 @@ pk_client_refresh_cache_async (PkClient *client, gboolean force, GCancellable *c
 	state->force = force;
 	state->progress_callback = progress_callback;
 	state->progress_user_data = progress_user_data;
-	state->progress = pk_progress_new ();
+	state->progress = pk_client_progress_new (client);
 
 	/* check not already cancelled */
 	if (cancellable != NULL &&
@@ -3574,7 +3917,7 @@ pk_client_install_packages_async (PkClient *client, PkBitfield transaction_flags
 	state->package_ids = g_strdupv (package_ids);
 	state->progress_callback = progress_callback;
 	state->progress_user_data = progress_user_data;
-	state->progress = pk_progress_new ();
+	state->progress = pk_client_progress_new (client);
 
 	/* check not already cancelled */
 	if (cancellable != NULL &&
@@ -3642,7 +3985,7 @@ pk_client_install_signature_async (PkClient *client, PkSigTypeEnum type, const g
 	state->package_id = g_strdup (package_id);
 	state->progress_callback = progress_callback;
 	state->progress_user_data = progress_user_data;
-	state->progress = pk_progress_new ();
+	state->progress = pk_client_progress_new (client);
 
 	/* check not already cancelled */
 	if (cancellable != NULL &&
@@ -3714,7 +4057,7 @@ pk_client_update_packages_async (PkClient *client,
 	state->package_ids = g_strdupv (package_ids);
 	state->progress_callback = progress_callback;
 	state->progress_user_data = progress_user_data;
-	state->progress = pk_progress_new ();
+	state->progress = pk_client_progress_new (client);
 
 	/* check not already cancelled */
 	if (cancellable != NULL &&
@@ -3775,11 +4118,8 @@ pk_client_copy_non_native_then_get_tid (PkClientState *state)
 
 	/* save percentage */
 	ret = pk_progress_set_percentage (state->progress, -1);
-	if (state->progress_callback != NULL && ret) {
-		state->progress_callback (state->progress,
-					  PK_PROGRESS_TYPE_PERCENTAGE,
-					  state->progress_user_data);
-	}
+	if (ret)
+		pk_client_state_progress_notify (state, PK_PROGRESS_TYPE_PERCENTAGE);
 
 	/* copy each file that is non-native */
 	for (i = 0; state->files[i] != NULL; i++) {
@@ -3863,7 +4203,7 @@ pk_client_install_files_async (PkClient *client,
 	state->transaction_flags = transaction_flags;
 	state->progress_callback = progress_callback;
 	state->progress_user_data = progress_user_data;
-	state->progress = pk_progress_new ();
+	state->progress = pk_client_progress_new (client);
 
 	/* check not already cancelled */
 	if (cancellable != NULL &&
@@ -3949,7 +4289,7 @@ pk_client_accept_eula_async (PkClient *client, const gchar *eula_id, GCancellabl
 	state->eula_id = g_strdup (eula_id);
 	state->progress_callback = progress_callback;
 	state->progress_user_data = progress_user_data;
-	state->progress = pk_progress_new ();
+	state->progress = pk_client_progress_new (client);
 
 	/* check not already cancelled */
 	if (cancellable != NULL &&
@@ -4013,7 +4353,7 @@ pk_client_get_repo_list_async (PkClient *client, PkBitfield filters, GCancellabl
 	state->filters = filters;
 	state->progress_callback = progress_callback;
 	state->progress_user_data = progress_user_data;
-	state->progress = pk_progress_new ();
+	state->progress = pk_client_progress_new (client);
 
 	/* check not already cancelled */
 	if (cancellable != NULL &&
@@ -4079,7 +4419,7 @@ pk_client_repo_enable_async (PkClient *client, const gchar *repo_id, gboolean en
 	state->repo_id = g_strdup (repo_id);
 	state->progress_callback = progress_callback;
 	state->progress_user_data = progress_user_data;
-	state->progress = pk_progress_new ();
+	state->progress = pk_client_progress_new (client);
 
 	/* check not already cancelled */
 	if (cancellable != NULL &&
@@ -4148,7 +4488,7 @@ pk_client_repo_set_data_async (PkClient *client, const gchar *repo_id, const gch
 	state->value = g_strdup (value);
 	state->progress_callback = progress_callback;
 	state->progress_user_data = progress_user_data;
-	state->progress = pk_progress_new ();
+	state->progress = pk_client_progress_new (client);
 
 	/* check not already cancelled */
 	if (cancellable != NULL &&
@@ -4222,7 +4562,7 @@ pk_client_repo_remove_async (PkClient *client,
 	state->autoremove = autoremove;
 	state->progress_callback = progress_callback;
 	state->progress_user_data = progress_user_data;
-	state->progress = pk_progress_new ();
+	state->progress = pk_client_progress_new (client);
 
 	/* check not already cancelled */
 	if (cancellable != NULL &&
@@ -4291,7 +4631,7 @@ pk_client_repair_system_async (PkClient *client,
 	state->transaction_flags = transaction_flags;
 	state->progress_callback = progress_callback;
 	state->progress_user_data = progress_user_data;
-	state->progress = pk_progress_new ();
+	state->progress = pk_client_progress_new (client);
 
 	/* check not already cancelled */
 	if (cancellable != NULL && g_cancellable_set_error_if_cancelled (cancellable, &error)) {
@@ -4378,7 +4718,7 @@ pk_client_adopt_async (PkClient *client,
 	state->tid = g_strdup (transaction_id);
 	state->progress_callback = progress_callback;
 	state->progress_user_data = progress_user_data;
-	state->progress = pk_progress_new ();
+	state->progress = pk_client_progress_new (client);
 	state->results = pk_results_new ();
 	g_object_set (state->results,
 		      "role", state->role,
@@ -4408,7 +4748,7 @@ pk_client_adopt_async (PkClient *client,
 				  state);
 
 	/* track state */
-	pk_client_state_add (client, state);
+	pk_client_add_call (client, state);
 }
 
 /**********************************************************************/
@@ -4476,7 +4816,7 @@ pk_client_get_progress_state_finish (PkClientState *state, const GError *error)
 	}
 
 	/* remove from list */
-	pk_client_state_remove (state->client, state);
+	pk_client_remove_call (state->client, state);
 
 	/* complete */
 	g_simple_async_result_complete_in_idle (state->res);
@@ -4555,7 +4895,7 @@ pk_client_get_progress_async (PkClient *client,
 							       NULL);
 	}
 	state->tid = g_strdup (transaction_id);
-	state->progress = pk_progress_new ();
+	state->progress = pk_client_progress_new (client);
 
 	/* check not already cancelled */
 	if (cancellable != NULL &&
@@ -4579,7 +4919,7 @@ pk_client_get_progress_async (PkClient *client,
 				  state);
 
 	/* track state */
-	pk_client_state_add (client, state);
+	pk_client_add_call (client, state);
 }
 
 /**********************************************************************/
@@ -4593,15 +4933,24 @@ pk_client_cancel_all_dbus_methods (PkClient *client)
 	const PkClientState *state;
 	guint i;
 	GPtrArray *array;
+	_cleanup_ptrarray_unref_ GPtrArray *cancellables = NULL;
 
-	/* just cancel the call */
+	/* cancelling can finish a call, so do it without holding the lock */
+	cancellables = g_ptr_array_new_with_free_func (g_object_unref);
+	g_mutex_lock (&client->priv->calls_lock);
 	array = client->priv->calls;
 	for (i = 0; i < array->len; i++) {
 		state = g_ptr_array_index (array, i);
 		if (state->proxy == NULL)
 			continue;
+		g_ptr_array_add (cancellables, g_object_ref (state->cancellable));
+	}
+	g_mutex_unlock (&client->priv->calls_lock);
+
+	/* just cancel the call */
+	for (i = 0; i < cancellables->len; i++) {
 		g_debug ("cancel in flight call");
-		g_cancellable_cancel (state->cancellable);
+		g_cancellable_cancel (g_ptr_array_index (cancellables, i));
 	}
 
 	return TRUE;
@@ -4726,8 +5075,15 @@ pk_client_get_interactive (PkClient *client)
 gboolean
 pk_client_get_idle (PkClient *client)
 {
+	gboolean idle;
+
 	g_return_val_if_fail (PK_IS_CLIENT (client), FALSE);
-	return client->priv->idle;
+
+	/* calls may be added and removed on other threads */
+	g_mutex_lock (&client->priv->calls_lock);
+	idle = client->priv->idle;
+	g_mutex_unlock (&client->priv->calls_lock);
+	return idle;
 }
 
 /**
@@ -4764,6 +5120,87 @@ pk_client_get_cache_age (PkClient *client)
 	return client->priv->cache_age;
 }
 
+/**
+ * pk_client_set_item_callback:
+ * @client: a valid #PkClient instance
+ * @callback: (scope notified) (allow-none): the function to run for each result item, or %NULL
+ * @user_data: data to pass to @callback
+ * @destroy: (allow-none): a function to free @user_data, or %NULL
+ *
+ * Streams the results of the following transactions started with this
+ * client. Each #PkPackage, #PkDetails, #PkFiles, #PkUpdateDetail,
+ * #PkTransactionPast, #PkDistroUpgrade, #PkCategory and #PkRepoDetail is
+ * handed to @callback as soon as it is received and is not added to the
+ * #PkResults, so large results do not have to be kept in memory. The
+ * callback is run from the main loop before the next item is processed.
+ *
+ * Simulated transactions are never streamed as #PkTask needs their results.
+ *
+ * Since: 1.0.1
+ **/
+void
+pk_client_set_item_callback (PkClient *client,
+			     PkClientItemCallback callback,
+			     gpointer user_data,
+			     GDestroyNotify destroy)
+{
+	PkClientPrivate *priv;
+
+	g_return_if_fail (PK_IS_CLIENT (client));
+
+	priv = client->priv;
+	if (priv->item_destroy != NULL)
+		priv->item_destroy (priv->item_user_data);
+	priv->item_callback = callback;
+	priv->item_user_data = user_data;
+	priv->item_destroy = destroy;
+}
+
+/**
+ * pk_client_set_progress_coalesce_policy:
+ * @client: a valid #PkClient instance
+ * @interval: the minimum time between progress callbacks in ms, or 0 for no limit
+ * @coalesce_by_type: if each #PkProgressType has its own interval
+ *
+ * Sets the coalescing policy of the #PkProgress used by the following
+ * transactions started with this client, so that a frontend is not
+ * called thousands of times a second during a large transaction.
+ * See pk_progress_set_coalesce_policy() for details.
+ *
+ * Since: 1.0.1
+ **/
+void
+pk_client_set_progress_coalesce_policy (PkClient *client,
+					guint interval,
+					gboolean coalesce_by_type)
+{
+	g_return_if_fail (PK_IS_CLIENT (client));
+	client->priv->progress_interval = interval;
+	client->priv->progress_by_type = coalesce_by_type;
+}
+
+/**
+ * pk_client_set_metadata_cache_file:
+ * @client: a valid #PkClient instance
+ * @filename: (allow-none): a file in the users cache directory, or %NULL
+ *
+ * Sets a file used to keep the results of resolve, search-name and
+ * get-details queries between processes. The results are only used for
+ * as long as the daemon reports the same cache generation, so checking
+ * them costs one D-Bus property read rather than a whole transaction.
+ *
+ * The cache is not used unless this is called, and %NULL disables it.
+ *
+ * Since: 1.0.1
+ **/
+void
+pk_client_set_metadata_cache_file (PkClient *client, const gchar *filename)
+{
+	g_return_if_fail (PK_IS_CLIENT (client));
+	g_free (client->priv->cache_filename);
+	client->priv->cache_filename = g_strdup (filename);
+}
+
 /**
  * pk_client_class_init:
  **/
@@ -4837,6 +5274,7 @@ pk_client_init (PkClient *client)
 {
 	client->priv = PK_CLIENT_GET_PRIVATE (client);
 	client->priv->calls = g_ptr_array_new ();
+	g_mutex_init (&client->priv->calls_lock);
 	client->priv->background = FALSE;
 	client->priv->interactive = TRUE;
 	client->priv->idle = TRUE;
@@ -4861,9 +5299,13 @@ pk_client_finalize (GObject *object)
 	/* ensure we cancel any in-flight DBus calls */
 	pk_client_cancel_all_dbus_methods (client);
 
+	if (priv->item_destroy != NULL)
+		priv->item_destroy (priv->item_user_data);
 	g_free (client->priv->locale);
+	g_free (priv->cache_filename);
 	g_object_unref (priv->control);
 	g_ptr_array_unref (priv->calls);
+	g_mutex_clear (&priv->calls_lock);
 
 	G_OBJECT_CLASS (pk_client_parent_class)->finalize (object);
 }
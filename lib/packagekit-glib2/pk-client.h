@@ -98,6 +98,10 @@ struct _PkClientClass
 	void (*_pk_reserved5) (void);
 };
 
+typedef void	(*PkClientItemCallback)			(PkClient		*client,
+							 PkSource		*item,
+							 gpointer		 user_data);
+
 GQuark		 pk_client_error_quark			(void);
 GType		 pk_client_get_type		  	(void);
 PkClient	*pk_client_new				(void);
@@ -410,6 +414,15 @@ gboolean	 pk_client_get_idle			(PkClient		*client);
 void		 pk_client_set_cache_age		(PkClient		*client,
 							 guint			 cache_age);
 guint		 pk_client_get_cache_age		(PkClient		*client);
+void		 pk_client_set_item_callback		(PkClient		*client,
+							 PkClientItemCallback	 callback,
+							 gpointer		 user_data,
+							 GDestroyNotify		 destroy);
+void		 pk_client_set_progress_coalesce_policy	(PkClient		*client,
+							 guint			 interval,
+							 gboolean		 coalesce_by_type);
+void		 pk_client_set_metadata_cache_file	(PkClient		*client,
+							 const gchar		*filename);
 
 G_END_DECLS
 
@@ -29,12 +29,12 @@
 #include <packagekit-glib2/pk-control.h>
 
 #include "pk-control-sync.h"
+#include "pk-sync-loop-private.h"
 
 /* tiny helper to help us do the async operation */
 typedef struct {
 	GError		**error;
-	GMainContext	*context;
-	GMainLoop	*loop;
+	PkSyncLoop	*loop;
 	gboolean	 ret;
 	guint		 seconds;
 	gchar		**transaction_list;
@@ -48,7 +48,7 @@ pk_control_get_properties_cb (PkControl *control, GAsyncResult *res, PkControlHe
 {
 	/* get the result */
 	helper->ret = pk_control_get_properties_finish (control, res, helper->error);
-	g_main_loop_quit (helper->loop);
+	pk_sync_loop_quit (helper->loop);
 }
 
 /**
@@ -76,23 +76,17 @@ pk_control_get_properties (PkControl *control, GCancellable *cancellable, GError
 
 	/* create temp object */
 	memset (&helper, 0, sizeof (PkControlHelper));
-	helper.context = g_main_context_new ();
-	helper.loop = g_main_loop_new (helper.context, FALSE);
+	helper.loop = pk_sync_loop_acquire ();
 	helper.error = error;
 
-	g_main_context_push_thread_default (helper.context);
-
 	/* run async method */
 	pk_control_get_properties_async (control, cancellable, (GAsyncReadyCallback) pk_control_get_properties_cb, &helper);
-	g_main_loop_run (helper.loop);
+	pk_sync_loop_run (helper.loop);
 
 	ret = helper.ret;
 
-	g_main_context_pop_thread_default (helper.context);
-
-	/* free temp object */
-	g_main_loop_unref (helper.loop);
-	g_main_context_unref (helper.context);
+	/* give back temp loop */
+	pk_sync_loop_release (helper.loop);
 
 	return ret;
 }
@@ -105,7 +99,7 @@ pk_control_get_transaction_list_cb (PkControl *control, GAsyncResult *res, PkCon
 {
 	/* get the result */
 	helper->transaction_list = pk_control_get_transaction_list_finish (control, res, helper->error);
-	g_main_loop_quit (helper->loop);
+	pk_sync_loop_quit (helper->loop);
 }
 
 /**
@@ -133,23 +127,17 @@ pk_control_get_transaction_list (PkControl *control, GCancellable *cancellable,
 
 	/* create temp object */
 	memset (&helper, 0, sizeof (PkControlHelper));
-	helper.context = g_main_context_new ();
-	helper.loop = g_main_loop_new (helper.context, FALSE);
+	helper.loop = pk_sync_loop_acquire ();
 	helper.error = error;
 
-	g_main_context_push_thread_default (helper.context);
-
 	/* run async method */
 	pk_control_get_transaction_list_async (control, cancellable, (GAsyncReadyCallback) pk_control_get_transaction_list_cb, &helper);
-	g_main_loop_run (helper.loop);
+	pk_sync_loop_run (helper.loop);
 
 	transaction_list = helper.transaction_list;
 
-	g_main_context_pop_thread_default (helper.context);
-
-	/* free temp object */
-	g_main_loop_unref (helper.loop);
-	g_main_context_unref (helper.context);
+	/* give back temp loop */
+	pk_sync_loop_release (helper.loop);
 
 	return transaction_list;
 }
@@ -162,7 +150,7 @@ pk_control_suggest_daemon_quit_cb (PkControl *control, GAsyncResult *res, PkCont
 {
 	/* get the result */
 	helper->ret = pk_control_suggest_daemon_quit_finish (control, res, helper->error);
-	g_main_loop_quit (helper->loop);
+	pk_sync_loop_quit (helper->loop);
 }
 
 /**
@@ -190,23 +178,17 @@ pk_control_suggest_daemon_quit (PkControl *control, GCancellable *cancellable, G
 
 	/* create temp object */
 	memset (&helper, 0, sizeof (PkControlHelper));
-	helper.context = g_main_context_new ();
-	helper.loop = g_main_loop_new (helper.context, FALSE);
+	helper.loop = pk_sync_loop_acquire ();
 	helper.error = error;
 
-	g_main_context_push_thread_default (helper.context);
-
 	/* run async method */
 	pk_control_suggest_daemon_quit_async (control, cancellable, (GAsyncReadyCallback) pk_control_suggest_daemon_quit_cb, &helper);
-	g_main_loop_run (helper.loop);
+	pk_sync_loop_run (helper.loop);
 
 	ret = helper.ret;
 
-	g_main_context_pop_thread_default (helper.context);
-
-	/* free temp object */
-	g_main_loop_unref (helper.loop);
-	g_main_context_unref (helper.context);
+	/* give back temp loop */
+	pk_sync_loop_release (helper.loop);
 
 	return ret;
 }
@@ -219,7 +201,7 @@ pk_control_set_proxy_cb (PkControl *control, GAsyncResult *res, PkControlHelper
 {
 	/* get the result */
 	helper->ret = pk_control_set_proxy_finish (control, res, helper->error);
-	g_main_loop_quit (helper->loop);
+	pk_sync_loop_quit (helper->loop);
 }
 
 /**
@@ -257,12 +239,9 @@ pk_control_set_proxy2 (PkControl *control,
 
 	/* create temp object */
 	memset (&helper, 0, sizeof (PkControlHelper));
-	helper.context = g_main_context_new ();
-	helper.loop = g_main_loop_new (helper.context, FALSE);
+	helper.loop = pk_sync_loop_acquire ();
 	helper.error = error;
 
-	g_main_context_push_thread_default (helper.context);
-
 	/* run async method */
 	pk_control_set_proxy2_async (control,
 				     proxy_http,
@@ -274,15 +253,12 @@ pk_control_set_proxy2 (PkControl *control,
 				     cancellable,
 				     (GAsyncReadyCallback) pk_control_set_proxy_cb,
 				     &helper);
-	g_main_loop_run (helper.loop);
+	pk_sync_loop_run (helper.loop);
 
 	ret = helper.ret;
 
-	g_main_context_pop_thread_default (helper.context);
-
-	/* free temp object */
-	g_main_loop_unref (helper.loop);
-	g_main_context_unref (helper.context);
+	/* give back temp loop */
+	pk_sync_loop_release (helper.loop);
 
 	return ret;
 }
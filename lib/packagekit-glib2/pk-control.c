@@ -125,8 +125,15 @@ typedef struct {
 	PkNetworkEnum		 network;
 	GVariant		*parameters;
 	GDBusProxy		*proxy;
+	GVariant		*history;
+	guint64			 cursor;
 } PkControlState;
 
+typedef struct {
+	GVariant		*history;
+	guint64			 cursor;
+} PkControlHistoryPage;
+
 /**
  * pk_control_error_quark:
  *
@@ -1691,6 +1698,244 @@ pk_control_get_time_since_action_finish (PkControl *control,
 /**********************************************************************/
 
 
+/**
+ * pk_control_history_page_free:
+ **/
+static void
+pk_control_history_page_free (PkControlHistoryPage *page)
+{
+	g_variant_unref (page->history);
+	g_slice_free (PkControlHistoryPage, page);
+}
+
+/**
+ * pk_control_get_package_history_since_state_finish:
+ **/
+static void
+pk_control_get_package_history_since_state_finish (PkControlState *state,
+						   const GError *error)
+{
+	PkControlHistoryPage *page;
+
+	/* get result */
+	if (state->history != NULL) {
+		page = g_slice_new (PkControlHistoryPage);
+		page->history = g_variant_ref (state->history);
+		page->cursor = state->cursor;
+		g_simple_async_result_set_op_res_gpointer (state->res, page,
+							   (GDestroyNotify) pk_control_history_page_free);
+	} else {
+		g_simple_async_result_set_from_error (state->res, error);
+	}
+
+	/* remove from list */
+	g_ptr_array_remove (state->control->priv->calls, state);
+
+	/* complete */
+	g_simple_async_result_complete_in_idle (state->res);
+
+	/* deallocate */
+	if (state->cancellable != NULL) {
+		g_cancellable_disconnect (state->cancellable,
+					  state->cancellable_id);
+		g_object_unref (state->cancellable);
+	}
+	if (state->history != NULL)
+		g_variant_unref (state->history);
+	g_object_unref (state->res);
+	g_object_unref (state->control);
+	if (state->proxy != NULL)
+		g_object_unref (state->proxy);
+	g_variant_unref (state->parameters);
+	g_slice_free (PkControlState, state);
+}
+
+/**
+ * pk_control_get_package_history_since_cb:
+ **/
+static void
+pk_control_get_package_history_since_cb (GObject *source_object,
+					 GAsyncResult *res,
+					 gpointer user_data)
+{
+	GDBusProxy *proxy = G_DBUS_PROXY (source_object);
+	PkControlState *state = (PkControlState *) user_data;
+	_cleanup_variant_unref_ GVariant *value = NULL;
+	_cleanup_error_free_ GError *error = NULL;
+
+	/* get the result */
+	value = g_dbus_proxy_call_finish (proxy, res, &error);
+	if (value == NULL) {
+		/* fix up the D-Bus error */
+		pk_control_fixup_dbus_error (error);
+		pk_control_get_package_history_since_state_finish (state, error);
+		return;
+	}
+
+	/* save data */
+	g_variant_get (value, "(@aa{sv}t)", &state->history, &state->cursor);
+
+	/* we're done */
+	pk_control_get_package_history_since_state_finish (state, NULL);
+}
+
+/**
+ * pk_control_get_package_history_since_internal:
+ **/
+static void
+pk_control_get_package_history_since_internal (PkControlState *state)
+{
+	g_dbus_proxy_call (state->control->priv->proxy,
+			   "GetPackageHistorySince",
+			   state->parameters,
+			   G_DBUS_CALL_FLAGS_NONE,
+			   PK_CONTROL_DBUS_METHOD_TIMEOUT,
+			   state->cancellable,
+			   pk_control_get_package_history_since_cb,
+			   state);
+}
+
+/**
+ * pk_control_get_package_history_since_proxy_cb:
+ **/
+static void
+pk_control_get_package_history_since_proxy_cb (GObject *source_object,
+					       GAsyncResult *res,
+					       gpointer user_data)
+{
+	_cleanup_error_free_ GError *error = NULL;
+	PkControlState *state = (PkControlState *) user_data;
+
+	state->proxy = g_dbus_proxy_new_for_bus_finish (res, &error);
+	if (state->proxy == NULL) {
+		pk_control_get_package_history_since_state_finish (state, error);
+		return;
+	}
+	pk_control_proxy_connect (state);
+	pk_control_get_package_history_since_internal (state);
+}
+
+/**
+ * pk_control_get_package_history_since_async:
+ * @control: a valid #PkControl instance
+ * @since: the oldest time to return history for, in seconds since the epoch, or 0
+ * @cursor: the cursor returned by the last page, or 0 to start at the beginning
+ * @limit: the maximum number of entries to return, or 0 for the daemon maximum
+ * @cancellable: a #GCancellable or %NULL
+ * @callback: the function to run on completion
+ * @user_data: the data to pass to @callback
+ *
+ * Gets one page of the package history for all packages, oldest first.
+ * Agents auditing the history should save the cursor returned by
+ * pk_control_get_package_history_since_finish() and pass it to the next
+ * call, so that only the entries saved since the last poll are sent.
+ *
+ * Since: 1.0.1
+ **/
+void
+pk_control_get_package_history_since_async (PkControl *control,
+					    guint64 since,
+					    guint64 cursor,
+					    guint limit,
+					    GCancellable *cancellable,
+					    GAsyncReadyCallback callback,
+					    gpointer user_data)
+{
+	PkControlState *state;
+	_cleanup_object_unref_ GSimpleAsyncResult *res = NULL;
+	_cleanup_error_free_ GError *error = NULL;
+
+	g_return_if_fail (PK_IS_CONTROL (control));
+	g_return_if_fail (callback != NULL);
+	g_return_if_fail (cancellable == NULL || G_IS_CANCELLABLE (cancellable));
+
+	res = g_simple_async_result_new (G_OBJECT (control),
+					 callback,
+					 user_data,
+					 pk_control_get_package_history_since_async);
+
+	/* save state */
+	state = g_slice_new0 (PkControlState);
+	state->res = g_object_ref (res);
+	state->control = g_object_ref (control);
+	state->parameters = g_variant_new ("(ttu)", since, cursor, limit);
+	g_variant_ref_sink (state->parameters);
+	if (cancellable != NULL)
+		state->cancellable = g_object_ref (cancellable);
+
+	/* check not already cancelled */
+	if (cancellable != NULL &&
+	    g_cancellable_set_error_if_cancelled (cancellable, &error)) {
+		pk_control_get_package_history_since_state_finish (state, error);
+		return;
+	}
+
+	/* skip straight to the D-Bus method if already connection */
+	if (control->priv->proxy != NULL) {
+		pk_control_get_package_history_since_internal (state);
+	} else {
+		g_dbus_proxy_new_for_bus (G_BUS_TYPE_SYSTEM,
+					  G_DBUS_PROXY_FLAGS_NONE,
+					  NULL,
+					  PK_DBUS_SERVICE,
+					  PK_DBUS_PATH,
+					  PK_DBUS_INTERFACE,
+					  control->priv->cancellable,
+					  pk_control_get_package_history_since_proxy_cb,
+					  state);
+	}
+
+	/* track state */
+	g_ptr_array_add (control->priv->calls, state);
+}
+
+/**
+ * pk_control_get_package_history_since_finish:
+ * @control: a valid #PkControl instance
+ * @res: the #GAsyncResult
+ * @cursor: (out) (allow-none): the cursor to use for the next page
+ * @error: A #GError or %NULL
+ *
+ * Gets the result from the asynchronous function. Each entry has the
+ * same keys as the GetPackageHistorySince D-Bus method, for instance
+ * "name", "version", "info" and "timestamp".
+ *
+ * Return value: (transfer full): a 'aa{sv}' #GVariant, or %NULL for error.
+ * An empty array means there is no more history yet.
+ *
+ * Since: 1.0.1
+ **/
+GVariant *
+pk_control_get_package_history_since_finish (PkControl *control,
+					     GAsyncResult *res,
+					     guint64 *cursor,
+					     GError **error)
+{
+	GSimpleAsyncResult *simple;
+	gpointer source_tag;
+	PkControlHistoryPage *page;
+
+	g_return_val_if_fail (PK_IS_CONTROL (control), NULL);
+	g_return_val_if_fail (G_IS_SIMPLE_ASYNC_RESULT (res), NULL);
+	g_return_val_if_fail (error == NULL || *error == NULL, NULL);
+
+	simple = G_SIMPLE_ASYNC_RESULT (res);
+	source_tag = g_simple_async_result_get_source_tag (simple);
+
+	g_return_val_if_fail (source_tag == pk_control_get_package_history_since_async, NULL);
+
+	if (g_simple_async_result_propagate_error (simple, error))
+		return NULL;
+
+	page = g_simple_async_result_get_op_res_gpointer (simple);
+	if (cursor != NULL)
+		*cursor = page->cursor;
+	return g_variant_ref (page->history);
+}
+
+/**********************************************************************/
+
+
 /**
  * pk_control_can_authorize_state_finish:
  **/
@@ -147,6 +147,17 @@ void		 pk_control_get_transaction_list_async	(PkControl		*control,
 gchar		**pk_control_get_transaction_list_finish (PkControl		*control,
 							 GAsyncResult		*res,
 							 GError			**error);
+void		 pk_control_get_package_history_since_async (PkControl		*control,
+							 guint64		 since,
+							 guint64		 cursor,
+							 guint			 limit,
+							 GCancellable		*cancellable,
+							 GAsyncReadyCallback	 callback,
+							 gpointer		 user_data);
+GVariant	*pk_control_get_package_history_since_finish (PkControl	*control,
+							 GAsyncResult		*res,
+							 guint64		*cursor,
+							 GError			**error);
 void		 pk_control_can_authorize_async		(PkControl		*control,
 							 const gchar		*action_id,
 							 GCancellable		*cancellable,
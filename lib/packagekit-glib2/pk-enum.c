@@ -431,6 +431,48 @@ pk_enum_find_string (const PkEnumMatch *table, guint value)
 	return table[0].string;
 }
 
+/**
+ * pk_enum_find_value_indexed:
+ * @table: A #PkEnumMatch enum table of values
+ * @hash: the location of the index for @table, which is built on first use
+ * @string: the string constant to search for, e.g. "desktop-gnome"
+ *
+ * Search for a string value in a table of constants using a hash index,
+ * so the lookup does not get slower as the table grows. The index is
+ * built once, and is safe to use from any thread.
+ *
+ * Return value: the enumerated constant value, e.g. PK_SIGTYPE_ENUM_GPG
+ */
+static guint
+pk_enum_find_value_indexed (const PkEnumMatch *table,
+			    GHashTable **hash,
+			    const gchar *string)
+{
+	gpointer value;
+
+	/* return the first entry on non-found or error */
+	if (string == NULL)
+		return table[0].value;
+
+	if (g_once_init_enter (hash)) {
+		GHashTable *tmp;
+		guint i;
+		tmp = g_hash_table_new (g_str_hash, g_str_equal);
+		for (i = 0; table[i].string != NULL; i++) {
+			/* the first match wins, as in pk_enum_find_value() */
+			if (g_hash_table_contains (tmp, table[i].string))
+				continue;
+			g_hash_table_insert (tmp,
+					     (gpointer) table[i].string,
+					     GUINT_TO_POINTER (table[i].value));
+		}
+		g_once_init_leave (hash, tmp);
+	}
+	if (!g_hash_table_lookup_extended (*hash, string, NULL, &value))
+		return table[0].value;
+	return GPOINTER_TO_UINT (value);
+}
+
 /**
  * pk_sig_type_enum_from_string:
  * @sig_type: Text describing the enumerated type
@@ -442,7 +484,8 @@ pk_enum_find_string (const PkEnumMatch *table, guint value)
 PkSigTypeEnum
 pk_sig_type_enum_from_string (const gchar *sig_type)
 {
-	return pk_enum_find_value (enum_sig_type, sig_type);
+	static GHashTable *hash = NULL;
+	return pk_enum_find_value_indexed (enum_sig_type, &hash, sig_type);
 }
 
 /**
@@ -474,7 +517,8 @@ pk_sig_type_enum_to_string (PkSigTypeEnum sig_type)
 PkDistroUpgradeEnum
 pk_distro_upgrade_enum_from_string (const gchar *upgrade)
 {
-	return pk_enum_find_value (enum_upgrade, upgrade);
+	static GHashTable *hash = NULL;
+	return pk_enum_find_value_indexed (enum_upgrade, &hash, upgrade);
 }
 
 /**
@@ -506,7 +550,8 @@ pk_distro_upgrade_enum_to_string (PkDistroUpgradeEnum upgrade)
 PkInfoEnum
 pk_info_enum_from_string (const gchar *info)
 {
-	return pk_enum_find_value (enum_info, info);
+	static GHashTable *hash = NULL;
+	return pk_enum_find_value_indexed (enum_info, &hash, info);
 }
 
 /**
@@ -538,7 +583,8 @@ pk_info_enum_to_string (PkInfoEnum info)
 PkExitEnum
 pk_exit_enum_from_string (const gchar *exit_text)
 {
-	return pk_enum_find_value (enum_exit, exit_text);
+	static GHashTable *hash = NULL;
+	return pk_enum_find_value_indexed (enum_exit, &hash, exit_text);
 }
 
 /**
@@ -570,7 +616,8 @@ pk_exit_enum_to_string (PkExitEnum exit_enum)
 PkNetworkEnum
 pk_network_enum_from_string (const gchar *network)
 {
-	return pk_enum_find_value (enum_network, network);
+	static GHashTable *hash = NULL;
+	return pk_enum_find_value_indexed (enum_network, &hash, network);
 }
 
 /**
@@ -602,7 +649,8 @@ pk_network_enum_to_string (PkNetworkEnum network)
 PkStatusEnum
 pk_status_enum_from_string (const gchar *status)
 {
-	return pk_enum_find_value (enum_status, status);
+	static GHashTable *hash = NULL;
+	return pk_enum_find_value_indexed (enum_status, &hash, status);
 }
 
 /**
@@ -634,7 +682,8 @@ pk_status_enum_to_string (PkStatusEnum status)
 PkRoleEnum
 pk_role_enum_from_string (const gchar *role)
 {
-	return pk_enum_find_value (enum_role, role);
+	static GHashTable *hash = NULL;
+	return pk_enum_find_value_indexed (enum_role, &hash, role);
 }
 
 /**
@@ -666,7 +715,8 @@ pk_role_enum_to_string (PkRoleEnum role)
 PkErrorEnum
 pk_error_enum_from_string (const gchar *code)
 {
-	return pk_enum_find_value (enum_error, code);
+	static GHashTable *hash = NULL;
+	return pk_enum_find_value_indexed (enum_error, &hash, code);
 }
 
 /**
@@ -698,7 +748,8 @@ pk_error_enum_to_string (PkErrorEnum code)
 PkRestartEnum
 pk_restart_enum_from_string (const gchar *restart)
 {
-	return pk_enum_find_value (enum_restart, restart);
+	static GHashTable *hash = NULL;
+	return pk_enum_find_value_indexed (enum_restart, &hash, restart);
 }
 
 /**
@@ -730,7 +781,8 @@ pk_restart_enum_to_string (PkRestartEnum restart)
 PkGroupEnum
 pk_group_enum_from_string (const gchar *group)
 {
-	return pk_enum_find_value (enum_group, group);
+	static GHashTable *hash = NULL;
+	return pk_enum_find_value_indexed (enum_group, &hash, group);
 }
 
 /**
@@ -762,7 +814,8 @@ pk_group_enum_to_string (PkGroupEnum group)
 PkUpdateStateEnum
 pk_update_state_enum_from_string (const gchar *update_state)
 {
-	return pk_enum_find_value (enum_update_state, update_state);
+	static GHashTable *hash = NULL;
+	return pk_enum_find_value_indexed (enum_update_state, &hash, update_state);
 }
 
 /**
@@ -794,7 +847,8 @@ pk_update_state_enum_to_string (PkUpdateStateEnum update_state)
 PkFilterEnum
 pk_filter_enum_from_string (const gchar *filter)
 {
-	return pk_enum_find_value (enum_filter, filter);
+	static GHashTable *hash = NULL;
+	return pk_enum_find_value_indexed (enum_filter, &hash, filter);
 }
 
 /**
@@ -826,7 +880,8 @@ pk_filter_enum_to_string (PkFilterEnum filter)
 PkMediaTypeEnum
 pk_media_type_enum_from_string (const gchar *media_type)
 {
-	return pk_enum_find_value (enum_media_type, media_type);
+	static GHashTable *hash = NULL;
+	return pk_enum_find_value_indexed (enum_media_type, &hash, media_type);
 }
 
 /**
@@ -858,7 +913,8 @@ pk_media_type_enum_to_string (PkMediaTypeEnum media_type)
 PkAuthorizeEnum
 pk_authorize_type_enum_from_string (const gchar *authorize_type)
 {
-	return pk_enum_find_value (enum_authorize_type, authorize_type);
+	static GHashTable *hash = NULL;
+	return pk_enum_find_value_indexed (enum_authorize_type, &hash, authorize_type);
 }
 
 /**
@@ -890,7 +946,8 @@ pk_authorize_type_enum_to_string (PkAuthorizeEnum authorize_type)
 PkUpgradeKindEnum
 pk_upgrade_kind_enum_from_string (const gchar *upgrade_kind)
 {
-	return pk_enum_find_value (enum_upgrade_kind, upgrade_kind);
+	static GHashTable *hash = NULL;
+	return pk_enum_find_value_indexed (enum_upgrade_kind, &hash, upgrade_kind);
 }
 
 /**
@@ -922,7 +979,8 @@ pk_upgrade_kind_enum_to_string (PkUpgradeKindEnum upgrade_kind)
 PkTransactionFlagEnum
 pk_transaction_flag_enum_from_string (const gchar *transaction_flag)
 {
-	return pk_enum_find_value (enum_transaction_flag, transaction_flag);
+	static GHashTable *hash = NULL;
+	return pk_enum_find_value_indexed (enum_transaction_flag, &hash, transaction_flag);
 }
 
 /**
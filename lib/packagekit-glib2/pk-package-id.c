@@ -26,6 +26,7 @@
 
 #include "config.h"
 
+#include <string.h>
 #include <glib.h>
 
 #include "src/pk-cleanup.h"
@@ -46,22 +47,17 @@
 gchar **
 pk_package_id_split (const gchar *package_id)
 {
-	gchar **sections = NULL;
+	PkPackageIdView view;
+	gchar **sections;
+	guint i;
 
-	if (package_id == NULL)
-		goto out;
-
-	/* split by delimeter ';' */
-	sections = g_strsplit (package_id, ";", -1);
-	if (g_strv_length (sections) != 4)
-		goto out;
-
-	/* name has to be valid */
-	if (sections[0][0] != '\0')
-		return sections;
-out:
-	g_strfreev (sections);
-	return NULL;
+	if (!pk_package_id_view_init (&view, package_id))
+		return NULL;
+	sections = g_new (gchar *, 5);
+	for (i = 0; i < 4; i++)
+		sections[i] = pk_package_id_view_dup_field (&view, i);
+	sections[4] = NULL;
+	return sections;
 }
 
 /**
@@ -75,7 +71,7 @@ out:
 gboolean
 pk_package_id_check (const gchar *package_id)
 {
-	_cleanup_strv_free_ gchar **sections = NULL;
+	PkPackageIdView view;
 	gboolean ret;
 
 	/* NULL check */
@@ -88,10 +84,149 @@ pk_package_id_check (const gchar *package_id)
 		return FALSE;
 
 	/* correct number of sections */
-	sections = pk_package_id_split (package_id);
-	if (sections == NULL)
+	return pk_package_id_view_init (&view, package_id);
+}
+
+/**
+ * pk_package_id_view_init:
+ * @view: a #PkPackageIdView, usually on the stack
+ * @package_id: the ; delimited PackageID, which must outlive @view
+ *
+ * Finds the sections of a PackageID without copying them, checking the
+ * correct number of delimiters are present and the name is not empty.
+ * Unlike pk_package_id_check() the string is not checked to be UTF-8.
+ *
+ * Return value: %TRUE if the PackageID was well formed
+ *
+ * Since: 1.0.1
+ **/
+gboolean
+pk_package_id_view_init (PkPackageIdView *view, const gchar *package_id)
+{
+	guint field = 0;
+	guint i;
+	guint start = 0;
+
+	g_return_val_if_fail (view != NULL, FALSE);
+
+	memset (view, 0, sizeof (PkPackageIdView));
+	view->package_id = package_id;
+	if (package_id == NULL)
 		return FALSE;
-	return TRUE;
+	for (i = 0; ; i++) {
+		if (package_id[i] != ';' && package_id[i] != '\0')
+			continue;
+		if (field == 4)
+			return FALSE;
+		view->offset[field] = start;
+		view->length[field] = i - start;
+		field++;
+		start = i + 1;
+		if (package_id[i] == '\0')
+			break;
+	}
+
+	/* name has to be valid */
+	return field == 4 && view->length[PK_PACKAGE_ID_NAME] > 0;
+}
+
+/**
+ * pk_package_id_view_get_field:
+ * @view: a #PkPackageIdView set up with pk_package_id_view_init()
+ * @field: the section, e.g. %PK_PACKAGE_ID_NAME
+ * @length: (out) (allow-none): the length of the section in bytes
+ *
+ * Return value: the start of the section inside the PackageID, which is
+ * not nul terminated
+ *
+ * Since: 1.0.1
+ **/
+const gchar *
+pk_package_id_view_get_field (const PkPackageIdView *view, guint field, guint *length)
+{
+	g_return_val_if_fail (view != NULL, NULL);
+	g_return_val_if_fail (field < 4, NULL);
+	if (length != NULL)
+		*length = view->length[field];
+	return view->package_id + view->offset[field];
+}
+
+/**
+ * pk_package_id_view_field_equal:
+ * @view: a #PkPackageIdView set up with pk_package_id_view_init()
+ * @field: the section, e.g. %PK_PACKAGE_ID_NAME
+ * @value: (allow-none): the string to compare against
+ *
+ * Return value: %TRUE if the section is exactly @value
+ *
+ * Since: 1.0.1
+ **/
+gboolean
+pk_package_id_view_field_equal (const PkPackageIdView *view, guint field, const gchar *value)
+{
+	g_return_val_if_fail (view != NULL, FALSE);
+	g_return_val_if_fail (field < 4, FALSE);
+	if (value == NULL)
+		return FALSE;
+	return strncmp (view->package_id + view->offset[field],
+			value, view->length[field]) == 0 &&
+	       value[view->length[field]] == '\0';
+}
+
+/**
+ * pk_package_id_view_compare_field:
+ * @view1: a #PkPackageIdView set up with pk_package_id_view_init()
+ * @view2: another #PkPackageIdView
+ * @field: the section, e.g. %PK_PACKAGE_ID_NAME
+ *
+ * Compares the same section of two PackageIDs, ordering them just like
+ * g_strcmp0() would order the split sections.
+ *
+ * Return value: negative, zero or positive
+ *
+ * Since: 1.0.1
+ **/
+gint
+pk_package_id_view_compare_field (const PkPackageIdView *view1,
+				  const PkPackageIdView *view2,
+				  guint field)
+{
+	gint rc;
+	guint len1;
+	guint len2;
+
+	g_return_val_if_fail (view1 != NULL, 0);
+	g_return_val_if_fail (view2 != NULL, 0);
+	g_return_val_if_fail (field < 4, 0);
+
+	len1 = view1->length[field];
+	len2 = view2->length[field];
+	rc = memcmp (view1->package_id + view1->offset[field],
+		     view2->package_id + view2->offset[field],
+		     MIN (len1, len2));
+	if (rc != 0)
+		return rc;
+	if (len1 == len2)
+		return 0;
+	return len1 < len2 ? -1 : 1;
+}
+
+/**
+ * pk_package_id_view_dup_field:
+ * @view: a #PkPackageIdView set up with pk_package_id_view_init()
+ * @field: the section, e.g. %PK_PACKAGE_ID_NAME
+ *
+ * Return value: (transfer full): a copy of the section, use g_free() to free
+ *
+ * Since: 1.0.1
+ **/
+gchar *
+pk_package_id_view_dup_field (const PkPackageIdView *view, guint field)
+{
+	g_return_val_if_fail (view != NULL, NULL);
+	g_return_val_if_fail (field < 4, NULL);
+	return g_strndup (view->package_id + view->offset[field],
+			  view->length[field]);
 }
 
 /**
@@ -122,12 +257,12 @@ pk_package_id_build (const gchar *name, const gchar *version,
  * pk_arch_base_ix86:
  **/
 static gboolean
-pk_arch_base_ix86 (const gchar *arch)
+pk_arch_base_ix86 (const PkPackageIdView *view)
 {
-	if (g_strcmp0 (arch, "i386") == 0 ||
-	    g_strcmp0 (arch, "i486") == 0 ||
-	    g_strcmp0 (arch, "i586") == 0 ||
-	    g_strcmp0 (arch, "i686") == 0)
+	if (pk_package_id_view_field_equal (view, PK_PACKAGE_ID_ARCH, "i386") ||
+	    pk_package_id_view_field_equal (view, PK_PACKAGE_ID_ARCH, "i486") ||
+	    pk_package_id_view_field_equal (view, PK_PACKAGE_ID_ARCH, "i586") ||
+	    pk_package_id_view_field_equal (view, PK_PACKAGE_ID_ARCH, "i686"))
 		return TRUE;
 	return FALSE;
 }
@@ -136,11 +271,12 @@ pk_arch_base_ix86 (const gchar *arch)
  * pk_package_id_equal_fuzzy_arch_section:
  **/
 static gboolean
-pk_package_id_equal_fuzzy_arch_section (const gchar *arch1, const gchar *arch2)
+pk_package_id_equal_fuzzy_arch_section (const PkPackageIdView *view1,
+					const PkPackageIdView *view2)
 {
-	if (g_strcmp0 (arch1, arch2) == 0)
+	if (pk_package_id_view_compare_field (view1, view2, PK_PACKAGE_ID_ARCH) == 0)
 		return TRUE;
-	if (pk_arch_base_ix86 (arch1) && pk_arch_base_ix86 (arch2))
+	if (pk_arch_base_ix86 (view1) && pk_arch_base_ix86 (view2))
 		return TRUE;
 	return FALSE;
 }
@@ -160,14 +296,16 @@ pk_package_id_equal_fuzzy_arch_section (const gchar *arch1, const gchar *arch2)
 gboolean
 pk_package_id_equal_fuzzy_arch (const gchar *package_id1, const gchar *package_id2)
 {
-	_cleanup_strv_free_ gchar **sections1 = NULL;
-	_cleanup_strv_free_ gchar **sections2 = NULL;
-
-	sections1 = pk_package_id_split (package_id1);
-	sections2 = pk_package_id_split (package_id2);
-	if (g_strcmp0 (sections1[0], sections2[0]) == 0 &&
-	    g_strcmp0 (sections1[1], sections2[1]) == 0 &&
-	    pk_package_id_equal_fuzzy_arch_section (sections1[2], sections2[2]))
+	PkPackageIdView view1;
+	PkPackageIdView view2;
+
+	if (!pk_package_id_view_init (&view1, package_id1))
+		return FALSE;
+	if (!pk_package_id_view_init (&view2, package_id2))
+		return FALSE;
+	if (pk_package_id_view_compare_field (&view1, &view2, PK_PACKAGE_ID_NAME) == 0 &&
+	    pk_package_id_view_compare_field (&view1, &view2, PK_PACKAGE_ID_VERSION) == 0 &&
+	    pk_package_id_equal_fuzzy_arch_section (&view1, &view2))
 		return TRUE;
 	return FALSE;
 }
@@ -185,31 +323,31 @@ pk_package_id_equal_fuzzy_arch (const gchar *package_id1, const gchar *package_i
 gchar *
 pk_package_id_to_printable (const gchar *package_id)
 {
-	_cleanup_strv_free_  gchar **parts = NULL;
-	gchar *value = NULL;
-	GString *string = NULL;
+	PkPackageIdView view;
+	GString *string;
+	const gchar *tmp;
+	guint len;
 
 	/* invalid */
-	if (package_id == NULL)
-		goto out;
-
-	/* split */
-	parts = pk_package_id_split (package_id);
-	if (parts == NULL)
-		goto out;
+	if (!pk_package_id_view_init (&view, package_id))
+		return NULL;
 
 	/* name */
-	string = g_string_new (parts[PK_PACKAGE_ID_NAME]);
+	tmp = pk_package_id_view_get_field (&view, PK_PACKAGE_ID_NAME, &len);
+	string = g_string_new_len (tmp, len);
 
 	/* version if present */
-	if (parts[PK_PACKAGE_ID_VERSION][0] != '\0')
-		g_string_append_printf (string, "-%s", parts[PK_PACKAGE_ID_VERSION]);
+	tmp = pk_package_id_view_get_field (&view, PK_PACKAGE_ID_VERSION, &len);
+	if (len > 0) {
+		g_string_append_c (string, '-');
+		g_string_append_len (string, tmp, len);
+	}
 
 	/* arch if present */
-	if (parts[PK_PACKAGE_ID_ARCH][0] != '\0')
-		g_string_append_printf (string, ".%s", parts[PK_PACKAGE_ID_ARCH]);
-out:
-	if (string != NULL)
-		value = g_string_free (string, FALSE);
-	return value;
+	tmp = pk_package_id_view_get_field (&view, PK_PACKAGE_ID_ARCH, &len);
+	if (len > 0) {
+		g_string_append_c (string, '.');
+		g_string_append_len (string, tmp, len);
+	}
+	return g_string_free (string, FALSE);
 }
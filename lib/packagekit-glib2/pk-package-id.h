@@ -58,6 +58,19 @@ G_BEGIN_DECLS
  */
 #define PK_PACKAGE_ID_DATA	3
 
+/**
+ * PkPackageIdView:
+ *
+ * The sections of a PackageID found by pk_package_id_view_init(), without
+ * any copies. The members are private.
+ */
+typedef struct {
+	/*< private >*/
+	const gchar	*package_id;
+	guint		 offset[4];
+	guint		 length[4];
+} PkPackageIdView;
+
 void		 pk_package_id_test			(gpointer		 user_data);
 gchar		*pk_package_id_build			(const gchar		*name,
 							 const gchar		*version,
@@ -68,6 +81,19 @@ gchar		**pk_package_id_split			(const gchar		*package_id);
 gchar		*pk_package_id_to_printable		(const gchar		*package_id);
 gboolean	 pk_package_id_equal_fuzzy_arch		(const gchar		*package_id1,
 							 const gchar		*package_id2);
+gboolean	 pk_package_id_view_init		(PkPackageIdView	*view,
+							 const gchar		*package_id);
+const gchar	*pk_package_id_view_get_field		(const PkPackageIdView	*view,
+							 guint			 field,
+							 guint			*length);
+gboolean	 pk_package_id_view_field_equal		(const PkPackageIdView	*view,
+							 guint			 field,
+							 const gchar		*value);
+gint		 pk_package_id_view_compare_field	(const PkPackageIdView	*view1,
+							 const PkPackageIdView	*view2,
+							 guint			 field);
+gchar		*pk_package_id_view_dup_field		(const PkPackageIdView	*view,
+							 guint			 field);
 G_END_DECLS
 
 #endif /* __PK_PACKAGE_ID_H */
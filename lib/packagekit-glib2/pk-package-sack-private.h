@@ -0,0 +1,54 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: t; c-basic-offset: 8 -*-
+ *
+ * Copyright (C) 2014 Richard Hughes <richard@hughsie.com>
+ *
+ * Licensed under the GNU Lesser General Public License Version 2.1
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#if !defined (__PACKAGEKIT_H_INSIDE__) && !defined (PK_COMPILATION)
+#error "Only <packagekit.h> can be included directly."
+#endif
+
+#ifndef __PK_PACKAGE_SACK_PRIVATE_H
+#define __PK_PACKAGE_SACK_PRIVATE_H
+
+#include <gio/gio.h>
+
+#include "pk-client.h"
+#include "pk-enum.h"
+#include "pk-package-sack.h"
+#include "pk-progress.h"
+
+G_BEGIN_DECLS
+
+/* sends one chunk of a merge, and must complete with a GSimpleAsyncResult
+ * that pk_client_generic_finish() can use */
+typedef void	(*PkPackageSackChunkFunc)		(PkClient	*client,
+							 PkRoleEnum	 role,
+							 gchar		**package_ids,
+							 GCancellable	*cancellable,
+							 PkProgressCallback progress_callback,
+							 gpointer	 progress_user_data,
+							 GAsyncReadyCallback callback_ready,
+							 gpointer	 user_data);
+
+void		 pk_package_sack_set_chunk_func		(PkPackageSack	*sack,
+							 PkPackageSackChunkFunc func);
+
+G_END_DECLS
+
+#endif /* __PK_PACKAGE_SACK_PRIVATE_H */
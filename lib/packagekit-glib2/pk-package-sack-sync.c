@@ -29,12 +29,12 @@
 #include <packagekit-glib2/pk-package-sack.h>
 
 #include "pk-package-sack-sync.h"
+#include "pk-sync-loop-private.h"
 
 /* tiny helper to help us do the async operation */
 typedef struct {
 	GError		**error;
-	GMainContext	*context;
-	GMainLoop	*loop;
+	PkSyncLoop	*loop;
 	gboolean	 ret;
 } PkPackageSackHelper;
 
@@ -46,7 +46,7 @@ pk_package_sack_generic_cb (PkPackageSack *package_sack, GAsyncResult *res, PkPa
 {
 	/* get the result */
 	helper->ret = pk_package_sack_merge_generic_finish (package_sack, res, helper->error);
-	g_main_loop_quit (helper->loop);
+	pk_sync_loop_quit (helper->loop);
 }
 
 /**
@@ -74,23 +74,17 @@ pk_package_sack_resolve (PkPackageSack *package_sack, GCancellable *cancellable,
 
 	/* create temp object */
 	memset (&helper, 0, sizeof (PkPackageSackHelper));
-	helper.context = g_main_context_new ();
-	helper.loop = g_main_loop_new (helper.context, FALSE);
+	helper.loop = pk_sync_loop_acquire ();
 	helper.error = error;
 
-	g_main_context_push_thread_default (helper.context);
-
 	/* run async method */
 	pk_package_sack_resolve_async (package_sack, cancellable, NULL, NULL, (GAsyncReadyCallback) pk_package_sack_generic_cb, &helper);
-	g_main_loop_run (helper.loop);
+	pk_sync_loop_run (helper.loop);
 
 	ret = helper.ret;
 
-	g_main_context_pop_thread_default (helper.context);
-
-	/* free temp object */
-	g_main_loop_unref (helper.loop);
-	g_main_context_unref (helper.context);
+	/* give back temp loop */
+	pk_sync_loop_release (helper.loop);
 
 	return ret;
 }
@@ -120,23 +114,17 @@ pk_package_sack_get_details (PkPackageSack *package_sack, GCancellable *cancella
 
 	/* create temp object */
 	memset (&helper, 0, sizeof (PkPackageSackHelper));
-	helper.context = g_main_context_new ();
-	helper.loop = g_main_loop_new (helper.context, FALSE);
+	helper.loop = pk_sync_loop_acquire ();
 	helper.error = error;
 
-	g_main_context_push_thread_default (helper.context);
-
 	/* run async method */
 	pk_package_sack_get_details_async (package_sack, cancellable, NULL, NULL, (GAsyncReadyCallback) pk_package_sack_generic_cb, &helper);
-	g_main_loop_run (helper.loop);
+	pk_sync_loop_run (helper.loop);
 
 	ret = helper.ret;
 
-	g_main_context_pop_thread_default (helper.context);
-
-	/* free temp object */
-	g_main_loop_unref (helper.loop);
-	g_main_context_unref (helper.context);
+	/* give back temp loop */
+	pk_sync_loop_release (helper.loop);
 
 	return ret;
 }
@@ -166,23 +154,17 @@ pk_package_sack_get_update_detail (PkPackageSack *package_sack, GCancellable *ca
 
 	/* create temp object */
 	memset (&helper, 0, sizeof (PkPackageSackHelper));
-	helper.context = g_main_context_new ();
-	helper.loop = g_main_loop_new (helper.context, FALSE);
+	helper.loop = pk_sync_loop_acquire ();
 	helper.error = error;
 
-	g_main_context_push_thread_default (helper.context);
-
 	/* run async method */
 	pk_package_sack_get_update_detail_async (package_sack, cancellable, NULL, NULL, (GAsyncReadyCallback) pk_package_sack_generic_cb, &helper);
-	g_main_loop_run (helper.loop);
+	pk_sync_loop_run (helper.loop);
 
 	ret = helper.ret;
 
-	g_main_context_pop_thread_default (helper.context);
-
-	/* free temp object */
-	g_main_loop_unref (helper.loop);
-	g_main_context_unref (helper.context);
+	/* give back temp loop */
+	pk_sync_loop_release (helper.loop);
 
 	return ret;
 }
@@ -30,6 +30,7 @@
 
 #include "config.h"
 
+#include <string.h>
 #include <glib-object.h>
 #include <gio/gio.h>
 
@@ -42,10 +43,18 @@
 #include <packagekit-glib2/pk-results.h>
 #include <packagekit-glib2/pk-package-id.h>
 
+#include "pk-package-private.h"
+#include "pk-package-sack-private.h"
+
 static void     pk_package_sack_finalize	(GObject     *object);
 
 #define PK_PACKAGE_SACK_GET_PRIVATE(o) (G_TYPE_INSTANCE_GET_PRIVATE ((o), PK_TYPE_PACKAGE_SACK, PkPackageSackPrivate))
 
+/* how many package-ids are merged in one transaction, and how many of
+ * those transactions can be running at the same time */
+#define PK_PACKAGE_SACK_CHUNK_SIZE_DEFAULT		500
+#define PK_PACKAGE_SACK_MAX_CHUNKS_IN_FLIGHT_DEFAULT	2
+
 /**
  * PkPackageSackPrivate:
  *
@@ -53,11 +62,34 @@ static void     pk_package_sack_finalize	(GObject     *object);
  **/
 struct _PkPackageSackPrivate
 {
-	GHashTable		*table;
+	GHashTable		*table;		/* package-id:PkPackage */
 	GPtrArray		*array;
 	PkClient		*client;
+	GHashTable		*index_name;	/* name:GPtrArray of PkPackage */
+	GHashTable		*index_name_arch; /* PkPackageSackKey:GPtrArray of PkPackage */
+	GHashTable		*index_position; /* PkPackage:array index + 1 */
+	guint			 index_position_dups;
+	GPtrArray		*index_info[PK_INFO_ENUM_LAST];
+	gboolean		 index_info_valid;
+	guint			 index_info_generation;
+	guint			 chunk_size;
+	guint			 max_chunks_in_flight;
+	PkPackageSackChunkFunc	 chunk_func;
 };
 
+/**
+ * PkPackageSackKey:
+ *
+ * The key of the name and architecture index, which can also point into
+ * a PackageID so that lookups do not have to copy the sections
+ **/
+typedef struct {
+	gchar			*name;
+	guint			 name_len;
+	gchar			*arch;
+	guint			 arch_len;
+} PkPackageSackKey;
+
 enum {
 	SIGNAL_CHANGED,
 	SIGNAL_LAST
@@ -65,6 +97,292 @@ enum {
 
 G_DEFINE_TYPE (PkPackageSack, pk_package_sack, G_TYPE_OBJECT)
 
+/**
+ * pk_package_sack_key_hash:
+ **/
+static guint
+pk_package_sack_key_hash (gconstpointer data)
+{
+	const PkPackageSackKey *key = data;
+	guint hash = 5381;
+	guint i;
+
+	/* same as g_str_hash(), but bounded by the lengths */
+	for (i = 0; i < key->name_len; i++)
+		hash = (hash << 5) + hash + (guchar) key->name[i];
+	hash = (hash << 5) + hash + ';';
+	for (i = 0; i < key->arch_len; i++)
+		hash = (hash << 5) + hash + (guchar) key->arch[i];
+	return hash;
+}
+
+/**
+ * pk_package_sack_key_equal:
+ **/
+static gboolean
+pk_package_sack_key_equal (gconstpointer a, gconstpointer b)
+{
+	const PkPackageSackKey *key1 = a;
+	const PkPackageSackKey *key2 = b;
+	return key1->name_len == key2->name_len &&
+	       key1->arch_len == key2->arch_len &&
+	       memcmp (key1->name, key2->name, key1->name_len) == 0 &&
+	       memcmp (key1->arch, key2->arch, key1->arch_len) == 0;
+}
+
+/**
+ * pk_package_sack_key_init:
+ **/
+static void
+pk_package_sack_key_init (PkPackageSackKey *key, const gchar *name, const gchar *arch)
+{
+	key->name = (gchar *) name;
+	key->name_len = name != NULL ? strlen (name) : 0;
+	key->arch = (gchar *) arch;
+	key->arch_len = arch != NULL ? strlen (arch) : 0;
+}
+
+/**
+ * pk_package_sack_key_free:
+ **/
+static void
+pk_package_sack_key_free (PkPackageSackKey *key)
+{
+	g_free (key->name);
+	g_free (key->arch);
+	g_slice_free (PkPackageSackKey, key);
+}
+
+/**
+ * pk_package_sack_index_info_check:
+ *
+ * Drops the info index if any package held by a sack changed its info
+ * since the index was built.
+ **/
+static void
+pk_package_sack_index_info_check (PkPackageSack *sack)
+{
+	PkPackageSackPrivate *priv = sack->priv;
+	if (priv->index_info_valid &&
+	    priv->index_info_generation != pk_package_get_info_generation ())
+		priv->index_info_valid = FALSE;
+}
+
+/**
+ * pk_package_sack_index_info_add:
+ **/
+static void
+pk_package_sack_index_info_add (PkPackageSack *sack, PkPackage *package)
+{
+	PkInfoEnum info;
+	PkPackageSackPrivate *priv = sack->priv;
+
+	info = pk_package_get_info (package);
+	if (info >= PK_INFO_ENUM_LAST)
+		return;
+	if (priv->index_info[info] == NULL)
+		priv->index_info[info] = g_ptr_array_new ();
+	g_ptr_array_add (priv->index_info[info], package);
+}
+
+/**
+ * pk_package_sack_ensure_index_info:
+ *
+ * The info index is built on first use as the info of a package is
+ * often only known after a sack has been merged.
+ **/
+static void
+pk_package_sack_ensure_index_info (PkPackageSack *sack)
+{
+	guint i;
+	PkPackageSackPrivate *priv = sack->priv;
+
+	pk_package_sack_index_info_check (sack);
+	if (priv->index_info_valid)
+		return;
+	for (i = 0; i < PK_INFO_ENUM_LAST; i++) {
+		if (priv->index_info[i] != NULL)
+			g_ptr_array_set_size (priv->index_info[i], 0);
+	}
+	for (i = 0; i < priv->array->len; i++)
+		pk_package_sack_index_info_add (sack, g_ptr_array_index (priv->array, i));
+	priv->index_info_generation = pk_package_get_info_generation ();
+	priv->index_info_valid = TRUE;
+}
+
+/**
+ * pk_package_sack_index_position_add:
+ *
+ * Records where the package lives in the array. If the same object was
+ * added more than once only the first slot is kept, and the duplicates
+ * are found again when it gets removed.
+ **/
+static void
+pk_package_sack_index_position_add (PkPackageSack *sack, PkPackage *package, guint idx)
+{
+	PkPackageSackPrivate *priv = sack->priv;
+
+	if (g_hash_table_lookup (priv->index_position, package) != NULL) {
+		priv->index_position_dups++;
+		return;
+	}
+	g_hash_table_insert (priv->index_position, package, GUINT_TO_POINTER (idx + 1));
+}
+
+/**
+ * pk_package_sack_index_add:
+ **/
+static void
+pk_package_sack_index_add (PkPackageSack *sack, PkPackage *package)
+{
+	GPtrArray *bucket;
+	PkPackageSackKey key;
+	PkPackageSackKey *key_new;
+	PkPackageSackPrivate *priv = sack->priv;
+
+	/* the key is owned by the package, so replace it too */
+	pk_package_set_in_sack (package, TRUE);
+	if (pk_package_get_id (package) != NULL) {
+		g_hash_table_replace (priv->table,
+				      (gpointer) pk_package_get_id (package),
+				      (gpointer) package);
+	}
+
+	/* by name */
+	pk_package_sack_key_init (&key,
+				  pk_package_get_name (package),
+				  pk_package_get_arch (package));
+	if (key.name != NULL) {
+		bucket = g_hash_table_lookup (priv->index_name, key.name);
+		if (bucket == NULL) {
+			bucket = g_ptr_array_new ();
+			g_hash_table_insert (priv->index_name,
+					     g_strdup (key.name), bucket);
+		}
+		g_ptr_array_add (bucket, package);
+
+		/* by name and arch */
+		bucket = g_hash_table_lookup (priv->index_name_arch, &key);
+		if (bucket == NULL) {
+			key_new = g_slice_new (PkPackageSackKey);
+			key_new->name = g_strndup (key.name, key.name_len);
+			key_new->name_len = key.name_len;
+			key_new->arch = g_strndup (key.arch, key.arch_len);
+			key_new->arch_len = key.arch_len;
+			bucket = g_ptr_array_new ();
+			g_hash_table_insert (priv->index_name_arch, key_new, bucket);
+		}
+		g_ptr_array_add (bucket, package);
+	}
+
+	/* by info, if we've needed it already */
+	pk_package_sack_index_info_check (sack);
+	if (priv->index_info_valid)
+		pk_package_sack_index_info_add (sack, package);
+}
+
+/**
+ * pk_package_sack_index_remove:
+ *
+ * Must be called before the sack drops its reference on the package.
+ **/
+static void
+pk_package_sack_index_remove (PkPackageSack *sack, PkPackage *package)
+{
+	const gchar *package_id;
+	GPtrArray *bucket;
+	PkPackage *pkg_tmp;
+	PkPackageSackKey key;
+	guint i;
+	PkPackageSackPrivate *priv = sack->priv;
+
+	/* by name and arch */
+	pk_package_sack_key_init (&key,
+				  pk_package_get_name (package),
+				  pk_package_get_arch (package));
+	bucket = NULL;
+	if (key.name != NULL) {
+		bucket = g_hash_table_lookup (priv->index_name_arch, &key);
+		if (bucket != NULL) {
+			g_ptr_array_remove (bucket, package);
+			if (bucket->len == 0) {
+				g_hash_table_remove (priv->index_name_arch, &key);
+				bucket = NULL;
+			}
+		}
+	}
+
+	/* the id may also be used by a duplicate which needs to take over,
+	 * the last one added wins just like in pk_package_sack_add_package() */
+	package_id = pk_package_get_id (package);
+	if (package_id != NULL &&
+	    g_hash_table_lookup (priv->table, package_id) == package) {
+		g_hash_table_remove (priv->table, package_id);
+		for (i = bucket != NULL ? bucket->len : 0; i > 0; i--) {
+			pkg_tmp = g_ptr_array_index (bucket, i - 1);
+			if (g_strcmp0 (pk_package_get_id (pkg_tmp), package_id) == 0) {
+				g_hash_table_replace (priv->table,
+						      (gpointer) pk_package_get_id (pkg_tmp),
+						      pkg_tmp);
+				break;
+			}
+		}
+	}
+
+	/* by name */
+	if (key.name != NULL) {
+		bucket = g_hash_table_lookup (priv->index_name, key.name);
+		if (bucket != NULL) {
+			g_ptr_array_remove (bucket, package);
+			if (bucket->len == 0)
+				g_hash_table_remove (priv->index_name, key.name);
+		}
+	}
+
+	/* the info buckets can be as large as the sack itself, so rather
+	 * than searching them on each removal just rebuild them when next
+	 * needed */
+	priv->index_info_valid = FALSE;
+	pk_package_set_in_sack (package, FALSE);
+}
+
+/**
+ * pk_package_sack_index_clear:
+ **/
+static void
+pk_package_sack_index_clear (PkPackageSack *sack)
+{
+	guint i;
+	PkPackageSackPrivate *priv = sack->priv;
+
+	for (i = 0; i < priv->array->len; i++)
+		pk_package_set_in_sack (g_ptr_array_index (priv->array, i), FALSE);
+	g_hash_table_remove_all (priv->table);
+	g_hash_table_remove_all (priv->index_name);
+	g_hash_table_remove_all (priv->index_name_arch);
+	g_hash_table_remove_all (priv->index_position);
+	priv->index_position_dups = 0;
+	priv->index_info_valid = FALSE;
+}
+
+/**
+ * pk_package_sack_index_rebuild:
+ *
+ * Rebuilds the indexes so the buckets follow the order of the array.
+ **/
+static void
+pk_package_sack_index_rebuild (PkPackageSack *sack)
+{
+	guint i;
+	PkPackageSackPrivate *priv = sack->priv;
+
+	pk_package_sack_index_clear (sack);
+	for (i = 0; i < priv->array->len; i++) {
+		pk_package_sack_index_add (sack, g_ptr_array_index (priv->array, i));
+		pk_package_sack_index_position_add (sack, g_ptr_array_index (priv->array, i), i);
+	}
+}
+
 /**
  * pk_package_sack_clear:
  * @sack: a valid #PkPackageSack instance
@@ -78,8 +396,8 @@ pk_package_sack_clear (PkPackageSack *sack)
 {
 	g_return_if_fail (PK_IS_PACKAGE_SACK (sack));
 
+	pk_package_sack_index_clear (sack);
 	g_ptr_array_set_size (sack->priv->array, 0);
-	g_hash_table_remove_all (sack->priv->table);
 }
 
 /**
@@ -162,8 +480,7 @@ PkPackageSack *
 pk_package_sack_filter_by_info (PkPackageSack *sack, PkInfoEnum info)
 {
 	PkPackageSack *results;
-	PkPackage *package;
-	PkInfoEnum info_tmp;
+	GPtrArray *bucket;
 	guint i;
 	PkPackageSackPrivate *priv = sack->priv;
 
@@ -173,13 +490,12 @@ pk_package_sack_filter_by_info (PkPackageSack *sack, PkInfoEnum info)
 	results = pk_package_sack_new ();
 
 	/* add each that matches the info enum */
-	for (i = 0; i < priv->array->len; i++) {
-		package = g_ptr_array_index (priv->array, i);
-		info_tmp = pk_package_get_info (package);
-		if (info_tmp == info)
-			pk_package_sack_add_package (results, package);
-	}
-
+	if (info >= PK_INFO_ENUM_LAST)
+		return results;
+	pk_package_sack_ensure_index_info (sack);
+	bucket = priv->index_info[info];
+	for (i = 0; bucket != NULL && i < bucket->len; i++)
+		pk_package_sack_add_package (results, g_ptr_array_index (bucket, i));
 	return results;
 }
 
@@ -239,10 +555,8 @@ pk_package_sack_add_package (PkPackageSack *sack, PkPackage *package)
 	/* add to array */
 	g_ptr_array_add (sack->priv->array,
 			 g_object_ref (package));
-	g_hash_table_insert (sack->priv->table,
-			     (gpointer) pk_package_get_id (package),
-			     (gpointer) package);
-
+	pk_package_sack_index_add (sack, package);
+	pk_package_sack_index_position_add (sack, package, sack->priv->array->len - 1);
 	return TRUE;
 }
 
@@ -406,6 +720,9 @@ pk_package_sack_to_file (PkPackageSack *sack, GFile *file, GError **error)
  *
  * Removes a package reference from the sack. The pointers have to match exactly.
  *
+ * The last package in the sack is moved into the slot of the removed one,
+ * so use pk_package_sack_sort() afterwards if the order matters.
+ *
  * Return value: %TRUE if the package was removed from the sack
  *
  * Since: 0.5.2
@@ -413,12 +730,47 @@ pk_package_sack_to_file (PkPackageSack *sack, GFile *file, GError **error)
 gboolean
 pk_package_sack_remove_package (PkPackageSack *sack, PkPackage *package)
 {
+	PkPackage *pkg_tmp;
+	guint i;
+	guint idx;
+	PkPackageSackPrivate *priv;
+
 	g_return_val_if_fail (PK_IS_PACKAGE_SACK (sack), FALSE);
 	g_return_val_if_fail (PK_IS_PACKAGE (package), FALSE);
 
-	/* remove from array */
-	g_hash_table_remove (sack->priv->table, pk_package_get_id (package));
-	return g_ptr_array_remove (sack->priv->array, package);
+	/* find the slot without searching the array */
+	priv = sack->priv;
+	idx = GPOINTER_TO_UINT (g_hash_table_lookup (priv->index_position, package));
+	if (idx == 0)
+		return FALSE;
+	idx--;
+
+	/* the last package takes over the slot */
+	g_hash_table_remove (priv->index_position, package);
+	if (idx != priv->array->len - 1) {
+		pkg_tmp = g_ptr_array_index (priv->array, priv->array->len - 1);
+		if (pkg_tmp != package) {
+			g_hash_table_replace (priv->index_position, pkg_tmp,
+					      GUINT_TO_POINTER (idx + 1));
+		}
+	}
+
+	/* remove from array, the indexes first as the array owns the ref */
+	pk_package_sack_index_remove (sack, package);
+	g_ptr_array_remove_index_fast (priv->array, idx);
+
+	/* the same object was added more than once */
+	if (priv->index_position_dups > 0) {
+		for (i = 0; i < priv->array->len; i++) {
+			if (g_ptr_array_index (priv->array, i) != package)
+				continue;
+			g_hash_table_replace (priv->index_position, package,
+					      GUINT_TO_POINTER (i + 1));
+			priv->index_position_dups--;
+			break;
+		}
+	}
+	return TRUE;
 }
 
 /**
@@ -438,21 +790,14 @@ pk_package_sack_remove_package_by_id (PkPackageSack *sack,
 				      const gchar *package_id)
 {
 	PkPackage *package;
-	guint i;
-	GPtrArray *array;
 
 	g_return_val_if_fail (PK_IS_PACKAGE_SACK (sack), FALSE);
 	g_return_val_if_fail (package_id != NULL, FALSE);
 
-	array = sack->priv->array;
-	for (i = 0; i < array->len; i++) {
-		package = g_ptr_array_index (array, i);
-		if (g_strcmp0 (package_id, pk_package_get_id (package)) == 0) {
-			pk_package_sack_remove_package (sack, package);
-			return TRUE;
-		}
-	}
-	return FALSE;
+	package = g_hash_table_lookup (sack->priv->table, package_id);
+	if (package == NULL)
+		return FALSE;
+	return pk_package_sack_remove_package (sack, package);
 }
 
 /**
@@ -475,23 +820,32 @@ pk_package_sack_remove_by_filter (PkPackageSack *sack,
 {
 	gboolean ret = FALSE;
 	PkPackage *package;
-	gint i;
+	guint i;
+	guint j = 0;
 	PkPackageSackPrivate *priv = sack->priv;
 
 	g_return_val_if_fail (PK_IS_PACKAGE_SACK (sack), FALSE);
 	g_return_val_if_fail (filter_cb != NULL, FALSE);
 
-	/* add each that matches the info enum */
-	for (i = 0; i < (gint) priv->array->len; i++) {
+	/* compact the array in place rather than removing each in turn */
+	g_hash_table_remove_all (priv->index_position);
+	priv->index_position_dups = 0;
+	for (i = 0; i < priv->array->len; i++) {
 		package = g_ptr_array_index (priv->array, i);
-		if (!filter_cb (package, user_data)) {
-			ret = TRUE;
-			pk_package_sack_remove_package (sack, package);
-
-			/* ensure we pick up subsequent matches */
-			i--;
+		if (filter_cb (package, user_data)) {
+			pk_package_sack_index_position_add (sack, package, j);
+			g_ptr_array_index (priv->array, j++) = package;
+			continue;
 		}
+		ret = TRUE;
+		pk_package_sack_index_remove (sack, package);
+		g_object_unref (package);
 	}
+
+	/* the refs past the end have been moved or dropped already */
+	g_ptr_array_set_free_func (priv->array, NULL);
+	g_ptr_array_set_size (priv->array, j);
+	g_ptr_array_set_free_func (priv->array, g_object_unref);
 	return ret;
 }
 
@@ -537,27 +891,119 @@ pk_package_sack_find_by_id (PkPackageSack *sack, const gchar *package_id)
 PkPackage *
 pk_package_sack_find_by_id_name_arch (PkPackageSack *sack, const gchar *package_id)
 {
-	PkPackage *pkg_tmp;
-	guint i;
-	_cleanup_strv_free_ gchar **split = NULL;
+	GPtrArray *bucket;
+	PkPackageIdView view;
+	PkPackageSackKey key;
 
 	g_return_val_if_fail (PK_IS_PACKAGE_SACK (sack), NULL);
 	g_return_val_if_fail (package_id != NULL, NULL);
 
 	/* does the package name feature in the array */
-	split = pk_package_id_split (package_id);
-	if (split == NULL)
+	if (!pk_package_id_view_init (&view, package_id))
 		return NULL;
-	for (i = 0; i < sack->priv->array->len; i++) {
-		pkg_tmp = g_ptr_array_index (sack->priv->array, i);
-		if (g_strcmp0 (pk_package_get_name (pkg_tmp),
-			       split[PK_PACKAGE_ID_NAME]) == 0 &&
-		    g_strcmp0 (pk_package_get_arch (pkg_tmp),
-			       split[PK_PACKAGE_ID_ARCH]) == 0) {
-			return g_object_ref (pkg_tmp);
-		}
-	}
-	return NULL;
+	key.name = (gchar *) pk_package_id_view_get_field (&view, PK_PACKAGE_ID_NAME, &key.name_len);
+	key.arch = (gchar *) pk_package_id_view_get_field (&view, PK_PACKAGE_ID_ARCH, &key.arch_len);
+	bucket = g_hash_table_lookup (sack->priv->index_name_arch, &key);
+	if (bucket == NULL)
+		return NULL;
+	return g_object_ref (g_ptr_array_index (bucket, 0));
+}
+
+/**
+ * pk_package_sack_find_by_name:
+ * @sack: a valid #PkPackageSack instance
+ * @name: a package name, e.g. "kernel"
+ *
+ * Finds all the packages in a sack with the given name, for instance
+ * every installed version and architecture of a package.
+ *
+ * Return value: (element-type PkPackage) (transfer container): the matching
+ * packages in the order of the sack, free with g_ptr_array_unref()
+ *
+ * Since: 1.0.1
+ */
+GPtrArray *
+pk_package_sack_find_by_name (PkPackageSack *sack, const gchar *name)
+{
+	GPtrArray *bucket;
+	GPtrArray *array;
+	guint i;
+
+	g_return_val_if_fail (PK_IS_PACKAGE_SACK (sack), NULL);
+	g_return_val_if_fail (name != NULL, NULL);
+
+	array = g_ptr_array_new_with_free_func (g_object_unref);
+	bucket = g_hash_table_lookup (sack->priv->index_name, name);
+	for (i = 0; bucket != NULL && i < bucket->len; i++)
+		g_ptr_array_add (array, g_object_ref (g_ptr_array_index (bucket, i)));
+	return array;
+}
+
+/**
+ * pk_package_sack_find_by_name_arch:
+ * @sack: a valid #PkPackageSack instance
+ * @name: a package name, e.g. "kernel"
+ * @arch: a package architecture, e.g. "x86_64"
+ *
+ * Finds all the packages in a sack with the given name and architecture.
+ *
+ * Return value: (element-type PkPackage) (transfer container): the matching
+ * packages in the order of the sack, free with g_ptr_array_unref()
+ *
+ * Since: 1.0.1
+ */
+GPtrArray *
+pk_package_sack_find_by_name_arch (PkPackageSack *sack,
+				   const gchar *name,
+				   const gchar *arch)
+{
+	GPtrArray *bucket;
+	GPtrArray *array;
+	PkPackageSackKey key;
+	guint i;
+
+	g_return_val_if_fail (PK_IS_PACKAGE_SACK (sack), NULL);
+	g_return_val_if_fail (name != NULL, NULL);
+	g_return_val_if_fail (arch != NULL, NULL);
+
+	array = g_ptr_array_new_with_free_func (g_object_unref);
+	pk_package_sack_key_init (&key, name, arch);
+	bucket = g_hash_table_lookup (sack->priv->index_name_arch, &key);
+	for (i = 0; bucket != NULL && i < bucket->len; i++)
+		g_ptr_array_add (array, g_object_ref (g_ptr_array_index (bucket, i)));
+	return array;
+}
+
+/**
+ * pk_package_sack_find_by_info:
+ * @sack: a valid #PkPackageSack instance
+ * @info: a %PkInfoEnum value to match
+ *
+ * Finds all the packages in a sack with the given info, without
+ * creating a new sack like pk_package_sack_filter_by_info() does.
+ *
+ * Return value: (element-type PkPackage) (transfer container): the matching
+ * packages, free with g_ptr_array_unref()
+ *
+ * Since: 1.0.1
+ */
+GPtrArray *
+pk_package_sack_find_by_info (PkPackageSack *sack, PkInfoEnum info)
+{
+	GPtrArray *bucket;
+	GPtrArray *array;
+	guint i;
+
+	g_return_val_if_fail (PK_IS_PACKAGE_SACK (sack), NULL);
+
+	array = g_ptr_array_new_with_free_func (g_object_unref);
+	if (info >= PK_INFO_ENUM_LAST)
+		return array;
+	pk_package_sack_ensure_index_info (sack);
+	bucket = sack->priv->index_info[info];
+	for (i = 0; bucket != NULL && i < bucket->len; i++)
+		g_ptr_array_add (array, g_object_ref (g_ptr_array_index (bucket, i)));
+	return array;
 }
 
 /**
@@ -566,16 +1012,8 @@ pk_package_sack_find_by_id_name_arch (PkPackageSack *sack, const gchar *package_
 static gint
 pk_package_sack_sort_compare_name_func (PkPackage **a, PkPackage **b)
 {
-	const gchar *package_id1;
-	const gchar *package_id2;
-	_cleanup_strv_free_ gchar **split1 = NULL;
-	_cleanup_strv_free_ gchar **split2 = NULL;
-
-	package_id1 = pk_package_get_id (*a);
-	package_id2 = pk_package_get_id (*b);
-	split1 = pk_package_id_split (package_id1);
-	split2 = pk_package_id_split (package_id2);
-	return g_strcmp0 (split1[PK_PACKAGE_ID_NAME], split2[PK_PACKAGE_ID_NAME]);
+	/* the package already keeps the split sections */
+	return g_strcmp0 (pk_package_get_name (*a), pk_package_get_name (*b));
 }
 
 /**
@@ -642,6 +1080,9 @@ pk_package_sack_sort (PkPackageSack *sack, PkPackageSackSortType type)
 		g_ptr_array_sort (sack->priv->array, (GCompareFunc) pk_package_sack_sort_compare_summary_func);
 	else if (type == PK_PACKAGE_SACK_SORT_TYPE_INFO)
 		g_ptr_array_sort (sack->priv->array, (GCompareFunc) pk_package_sack_sort_compare_info_func);
+
+	/* lookups return the first match in the sack order */
+	pk_package_sack_index_rebuild (sack);
 }
 
 /**
@@ -677,6 +1118,46 @@ pk_package_sack_get_total_bytes (PkPackageSack *sack)
 	return bytes;
 }
 
+/**
+ * pk_package_sack_set_chunk_size:
+ * @sack: a valid #PkPackageSack instance
+ * @chunk_size: the number of packages per transaction, or 0 for no limit
+ * @max_chunks_in_flight: the number of transactions to run at once
+ *
+ * Sets how pk_package_sack_resolve_async(), pk_package_sack_get_details_async()
+ * and pk_package_sack_get_update_detail_async() split up a large sack.
+ * The results of each transaction are merged as soon as it completes, and
+ * the percentage reported to the progress callback counts the completed
+ * transactions.
+ *
+ * Since: 1.0.1
+ **/
+void
+pk_package_sack_set_chunk_size (PkPackageSack *sack,
+				guint chunk_size,
+				guint max_chunks_in_flight)
+{
+	g_return_if_fail (PK_IS_PACKAGE_SACK (sack));
+	g_return_if_fail (max_chunks_in_flight > 0);
+	sack->priv->chunk_size = chunk_size;
+	sack->priv->max_chunks_in_flight = max_chunks_in_flight;
+}
+
+/**
+ * pk_package_sack_set_chunk_func:
+ * @sack: a valid #PkPackageSack instance
+ * @func: the function that sends one chunk, or %NULL for the daemon
+ *
+ * Replaces the transactions a merge sends, so the self tests can merge
+ * without a daemon.
+ **/
+void
+pk_package_sack_set_chunk_func (PkPackageSack *sack, PkPackageSackChunkFunc func)
+{
+	g_return_if_fail (PK_IS_PACKAGE_SACK (sack));
+	sack->priv->chunk_func = func;
+}
+
 /**
  * pk_package_sack_get_package_ids:
  **/
@@ -703,11 +1184,26 @@ pk_package_sack_get_package_ids (PkPackageSack *sack)
 
 typedef struct {
 	PkPackageSack		*sack;
-	GCancellable		*cancellable;
+	GCancellable		*cancellable;	/* cancels every chunk in flight */
+	GCancellable		*cancellable_caller;
+	gulong			 cancellable_id;
 	gboolean		 ret;
 	GSimpleAsyncResult	*res;
+	PkRoleEnum		 role;
+	gchar			**package_ids;
+	guint			 next;		/* first package-id not yet sent */
+	guint			 in_flight;
+	guint			 chunks_done;
+	guint			 chunks_total;
+	guint			 items;		/* results merged so far */
+	GError			*error;		/* the first chunk that failed */
+	PkProgress		*progress;	/* for the whole merge */
+	PkProgressCallback	 progress_callback;
+	gpointer		 progress_user_data;
 } PkPackageSackState;
 
+static void pk_package_sack_merge_chunk_next (PkPackageSackState *state);
+
 /***************************************************************************************************/
 
 /**
@@ -727,50 +1223,41 @@ pk_package_sack_merge_bool_state_finish (PkPackageSackState *state, const GError
 	g_simple_async_result_complete_in_idle (state->res);
 
 	/* deallocate */
-	if (state->cancellable != NULL)
-		g_object_unref (state->cancellable);
+	if (state->cancellable_caller != NULL) {
+		g_cancellable_disconnect (state->cancellable_caller,
+					  state->cancellable_id);
+		g_object_unref (state->cancellable_caller);
+	}
+	g_object_unref (state->cancellable);
+	if (state->error != NULL)
+		g_error_free (state->error);
+	g_strfreev (state->package_ids);
+	g_object_unref (state->progress);
 	g_object_unref (state->res);
 	g_object_unref (state->sack);
 	g_slice_free (PkPackageSackState, state);
 }
 
 /**
- * pk_package_sack_resolve_cb:
+ * pk_package_sack_merge_resolve:
+ *
+ * Return value: the number of packages in the results
  **/
-static void
-pk_package_sack_resolve_cb (GObject *source_object, GAsyncResult *res, PkPackageSackState *state)
+static guint
+pk_package_sack_merge_resolve (PkPackageSack *sack, PkResults *results)
 {
-	PkClient *client = PK_CLIENT (source_object);
 	PkPackage *item;
 	guint i;
 	PkPackage *package;
 	const gchar *package_id;
-	_cleanup_error_free_ GError *error = NULL;
-	_cleanup_object_unref_ PkResults *results = NULL;
 	_cleanup_ptrarray_unref_ GPtrArray *packages = NULL;
 
-	/* get the results */
-	results = pk_client_generic_finish (client, res, &error);
-	if (results == NULL) {
-		g_warning ("failed to resolve: %s", error->message);
-		pk_package_sack_merge_bool_state_finish (state, error);
-		return;
-	}
-
-	/* get the packages */
+	/* set data on each item */
 	packages = pk_results_get_package_array (results);
-	if (packages->len == 0) {
-		g_warning ("%i", state->ret);
-		error = g_error_new (1, 0, "no packages found!");
-		pk_package_sack_merge_bool_state_finish (state, error);
-		return;
-	}
-
-	/* set data on each item */
 	for (i = 0; i < packages->len; i++) {
 		item = g_ptr_array_index (packages, i);
 		package_id = pk_package_get_id (item);
-		package = pk_package_sack_find_by_id (state->sack, package_id);
+		package = pk_package_sack_find_by_id (sack, package_id);
 		if (package == NULL) {
 			g_warning ("failed to find %s", package_id);
 			continue;
@@ -783,119 +1270,24 @@ pk_package_sack_resolve_cb (GObject *source_object, GAsyncResult *res, PkPackage
 			      NULL);
 		g_object_unref (package);
 	}
-
-	/* all okay */
-	state->ret = TRUE;
-
-	/* we're done */
-	pk_package_sack_merge_bool_state_finish (state, error);
+	return packages->len;
 }
 
 /**
- * pk_package_sack_resolve_async:
- * @sack: a valid #PkPackageSack instance
- * @cancellable: a #GCancellable or %NULL
- * @progress_callback: (scope call): the function to run when the progress changes
- * @progress_user_data: data to pass to @progress_callback
- * @callback: the function to run on completion
- * @user_data: the data to pass to @callback
- *
- * Merges in details about packages using resolve.
+ * pk_package_sack_merge_details:
  *
- * Since: 0.5.2
+ * Return value: the number of details in the results
  **/
-void
-pk_package_sack_resolve_async (PkPackageSack *sack, GCancellable *cancellable,
-				     PkProgressCallback progress_callback, gpointer progress_user_data,
-				     GAsyncReadyCallback callback, gpointer user_data)
+static guint
+pk_package_sack_merge_details (PkPackageSack *sack, PkResults *results)
 {
-	PkPackageSackState *state;
-	_cleanup_object_unref_ GSimpleAsyncResult *res = NULL;
-	_cleanup_strv_free_ gchar **package_ids = NULL;
-
-	g_return_if_fail (PK_IS_PACKAGE_SACK (sack));
-	g_return_if_fail (callback != NULL);
-
-	res = g_simple_async_result_new (G_OBJECT (sack), callback, user_data, pk_package_sack_resolve_async);
-
-	/* save state */
-	state = g_slice_new0 (PkPackageSackState);
-	state->res = g_object_ref (res);
-	state->sack = g_object_ref (sack);
-	if (cancellable != NULL)
-		state->cancellable = g_object_ref (cancellable);
-	state->ret = FALSE;
-
-	/* start resolve async */
-	package_ids = pk_package_sack_get_package_ids (sack);
-	pk_client_resolve_async (sack->priv->client,
-				 pk_bitfield_value (PK_FILTER_ENUM_INSTALLED), package_ids,
-				 cancellable, progress_callback, progress_user_data,
-				 (GAsyncReadyCallback) pk_package_sack_resolve_cb, state);
-}
-
-/**
- * pk_package_sack_merge_generic_finish:
- * @sack: a valid #PkPackageSack instance
- * @res: the #GAsyncResult
- * @error: A #GError or %NULL
- *
- * Gets the result from the asynchronous function.
- *
- * Return value: %TRUE for success
- *
- * Since: 0.5.2
- **/
-gboolean
-pk_package_sack_merge_generic_finish (PkPackageSack *sack, GAsyncResult *res, GError **error)
-{
-	GSimpleAsyncResult *simple;
-
-	g_return_val_if_fail (PK_IS_PACKAGE_SACK (sack), FALSE);
-	g_return_val_if_fail (G_IS_SIMPLE_ASYNC_RESULT (res), FALSE);
-	g_return_val_if_fail (error == NULL || *error == NULL, FALSE);
-
-	simple = G_SIMPLE_ASYNC_RESULT (res);
-
-	if (g_simple_async_result_propagate_error (simple, error))
-		return FALSE;
-
-	return g_simple_async_result_get_op_res_gboolean (simple);
-}
-
-/***************************************************************************************************/
-
-/**
- * pk_package_sack_get_details_cb:
- **/
-static void
-pk_package_sack_get_details_cb (GObject *source_object, GAsyncResult *res, PkPackageSackState *state)
-{
-	PkClient *client = PK_CLIENT (source_object);
 	PkDetails *item;
 	guint i;
 	PkPackage *package;
-	_cleanup_error_free_ GError *error = NULL;
-	_cleanup_object_unref_ PkResults *results = NULL;
 	_cleanup_ptrarray_unref_ GPtrArray *details = NULL;
 
-	/* get the results */
-	results = pk_client_generic_finish (client, res, &error);
-	if (results == NULL) {
-		g_warning ("failed to details: %s", error->message);
-		pk_package_sack_merge_bool_state_finish (state, error);
-		return;
-	}
-
-	/* get the details */
-	details = pk_results_get_details_array (results);
-	if (details->len == 0) {
-		error = g_error_new (1, 0, "no details found!");
-		pk_package_sack_merge_bool_state_finish (state, error);
-		return;
-	}
-
 	/* set data on each item */
+	details = pk_results_get_details_array (results);
 	for (i = 0; i < details->len; i++) {
 		_cleanup_free_ gchar *package_id = NULL;
 		item = g_ptr_array_index (details, i);
@@ -904,7 +1296,7 @@ pk_package_sack_get_details_cb (GObject *source_object, GAsyncResult *res, PkPac
 			      NULL);
 
 		/* get package, and set data */
-		package = pk_package_sack_find_by_id (state->sack, package_id);
+		package = pk_package_sack_find_by_id (sack, package_id);
 		if (package == NULL) {
 			g_warning ("failed to find %s", package_id);
 			continue;
@@ -920,87 +1312,24 @@ pk_package_sack_get_details_cb (GObject *source_object, GAsyncResult *res, PkPac
 			      NULL);
 		g_object_unref (package);
 	}
-
-	/* all okay */
-	state->ret = TRUE;
-
-	/* we're done */
-	pk_package_sack_merge_bool_state_finish (state, error);
+	return details->len;
 }
 
 /**
- * pk_package_sack_get_details_async:
- * @sack: a valid #PkPackageSack instance
- * @cancellable: a #GCancellable or %NULL
- * @progress_callback: (scope call): the function to run when the progress changes
- * @progress_user_data: data to pass to @progress_callback
- * @callback: the function to run on completion
- * @user_data: the data to pass to @callback
+ * pk_package_sack_merge_update_detail:
  *
- * Merges in details about packages.
+ * Return value: the number of update details in the results
  **/
-void
-pk_package_sack_get_details_async (PkPackageSack *sack, GCancellable *cancellable,
-				   PkProgressCallback progress_callback, gpointer progress_user_data,
-				   GAsyncReadyCallback callback, gpointer user_data)
+static guint
+pk_package_sack_merge_update_detail (PkPackageSack *sack, PkResults *results)
 {
-	PkPackageSackState *state;
-	_cleanup_object_unref_ GSimpleAsyncResult *res = NULL;
-	_cleanup_strv_free_ gchar **package_ids = NULL;
-
-	g_return_if_fail (PK_IS_PACKAGE_SACK (sack));
-	g_return_if_fail (callback != NULL);
-
-	res = g_simple_async_result_new (G_OBJECT (sack), callback, user_data, pk_package_sack_get_details_async);
-
-	/* save state */
-	state = g_slice_new0 (PkPackageSackState);
-	state->res = g_object_ref (res);
-	state->sack = g_object_ref (sack);
-	if (cancellable != NULL)
-		state->cancellable = g_object_ref (cancellable);
-	state->ret = FALSE;
-
-	/* start details async */
-	package_ids = pk_package_sack_get_package_ids (sack);
-	pk_client_get_details_async (sack->priv->client, package_ids,
-				     cancellable, progress_callback, progress_user_data,
-				     (GAsyncReadyCallback) pk_package_sack_get_details_cb, state);
-}
-
-/***************************************************************************************************/
-
-/**
- * pk_package_sack_get_update_detail_cb:
- **/
-static void
-pk_package_sack_get_update_detail_cb (GObject *source_object, GAsyncResult *res, PkPackageSackState *state)
-{
-	PkClient *client = PK_CLIENT (source_object);
 	PkUpdateDetail *item;
 	guint i;
 	PkPackage *package;
-	_cleanup_error_free_ GError *error = NULL;
-	_cleanup_object_unref_ PkResults *results = NULL;
 	_cleanup_ptrarray_unref_ GPtrArray *update_details = NULL;
 
-	/* get the results */
-	results = pk_client_generic_finish (client, res, &error);
-	if (results == NULL) {
-		g_warning ("failed to update_detail: %s", error->message);
-		pk_package_sack_merge_bool_state_finish (state, error);
-		return;
-	}
-
-	/* get the update_details */
-	update_details = pk_results_get_update_detail_array (results);
-	if (update_details->len == 0) {
-		error = g_error_new (1, 0, "no update details found!");
-		pk_package_sack_merge_bool_state_finish (state, error);
-		return;
-	}
-
 	/* set data on each item */
+	update_details = pk_results_get_update_detail_array (results);
 	for (i = 0; i < update_details->len; i++) {
 		PkRestartEnum restart;
 		PkUpdateStateEnum state_enum;
@@ -1032,7 +1361,7 @@ pk_package_sack_get_update_detail_cb (GObject *source_object, GAsyncResult *res,
 			      NULL);
 
 		/* get package, and set data */
-		package = pk_package_sack_find_by_id (state->sack, package_id);
+		package = pk_package_sack_find_by_id (sack, package_id);
 		if (package == NULL) {
 			g_warning ("failed to find %s", package_id);
 			continue;
@@ -1054,14 +1383,328 @@ pk_package_sack_get_update_detail_cb (GObject *source_object, GAsyncResult *res,
 			      NULL);
 		g_object_unref (package);
 	}
+	return update_details->len;
+}
+
+/**
+ * pk_package_sack_merge_chunk_progress_cb:
+ *
+ * Each chunk is a transaction of its own, so only pass on the overall
+ * percentage rather than one that restarts from zero for every chunk.
+ **/
+static void
+pk_package_sack_merge_chunk_progress_cb (PkProgress *progress,
+					 PkProgressType type,
+					 gpointer user_data)
+{
+	PkPackageSackState *state = (PkPackageSackState *) user_data;
+	if (state->progress_callback == NULL)
+		return;
+	if (type == PK_PROGRESS_TYPE_PERCENTAGE)
+		return;
+	state->progress_callback (progress, type, state->progress_user_data);
+}
+
+/**
+ * pk_package_sack_merge_chunk_cb:
+ **/
+static void
+pk_package_sack_merge_chunk_cb (GObject *source_object, GAsyncResult *res, PkPackageSackState *state)
+{
+	PkClient *client = PK_CLIENT (source_object);
+	GError *error = NULL;
+	_cleanup_object_unref_ PkResults *results = NULL;
+
+	/* merge what we've got so far */
+	state->in_flight--;
+	state->chunks_done++;
+	results = pk_client_generic_finish (client, res, &error);
+	if (results == NULL && state->error != NULL) {
+		/* most likely cancelled by the chunk that failed first */
+		g_debug ("also failed to %s: %s",
+			 pk_role_enum_to_string (state->role),
+			 error->message);
+		g_error_free (error);
+	} else if (results == NULL) {
+		g_warning ("failed to %s: %s",
+			   pk_role_enum_to_string (state->role),
+			   error->message);
+		state->error = error;
+
+		/* the merge fails anyway, so don't wait for the others */
+		g_cancellable_cancel (state->cancellable);
+	} else if (state->role == PK_ROLE_ENUM_RESOLVE) {
+		state->items += pk_package_sack_merge_resolve (state->sack, results);
+	} else if (state->role == PK_ROLE_ENUM_GET_DETAILS) {
+		state->items += pk_package_sack_merge_details (state->sack, results);
+	} else if (state->role == PK_ROLE_ENUM_GET_UPDATE_DETAIL) {
+		state->items += pk_package_sack_merge_update_detail (state->sack, results);
+	}
+
+	/* report progress per chunk */
+	if (pk_progress_set_percentage (state->progress,
+					100 * state->chunks_done / state->chunks_total) &&
+	    state->progress_callback != NULL) {
+		state->progress_callback (state->progress,
+					  PK_PROGRESS_TYPE_PERCENTAGE,
+					  state->progress_user_data);
+	}
+	pk_package_sack_merge_chunk_next (state);
+}
+
+/**
+ * pk_package_sack_merge_chunk_client:
+ *
+ * The #PkPackageSackChunkFunc that asks the daemon.
+ **/
+static void
+pk_package_sack_merge_chunk_client (PkClient *client,
+				    PkRoleEnum role,
+				    gchar **package_ids,
+				    GCancellable *cancellable,
+				    PkProgressCallback progress_callback,
+				    gpointer progress_user_data,
+				    GAsyncReadyCallback callback_ready,
+				    gpointer user_data)
+{
+	switch (role) {
+	case PK_ROLE_ENUM_RESOLVE:
+		pk_client_resolve_async (client,
+					 pk_bitfield_value (PK_FILTER_ENUM_INSTALLED), package_ids,
+					 cancellable,
+					 progress_callback, progress_user_data,
+					 callback_ready, user_data);
+		break;
+	case PK_ROLE_ENUM_GET_DETAILS:
+		pk_client_get_details_async (client, package_ids,
+					     cancellable,
+					     progress_callback, progress_user_data,
+					     callback_ready, user_data);
+		break;
+	case PK_ROLE_ENUM_GET_UPDATE_DETAIL:
+		pk_client_get_update_detail_async (client, package_ids,
+						   cancellable,
+						   progress_callback, progress_user_data,
+						   callback_ready, user_data);
+		break;
+	default:
+		g_assert_not_reached ();
+	}
+}
+
+/**
+ * pk_package_sack_merge_chunk_send:
+ **/
+static void
+pk_package_sack_merge_chunk_send (PkPackageSackState *state)
+{
+	PkPackageSackPrivate *priv = state->sack->priv;
+	PkPackageSackChunkFunc func = pk_package_sack_merge_chunk_client;
+	guint len;
+	_cleanup_free_ gchar **chunk = NULL;
+
+	/* the ids are copied by the client, so just point at ours */
+	for (len = 0; state->package_ids[state->next + len] != NULL; len++) {
+		if (priv->chunk_size > 0 && len == priv->chunk_size)
+			break;
+	}
+	chunk = g_new0 (gchar *, len + 1);
+	memcpy (chunk, state->package_ids + state->next, len * sizeof (gchar *));
+	state->next += len;
+	state->in_flight++;
+
+	if (priv->chunk_func != NULL)
+		func = priv->chunk_func;
+	func (priv->client, state->role, chunk, state->cancellable,
+	      pk_package_sack_merge_chunk_progress_cb, state,
+	      (GAsyncReadyCallback) pk_package_sack_merge_chunk_cb, state);
+}
 
-	/* all okay */
+/**
+ * pk_package_sack_merge_chunk_next:
+ *
+ * Keeps up to max-chunks-in-flight transactions running, and finishes
+ * the merge when the last one has completed.
+ **/
+static void
+pk_package_sack_merge_chunk_next (PkPackageSackState *state)
+{
+	guint max_in_flight = state->sack->priv->max_chunks_in_flight;
+	_cleanup_error_free_ GError *error = NULL;
+
+	/* don't start anything new after a failure */
+	while (state->error == NULL &&
+	       state->in_flight < max_in_flight &&
+	       state->package_ids[state->next] != NULL)
+		pk_package_sack_merge_chunk_send (state);
+	if (state->in_flight > 0)
+		return;
+
+	/* all done */
+	if (state->error != NULL) {
+		pk_package_sack_merge_bool_state_finish (state, state->error);
+		return;
+	}
+	if (state->items == 0) {
+		if (state->role == PK_ROLE_ENUM_RESOLVE)
+			error = g_error_new (1, 0, "no packages found!");
+		else if (state->role == PK_ROLE_ENUM_GET_DETAILS)
+			error = g_error_new (1, 0, "no details found!");
+		else
+			error = g_error_new (1, 0, "no update details found!");
+		pk_package_sack_merge_bool_state_finish (state, error);
+		return;
+	}
 	state->ret = TRUE;
+	pk_package_sack_merge_bool_state_finish (state, NULL);
+}
+
+/**
+ * pk_package_sack_merge_cancelled_cb:
+ **/
+static void
+pk_package_sack_merge_cancelled_cb (GCancellable *cancellable, GCancellable *chunks)
+{
+	g_cancellable_cancel (chunks);
+}
+
+/**
+ * pk_package_sack_merge_chunked_async:
+ **/
+static void
+pk_package_sack_merge_chunked_async (PkPackageSack *sack,
+				     PkRoleEnum role,
+				     GCancellable *cancellable,
+				     PkProgressCallback progress_callback,
+				     gpointer progress_user_data,
+				     GSimpleAsyncResult *res)
+{
+	PkPackageSackState *state;
+	guint len;
+
+	/* save state */
+	state = g_slice_new0 (PkPackageSackState);
+	state->res = g_object_ref (res);
+	state->sack = g_object_ref (sack);
+	state->cancellable = g_cancellable_new ();
+	if (cancellable != NULL) {
+		state->cancellable_caller = g_object_ref (cancellable);
+		state->cancellable_id = g_cancellable_connect (cancellable,
+							       G_CALLBACK (pk_package_sack_merge_cancelled_cb),
+							       g_object_ref (state->cancellable),
+							       g_object_unref);
+	}
+	state->ret = FALSE;
+	state->role = role;
+	state->progress = pk_progress_new ();
+	pk_progress_set_role (state->progress, role);
+	state->progress_callback = progress_callback;
+	state->progress_user_data = progress_user_data;
+
+	/* split the sack into chunks, an empty one is still sent so the
+	 * daemon gets to report the failure */
+	state->package_ids = pk_package_sack_get_package_ids (sack);
+	len = g_strv_length (state->package_ids);
+	if (sack->priv->chunk_size == 0 || len == 0)
+		state->chunks_total = 1;
+	else
+		state->chunks_total = (len + sack->priv->chunk_size - 1) / sack->priv->chunk_size;
+	if (len == 0) {
+		pk_package_sack_merge_chunk_send (state);
+		return;
+	}
+	pk_package_sack_merge_chunk_next (state);
+}
+
+/**
+ * pk_package_sack_resolve_async:
+ * @sack: a valid #PkPackageSack instance
+ * @cancellable: a #GCancellable or %NULL
+ * @progress_callback: (scope call): the function to run when the progress changes
+ * @progress_user_data: data to pass to @progress_callback
+ * @callback: the function to run on completion
+ * @user_data: the data to pass to @callback
+ *
+ * Merges in details about packages using resolve. Large sacks are split
+ * into several transactions, see pk_package_sack_set_chunk_size().
+ *
+ * Since: 0.5.2
+ **/
+void
+pk_package_sack_resolve_async (PkPackageSack *sack, GCancellable *cancellable,
+				     PkProgressCallback progress_callback, gpointer progress_user_data,
+				     GAsyncReadyCallback callback, gpointer user_data)
+{
+	_cleanup_object_unref_ GSimpleAsyncResult *res = NULL;
 
-	/* we're done */
-	pk_package_sack_merge_bool_state_finish (state, error);
+	g_return_if_fail (PK_IS_PACKAGE_SACK (sack));
+	g_return_if_fail (callback != NULL);
+
+	res = g_simple_async_result_new (G_OBJECT (sack), callback, user_data, pk_package_sack_resolve_async);
+	pk_package_sack_merge_chunked_async (sack, PK_ROLE_ENUM_RESOLVE, cancellable,
+					     progress_callback, progress_user_data, res);
 }
 
+/**
+ * pk_package_sack_merge_generic_finish:
+ * @sack: a valid #PkPackageSack instance
+ * @res: the #GAsyncResult
+ * @error: A #GError or %NULL
+ *
+ * Gets the result from the asynchronous function.
+ *
+ * Return value: %TRUE for success
+ *
+ * Since: 0.5.2
+ **/
+gboolean
+pk_package_sack_merge_generic_finish (PkPackageSack *sack, GAsyncResult *res, GError **error)
+{
+	GSimpleAsyncResult *simple;
+
+	g_return_val_if_fail (PK_IS_PACKAGE_SACK (sack), FALSE);
+	g_return_val_if_fail (G_IS_SIMPLE_ASYNC_RESULT (res), FALSE);
+	g_return_val_if_fail (error == NULL || *error == NULL, FALSE);
+
+	simple = G_SIMPLE_ASYNC_RESULT (res);
+
+	if (g_simple_async_result_propagate_error (simple, error))
+		return FALSE;
+
+	return g_simple_async_result_get_op_res_gboolean (simple);
+}
+
+/***************************************************************************************************/
+
+/**
+ * pk_package_sack_get_details_async:
+ * @sack: a valid #PkPackageSack instance
+ * @cancellable: a #GCancellable or %NULL
+ * @progress_callback: (scope call): the function to run when the progress changes
+ * @progress_user_data: data to pass to @progress_callback
+ * @callback: the function to run on completion
+ * @user_data: the data to pass to @callback
+ *
+ * Merges in details about packages. Large sacks are split into several
+ * transactions, see pk_package_sack_set_chunk_size().
+ **/
+void
+pk_package_sack_get_details_async (PkPackageSack *sack, GCancellable *cancellable,
+				   PkProgressCallback progress_callback, gpointer progress_user_data,
+				   GAsyncReadyCallback callback, gpointer user_data)
+{
+	_cleanup_object_unref_ GSimpleAsyncResult *res = NULL;
+
+	g_return_if_fail (PK_IS_PACKAGE_SACK (sack));
+	g_return_if_fail (callback != NULL);
+
+	res = g_simple_async_result_new (G_OBJECT (sack), callback, user_data, pk_package_sack_get_details_async);
+	pk_package_sack_merge_chunked_async (sack, PK_ROLE_ENUM_GET_DETAILS, cancellable,
+					     progress_callback, progress_user_data, res);
+}
+
+/***************************************************************************************************/
+
 /**
  * pk_package_sack_get_update_detail_async:
  * @sack: a valid #PkPackageSack instance
@@ -1071,7 +1714,8 @@ pk_package_sack_get_update_detail_cb (GObject *source_object, GAsyncResult *res,
  * @callback: the function to run on completion
  * @user_data: the data to pass to @callback
  *
- * Merges in update details about packages.
+ * Merges in update details about packages. Large sacks are split into
+ * several transactions, see pk_package_sack_set_chunk_size().
  *
  * Since: 0.5.2
  **/
@@ -1080,28 +1724,14 @@ pk_package_sack_get_update_detail_async (PkPackageSack *sack, GCancellable *canc
 					 PkProgressCallback progress_callback, gpointer progress_user_data,
 					 GAsyncReadyCallback callback, gpointer user_data)
 {
-	PkPackageSackState *state;
 	_cleanup_object_unref_ GSimpleAsyncResult *res = NULL;
-	_cleanup_strv_free_ gchar **package_ids = NULL;
 
 	g_return_if_fail (PK_IS_PACKAGE_SACK (sack));
 	g_return_if_fail (callback != NULL);
 
 	res = g_simple_async_result_new (G_OBJECT (sack), callback, user_data, pk_package_sack_get_update_detail_async);
-
-	/* save state */
-	state = g_slice_new0 (PkPackageSackState);
-	state->res = g_object_ref (res);
-	state->sack = g_object_ref (sack);
-	if (cancellable != NULL)
-		state->cancellable = g_object_ref (cancellable);
-	state->ret = FALSE;
-
-	/* start update_detail async */
-	package_ids = pk_package_sack_get_package_ids (sack);
-	pk_client_get_update_detail_async (sack->priv->client, package_ids,
-					   cancellable, progress_callback, progress_user_data,
-					   (GAsyncReadyCallback) pk_package_sack_get_update_detail_cb, state);
+	pk_package_sack_merge_chunked_async (sack, PK_ROLE_ENUM_GET_UPDATE_DETAIL, cancellable,
+					     progress_callback, progress_user_data, res);
 }
 
 /***************************************************************************************************/
@@ -1146,6 +1776,15 @@ pk_package_sack_init (PkPackageSack *sack)
 	priv->table = g_hash_table_new (g_str_hash, g_str_equal);
 	priv->array = g_ptr_array_new_with_free_func (g_object_unref);
 	priv->client = pk_client_new ();
+	priv->chunk_size = PK_PACKAGE_SACK_CHUNK_SIZE_DEFAULT;
+	priv->max_chunks_in_flight = PK_PACKAGE_SACK_MAX_CHUNKS_IN_FLIGHT_DEFAULT;
+	priv->index_name = g_hash_table_new_full (g_str_hash, g_str_equal,
+						  g_free, (GDestroyNotify) g_ptr_array_unref);
+	priv->index_name_arch = g_hash_table_new_full (pk_package_sack_key_hash,
+						       pk_package_sack_key_equal,
+						       (GDestroyNotify) pk_package_sack_key_free,
+						       (GDestroyNotify) g_ptr_array_unref);
+	priv->index_position = g_hash_table_new (g_direct_hash, g_direct_equal);
 }
 
 /**
@@ -1156,7 +1795,16 @@ pk_package_sack_finalize (GObject *object)
 {
 	PkPackageSack *sack = PK_PACKAGE_SACK (object);
 	PkPackageSackPrivate *priv = sack->priv;
+	guint i;
 
+	pk_package_sack_index_clear (sack);
+	for (i = 0; i < PK_INFO_ENUM_LAST; i++) {
+		if (priv->index_info[i] != NULL)
+			g_ptr_array_unref (priv->index_info[i]);
+	}
+	g_hash_table_unref (priv->index_name);
+	g_hash_table_unref (priv->index_name_arch);
+	g_hash_table_unref (priv->index_position);
 	g_ptr_array_unref (priv->array);
 	g_hash_table_unref (priv->table);
 	g_object_unref (priv->client);
@@ -110,12 +110,22 @@ PkPackage	*pk_package_sack_find_by_id		(PkPackageSack		*sack,
 							 const gchar		*package_id);
 PkPackage	*pk_package_sack_find_by_id_name_arch	(PkPackageSack		*sack,
 							 const gchar		*package_id);
+GPtrArray	*pk_package_sack_find_by_name		(PkPackageSack		*sack,
+							 const gchar		*name);
+GPtrArray	*pk_package_sack_find_by_name_arch	(PkPackageSack		*sack,
+							 const gchar		*name,
+							 const gchar		*arch);
+GPtrArray	*pk_package_sack_find_by_info		(PkPackageSack		*sack,
+							 PkInfoEnum		 info);
 PkPackageSack	*pk_package_sack_filter_by_info		(PkPackageSack		*sack,
 							 PkInfoEnum		 info);
 PkPackageSack	*pk_package_sack_filter			(PkPackageSack		*sack,
 							 PkPackageSackFilterFunc filter_cb,
 							 gpointer		 user_data);
 guint64		 pk_package_sack_get_total_bytes	(PkPackageSack		*sack);
+void		 pk_package_sack_set_chunk_size		(PkPackageSack		*sack,
+							 guint			 chunk_size,
+							 guint			 max_chunks_in_flight);
 
 gboolean	 pk_package_sack_merge_generic_finish	(PkPackageSack		*sack,
 							 GAsyncResult		*res,
@@ -0,0 +1,217 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: t; c-basic-offset: 8 -*-
+ *
+ * Copyright (C) 2014 Richard Hughes <richard@hughsie.com>
+ *
+ * Licensed under the GNU Lesser General Public License Version 2.1
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+/*
+ * Results such as GetPackages can contain tens of thousands of packages
+ * that only ever have an info, a package-id and a summary. Rather than
+ * keeping a full #PkPackage for each, the store keeps one row per package
+ * and deduplicates the name, version, arch, repo data and summary strings
+ * through a string pool. #PkPackage objects are only created when asked
+ * for.
+ */
+
+#include "config.h"
+
+#include <string.h>
+#include <glib-object.h>
+
+#include "src/pk-cleanup.h"
+
+#include <packagekit-glib2/pk-package-id.h>
+
+#include "pk-package-private.h"
+#include "pk-package-store-private.h"
+#include "pk-source-private.h"
+
+typedef struct {
+	const gchar		*split[4];
+	const gchar		*summary;
+	const gchar		*transaction_id;
+	guint8			 info;
+	guint8			 role;
+} PkPackageStoreRow;
+
+struct _PkPackageStore
+{
+	GArray			*rows;
+	GStringChunk		*pool;
+	GHashTable		*objects;	/* row index:PkPackage */
+};
+
+/* one page of the string pool */
+#define PK_PACKAGE_STORE_POOL_SIZE	(16 * 1024)
+
+/**
+ * pk_package_store_intern:
+ **/
+static const gchar *
+pk_package_store_intern (PkPackageStore *store, const gchar *str)
+{
+	if (str == NULL)
+		return NULL;
+	return g_string_chunk_insert_const (store->pool, str);
+}
+
+/**
+ * pk_package_store_intern_len:
+ **/
+static const gchar *
+pk_package_store_intern_len (PkPackageStore *store, const gchar *str, gsize len)
+{
+	gchar buf[256];
+	_cleanup_free_ gchar *tmp = NULL;
+
+	/* the pool only deduplicates NUL-terminated strings */
+	if (len < sizeof (buf)) {
+		memcpy (buf, str, len);
+		buf[len] = '\0';
+		return g_string_chunk_insert_const (store->pool, buf);
+	}
+	tmp = g_strndup (str, len);
+	return g_string_chunk_insert_const (store->pool, tmp);
+}
+
+/**
+ * pk_package_store_add:
+ * @store: a #PkPackageStore
+ * @package: a #PkPackage
+ *
+ * Adds a package to the store. Packages that carry more than an info,
+ * package-id and summary are kept as they are.
+ **/
+void
+pk_package_store_add (PkPackageStore *store, PkPackage *package)
+{
+	PkPackageStoreRow row;
+	const gchar *end;
+	const gchar *start;
+	guint i;
+
+	memset (&row, 0, sizeof (row));
+	if (!pk_package_is_compact (package))
+		goto keep_object;
+
+	/* split the package-id into the pool */
+	start = pk_package_get_id (package);
+	for (i = 0; i < 3; i++) {
+		end = strchr (start, ';');
+		if (end == NULL)
+			goto keep_object;
+		row.split[i] = pk_package_store_intern_len (store, start, end - start);
+		start = end + 1;
+	}
+	row.split[PK_PACKAGE_ID_DATA] = pk_package_store_intern (store, start);
+	row.summary = pk_package_store_intern (store, pk_package_get_summary (package));
+	row.info = pk_package_get_info (package);
+
+	/* these are normally the same for every package in the results */
+	row.role = pk_source_get_role (PK_SOURCE (package));
+	row.transaction_id = pk_package_store_intern (store,
+						      pk_source_get_transaction_id (PK_SOURCE (package)));
+	g_array_append_val (store->rows, row);
+	return;
+keep_object:
+	memset (&row, 0, sizeof (row));
+	g_hash_table_insert (store->objects,
+			     GUINT_TO_POINTER (store->rows->len),
+			     g_object_ref (package));
+	g_array_append_val (store->rows, row);
+}
+
+/**
+ * pk_package_store_get_size:
+ * @store: a #PkPackageStore
+ *
+ * Return value: the number of packages in the store
+ **/
+guint
+pk_package_store_get_size (PkPackageStore *store)
+{
+	return store->rows->len;
+}
+
+/**
+ * pk_package_store_get_package:
+ * @store: a #PkPackageStore
+ * @idx: the row index
+ *
+ * Creates a #PkPackage for a row in the store.
+ *
+ * Return value: (transfer full): a #PkPackage
+ **/
+PkPackage *
+pk_package_store_get_package (PkPackageStore *store, guint idx)
+{
+	PkPackage *package;
+	PkPackageStoreRow *row;
+	_cleanup_free_ gchar *package_id = NULL;
+
+	g_return_val_if_fail (idx < store->rows->len, NULL);
+
+	/* this was never compacted */
+	package = g_hash_table_lookup (store->objects, GUINT_TO_POINTER (idx));
+	if (package != NULL)
+		return g_object_ref (package);
+
+	row = &g_array_index (store->rows, PkPackageStoreRow, idx);
+	package_id = g_strjoin (";",
+				row->split[PK_PACKAGE_ID_NAME],
+				row->split[PK_PACKAGE_ID_VERSION],
+				row->split[PK_PACKAGE_ID_ARCH],
+				row->split[PK_PACKAGE_ID_DATA],
+				NULL);
+	package = pk_package_new ();
+	pk_package_set_id (package, package_id, NULL);
+	pk_package_set_info (package, row->info);
+	pk_package_set_summary (package, row->summary);
+	pk_source_set_transaction (PK_SOURCE (package), row->role, row->transaction_id);
+	return package;
+}
+
+/**
+ * pk_package_store_new:
+ *
+ * Return value: a new #PkPackageStore, free with pk_package_store_free()
+ **/
+PkPackageStore *
+pk_package_store_new (void)
+{
+	PkPackageStore *store;
+	store = g_new0 (PkPackageStore, 1);
+	store->rows = g_array_new (FALSE, FALSE, sizeof (PkPackageStoreRow));
+	store->pool = g_string_chunk_new (PK_PACKAGE_STORE_POOL_SIZE);
+	store->objects = g_hash_table_new_full (g_direct_hash, g_direct_equal,
+						NULL, g_object_unref);
+	return store;
+}
+
+/**
+ * pk_package_store_free:
+ * @store: a #PkPackageStore
+ **/
+void
+pk_package_store_free (PkPackageStore *store)
+{
+	g_array_unref (store->rows);
+	g_string_chunk_free (store->pool);
+	g_hash_table_unref (store->objects);
+	g_free (store);
+}
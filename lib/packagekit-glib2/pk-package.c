@@ -30,6 +30,7 @@
 
 #include "config.h"
 
+#include <string.h>
 #include <glib-object.h>
 
 #include "src/pk-cleanup.h"
@@ -39,10 +40,32 @@
 #include <packagekit-glib2/pk-enum.h>
 #include <packagekit-glib2/pk-package-id.h>
 
+#include "pk-package-private.h"
+
 static void     pk_package_finalize	(GObject     *object);
 
 #define PK_PACKAGE_GET_PRIVATE(o) (G_TYPE_INSTANCE_GET_PRIVATE ((o), PK_TYPE_PACKAGE, PkPackagePrivate))
 
+/**
+ * PkPackageUpdate:
+ *
+ * Update details, only allocated when one of them is set as most
+ * packages never have any.
+ **/
+typedef struct {
+	gchar			*update_updates;
+	gchar			*update_obsoletes;
+	gchar			**update_vendor_urls;
+	gchar			**update_bugzilla_urls;
+	gchar			**update_cve_urls;
+	PkRestartEnum		 update_restart;
+	gchar			*update_text;
+	gchar			*update_changelog;
+	PkUpdateStateEnum	 update_state;
+	gchar			*update_issued;
+	gchar			*update_updated;
+} PkPackageUpdate;
+
 /**
  * PkPackagePrivate:
  *
@@ -51,8 +74,8 @@ static void     pk_package_finalize	(GObject     *object);
 struct _PkPackagePrivate
 {
 	PkInfoEnum		 info;
-	gchar			*package_id;
-	gchar			*package_id_data;
+	guint			 sack_count;	/* number of sacks indexing us */
+	gchar			*package_id;	/* followed by the split copy */
 	const gchar		*package_id_split[4];
 	gchar			*summary;
 	gchar			*license;
@@ -60,17 +83,7 @@ struct _PkPackagePrivate
 	gchar			*description;
 	gchar			*url;
 	guint64			 size;
-	gchar			*update_updates;
-	gchar			*update_obsoletes;
-	gchar			**update_vendor_urls;
-	gchar			**update_bugzilla_urls;
-	gchar			**update_cve_urls;
-	PkRestartEnum		 update_restart;
-	gchar			*update_text;
-	gchar			*update_changelog;
-	PkUpdateStateEnum	 update_state;
-	gchar			*update_issued;
-	gchar			*update_updated;
+	PkPackageUpdate		*update;
 };
 
 enum {
@@ -103,6 +116,7 @@ enum {
 };
 
 static guint signals [SIGNAL_LAST] = { 0 };
+static gint pk_package_info_generation = 0;
 
 G_DEFINE_TYPE (PkPackage, pk_package, PK_TYPE_SOURCE)
 
@@ -163,27 +177,31 @@ pk_package_set_id (PkPackage *package, const gchar *package_id, GError **error)
 {
 	PkPackagePrivate *priv = package->priv;
 	gboolean ret;
+	gchar *data;
+	gsize len;
 	guint cnt = 0;
 	guint i;
 
 	g_return_val_if_fail (PK_IS_PACKAGE (package), FALSE);
+	g_return_val_if_fail (package_id != NULL, FALSE);
 	g_return_val_if_fail (error == NULL || *error == NULL, FALSE);
 
-	/* free old data */
+	/* keep the package-id and a copy with each ';' changed into '\0' in
+	 * one allocation and reference the pointers in the const gchar * array */
+	len = strlen (package_id) + 1;
+	data = g_malloc (len * 2);
+	memcpy (data, package_id, len);
+	memcpy (data + len, package_id, len);
 	g_free (priv->package_id);
-	g_free (priv->package_id_data);
-
-	/* copy the package-id into package_id_data, change the ';' into '\0'
-	 * and reference the pointers in the const gchar * array */
-	priv->package_id = g_strdup (package_id);
-	priv->package_id_data = g_strdup (package_id);
-	priv->package_id_split[0] = priv->package_id_data;
-	for (i = 0; priv->package_id_data[i] != '\0'; i++) {
-		if (package_id[i] == ';') {
+	priv->package_id = data;
+	data += len;
+	priv->package_id_split[0] = data;
+	for (i = 0; data[i] != '\0'; i++) {
+		if (data[i] == ';') {
 			if (++cnt > 3)
 				continue;
-			priv->package_id_split[cnt] = &priv->package_id_data[i+1];
-			priv->package_id_data[i] = '\0';
+			priv->package_id_split[cnt] = &data[i+1];
+			data[i] = '\0';
 		}
 	}
 	if (cnt != 3) {
@@ -268,7 +286,13 @@ void
 pk_package_set_info (PkPackage *package, PkInfoEnum info)
 {
 	g_return_if_fail (PK_IS_PACKAGE (package));
+	if (package->priv->info == info)
+		return;
 	package->priv->info = info;
+
+	/* the info index of any sack holding us is now stale */
+	if (package->priv->sack_count > 0)
+		g_atomic_int_inc (&pk_package_info_generation);
 }
 
 /**
@@ -448,37 +472,48 @@ pk_package_get_property (GObject *object, guint prop_id, GValue *value, GParamSp
 		g_value_set_uint64 (value, priv->size);
 		break;
 	case PROP_UPDATE_UPDATES:
-		g_value_set_string (value, priv->update_updates);
+		if (priv->update != NULL)
+			g_value_set_string (value, priv->update->update_updates);
 		break;
 	case PROP_UPDATE_OBSOLETES:
-		g_value_set_string (value, priv->update_obsoletes);
+		if (priv->update != NULL)
+			g_value_set_string (value, priv->update->update_obsoletes);
 		break;
 	case PROP_UPDATE_VENDOR_URLS:
-		g_value_set_boxed (value, priv->update_vendor_urls);
+		if (priv->update != NULL)
+			g_value_set_boxed (value, priv->update->update_vendor_urls);
 		break;
 	case PROP_UPDATE_BUGZILLA_URLS:
-		g_value_set_boxed (value, priv->update_bugzilla_urls);
+		if (priv->update != NULL)
+			g_value_set_boxed (value, priv->update->update_bugzilla_urls);
 		break;
 	case PROP_UPDATE_CVE_URLS:
-		g_value_set_boxed (value, priv->update_cve_urls);
+		if (priv->update != NULL)
+			g_value_set_boxed (value, priv->update->update_cve_urls);
 		break;
 	case PROP_UPDATE_RESTART:
-		g_value_set_uint (value, priv->update_restart);
+		if (priv->update != NULL)
+			g_value_set_uint (value, priv->update->update_restart);
 		break;
 	case PROP_UPDATE_UPDATE_TEXT:
-		g_value_set_string (value, priv->update_text);
+		if (priv->update != NULL)
+			g_value_set_string (value, priv->update->update_text);
 		break;
 	case PROP_UPDATE_CHANGELOG:
-		g_value_set_string (value, priv->update_changelog);
+		if (priv->update != NULL)
+			g_value_set_string (value, priv->update->update_changelog);
 		break;
 	case PROP_UPDATE_STATE:
-		g_value_set_uint (value, priv->update_state);
+		if (priv->update != NULL)
+			g_value_set_uint (value, priv->update->update_state);
 		break;
 	case PROP_UPDATE_ISSUED:
-		g_value_set_string (value, priv->update_issued);
+		if (priv->update != NULL)
+			g_value_set_string (value, priv->update->update_issued);
 		break;
 	case PROP_UPDATE_UPDATED:
-		g_value_set_string (value, priv->update_updated);
+		if (priv->update != NULL)
+			g_value_set_string (value, priv->update->update_updated);
 		break;
 	default:
 		G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
@@ -486,6 +521,65 @@ pk_package_get_property (GObject *object, guint prop_id, GValue *value, GParamSp
 	}
 }
 
+/**
+ * pk_package_ensure_update:
+ **/
+static PkPackageUpdate *
+pk_package_ensure_update (PkPackage *package)
+{
+	if (package->priv->update == NULL)
+		package->priv->update = g_new0 (PkPackageUpdate, 1);
+	return package->priv->update;
+}
+
+/**
+ * pk_package_set_in_sack:
+ * @package: a valid #PkPackage instance
+ * @in_sack: %TRUE when a #PkPackageSack starts indexing the package
+ *
+ * Lets a sack know when to rebuild its info index, see
+ * pk_package_get_info_generation().
+ **/
+void
+pk_package_set_in_sack (PkPackage *package, gboolean in_sack)
+{
+	if (in_sack)
+		package->priv->sack_count++;
+	else if (package->priv->sack_count > 0)
+		package->priv->sack_count--;
+}
+
+/**
+ * pk_package_get_info_generation:
+ *
+ * Return value: a counter that changes whenever the info of a package
+ * held by any #PkPackageSack is changed
+ **/
+guint
+pk_package_get_info_generation (void)
+{
+	return (guint) g_atomic_int_get (&pk_package_info_generation);
+}
+
+/**
+ * pk_package_is_compact:
+ * @package: a valid #PkPackage instance
+ *
+ * Return value: %TRUE if only the info, package-id and summary are set
+ **/
+gboolean
+pk_package_is_compact (PkPackage *package)
+{
+	PkPackagePrivate *priv = package->priv;
+	return priv->package_id != NULL &&
+	       priv->license == NULL &&
+	       priv->group == PK_GROUP_ENUM_UNKNOWN &&
+	       priv->description == NULL &&
+	       priv->url == NULL &&
+	       priv->size == 0 &&
+	       priv->update == NULL;
+}
+
 /**
  * pk_package_set_property:
  **/
@@ -494,6 +588,11 @@ pk_package_set_property (GObject *object, guint prop_id, const GValue *value, GP
 {
 	PkPackage *package = PK_PACKAGE (object);
 	PkPackagePrivate *priv = package->priv;
+	PkPackageUpdate *update = NULL;
+
+	/* the update details are only allocated when first set */
+	if (prop_id >= PROP_UPDATE_UPDATES && prop_id < PROP_LAST)
+		update = pk_package_ensure_update (package);
 
 	switch (prop_id) {
 	case PROP_INFO:
@@ -521,46 +620,46 @@ pk_package_set_property (GObject *object, guint prop_id, const GValue *value, GP
 		priv->size = g_value_get_uint64 (value);
 		break;
 	case PROP_UPDATE_UPDATES:
-		g_free (priv->update_updates);
-		priv->update_updates = g_strdup (g_value_get_string (value));
+		g_free (update->update_updates);
+		update->update_updates = g_strdup (g_value_get_string (value));
 		break;
 	case PROP_UPDATE_OBSOLETES:
-		g_free (priv->update_obsoletes);
-		priv->update_obsoletes = g_strdup (g_value_get_string (value));
+		g_free (update->update_obsoletes);
+		update->update_obsoletes = g_strdup (g_value_get_string (value));
 		break;
 	case PROP_UPDATE_VENDOR_URLS:
-		g_strfreev (priv->update_vendor_urls);
-		priv->update_vendor_urls = g_strdupv (g_value_get_boxed (value));
+		g_strfreev (update->update_vendor_urls);
+		update->update_vendor_urls = g_strdupv (g_value_get_boxed (value));
 		break;
 	case PROP_UPDATE_BUGZILLA_URLS:
-		g_strfreev (priv->update_bugzilla_urls);
-		priv->update_bugzilla_urls = g_strdupv (g_value_get_boxed (value));
+		g_strfreev (update->update_bugzilla_urls);
+		update->update_bugzilla_urls = g_strdupv (g_value_get_boxed (value));
 		break;
 	case PROP_UPDATE_CVE_URLS:
-		g_strfreev (priv->update_cve_urls);
-		priv->update_cve_urls = g_strdupv (g_value_get_boxed (value));
+		g_strfreev (update->update_cve_urls);
+		update->update_cve_urls = g_strdupv (g_value_get_boxed (value));
 		break;
 	case PROP_UPDATE_RESTART:
-		priv->update_restart = g_value_get_uint (value);
+		update->update_restart = g_value_get_uint (value);
 		break;
 	case PROP_UPDATE_UPDATE_TEXT:
-		g_free (priv->update_text);
-		priv->update_text = g_strdup (g_value_get_string (value));
+		g_free (update->update_text);
+		update->update_text = g_strdup (g_value_get_string (value));
 		break;
 	case PROP_UPDATE_CHANGELOG:
-		g_free (priv->update_changelog);
-		priv->update_changelog = g_strdup (g_value_get_string (value));
+		g_free (update->update_changelog);
+		update->update_changelog = g_strdup (g_value_get_string (value));
 		break;
 	case PROP_UPDATE_STATE:
-		priv->update_state = g_value_get_uint (value);
+		update->update_state = g_value_get_uint (value);
 		break;
 	case PROP_UPDATE_ISSUED:
-		g_free (priv->update_issued);
-		priv->update_issued = g_strdup (g_value_get_string (value));
+		g_free (update->update_issued);
+		update->update_issued = g_strdup (g_value_get_string (value));
 		break;
 	case PROP_UPDATE_UPDATED:
-		g_free (priv->update_updated);
-		priv->update_updated = g_strdup (g_value_get_string (value));
+		g_free (update->update_updated);
+		update->update_updated = g_strdup (g_value_get_string (value));
 		break;
 	default:
 		G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
@@ -835,16 +934,18 @@ pk_package_finalize (GObject *object)
 	g_free (priv->license);
 	g_free (priv->description);
 	g_free (priv->url);
-	g_free (priv->update_updates);
-	g_free (priv->update_obsoletes);
-	g_strfreev (priv->update_vendor_urls);
-	g_strfreev (priv->update_bugzilla_urls);
-	g_strfreev (priv->update_cve_urls);
-	g_free (priv->update_text);
-	g_free (priv->update_changelog);
-	g_free (priv->update_issued);
-	g_free (priv->update_updated);
-	g_free (priv->package_id_data);
+	if (priv->update != NULL) {
+		g_free (priv->update->update_updates);
+		g_free (priv->update->update_obsoletes);
+		g_strfreev (priv->update->update_vendor_urls);
+		g_strfreev (priv->update->update_bugzilla_urls);
+		g_strfreev (priv->update->update_cve_urls);
+		g_free (priv->update->update_text);
+		g_free (priv->update->update_changelog);
+		g_free (priv->update->update_issued);
+		g_free (priv->update->update_updated);
+		g_free (priv->update);
+	}
 
 	G_OBJECT_CLASS (pk_package_parent_class)->finalize (object);
 }
@@ -33,6 +33,8 @@
 #include <packagekit-glib2/pk-package-id.h>
 #include <packagekit-glib2/pk-progress.h>
 
+#include "pk-progress-private.h"
+
 static void     pk_progress_finalize	(GObject     *object);
 
 #define PK_PROGRESS_GET_PRIVATE(o) (G_TYPE_INSTANCE_GET_PRIVATE ((o), PK_TYPE_PROGRESS, PkProgressPrivate))
@@ -59,6 +61,13 @@ struct _PkProgressPrivate
 	guint				 uid;
 	PkItemProgress			*item_progress;
 	PkPackage			*package;
+	guint				 coalesce_interval;	/* ms */
+	gboolean			 coalesce_by_type;
+	PkProgressCallback		 dispatch_callback;
+	gpointer			 dispatch_user_data;
+	guint32				 dispatch_pending;	/* 1 << PkProgressType */
+	gint64				 dispatch_last[PK_PROGRESS_TYPE_INVALID];
+	GSource				*dispatch_source;
 };
 
 enum {
@@ -81,6 +90,8 @@ enum {
 	PROP_LAST
 };
 
+static GParamSpec *obj_props[PROP_LAST] = { NULL, };
+
 G_DEFINE_TYPE (PkProgress, pk_progress, G_TYPE_OBJECT)
 
 /**
@@ -167,7 +178,7 @@ pk_progress_set_package_id (PkProgress *progress, const gchar *package_id)
 	/* new value */
 	g_free (progress->priv->package_id);
 	progress->priv->package_id = g_strdup (package_id);
-	g_object_notify (G_OBJECT(progress), "package-id");
+	g_object_notify_by_pspec (G_OBJECT(progress), obj_props[PROP_PACKAGE_ID]);
 
 	return TRUE;
 }
@@ -192,7 +203,7 @@ pk_progress_set_item_progress (PkProgress *progress,
 	if (progress->priv->item_progress != NULL)
 		g_object_unref (progress->priv->item_progress);
 	progress->priv->item_progress = g_object_ref (item_progress);
-	g_object_notify (G_OBJECT(progress), "item-progress");
+	g_object_notify_by_pspec (G_OBJECT(progress), obj_props[PROP_ITEM_PROGRESS]);
 	return TRUE;
 }
 
@@ -214,7 +225,7 @@ pk_progress_set_transaction_id (PkProgress *progress, const gchar *transaction_i
 	/* new value */
 	g_free (progress->priv->transaction_id);
 	progress->priv->transaction_id = g_strdup (transaction_id);
-	g_object_notify (G_OBJECT(progress), "transaction-id");
+	g_object_notify_by_pspec (G_OBJECT(progress), obj_props[PROP_TRANSACTION_ID]);
 
 	return TRUE;
 }
@@ -235,7 +246,7 @@ pk_progress_set_percentage (PkProgress *progress, gint percentage)
 
 	/* new value */
 	progress->priv->percentage = percentage;
-	g_object_notify (G_OBJECT(progress), "percentage");
+	g_object_notify_by_pspec (G_OBJECT(progress), obj_props[PROP_PERCENTAGE]);
 
 	return TRUE;
 }
@@ -256,7 +267,7 @@ pk_progress_set_status (PkProgress *progress, PkStatusEnum status)
 
 	/* new value */
 	progress->priv->status = status;
-	g_object_notify (G_OBJECT(progress), "status");
+	g_object_notify_by_pspec (G_OBJECT(progress), obj_props[PROP_STATUS]);
 
 	return TRUE;
 }
@@ -282,7 +293,7 @@ pk_progress_set_role (PkProgress *progress, PkRoleEnum role)
 	/* new value */
 	progress->priv->role = role;
 	g_debug ("role now %s", pk_role_enum_to_string (role));
-	g_object_notify (G_OBJECT(progress), "role");
+	g_object_notify_by_pspec (G_OBJECT(progress), obj_props[PROP_ROLE]);
 
 	return TRUE;
 }
@@ -303,7 +314,7 @@ pk_progress_set_allow_cancel (PkProgress *progress, gboolean allow_cancel)
 
 	/* new value */
 	progress->priv->allow_cancel = allow_cancel;
-	g_object_notify (G_OBJECT(progress), "allow-cancel");
+	g_object_notify_by_pspec (G_OBJECT(progress), obj_props[PROP_ALLOW_CANCEL]);
 
 	return TRUE;
 }
@@ -324,7 +335,7 @@ pk_progress_set_caller_active (PkProgress *progress, gboolean caller_active)
 
 	/* new value */
 	progress->priv->caller_active = caller_active;
-	g_object_notify (G_OBJECT(progress), "caller-active");
+	g_object_notify_by_pspec (G_OBJECT(progress), obj_props[PROP_CALLER_ACTIVE]);
 
 	return TRUE;
 }
@@ -345,7 +356,7 @@ pk_progress_set_elapsed_time (PkProgress *progress, guint elapsed_time)
 
 	/* new value */
 	progress->priv->elapsed_time = elapsed_time;
-	g_object_notify (G_OBJECT(progress), "elapsed-time");
+	g_object_notify_by_pspec (G_OBJECT(progress), obj_props[PROP_ELAPSED_TIME]);
 
 	return TRUE;
 }
@@ -366,7 +377,7 @@ pk_progress_set_remaining_time (PkProgress *progress, guint remaining_time)
 
 	/* new value */
 	progress->priv->remaining_time = remaining_time;
-	g_object_notify (G_OBJECT(progress), "remaining-time");
+	g_object_notify_by_pspec (G_OBJECT(progress), obj_props[PROP_REMAINING_TIME]);
 
 	return TRUE;
 }
@@ -387,7 +398,7 @@ pk_progress_set_speed (PkProgress *progress, guint speed)
 
 	/* new value */
 	progress->priv->speed = speed;
-	g_object_notify (G_OBJECT(progress), "speed");
+	g_object_notify_by_pspec (G_OBJECT(progress), obj_props[PROP_SPEED]);
 
 	return TRUE;
 }
@@ -408,7 +419,7 @@ pk_progress_set_download_size_remaining (PkProgress *progress, guint64 download_
 
 	/* new value */
 	progress->priv->download_size_remaining = download_size_remaining;
-	g_object_notify (G_OBJECT(progress), "download-size-remaining");
+	g_object_notify_by_pspec (G_OBJECT(progress), obj_props[PROP_DOWNLOAD_SIZE_REMAINING]);
 
 	return TRUE;
 }
@@ -429,7 +440,7 @@ pk_progress_set_transaction_flags (PkProgress *progress, guint64 transaction_fla
 
 	/* new value */
 	progress->priv->transaction_flags = transaction_flags;
-	g_object_notify (G_OBJECT(progress), "transaction-flags");
+	g_object_notify_by_pspec (G_OBJECT(progress), obj_props[PROP_TRANSACTION_FLAGS]);
 
 	return TRUE;
 }
@@ -450,7 +461,7 @@ pk_progress_set_uid (PkProgress *progress, guint uid)
 
 	/* new value */
 	progress->priv->uid = uid;
-	g_object_notify (G_OBJECT(progress), "uid");
+	g_object_notify_by_pspec (G_OBJECT(progress), obj_props[PROP_UID]);
 
 	return TRUE;
 }
@@ -473,11 +484,250 @@ pk_progress_set_package (PkProgress *progress, PkPackage *package)
 	if (progress->priv->package != NULL)
 		g_object_unref (progress->priv->package);
 	progress->priv->package = g_object_ref (package);
-	g_object_notify (G_OBJECT(progress), "package");
+	g_object_notify_by_pspec (G_OBJECT(progress), obj_props[PROP_PACKAGE]);
 
 	return TRUE;
 }
 
+/**
+ * pk_progress_type_is_coalesced:
+ *
+ * Only values that change many times a second are delayed; everything
+ * else, including the percentage reaching 100, is sent straight away.
+ **/
+static gboolean
+pk_progress_type_is_coalesced (PkProgress *progress, PkProgressType type)
+{
+	switch (type) {
+	case PK_PROGRESS_TYPE_PERCENTAGE:
+		return progress->priv->percentage != 100;
+	case PK_PROGRESS_TYPE_PACKAGE_ID:
+	case PK_PROGRESS_TYPE_PACKAGE:
+	case PK_PROGRESS_TYPE_ITEM_PROGRESS:
+	case PK_PROGRESS_TYPE_ELAPSED_TIME:
+	case PK_PROGRESS_TYPE_REMAINING_TIME:
+	case PK_PROGRESS_TYPE_SPEED:
+	case PK_PROGRESS_TYPE_DOWNLOAD_SIZE_REMAINING:
+		return TRUE;
+	default:
+		break;
+	}
+	return FALSE;
+}
+
+/**
+ * pk_progress_dispatch_deadline:
+ **/
+static gint64
+pk_progress_dispatch_deadline (PkProgress *progress, PkProgressType type)
+{
+	PkProgressPrivate *priv = progress->priv;
+	guint slot = priv->coalesce_by_type ? type : 0;
+	return priv->dispatch_last[slot] + (gint64) priv->coalesce_interval * 1000;
+}
+
+/**
+ * pk_progress_dispatch_cancel:
+ **/
+static void
+pk_progress_dispatch_cancel (PkProgress *progress)
+{
+	if (progress->priv->dispatch_source == NULL)
+		return;
+	g_source_destroy (progress->priv->dispatch_source);
+	g_source_unref (progress->priv->dispatch_source);
+	progress->priv->dispatch_source = NULL;
+}
+
+static void pk_progress_dispatch_pending (PkProgress *progress, gboolean force);
+
+/**
+ * pk_progress_dispatch_timeout_cb:
+ **/
+static gboolean
+pk_progress_dispatch_timeout_cb (gpointer user_data)
+{
+	PkProgress *progress = PK_PROGRESS (user_data);
+	g_source_unref (progress->priv->dispatch_source);
+	progress->priv->dispatch_source = NULL;
+	pk_progress_dispatch_pending (progress, FALSE);
+	return G_SOURCE_REMOVE;
+}
+
+/**
+ * pk_progress_dispatch_schedule:
+ *
+ * Wakes up the thread-default main context when the first pending value
+ * is due, which is the context the client is delivering results in.
+ **/
+static void
+pk_progress_dispatch_schedule (PkProgress *progress)
+{
+	PkProgressPrivate *priv = progress->priv;
+	gint64 delay;
+	gint64 next = G_MAXINT64;
+	guint type;
+
+	pk_progress_dispatch_cancel (progress);
+	for (type = 0; type < PK_PROGRESS_TYPE_INVALID; type++) {
+		if ((priv->dispatch_pending & (1u << type)) == 0)
+			continue;
+		next = MIN (next, pk_progress_dispatch_deadline (progress, type));
+	}
+	if (next == G_MAXINT64)
+		return;
+
+	delay = MAX (next - g_get_monotonic_time (), 0);
+	priv->dispatch_source = g_timeout_source_new ((delay + 999) / 1000);
+	g_source_set_callback (priv->dispatch_source,
+			       pk_progress_dispatch_timeout_cb,
+			       progress, NULL);
+	g_source_set_name (priv->dispatch_source, "[PkProgress] dispatch");
+	g_source_attach (priv->dispatch_source,
+			 g_main_context_get_thread_default ());
+}
+
+/**
+ * pk_progress_dispatch_pending:
+ * @force: send everything pending, even if the interval has not elapsed
+ **/
+static void
+pk_progress_dispatch_pending (PkProgress *progress, gboolean force)
+{
+	PkProgressPrivate *priv = progress->priv;
+	gint64 now;
+	guint32 sent = 0;
+	guint type;
+
+	if (priv->dispatch_pending == 0) {
+		pk_progress_dispatch_cancel (progress);
+		return;
+	}
+
+	/* the callback may drop the last reference */
+	g_object_ref (progress);
+	now = g_get_monotonic_time ();
+	for (type = 0; type < PK_PROGRESS_TYPE_INVALID; type++) {
+		if ((priv->dispatch_pending & (1u << type)) == 0)
+			continue;
+		if (!force && now < pk_progress_dispatch_deadline (progress, type))
+			continue;
+		priv->dispatch_pending &= ~(1u << type);
+		sent |= 1u << type;
+		priv->dispatch_callback (progress, type, priv->dispatch_user_data);
+	}
+
+	/* only start the next interval once everything due has been sent,
+	 * otherwise a shared interval would hold back the second type */
+	for (type = 0; type < PK_PROGRESS_TYPE_INVALID; type++) {
+		if (sent & (1u << type))
+			priv->dispatch_last[priv->coalesce_by_type ? type : 0] = now;
+	}
+	if (priv->dispatch_pending != 0)
+		pk_progress_dispatch_schedule (progress);
+	else
+		pk_progress_dispatch_cancel (progress);
+	g_object_unref (progress);
+}
+
+/**
+ * pk_progress_dispatch:
+ * @progress: a valid #PkProgress instance
+ * @type: the value that has just changed
+ * @callback: (allow-none): the function to call
+ * @user_data: the data to pass to @callback
+ *
+ * Calls @callback for the changed value, unless the coalescing policy says
+ * it has been called too recently, in which case the latest value of
+ * @type is sent once the interval has elapsed.
+ **/
+void
+pk_progress_dispatch (PkProgress *progress,
+		      PkProgressType type,
+		      PkProgressCallback callback,
+		      gpointer user_data)
+{
+	PkProgressPrivate *priv = progress->priv;
+	gint64 now;
+
+	g_return_if_fail (PK_IS_PROGRESS (progress));
+	g_return_if_fail (type < PK_PROGRESS_TYPE_INVALID);
+
+	if (callback == NULL)
+		return;
+	priv->dispatch_callback = callback;
+	priv->dispatch_user_data = user_data;
+
+	/* never delay these, but send anything older first so the callback
+	 * sees the changes in order */
+	if (priv->coalesce_interval == 0 ||
+	    !pk_progress_type_is_coalesced (progress, type)) {
+		pk_progress_dispatch_pending (progress, TRUE);
+		callback (progress, type, user_data);
+		return;
+	}
+
+	/* already waiting, and the latest value is read when it is sent */
+	if (priv->dispatch_pending & (1u << type))
+		return;
+
+	now = g_get_monotonic_time ();
+	if (now >= pk_progress_dispatch_deadline (progress, type)) {
+		priv->dispatch_last[priv->coalesce_by_type ? type : 0] = now;
+		callback (progress, type, user_data);
+		return;
+	}
+	priv->dispatch_pending |= 1u << type;
+	pk_progress_dispatch_schedule (progress);
+}
+
+/**
+ * pk_progress_dispatch_flush:
+ * @progress: a valid #PkProgress instance
+ *
+ * Sends all the pending values now, for instance when the transaction
+ * has finished.
+ **/
+void
+pk_progress_dispatch_flush (PkProgress *progress)
+{
+	g_return_if_fail (PK_IS_PROGRESS (progress));
+	pk_progress_dispatch_pending (progress, TRUE);
+}
+
+/**
+ * pk_progress_set_coalesce_policy:
+ * @progress: a valid #PkProgress instance
+ * @interval: the minimum time between callbacks in ms, or 0 for no limit
+ * @coalesce_by_type: if each #PkProgressType has its own interval
+ *
+ * Limits how often the #PkProgressCallback is called for values that
+ * change quickly, such as the percentage, the speed or the package being
+ * processed. Changes that arrive within @interval of the last callback are
+ * coalesced, and only the latest value is sent when the interval elapses.
+ *
+ * If @coalesce_by_type is %FALSE then all these values share one interval,
+ * so the callback is called at most once per interval for all of them.
+ *
+ * Changes to the role, status and other values that rarely change, a
+ * percentage of 100 and anything pending when the transaction finishes
+ * are never dropped or delayed.
+ *
+ * Since: 1.0.1
+ **/
+void
+pk_progress_set_coalesce_policy (PkProgress *progress,
+				 guint interval,
+				 gboolean coalesce_by_type)
+{
+	g_return_if_fail (PK_IS_PROGRESS (progress));
+
+	/* do not hold anything back with the old policy */
+	pk_progress_dispatch_pending (progress, TRUE);
+	progress->priv->coalesce_interval = interval;
+	progress->priv->coalesce_by_type = coalesce_by_type;
+}
+
 /**
  * pk_progress_set_property:
  **/
@@ -553,6 +803,7 @@ pk_progress_class_init (PkProgressClass *klass)
 				     "The full package_id, e.g. 'gnome-power-manager;0.1.2;i386;fedora'",
 				     NULL,
 				     G_PARAM_READWRITE);
+	obj_props[PROP_PACKAGE_ID] = pspec;
 	g_object_class_install_property (object_class, PROP_PACKAGE_ID, pspec);
 
 	/**
@@ -564,6 +815,7 @@ pk_progress_class_init (PkProgressClass *klass)
 				     "The transaction_id, e.g. '/892_deabbbdb_data'",
 				     NULL,
 				     G_PARAM_READWRITE);
+	obj_props[PROP_TRANSACTION_ID] = pspec;
 	g_object_class_install_property (object_class, PROP_TRANSACTION_ID, pspec);
 
 	/**
@@ -574,6 +826,7 @@ pk_progress_class_init (PkProgressClass *klass)
 	pspec = g_param_spec_int ("percentage", NULL, NULL,
 				  -1, G_MAXINT, -1,
 				  G_PARAM_READWRITE);
+	obj_props[PROP_PERCENTAGE] = pspec;
 	g_object_class_install_property (object_class, PROP_PERCENTAGE, pspec);
 
 	/**
@@ -584,6 +837,7 @@ pk_progress_class_init (PkProgressClass *klass)
 	pspec = g_param_spec_boolean ("allow-cancel", NULL, NULL,
 				      FALSE,
 				      G_PARAM_READWRITE);
+	obj_props[PROP_ALLOW_CANCEL] = pspec;
 	g_object_class_install_property (object_class, PROP_ALLOW_CANCEL, pspec);
 
 	/**
@@ -594,6 +848,7 @@ pk_progress_class_init (PkProgressClass *klass)
 	pspec = g_param_spec_uint ("status", NULL, NULL,
 				   0, PK_STATUS_ENUM_LAST, PK_STATUS_ENUM_UNKNOWN,
 				   G_PARAM_READWRITE);
+	obj_props[PROP_STATUS] = pspec;
 	g_object_class_install_property (object_class, PROP_STATUS, pspec);
 
 	/**
@@ -604,6 +859,7 @@ pk_progress_class_init (PkProgressClass *klass)
 	pspec = g_param_spec_uint ("role", NULL, NULL,
 				   0, PK_ROLE_ENUM_LAST, PK_ROLE_ENUM_UNKNOWN,
 				   G_PARAM_READWRITE);
+	obj_props[PROP_ROLE] = pspec;
 	g_object_class_install_property (object_class, PROP_ROLE, pspec);
 
 	/**
@@ -614,6 +870,7 @@ pk_progress_class_init (PkProgressClass *klass)
 	pspec = g_param_spec_boolean ("caller-active", NULL, NULL,
 				      FALSE,
 				      G_PARAM_READWRITE);
+	obj_props[PROP_CALLER_ACTIVE] = pspec;
 	g_object_class_install_property (object_class, PROP_CALLER_ACTIVE, pspec);
 
 	/**
@@ -624,6 +881,7 @@ pk_progress_class_init (PkProgressClass *klass)
 	pspec = g_param_spec_uint ("elapsed-time", NULL, NULL,
 				   0, G_MAXUINT, 0,
 				   G_PARAM_READWRITE);
+	obj_props[PROP_ELAPSED_TIME] = pspec;
 	g_object_class_install_property (object_class, PROP_ELAPSED_TIME, pspec);
 
 	/**
@@ -634,6 +892,7 @@ pk_progress_class_init (PkProgressClass *klass)
 	pspec = g_param_spec_uint ("remaining-time", NULL, NULL,
 				   0, G_MAXUINT, 0,
 				   G_PARAM_READWRITE);
+	obj_props[PROP_REMAINING_TIME] = pspec;
 	g_object_class_install_property (object_class, PROP_REMAINING_TIME, pspec);
 
 	/**
@@ -644,6 +903,7 @@ pk_progress_class_init (PkProgressClass *klass)
 	pspec = g_param_spec_uint ("speed", NULL, NULL,
 				   0, G_MAXUINT, 0,
 				   G_PARAM_READWRITE);
+	obj_props[PROP_SPEED] = pspec;
 	g_object_class_install_property (object_class, PROP_SPEED, pspec);
 	
 	/**
@@ -654,6 +914,7 @@ pk_progress_class_init (PkProgressClass *klass)
 	pspec = g_param_spec_uint ("download-size-remaining", NULL, NULL,
 				   0, G_MAXUINT, 0,
 				   G_PARAM_READWRITE);
+	obj_props[PROP_DOWNLOAD_SIZE_REMAINING] = pspec;
 	g_object_class_install_property (object_class, PROP_DOWNLOAD_SIZE_REMAINING, pspec);
 
 	/**
@@ -664,6 +925,7 @@ pk_progress_class_init (PkProgressClass *klass)
 	pspec = g_param_spec_uint64 ("transaction-flags", NULL, NULL,
 				     0, G_MAXUINT64, 0,
 				     G_PARAM_READWRITE);
+	obj_props[PROP_TRANSACTION_FLAGS] = pspec;
 	g_object_class_install_property (object_class, PROP_TRANSACTION_FLAGS, pspec);
 
 	/**
@@ -674,6 +936,7 @@ pk_progress_class_init (PkProgressClass *klass)
 	pspec = g_param_spec_uint ("uid", NULL, NULL,
 				   0, G_MAXUINT, 0,
 				   G_PARAM_READWRITE);
+	obj_props[PROP_UID] = pspec;
 	g_object_class_install_property (object_class, PROP_UID, pspec);
 
 	/**
@@ -684,6 +947,7 @@ pk_progress_class_init (PkProgressClass *klass)
 	pspec = g_param_spec_object ("package", NULL, NULL,
 				     PK_TYPE_PACKAGE,
 				     G_PARAM_READWRITE);
+	obj_props[PROP_PACKAGE] = pspec;
 	g_object_class_install_property (object_class, PROP_PACKAGE, pspec);
 
 	/**
@@ -694,6 +958,7 @@ pk_progress_class_init (PkProgressClass *klass)
 	pspec = g_param_spec_object ("item-progress", NULL, NULL,
 				     PK_TYPE_ITEM_PROGRESS,
 				     G_PARAM_READWRITE);
+	obj_props[PROP_ITEM_PROGRESS] = pspec;
 	g_object_class_install_property (object_class, PROP_ITEM_PROGRESS, pspec);
 
 	g_type_class_add_private (klass, sizeof (PkProgressPrivate));
@@ -716,6 +981,7 @@ pk_progress_finalize (GObject *object)
 {
 	PkProgress *progress = PK_PROGRESS (object);
 
+	pk_progress_dispatch_cancel (progress);
 	if (progress->priv->package != NULL)
 		g_object_unref (progress->priv->package);
 	if (progress->priv->item_progress != NULL)
@@ -119,6 +119,9 @@ gboolean	 pk_progress_set_uid			(PkProgress		*progress,
 							 guint			 uid);
 gboolean	 pk_progress_set_package		(PkProgress		*progress,
 							 PkPackage		*package);
+void		 pk_progress_set_coalesce_policy	(PkProgress		*progress,
+							 guint			 interval,
+							 gboolean		 coalesce_by_type);
 
 G_END_DECLS
 
@@ -33,9 +33,13 @@
 
 #include <glib-object.h>
 
+#include "src/pk-cleanup.h"
+
 #include <packagekit-glib2/pk-results.h>
 #include <packagekit-glib2/pk-enum.h>
 
+#include "pk-package-store-private.h"
+
 static void     pk_results_finalize	(GObject     *object);
 
 #define PK_RESULTS_GET_PRIVATE(o) (G_TYPE_INSTANCE_GET_PRIVATE ((o), PK_TYPE_RESULTS, PkResultsPrivate))
@@ -64,6 +68,7 @@ struct _PkResultsPrivate
 	GPtrArray		*eula_required_array;
 	GPtrArray		*media_change_required_array;
 	GPtrArray		*repo_detail_array;
+	PkPackageStore		*package_store;
 	PkPackageSack		*package_sack;
 };
 
@@ -180,7 +185,12 @@ pk_results_add_package (PkResults *results, PkPackage *item)
 		g_warning ("Finished packages cannot be added to PkResults");
 		return FALSE;
 	}
-	pk_package_sack_add_package (results->priv->package_sack, item);
+
+	/* only keep objects once somebody has asked for them */
+	if (results->priv->package_sack != NULL)
+		pk_package_sack_add_package (results->priv->package_sack, item);
+	else
+		pk_package_store_add (results->priv->package_store, item);
 	return TRUE;
 }
 
@@ -541,6 +551,33 @@ pk_results_get_error_code (PkResults *results)
 	return g_object_ref (results->priv->error_code);
 }
 
+/**
+ * pk_results_ensure_package_sack:
+ *
+ * Creates the #PkPackage objects for everything in the package store.
+ **/
+static PkPackageSack *
+pk_results_ensure_package_sack (PkResults *results)
+{
+	PkResultsPrivate *priv = results->priv;
+	guint i;
+	guint len;
+
+	if (priv->package_sack != NULL)
+		return priv->package_sack;
+
+	priv->package_sack = pk_package_sack_new ();
+	len = pk_package_store_get_size (priv->package_store);
+	for (i = 0; i < len; i++) {
+		_cleanup_object_unref_ PkPackage *package = NULL;
+		package = pk_package_store_get_package (priv->package_store, i);
+		pk_package_sack_add_package (priv->package_sack, package);
+	}
+	pk_package_store_free (priv->package_store);
+	priv->package_store = NULL;
+	return priv->package_sack;
+}
+
 /**
  * pk_results_get_package_array:
  * @results: a valid #PkResults instance
@@ -556,7 +593,7 @@ GPtrArray *
 pk_results_get_package_array (PkResults *results)
 {
 	g_return_val_if_fail (PK_IS_RESULTS (results), NULL);
-	return pk_package_sack_get_array (results->priv->package_sack);
+	return pk_package_sack_get_array (pk_results_ensure_package_sack (results));
 }
 
 /**
@@ -573,7 +610,7 @@ PkPackageSack *
 pk_results_get_package_sack (PkResults *results)
 {
 	g_return_val_if_fail (PK_IS_RESULTS (results), NULL);
-	return g_object_ref (results->priv->package_sack);
+	return g_object_ref (pk_results_ensure_package_sack (results));
 }
 
 /**
@@ -871,7 +908,7 @@ pk_results_init (PkResults *results)
 	results->priv->inputs = 0;
 	results->priv->progress = NULL;
 	results->priv->error_code = NULL;
-	results->priv->package_sack = pk_package_sack_new ();
+	results->priv->package_store = pk_package_store_new ();
 	results->priv->details_array = g_ptr_array_new_with_free_func ((GDestroyNotify) g_object_unref);
 	results->priv->update_detail_array = g_ptr_array_new_with_free_func ((GDestroyNotify) g_object_unref);
 	results->priv->category_array = g_ptr_array_new_with_free_func ((GDestroyNotify) g_object_unref);
@@ -905,7 +942,10 @@ pk_results_finalize (GObject *object)
 	g_ptr_array_unref (priv->eula_required_array);
 	g_ptr_array_unref (priv->media_change_required_array);
 	g_ptr_array_unref (priv->repo_detail_array);
-	g_object_unref (priv->package_sack);
+	if (priv->package_store != NULL)
+		pk_package_store_free (priv->package_store);
+	if (priv->package_sack != NULL)
+		g_object_unref (priv->package_sack);
 	if (results->priv->progress != NULL)
 		g_object_unref (results->priv->progress);
 	if (results->priv->error_code != NULL)
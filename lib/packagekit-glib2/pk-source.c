@@ -34,6 +34,8 @@
 #include <packagekit-glib2/pk-source.h>
 #include <packagekit-glib2/pk-enum.h>
 
+#include "pk-source-private.h"
+
 static void     pk_source_finalize	(GObject     *object);
 
 #define PK_SOURCE_GET_PRIVATE(o) (G_TYPE_INSTANCE_GET_PRIVATE ((o), PK_TYPE_SOURCE, PkSourcePrivate))
@@ -58,6 +60,43 @@ enum {
 
 G_DEFINE_TYPE (PkSource, pk_source, G_TYPE_OBJECT)
 
+/**
+ * pk_source_get_role:
+ **/
+PkRoleEnum
+pk_source_get_role (PkSource *source)
+{
+	return source->priv->role;
+}
+
+/**
+ * pk_source_get_transaction_id:
+ **/
+const gchar *
+pk_source_get_transaction_id (PkSource *source)
+{
+	return source->priv->transaction_id;
+}
+
+/**
+ * pk_source_set_transaction:
+ *
+ * Sets the role and transaction ID without looking up the properties or
+ * emitting ::notify, which is only useful for new objects.
+ **/
+void
+pk_source_set_transaction (PkSource *source,
+			   PkRoleEnum role,
+			   const gchar *transaction_id)
+{
+	PkSourcePrivate *priv = source->priv;
+	priv->role = role;
+	if (g_strcmp0 (priv->transaction_id, transaction_id) == 0)
+		return;
+	g_free (priv->transaction_id);
+	priv->transaction_id = g_strdup (transaction_id);
+}
+
 /**
  * pk_source_get_property:
  **/
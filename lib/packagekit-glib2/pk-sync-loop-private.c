@@ -0,0 +1,144 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: t; c-basic-offset: 8 -*-
+ *
+ * Copyright (C) 2014 Richard Hughes <richard@hughsie.com>
+ *
+ * Licensed under the GNU Lesser General Public License Version 2.1
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+/*
+ * The synchronous wrappers run the async method in their own main context
+ * so that nothing else gets dispatched while they block. Rather than
+ * creating and destroying a context and a loop for every call, each thread
+ * keeps the ones it has finished with and reuses them for the next call.
+ * A sync call made from a callback of another sync call on the same
+ * thread just takes a second loop from the pool.
+ */
+
+#include "config.h"
+
+#include <glib.h>
+
+#include "pk-sync-loop-private.h"
+
+/* loops kept per thread when not in use */
+#define PK_SYNC_LOOP_POOL_MAX	4
+
+struct PkSyncLoop
+{
+	GMainContext		*context;
+	GMainLoop		*loop;
+};
+
+/**
+ * pk_sync_loop_free:
+ **/
+static void
+pk_sync_loop_free (PkSyncLoop *loop)
+{
+	g_main_loop_unref (loop->loop);
+	g_main_context_unref (loop->context);
+	g_slice_free (PkSyncLoop, loop);
+}
+
+/**
+ * pk_sync_loop_pool_free:
+ **/
+static void
+pk_sync_loop_pool_free (gpointer data)
+{
+	g_slist_free_full (data, (GDestroyNotify) pk_sync_loop_free);
+}
+
+static GPrivate pk_sync_loop_pool = G_PRIVATE_INIT (pk_sync_loop_pool_free);
+
+/**
+ * pk_sync_loop_acquire:
+ *
+ * Gets an unused loop for this thread and makes its context the
+ * thread-default one, so async methods started afterwards complete in it.
+ *
+ * Return value: a #PkSyncLoop, give back with pk_sync_loop_release()
+ **/
+PkSyncLoop *
+pk_sync_loop_acquire (void)
+{
+	GSList *pool;
+	PkSyncLoop *loop;
+
+	pool = g_private_get (&pk_sync_loop_pool);
+	if (pool != NULL) {
+		loop = pool->data;
+		g_private_set (&pk_sync_loop_pool, g_slist_delete_link (pool, pool));
+	} else {
+		loop = g_slice_new (PkSyncLoop);
+		loop->context = g_main_context_new ();
+		loop->loop = g_main_loop_new (loop->context, FALSE);
+	}
+	g_main_context_push_thread_default (loop->context);
+	return loop;
+}
+
+/**
+ * pk_sync_loop_run:
+ *
+ * Blocks until pk_sync_loop_quit() is called from a callback.
+ **/
+void
+pk_sync_loop_run (PkSyncLoop *loop)
+{
+	g_main_loop_run (loop->loop);
+}
+
+/**
+ * pk_sync_loop_quit:
+ **/
+void
+pk_sync_loop_quit (PkSyncLoop *loop)
+{
+	g_main_loop_quit (loop->loop);
+}
+
+/**
+ * pk_sync_loop_release:
+ *
+ * Restores the previous thread-default context and keeps the loop for
+ * the next synchronous call made from this thread.
+ **/
+void
+pk_sync_loop_release (PkSyncLoop *loop)
+{
+	GSList *pool;
+
+	g_main_context_pop_thread_default (loop->context);
+	pool = g_private_get (&pk_sync_loop_pool);
+	if (g_slist_length (pool) >= PK_SYNC_LOOP_POOL_MAX) {
+		pk_sync_loop_free (loop);
+		return;
+	}
+	g_private_set (&pk_sync_loop_pool, g_slist_prepend (pool, loop));
+}
+
+/**
+ * pk_sync_loop_get_pool_size:
+ *
+ * Return value: the number of loops this thread keeps for reuse
+ **/
+guint
+pk_sync_loop_get_pool_size (void)
+{
+	return g_slist_length (g_private_get (&pk_sync_loop_pool));
+}
@@ -0,0 +1,43 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: t; c-basic-offset: 8 -*-
+ *
+ * Copyright (C) 2014 Richard Hughes <richard@hughsie.com>
+ *
+ * Licensed under the GNU Lesser General Public License Version 2.1
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#if !defined (__PACKAGEKIT_H_INSIDE__) && !defined (PK_COMPILATION)
+#error "Only <packagekit.h> can be included directly."
+#endif
+
+#ifndef __PK_SYNC_LOOP_PRIVATE_H
+#define __PK_SYNC_LOOP_PRIVATE_H
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+typedef struct PkSyncLoop	PkSyncLoop;
+
+PkSyncLoop	*pk_sync_loop_acquire			(void);
+void		 pk_sync_loop_run			(PkSyncLoop	*loop);
+void		 pk_sync_loop_quit			(PkSyncLoop	*loop);
+void		 pk_sync_loop_release			(PkSyncLoop	*loop);
+guint		 pk_sync_loop_get_pool_size		(void);
+
+G_END_DECLS
+
+#endif /* __PK_SYNC_LOOP_PRIVATE_H */
@@ -30,12 +30,12 @@
 #include <packagekit-glib2/pk-progress.h>
 
 #include "pk-task-sync.h"
+#include "pk-sync-loop-private.h"
 
 /* tiny helper to help us do the async operation */
 typedef struct {
 	GError		**error;
-	GMainContext	*context;
-	GMainLoop	*loop;
+	PkSyncLoop	*loop;
 	PkResults	*results;
 } PkTaskHelper;
 
@@ -52,7 +52,7 @@ pk_task_generic_finish_sync (PkTask *task, GAsyncResult *res, PkTaskHelper *help
 		g_object_unref (results);
 		helper->results = g_object_ref (G_OBJECT (results));
 	}
-	g_main_loop_quit (helper->loop);
+	pk_sync_loop_quit (helper->loop);
 }
 
 /**
@@ -89,25 +89,19 @@ pk_task_remove_packages_sync (PkTask *task, gchar **package_ids, gboolean allow_
 
 	/* create temp object */
 	memset (&helper, 0, sizeof (PkTaskHelper));
-	helper.context = g_main_context_new ();
-	helper.loop = g_main_loop_new (helper.context, FALSE);
+	helper.loop = pk_sync_loop_acquire ();
 	helper.error = error;
 
-	g_main_context_push_thread_default (helper.context);
-
 	/* run async method */
 	pk_task_remove_packages_async (task, package_ids, allow_deps, autoremove, cancellable, progress_callback, progress_user_data,
 				       (GAsyncReadyCallback) pk_task_generic_finish_sync, &helper);
 
-	g_main_loop_run (helper.loop);
+	pk_sync_loop_run (helper.loop);
 
 	results = helper.results;
 
-	g_main_context_pop_thread_default (helper.context);
-
-	/* free temp object */
-	g_main_loop_unref (helper.loop);
-	g_main_context_unref (helper.context);
+	/* give back temp loop */
+	pk_sync_loop_release (helper.loop);
 
 	return results;
 }
@@ -142,25 +136,19 @@ pk_task_install_packages_sync (PkTask *task, gchar **package_ids, GCancellable *
 
 	/* create temp object */
 	memset (&helper, 0, sizeof (PkTaskHelper));
-	helper.context = g_main_context_new ();
-	helper.loop = g_main_loop_new (helper.context, FALSE);
+	helper.loop = pk_sync_loop_acquire ();
 	helper.error = error;
 
-	g_main_context_push_thread_default (helper.context);
-
 	/* run async method */
 	pk_task_install_packages_async (task, package_ids, cancellable, progress_callback, progress_user_data,
 					(GAsyncReadyCallback) pk_task_generic_finish_sync, &helper);
 
-	g_main_loop_run (helper.loop);
+	pk_sync_loop_run (helper.loop);
 
 	results = helper.results;
 
-	g_main_context_pop_thread_default (helper.context);
-
-	/* free temp object */
-	g_main_loop_unref (helper.loop);
-	g_main_context_unref (helper.context);
+	/* give back temp loop */
+	pk_sync_loop_release (helper.loop);
 
 	return results;
 }
@@ -195,25 +183,19 @@ pk_task_update_packages_sync (PkTask *task, gchar **package_ids, GCancellable *c
 
 	/* create temp object */
 	memset (&helper, 0, sizeof (PkTaskHelper));
-	helper.context = g_main_context_new ();
-	helper.loop = g_main_loop_new (helper.context, FALSE);
+	helper.loop = pk_sync_loop_acquire ();
 	helper.error = error;
 
-	g_main_context_push_thread_default (helper.context);
-
 	/* run async method */
 	pk_task_update_packages_async (task, package_ids, cancellable, progress_callback, progress_user_data,
 				       (GAsyncReadyCallback) pk_task_generic_finish_sync, &helper);
 
-	g_main_loop_run (helper.loop);
+	pk_sync_loop_run (helper.loop);
 
 	results = helper.results;
 
-	g_main_context_pop_thread_default (helper.context);
-
-	/* free temp object */
-	g_main_loop_unref (helper.loop);
-	g_main_context_unref (helper.context);
+	/* give back temp loop */
+	pk_sync_loop_release (helper.loop);
 
 	return results;
 }
@@ -249,25 +231,19 @@ pk_task_install_files_sync (PkTask *task, gchar **files, GCancellable *cancellab
 
 	/* create temp object */
 	memset (&helper, 0, sizeof (PkTaskHelper));
-	helper.context = g_main_context_new ();
-	helper.loop = g_main_loop_new (helper.context, FALSE);
+	helper.loop = pk_sync_loop_acquire ();
 	helper.error = error;
 
-	g_main_context_push_thread_default (helper.context);
-
 	/* run async method */
 	pk_task_install_files_async (task, files, cancellable, progress_callback, progress_user_data,
 				     (GAsyncReadyCallback) pk_task_generic_finish_sync, &helper);
 
-	g_main_loop_run (helper.loop);
+	pk_sync_loop_run (helper.loop);
 
 	results = helper.results;
 
-	g_main_context_pop_thread_default (helper.context);
-
-	/* free temp object */
-	g_main_loop_unref (helper.loop);
-	g_main_context_unref (helper.context);
+	/* give back temp loop */
+	pk_sync_loop_release (helper.loop);
 
 	return results;
 }
@@ -301,25 +277,19 @@ pk_task_resolve_sync (PkTask *task, PkBitfield filters, gchar **packages, GCance
 
 	/* create temp object */
 	memset (&helper, 0, sizeof (PkTaskHelper));
-	helper.context = g_main_context_new ();
-	helper.loop = g_main_loop_new (helper.context, FALSE);
+	helper.loop = pk_sync_loop_acquire ();
 	helper.error = error;
 
-	g_main_context_push_thread_default (helper.context);
-
 	/* run async method */
 	pk_task_resolve_async (task, filters, packages, cancellable, progress_callback, progress_user_data,
 			       (GAsyncReadyCallback) pk_task_generic_finish_sync, &helper);
 
-	g_main_loop_run (helper.loop);
+	pk_sync_loop_run (helper.loop);
 
 	results = helper.results;
 
-	g_main_context_pop_thread_default (helper.context);
-
-	/* free temp object */
-	g_main_loop_unref (helper.loop);
-	g_main_context_unref (helper.context);
+	/* give back temp loop */
+	pk_sync_loop_release (helper.loop);
 
 	return results;
 }
@@ -353,25 +323,19 @@ pk_task_search_names_sync (PkTask *task, PkBitfield filters, gchar **values, GCa
 
 	/* create temp object */
 	memset (&helper, 0, sizeof (PkTaskHelper));
-	helper.context = g_main_context_new ();
-	helper.loop = g_main_loop_new (helper.context, FALSE);
+	helper.loop = pk_sync_loop_acquire ();
 	helper.error = error;
 
-	g_main_context_push_thread_default (helper.context);
-
 	/* run async method */
 	pk_task_search_names_async (task, filters, values, cancellable, progress_callback, progress_user_data,
 				    (GAsyncReadyCallback) pk_task_generic_finish_sync, &helper);
 
-	g_main_loop_run (helper.loop);
+	pk_sync_loop_run (helper.loop);
 
 	results = helper.results;
 
-	g_main_context_pop_thread_default (helper.context);
-
-	/* free temp object */
-	g_main_loop_unref (helper.loop);
-	g_main_context_unref (helper.context);
+	/* give back temp loop */
+	pk_sync_loop_release (helper.loop);
 
 	return results;
 }
@@ -405,25 +369,19 @@ pk_task_search_details_sync (PkTask *task, PkBitfield filters, gchar **values, G
 
 	/* create temp object */
 	memset (&helper, 0, sizeof (PkTaskHelper));
-	helper.context = g_main_context_new ();
-	helper.loop = g_main_loop_new (helper.context, FALSE);
+	helper.loop = pk_sync_loop_acquire ();
 	helper.error = error;
 
-	g_main_context_push_thread_default (helper.context);
-
 	/* run async method */
 	pk_task_search_details_async (task, filters, values, cancellable, progress_callback, progress_user_data,
 				      (GAsyncReadyCallback) pk_task_generic_finish_sync, &helper);
 
-	g_main_loop_run (helper.loop);
+	pk_sync_loop_run (helper.loop);
 
 	results = helper.results;
 
-	g_main_context_pop_thread_default (helper.context);
-
-	/* free temp object */
-	g_main_loop_unref (helper.loop);
-	g_main_context_unref (helper.context);
+	/* give back temp loop */
+	pk_sync_loop_release (helper.loop);
 
 	return results;
 }
@@ -457,25 +415,19 @@ pk_task_search_groups_sync (PkTask *task, PkBitfield filters, gchar **values, GC
 
 	/* create temp object */
 	memset (&helper, 0, sizeof (PkTaskHelper));
-	helper.context = g_main_context_new ();
-	helper.loop = g_main_loop_new (helper.context, FALSE);
+	helper.loop = pk_sync_loop_acquire ();
 	helper.error = error;
 
-	g_main_context_push_thread_default (helper.context);
-
 	/* run async method */
 	pk_task_search_groups_async (task, filters, values, cancellable, progress_callback, progress_user_data,
 				     (GAsyncReadyCallback) pk_task_generic_finish_sync, &helper);
 
-	g_main_loop_run (helper.loop);
+	pk_sync_loop_run (helper.loop);
 
 	results = helper.results;
 
-	g_main_context_pop_thread_default (helper.context);
-
-	/* free temp object */
-	g_main_loop_unref (helper.loop);
-	g_main_context_unref (helper.context);
+	/* give back temp loop */
+	pk_sync_loop_release (helper.loop);
 
 	return results;
 }
@@ -509,25 +461,19 @@ pk_task_search_files_sync (PkTask *task, PkBitfield filters, gchar **values, GCa
 
 	/* create temp object */
 	memset (&helper, 0, sizeof (PkTaskHelper));
-	helper.context = g_main_context_new ();
-	helper.loop = g_main_loop_new (helper.context, FALSE);
+	helper.loop = pk_sync_loop_acquire ();
 	helper.error = error;
 
-	g_main_context_push_thread_default (helper.context);
-
 	/* run async method */
 	pk_task_search_files_async (task, filters, values, cancellable, progress_callback, progress_user_data,
 				    (GAsyncReadyCallback) pk_task_generic_finish_sync, &helper);
 
-	g_main_loop_run (helper.loop);
+	pk_sync_loop_run (helper.loop);
 
 	results = helper.results;
 
-	g_main_context_pop_thread_default (helper.context);
-
-	/* free temp object */
-	g_main_loop_unref (helper.loop);
-	g_main_context_unref (helper.context);
+	/* give back temp loop */
+	pk_sync_loop_release (helper.loop);
 
 	return results;
 }
@@ -560,25 +506,19 @@ pk_task_get_details_sync (PkTask *task, gchar **package_ids, GCancellable *cance
 
 	/* create temp object */
 	memset (&helper, 0, sizeof (PkTaskHelper));
-	helper.context = g_main_context_new ();
-	helper.loop = g_main_loop_new (helper.context, FALSE);
+	helper.loop = pk_sync_loop_acquire ();
 	helper.error = error;
 
-	g_main_context_push_thread_default (helper.context);
-
 	/* run async method */
 	pk_task_get_details_async (task, package_ids, cancellable, progress_callback, progress_user_data,
 				   (GAsyncReadyCallback) pk_task_generic_finish_sync, &helper);
 
-	g_main_loop_run (helper.loop);
+	pk_sync_loop_run (helper.loop);
 
 	results = helper.results;
 
-	g_main_context_pop_thread_default (helper.context);
-
-	/* free temp object */
-	g_main_loop_unref (helper.loop);
-	g_main_context_unref (helper.context);
+	/* give back temp loop */
+	pk_sync_loop_release (helper.loop);
 
 	return results;
 }
@@ -611,25 +551,19 @@ pk_task_get_update_detail_sync (PkTask *task, gchar **package_ids, GCancellable
 
 	/* create temp object */
 	memset (&helper, 0, sizeof (PkTaskHelper));
-	helper.context = g_main_context_new ();
-	helper.loop = g_main_loop_new (helper.context, FALSE);
+	helper.loop = pk_sync_loop_acquire ();
 	helper.error = error;
 
-	g_main_context_push_thread_default (helper.context);
-
 	/* run async method */
 	pk_task_get_update_detail_async (task, package_ids, cancellable, progress_callback, progress_user_data,
 				         (GAsyncReadyCallback) pk_task_generic_finish_sync, &helper);
 
-	g_main_loop_run (helper.loop);
+	pk_sync_loop_run (helper.loop);
 
 	results = helper.results;
 
-	g_main_context_pop_thread_default (helper.context);
-
-	/* free temp object */
-	g_main_loop_unref (helper.loop);
-	g_main_context_unref (helper.context);
+	/* give back temp loop */
+	pk_sync_loop_release (helper.loop);
 
 	return results;
 }
@@ -663,25 +597,19 @@ pk_task_download_packages_sync (PkTask *task, gchar **package_ids, const gchar *
 
 	/* create temp object */
 	memset (&helper, 0, sizeof (PkTaskHelper));
-	helper.context = g_main_context_new ();
-	helper.loop = g_main_loop_new (helper.context, FALSE);
+	helper.loop = pk_sync_loop_acquire ();
 	helper.error = error;
 
-	g_main_context_push_thread_default (helper.context);
-
 	/* run async method */
 	pk_task_download_packages_async (task, package_ids, directory, cancellable, progress_callback, progress_user_data,
 				         (GAsyncReadyCallback) pk_task_generic_finish_sync, &helper);
 
-	g_main_loop_run (helper.loop);
+	pk_sync_loop_run (helper.loop);
 
 	results = helper.results;
 
-	g_main_context_pop_thread_default (helper.context);
-
-	/* free temp object */
-	g_main_loop_unref (helper.loop);
-	g_main_context_unref (helper.context);
+	/* give back temp loop */
+	pk_sync_loop_release (helper.loop);
 
 	return results;
 }
@@ -714,25 +642,19 @@ pk_task_get_updates_sync (PkTask *task, PkBitfield filters, GCancellable *cancel
 
 	/* create temp object */
 	memset (&helper, 0, sizeof (PkTaskHelper));
-	helper.context = g_main_context_new ();
-	helper.loop = g_main_loop_new (helper.context, FALSE);
+	helper.loop = pk_sync_loop_acquire ();
 	helper.error = error;
 
-	g_main_context_push_thread_default (helper.context);
-
 	/* run async method */
 	pk_task_get_updates_async (task, filters, cancellable, progress_callback, progress_user_data,
 				     (GAsyncReadyCallback) pk_task_generic_finish_sync, &helper);
 
-	g_main_loop_run (helper.loop);
+	pk_sync_loop_run (helper.loop);
 
 	results = helper.results;
 
-	g_main_context_pop_thread_default (helper.context);
-
-	/* free temp object */
-	g_main_loop_unref (helper.loop);
-	g_main_context_unref (helper.context);
+	/* give back temp loop */
+	pk_sync_loop_release (helper.loop);
 
 	return results;
 }
@@ -767,25 +689,19 @@ pk_task_depends_on_sync (PkTask *task, PkBitfield filters, gchar **package_ids,
 
 	/* create temp object */
 	memset (&helper, 0, sizeof (PkTaskHelper));
-	helper.context = g_main_context_new ();
-	helper.loop = g_main_loop_new (helper.context, FALSE);
+	helper.loop = pk_sync_loop_acquire ();
 	helper.error = error;
 
-	g_main_context_push_thread_default (helper.context);
-
 	/* run async method */
 	pk_task_depends_on_async (task, filters, package_ids, recursive, cancellable, progress_callback, progress_user_data,
 				     (GAsyncReadyCallback) pk_task_generic_finish_sync, &helper);
 
-	g_main_loop_run (helper.loop);
+	pk_sync_loop_run (helper.loop);
 
 	results = helper.results;
 
-	g_main_context_pop_thread_default (helper.context);
-
-	/* free temp object */
-	g_main_loop_unref (helper.loop);
-	g_main_context_unref (helper.context);
+	/* give back temp loop */
+	pk_sync_loop_release (helper.loop);
 
 	return results;
 }
@@ -818,25 +734,19 @@ pk_task_get_packages_sync (PkTask *task, PkBitfield filters, GCancellable *cance
 
 	/* create temp object */
 	memset (&helper, 0, sizeof (PkTaskHelper));
-	helper.context = g_main_context_new ();
-	helper.loop = g_main_loop_new (helper.context, FALSE);
+	helper.loop = pk_sync_loop_acquire ();
 	helper.error = error;
 
-	g_main_context_push_thread_default (helper.context);
-
 	/* run async method */
 	pk_task_get_packages_async (task, filters, cancellable, progress_callback, progress_user_data,
 				    (GAsyncReadyCallback) pk_task_generic_finish_sync, &helper);
 
-	g_main_loop_run (helper.loop);
+	pk_sync_loop_run (helper.loop);
 
 	results = helper.results;
 
-	g_main_context_pop_thread_default (helper.context);
-
-	/* free temp object */
-	g_main_loop_unref (helper.loop);
-	g_main_context_unref (helper.context);
+	/* give back temp loop */
+	pk_sync_loop_release (helper.loop);
 
 	return results;
 }
@@ -871,25 +781,19 @@ pk_task_required_by_sync (PkTask *task, PkBitfield filters, gchar **package_ids,
 
 	/* create temp object */
 	memset (&helper, 0, sizeof (PkTaskHelper));
-	helper.context = g_main_context_new ();
-	helper.loop = g_main_loop_new (helper.context, FALSE);
+	helper.loop = pk_sync_loop_acquire ();
 	helper.error = error;
 
-	g_main_context_push_thread_default (helper.context);
-
 	/* run async method */
 	pk_task_required_by_async (task, filters, package_ids, recursive, cancellable, progress_callback, progress_user_data,
 				    (GAsyncReadyCallback) pk_task_generic_finish_sync, &helper);
 
-	g_main_loop_run (helper.loop);
+	pk_sync_loop_run (helper.loop);
 
 	results = helper.results;
 
-	g_main_context_pop_thread_default (helper.context);
-
-	/* free temp object */
-	g_main_loop_unref (helper.loop);
-	g_main_context_unref (helper.context);
+	/* give back temp loop */
+	pk_sync_loop_release (helper.loop);
 
 	return results;
 }
@@ -924,25 +828,19 @@ pk_task_what_provides_sync (PkTask *task, PkBitfield filters,
 
 	/* create temp object */
 	memset (&helper, 0, sizeof (PkTaskHelper));
-	helper.context = g_main_context_new ();
-	helper.loop = g_main_loop_new (helper.context, FALSE);
+	helper.loop = pk_sync_loop_acquire ();
 	helper.error = error;
 
-	g_main_context_push_thread_default (helper.context);
-
 	/* run async method */
 	pk_task_what_provides_async (task, filters, values, cancellable, progress_callback, progress_user_data,
 				     (GAsyncReadyCallback) pk_task_generic_finish_sync, &helper);
 
-	g_main_loop_run (helper.loop);
+	pk_sync_loop_run (helper.loop);
 
 	results = helper.results;
 
-	g_main_context_pop_thread_default (helper.context);
-
-	/* free temp object */
-	g_main_loop_unref (helper.loop);
-	g_main_context_unref (helper.context);
+	/* give back temp loop */
+	pk_sync_loop_release (helper.loop);
 
 	return results;
 }
@@ -975,25 +873,19 @@ pk_task_get_files_sync (PkTask *task, gchar **package_ids, GCancellable *cancell
 
 	/* create temp object */
 	memset (&helper, 0, sizeof (PkTaskHelper));
-	helper.context = g_main_context_new ();
-	helper.loop = g_main_loop_new (helper.context, FALSE);
+	helper.loop = pk_sync_loop_acquire ();
 	helper.error = error;
 
-	g_main_context_push_thread_default (helper.context);
-
 	/* run async method */
 	pk_task_get_files_async (task, package_ids, cancellable, progress_callback, progress_user_data,
 				 (GAsyncReadyCallback) pk_task_generic_finish_sync, &helper);
 
-	g_main_loop_run (helper.loop);
+	pk_sync_loop_run (helper.loop);
 
 	results = helper.results;
 
-	g_main_context_pop_thread_default (helper.context);
-
-	/* free temp object */
-	g_main_loop_unref (helper.loop);
-	g_main_context_unref (helper.context);
+	/* give back temp loop */
+	pk_sync_loop_release (helper.loop);
 
 	return results;
 }
@@ -1025,25 +917,19 @@ pk_task_get_categories_sync (PkTask *task, GCancellable *cancellable,
 
 	/* create temp object */
 	memset (&helper, 0, sizeof (PkTaskHelper));
-	helper.context = g_main_context_new ();
-	helper.loop = g_main_loop_new (helper.context, FALSE);
+	helper.loop = pk_sync_loop_acquire ();
 	helper.error = error;
 
-	g_main_context_push_thread_default (helper.context);
-
 	/* run async method */
 	pk_task_get_categories_async (task, cancellable, progress_callback, progress_user_data,
 				      (GAsyncReadyCallback) pk_task_generic_finish_sync, &helper);
 
-	g_main_loop_run (helper.loop);
+	pk_sync_loop_run (helper.loop);
 
 	results = helper.results;
 
-	g_main_context_pop_thread_default (helper.context);
-
-	/* free temp object */
-	g_main_loop_unref (helper.loop);
-	g_main_context_unref (helper.context);
+	/* give back temp loop */
+	pk_sync_loop_release (helper.loop);
 
 	return results;
 }
@@ -1076,25 +962,19 @@ pk_task_refresh_cache_sync (PkTask *task, gboolean force, GCancellable *cancella
 
 	/* create temp object */
 	memset (&helper, 0, sizeof (PkTaskHelper));
-	helper.context = g_main_context_new ();
-	helper.loop = g_main_loop_new (helper.context, FALSE);
+	helper.loop = pk_sync_loop_acquire ();
 	helper.error = error;
 
-	g_main_context_push_thread_default (helper.context);
-
 	/* run async method */
 	pk_task_refresh_cache_async (task, force, cancellable, progress_callback, progress_user_data,
 				     (GAsyncReadyCallback) pk_task_generic_finish_sync, &helper);
 
-	g_main_loop_run (helper.loop);
+	pk_sync_loop_run (helper.loop);
 
 	results = helper.results;
 
-	g_main_context_pop_thread_default (helper.context);
-
-	/* free temp object */
-	g_main_loop_unref (helper.loop);
-	g_main_context_unref (helper.context);
+	/* give back temp loop */
+	pk_sync_loop_release (helper.loop);
 
 	return results;
 }
@@ -1127,25 +1007,19 @@ pk_task_get_repo_list_sync (PkTask *task, PkBitfield filters, GCancellable *canc
 
 	/* create temp object */
 	memset (&helper, 0, sizeof (PkTaskHelper));
-	helper.context = g_main_context_new ();
-	helper.loop = g_main_loop_new (helper.context, FALSE);
+	helper.loop = pk_sync_loop_acquire ();
 	helper.error = error;
 
-	g_main_context_push_thread_default (helper.context);
-
 	/* run async method */
 	pk_task_get_repo_list_async (task, filters, cancellable, progress_callback, progress_user_data,
 				     (GAsyncReadyCallback) pk_task_generic_finish_sync, &helper);
 
-	g_main_loop_run (helper.loop);
+	pk_sync_loop_run (helper.loop);
 
 	results = helper.results;
 
-	g_main_context_pop_thread_default (helper.context);
-
-	/* free temp object */
-	g_main_loop_unref (helper.loop);
-	g_main_context_unref (helper.context);
+	/* give back temp loop */
+	pk_sync_loop_release (helper.loop);
 
 	return results;
 }
@@ -1179,25 +1053,19 @@ pk_task_repo_enable_sync (PkTask *task, const gchar *repo_id, gboolean enabled,
 
 	/* create temp object */
 	memset (&helper, 0, sizeof (PkTaskHelper));
-	helper.context = g_main_context_new ();
-	helper.loop = g_main_loop_new (helper.context, FALSE);
+	helper.loop = pk_sync_loop_acquire ();
 	helper.error = error;
 
-	g_main_context_push_thread_default (helper.context);
-
 	/* run async method */
 	pk_task_repo_enable_async (task, repo_id, enabled, cancellable, progress_callback, progress_user_data,
 				   (GAsyncReadyCallback) pk_task_generic_finish_sync, &helper);
 
-	g_main_loop_run (helper.loop);
+	pk_sync_loop_run (helper.loop);
 
 	results = helper.results;
 
-	g_main_context_pop_thread_default (helper.context);
-
-	/* free temp object */
-	g_main_loop_unref (helper.loop);
-	g_main_context_unref (helper.context);
+	/* give back temp loop */
+	pk_sync_loop_release (helper.loop);
 
 	return results;
 }
@@ -1233,26 +1101,20 @@ pk_task_repair_system_sync (PkTask *task, GCancellable *cancellable,
 
 	/* create temp object */
 	memset (&helper, 0, sizeof (PkTaskHelper));
-	helper.context = g_main_context_new ();
-	helper.loop = g_main_loop_new (helper.context, FALSE);
+	helper.loop = pk_sync_loop_acquire ();
 	helper.error = error;
 
-	g_main_context_push_thread_default (helper.context);
-
 	/* run async method */
 	pk_task_repair_system_async (task, cancellable, progress_callback, progress_user_data,
 				     (GAsyncReadyCallback) pk_task_generic_finish_sync,
 				     &helper);
 
-	g_main_loop_run (helper.loop);
+	pk_sync_loop_run (helper.loop);
 
 	results = helper.results;
 
-	g_main_context_pop_thread_default (helper.context);
-
-	/* free temp object */
-	g_main_loop_unref (helper.loop);
-	g_main_context_unref (helper.context);
+	/* give back temp loop */
+	pk_sync_loop_release (helper.loop);
 
 	return results;
 }
@@ -22,9 +22,14 @@
 #include "config.h"
 
 #include <glib-object.h>
+#include <glib/gstdio.h>
+#include <string.h>
+#include <unistd.h>
 
 #include "src/pk-cleanup.h"
 
+#include "pk-client-cache-private.h"
+#include "pk-client-private.h"
 #include "pk-common.h"
 #include "pk-debug.h"
 #include "pk-enum.h"
@@ -33,8 +38,12 @@
 #include "pk-package.h"
 #include "pk-package-id.h"
 #include "pk-package-ids.h"
+#include "pk-package-sack.h"
+#include "pk-package-sack-private.h"
 #include "pk-progress-bar.h"
+#include "pk-progress-private.h"
 #include "pk-results.h"
+#include "pk-sync-loop-private.h"
 
 static void
 pk_test_bitfield_func (void)
@@ -216,6 +225,17 @@ pk_test_enum_func (void)
 	string = pk_role_enum_to_string (PK_ROLE_ENUM_SEARCH_FILE);
 	g_assert_cmpstr (string, ==, "search-file");
 
+	/* find unknown and NULL values */
+	g_assert_cmpint (pk_role_enum_from_string ("dave"), ==, PK_ROLE_ENUM_UNKNOWN);
+	g_assert_cmpint (pk_role_enum_from_string (NULL), ==, PK_ROLE_ENUM_UNKNOWN);
+	g_assert_cmpint (pk_info_enum_from_string ("installed"), ==, PK_INFO_ENUM_INSTALLED);
+
+	/* check every role string converts back to the same value */
+	for (i = 1; i < PK_ROLE_ENUM_LAST; i++) {
+		string = pk_role_enum_to_string (i);
+		g_assert_cmpint (pk_role_enum_from_string (string), ==, i);
+	}
+
 	/* check we convert all the role bitfield */
 	for (i = 1; i < PK_ROLE_ENUM_LAST; i++) {
 		string = pk_role_enum_to_string (i);
@@ -406,6 +426,99 @@ pk_test_package_id_func (void)
 	g_assert (sections == NULL);
 }
 
+static void
+pk_test_package_id_view_func (void)
+{
+	PkPackageIdView view;
+	PkPackageIdView view2;
+	const gchar *field;
+	gboolean ret;
+	gchar *text;
+	gchar **sections;
+	gdouble elapsed;
+	guint i;
+	guint len;
+	guint loops = 1000000;
+
+	/* not valid */
+	g_assert (!pk_package_id_view_init (&view, NULL));
+	g_assert (!pk_package_id_view_init (&view, ";0.0.1;i386;fedora"));
+	g_assert (!pk_package_id_view_init (&view, "moo;0.0.1;i386"));
+	g_assert (!pk_package_id_view_init (&view, "moo;0.0.1;i386;fedora;"));
+
+	/* valid */
+	ret = pk_package_id_view_init (&view, "kde-i18n-csb;4:3.5.8~pre20071001-0ubuntu1;all;");
+	g_assert (ret);
+	field = pk_package_id_view_get_field (&view, PK_PACKAGE_ID_NAME, &len);
+	g_assert (strncmp (field, "kde-i18n-csb", len) == 0);
+	g_assert_cmpint (len, ==, 12);
+	field = pk_package_id_view_get_field (&view, PK_PACKAGE_ID_ARCH, &len);
+	g_assert (strncmp (field, "all", len) == 0);
+	g_assert_cmpint (len, ==, 3);
+	pk_package_id_view_get_field (&view, PK_PACKAGE_ID_DATA, &len);
+	g_assert_cmpint (len, ==, 0);
+
+	/* compare a section with a string */
+	g_assert (pk_package_id_view_field_equal (&view, PK_PACKAGE_ID_ARCH, "all"));
+	g_assert (!pk_package_id_view_field_equal (&view, PK_PACKAGE_ID_ARCH, "al"));
+	g_assert (!pk_package_id_view_field_equal (&view, PK_PACKAGE_ID_ARCH, "allx"));
+	g_assert (pk_package_id_view_field_equal (&view, PK_PACKAGE_ID_DATA, ""));
+	g_assert (!pk_package_id_view_field_equal (&view, PK_PACKAGE_ID_DATA, NULL));
+
+	/* copy a section */
+	text = pk_package_id_view_dup_field (&view, PK_PACKAGE_ID_VERSION);
+	g_assert_cmpstr (text, ==, "4:3.5.8~pre20071001-0ubuntu1");
+	g_free (text);
+
+	/* compare sections of two ids */
+	pk_package_id_view_init (&view, "moo;0.0.1;i386;fedora");
+	pk_package_id_view_init (&view2, "moo2;0.0.1;i686;fedora");
+	g_assert_cmpint (pk_package_id_view_compare_field (&view, &view2, PK_PACKAGE_ID_NAME), <, 0);
+	g_assert_cmpint (pk_package_id_view_compare_field (&view2, &view, PK_PACKAGE_ID_NAME), >, 0);
+	g_assert_cmpint (pk_package_id_view_compare_field (&view, &view2, PK_PACKAGE_ID_VERSION), ==, 0);
+	g_assert_cmpint (pk_package_id_view_compare_field (&view, &view2, PK_PACKAGE_ID_DATA), ==, 0);
+	g_assert (pk_package_id_equal_fuzzy_arch ("moo;0.0.1;i386;fedora", "moo;0.0.1;i686;fedora"));
+	g_assert (!pk_package_id_equal_fuzzy_arch ("moo;0.0.1;i386;fedora", "moo;0.0.1;x86_64;fedora"));
+	g_assert (!pk_package_id_equal_fuzzy_arch ("moo;0.0.1;i386", "moo;0.0.1;i386"));
+
+	/* the old way of checking an id */
+	if (g_test_perf ()) {
+		g_test_timer_start ();
+		for (i = 0; i < loops; i++) {
+			sections = g_strsplit ("kde-i18n-csb;4:3.5.8~pre20071001-0ubuntu1;all;fedora", ";", -1);
+			g_assert_cmpint (g_strv_length (sections), ==, 4);
+			g_strfreev (sections);
+		}
+		elapsed = g_test_timer_elapsed ();
+		g_test_message ("split %u ids in %.3fs, %.0f ids/s",
+				loops, elapsed, loops / elapsed);
+	}
+
+	/* the view does not allocate at all */
+	if (g_test_perf ()) {
+		g_test_timer_start ();
+		for (i = 0; i < loops; i++) {
+			ret = pk_package_id_view_init (&view, "kde-i18n-csb;4:3.5.8~pre20071001-0ubuntu1;all;fedora");
+			g_assert (ret);
+		}
+		elapsed = g_test_timer_elapsed ();
+		g_test_message ("viewed %u ids in %.3fs, %.0f ids/s",
+				loops, elapsed, loops / elapsed);
+	}
+
+	/* and checking is just UTF-8 validation on top */
+	if (g_test_perf ()) {
+		g_test_timer_start ();
+		for (i = 0; i < loops; i++) {
+			ret = pk_package_id_check ("kde-i18n-csb;4:3.5.8~pre20071001-0ubuntu1;all;fedora");
+			g_assert (ret);
+		}
+		elapsed = g_test_timer_elapsed ();
+		g_test_message ("checked %u ids in %.3fs, %.0f ids/s",
+				loops, elapsed, loops / elapsed);
+	}
+}
+
 static void
 pk_test_package_ids_func (void)
 {
@@ -442,6 +555,90 @@ pk_test_progress_func (void)
 	g_object_unref (progress);
 }
 
+typedef struct {
+	guint		 calls[PK_PROGRESS_TYPE_INVALID];
+	gint		 percentage;
+} PkTestProgressHelper;
+
+static void
+pk_test_progress_coalesce_cb (PkProgress *progress, PkProgressType type, gpointer user_data)
+{
+	PkTestProgressHelper *helper = (PkTestProgressHelper *) user_data;
+	helper->calls[type]++;
+	if (type == PK_PROGRESS_TYPE_PERCENTAGE)
+		g_object_get (progress, "percentage", &helper->percentage, NULL);
+}
+
+static void
+pk_test_progress_coalesce_func (void)
+{
+	gint i;
+	gint64 end;
+	PkTestProgressHelper helper;
+	_cleanup_object_unref_ PkProgress *progress = NULL;
+
+	/* no policy, every change is sent */
+	memset (&helper, 0, sizeof (helper));
+	progress = pk_progress_new ();
+	for (i = 0; i < 100; i++) {
+		pk_progress_set_percentage (progress, i);
+		pk_progress_dispatch (progress, PK_PROGRESS_TYPE_PERCENTAGE,
+				      pk_test_progress_coalesce_cb, &helper);
+	}
+	g_assert_cmpint (helper.calls[PK_PROGRESS_TYPE_PERCENTAGE], ==, 100);
+
+	/* one shared interval, so only the first change of any type is sent */
+	memset (&helper, 0, sizeof (helper));
+	pk_progress_set_coalesce_policy (progress, 50, FALSE);
+	for (i = 0; i < 99; i++) {
+		pk_progress_set_percentage (progress, i);
+		pk_progress_dispatch (progress, PK_PROGRESS_TYPE_PERCENTAGE,
+				      pk_test_progress_coalesce_cb, &helper);
+		pk_progress_set_speed (progress, i + 1);
+		pk_progress_dispatch (progress, PK_PROGRESS_TYPE_SPEED,
+				      pk_test_progress_coalesce_cb, &helper);
+	}
+	g_assert_cmpint (helper.calls[PK_PROGRESS_TYPE_PERCENTAGE], ==, 1);
+	g_assert_cmpint (helper.calls[PK_PROGRESS_TYPE_SPEED], ==, 0);
+
+	/* the latest values arrive once the interval has elapsed */
+	end = g_get_monotonic_time () + 200 * G_TIME_SPAN_MILLISECOND;
+	while (helper.calls[PK_PROGRESS_TYPE_SPEED] == 0 &&
+	       g_get_monotonic_time () < end)
+		g_main_context_iteration (NULL, TRUE);
+	g_assert_cmpint (helper.calls[PK_PROGRESS_TYPE_PERCENTAGE], ==, 2);
+	g_assert_cmpint (helper.calls[PK_PROGRESS_TYPE_SPEED], ==, 1);
+	g_assert_cmpint (helper.percentage, ==, 98);
+
+	/* final states are never held back */
+	pk_progress_set_percentage (progress, 100);
+	pk_progress_dispatch (progress, PK_PROGRESS_TYPE_PERCENTAGE,
+			      pk_test_progress_coalesce_cb, &helper);
+	g_assert_cmpint (helper.calls[PK_PROGRESS_TYPE_PERCENTAGE], ==, 3);
+	g_assert_cmpint (helper.percentage, ==, 100);
+	pk_progress_set_status (progress, PK_STATUS_ENUM_FINISHED);
+	pk_progress_dispatch (progress, PK_PROGRESS_TYPE_STATUS,
+			      pk_test_progress_coalesce_cb, &helper);
+	g_assert_cmpint (helper.calls[PK_PROGRESS_TYPE_STATUS], ==, 1);
+
+	/* each type has its own interval, and flushing sends what is left */
+	memset (&helper, 0, sizeof (helper));
+	pk_progress_set_coalesce_policy (progress, 1000, TRUE);
+	pk_progress_set_elapsed_time (progress, 1);
+	pk_progress_dispatch (progress, PK_PROGRESS_TYPE_ELAPSED_TIME,
+			      pk_test_progress_coalesce_cb, &helper);
+	pk_progress_set_remaining_time (progress, 1);
+	pk_progress_dispatch (progress, PK_PROGRESS_TYPE_REMAINING_TIME,
+			      pk_test_progress_coalesce_cb, &helper);
+	pk_progress_set_elapsed_time (progress, 2);
+	pk_progress_dispatch (progress, PK_PROGRESS_TYPE_ELAPSED_TIME,
+			      pk_test_progress_coalesce_cb, &helper);
+	g_assert_cmpint (helper.calls[PK_PROGRESS_TYPE_ELAPSED_TIME], ==, 1);
+	g_assert_cmpint (helper.calls[PK_PROGRESS_TYPE_REMAINING_TIME], ==, 1);
+	pk_progress_dispatch_flush (progress);
+	g_assert_cmpint (helper.calls[PK_PROGRESS_TYPE_ELAPSED_TIME], ==, 2);
+}
+
 static void
 pk_test_progress_bar (void)
 {
@@ -537,6 +734,353 @@ pk_test_results_func (void)
 	g_object_unref (results);
 }
 
+static void
+pk_test_client_item_cb (PkClient *client, PkSource *item, gpointer user_data)
+{
+	guint *n_items = (guint *) user_data;
+	g_assert (PK_IS_PACKAGE (item));
+	(*n_items)++;
+}
+
+static void
+pk_test_client_replay_func (void)
+{
+	GVariantBuilder builder;
+	GVariantBuilder packages;
+	PkPackage *item;
+	PkRoleEnum role;
+	const guint n_packages = 100000;
+	gdouble elapsed;
+	guint i;
+	guint n_items = 0;
+	_cleanup_free_ gchar *tid = NULL;
+	_cleanup_object_unref_ PkClient *client = NULL;
+	_cleanup_object_unref_ PkResults *results = NULL;
+	_cleanup_ptrarray_unref_ GPtrArray *array = NULL;
+	_cleanup_variant_unref_ GVariant *signals = NULL;
+
+	/* replay without a client */
+	signals = g_variant_ref_sink (g_variant_new_array (G_VARIANT_TYPE ("(sv)"), NULL, 0));
+	results = pk_client_replay_signals (NULL,
+					    PK_ROLE_ENUM_GET_PACKAGES,
+					    "/42_dafeca",
+					    signals);
+	g_assert (PK_IS_RESULTS (results));
+	array = pk_results_get_package_array (results);
+	g_assert_cmpint (array->len, ==, 0);
+	g_ptr_array_unref (array);
+	g_object_unref (results);
+	g_variant_unref (signals);
+
+	/* record a GetPackages stream as the daemon batches it */
+	g_variant_builder_init (&builder, G_VARIANT_TYPE ("a(sv)"));
+	g_variant_builder_init (&packages, G_VARIANT_TYPE ("a(uss)"));
+	for (i = 0; i < n_packages; i++) {
+		_cleanup_free_ gchar *package_id = NULL;
+		package_id = g_strdup_printf ("package%05u;0.%u;x86_64;fedora", i, i % 10);
+		g_variant_builder_add (&packages, "(uss)",
+				       PK_INFO_ENUM_AVAILABLE,
+				       package_id,
+				       "Test package");
+		if (i % 500 == 499) {
+			g_variant_builder_add (&builder, "(sv)", "Packages",
+					       g_variant_new ("(a(uss))", &packages));
+			g_variant_builder_init (&packages, G_VARIANT_TYPE ("a(uss)"));
+		}
+	}
+	g_variant_builder_clear (&packages);
+	g_variant_builder_add (&builder, "(sv)", "Package",
+			       g_variant_new ("(uss)",
+					      PK_INFO_ENUM_INSTALLED,
+					      "powertop;0.1.3;i386;installed",
+					      "Power consumption monitor"));
+	g_variant_builder_add (&builder, "(sv)", "Finished",
+			       g_variant_new ("(uu)", PK_EXIT_ENUM_SUCCESS, 0));
+	signals = g_variant_ref_sink (g_variant_builder_end (&builder));
+
+	/* decode it */
+	g_test_timer_start ();
+	results = pk_client_replay_signals (NULL,
+					    PK_ROLE_ENUM_GET_PACKAGES,
+					    "/42_dafeca",
+					    signals);
+	elapsed = g_test_timer_elapsed ();
+	if (g_test_perf ()) {
+		g_test_message ("decoded %u packages in %.3fs, %.0f packages/s",
+				n_packages, elapsed, n_packages / elapsed);
+	}
+
+	/* check the packages have all the data */
+	array = pk_results_get_package_array (results);
+	g_assert_cmpint (array->len, ==, n_packages + 1);
+	item = g_ptr_array_index (array, n_packages);
+	g_assert_cmpstr (pk_package_get_id (item), ==, "powertop;0.1.3;i386;installed");
+	g_assert_cmpstr (pk_package_get_summary (item), ==, "Power consumption monitor");
+	g_assert_cmpint (pk_package_get_info (item), ==, PK_INFO_ENUM_INSTALLED);
+	item = g_ptr_array_index (array, 0);
+	g_assert_cmpstr (pk_package_get_id (item), ==, "package00000;0.0;x86_64;fedora");
+	g_object_get (item,
+		      "role", &role,
+		      "transaction-id", &tid,
+		      NULL);
+	g_assert_cmpint (role, ==, PK_ROLE_ENUM_GET_PACKAGES);
+	g_assert_cmpstr (tid, ==, "/42_dafeca");
+
+	/* stream the same packages without keeping them */
+	client = pk_client_new ();
+	pk_client_set_item_callback (client, pk_test_client_item_cb, &n_items, NULL);
+	g_object_unref (results);
+	results = pk_client_replay_signals (client,
+					    PK_ROLE_ENUM_GET_PACKAGES,
+					    "/42_dafeca",
+					    signals);
+	g_assert_cmpint (n_items, ==, n_packages + 1);
+	g_ptr_array_unref (array);
+	array = pk_results_get_package_array (results);
+	g_assert_cmpint (array->len, ==, 0);
+}
+
+typedef struct {
+	PkSyncLoop	*loop;
+	gboolean	 ret;
+} PkTestSyncHelper;
+
+static void
+pk_test_sync_loop_finish_cb (GObject *object, GAsyncResult *res, gpointer user_data)
+{
+	PkTestSyncHelper *helper = (PkTestSyncHelper *) user_data;
+	helper->ret = g_simple_async_result_get_op_res_gboolean (G_SIMPLE_ASYNC_RESULT (res));
+	pk_sync_loop_quit (helper->loop);
+}
+
+/* the same round trip a sync method does, without the daemon */
+static gboolean
+pk_test_sync_loop_call (void)
+{
+	PkTestSyncHelper helper;
+	_cleanup_object_unref_ GSimpleAsyncResult *res = NULL;
+
+	helper.loop = pk_sync_loop_acquire ();
+	helper.ret = FALSE;
+	res = g_simple_async_result_new (NULL, pk_test_sync_loop_finish_cb,
+					 &helper, pk_test_sync_loop_call);
+	g_simple_async_result_set_op_res_gboolean (res, TRUE);
+	g_simple_async_result_complete_in_idle (res);
+	pk_sync_loop_run (helper.loop);
+	pk_sync_loop_release (helper.loop);
+	return helper.ret;
+}
+
+static gpointer
+pk_test_sync_loop_thread_cb (gpointer user_data)
+{
+	guint i;
+	for (i = 0; i < 1000; i++) {
+		if (!pk_test_sync_loop_call ())
+			return GUINT_TO_POINTER (FALSE);
+	}
+	return GUINT_TO_POINTER (pk_sync_loop_get_pool_size () == 1);
+}
+
+static void
+pk_test_sync_loop_func (void)
+{
+	GThread *threads[8];
+	PkSyncLoop *loop1;
+	PkSyncLoop *loop2;
+	const guint n_calls = 10000;
+	gdouble elapsed;
+	guint i;
+
+	/* the loop is kept for the next call */
+	g_assert (pk_test_sync_loop_call ());
+	g_assert_cmpint (pk_sync_loop_get_pool_size (), ==, 1);
+
+	/* a nested sync call gets its own loop */
+	loop1 = pk_sync_loop_acquire ();
+	loop2 = pk_sync_loop_acquire ();
+	g_assert (loop1 != loop2);
+	g_assert_cmpint (pk_sync_loop_get_pool_size (), ==, 0);
+	pk_sync_loop_release (loop2);
+	pk_sync_loop_release (loop1);
+	g_assert_cmpint (pk_sync_loop_get_pool_size (), ==, 2);
+
+	/* latency of the sync dispatch that wraps every Resolve */
+	g_test_timer_start ();
+	for (i = 0; i < n_calls; i++)
+		g_assert (pk_test_sync_loop_call ());
+	elapsed = g_test_timer_elapsed ();
+	if (g_test_perf ()) {
+		g_test_message ("%u sync calls in %.3fs, %.2fus per call",
+				n_calls, elapsed, elapsed * G_USEC_PER_SEC / n_calls);
+	}
+
+	/* sync calls from many threads at once */
+	for (i = 0; i < G_N_ELEMENTS (threads); i++)
+		threads[i] = g_thread_new ("pk-self-test", pk_test_sync_loop_thread_cb, NULL);
+	for (i = 0; i < G_N_ELEMENTS (threads); i++)
+		g_assert (GPOINTER_TO_UINT (g_thread_join (threads[i])));
+}
+
+static gint _client_idle_notify = 0;
+
+static void
+pk_test_client_idle_notify_cb (PkClient *client, GParamSpec *pspec, gpointer user_data)
+{
+	g_atomic_int_inc (&_client_idle_notify);
+}
+
+static gpointer
+pk_test_client_idle_thread_cb (gpointer user_data)
+{
+	PkClient *client = PK_CLIENT (user_data);
+	guint i;
+	gint call;
+
+	/* any address will do as a call */
+	for (i = 0; i < 1000; i++) {
+		pk_client_add_call (client, &call);
+		pk_client_remove_call (client, &call);
+	}
+	return NULL;
+}
+
+static void
+pk_test_client_idle_func (void)
+{
+	GThread *threads[8];
+	guint i;
+	gint call1;
+	gint call2;
+	_cleanup_object_unref_ PkClient *client = NULL;
+
+	client = pk_client_new ();
+	g_signal_connect (client, "notify::idle",
+			  G_CALLBACK (pk_test_client_idle_notify_cb), NULL);
+	g_assert (pk_client_get_idle (client));
+
+	/* only the first and the last call change the idle state */
+	pk_client_add_call (client, &call1);
+	g_assert (!pk_client_get_idle (client));
+	g_assert_cmpint (_client_idle_notify, ==, 1);
+	pk_client_add_call (client, &call2);
+	pk_client_remove_call (client, &call1);
+	g_assert (!pk_client_get_idle (client));
+	g_assert_cmpint (_client_idle_notify, ==, 1);
+	pk_client_remove_call (client, &call2);
+	g_assert (pk_client_get_idle (client));
+	g_assert_cmpint (_client_idle_notify, ==, 2);
+
+	/* one client shared by many threads: every time it stopped being
+	 * idle it became idle again, and was notified exactly once each */
+	_client_idle_notify = 0;
+	for (i = 0; i < G_N_ELEMENTS (threads); i++)
+		threads[i] = g_thread_new ("pk-self-test", pk_test_client_idle_thread_cb, client);
+	for (i = 0; i < G_N_ELEMENTS (threads); i++)
+		g_thread_join (threads[i]);
+	g_assert (pk_client_get_idle (client));
+	g_assert_cmpint (_client_idle_notify, >=, 2);
+	g_assert_cmpint (_client_idle_notify % 2, ==, 0);
+}
+
+static void
+pk_test_client_cache_func (void)
+{
+	GVariantBuilder builder;
+	gboolean ret;
+	guint i;
+	const gchar *filename = "/tmp/PackageKit-self-test/client-cache/metadata.cache";
+	_cleanup_error_free_ GError *error = NULL;
+	_cleanup_free_ gchar *key = NULL;
+	_cleanup_free_ gchar *key_other = NULL;
+	_cleanup_object_unref_ PkResults *results = NULL;
+	_cleanup_ptrarray_unref_ GPtrArray *array = NULL;
+	_cleanup_strv_free_ gchar **names = NULL;
+	_cleanup_variant_unref_ GVariant *cached = NULL;
+	_cleanup_variant_unref_ GVariant *signals = NULL;
+
+	g_unlink (filename);
+	g_assert (pk_client_cache_role_is_cacheable (PK_ROLE_ENUM_RESOLVE));
+	g_assert (!pk_client_cache_role_is_cacheable (PK_ROLE_ENUM_GET_UPDATES));
+
+	/* the key includes the role, filters, locale and values */
+	names = g_strsplit ("powertop", ";", -1);
+	key = pk_client_cache_get_key (PK_ROLE_ENUM_RESOLVE, 0, "C", names);
+	key_other = pk_client_cache_get_key (PK_ROLE_ENUM_RESOLVE, 0, "en_GB", names);
+	g_assert_cmpstr (key, !=, key_other);
+	g_assert (pk_client_cache_lookup (filename, 1, key) == NULL);
+
+	/* save a query */
+	g_variant_builder_init (&builder, G_VARIANT_TYPE ("a(sv)"));
+	g_variant_builder_add (&builder, "(sv)", "Package",
+			       g_variant_new ("(uss)",
+					      PK_INFO_ENUM_INSTALLED,
+					      "powertop;0.1.3;i386;installed",
+					      "Power consumption monitor"));
+	signals = g_variant_ref_sink (g_variant_builder_end (&builder));
+	ret = pk_client_cache_add (filename, 1, key, signals, &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+
+	/* it can be decoded like a live transaction */
+	cached = pk_client_cache_lookup (filename, 1, key);
+	g_assert (cached != NULL);
+	g_assert (g_variant_equal (cached, signals));
+	results = pk_client_replay_signals (NULL, PK_ROLE_ENUM_RESOLVE, "/42_dafeca", cached);
+	array = pk_results_get_package_array (results);
+	g_assert_cmpint (array->len, ==, 1);
+	g_assert (pk_client_cache_lookup (filename, 1, key_other) == NULL);
+
+	/* the daemon changed the package database */
+	g_assert (pk_client_cache_lookup (filename, 2, key) == NULL);
+	ret = pk_client_cache_add (filename, 2, key_other, signals, &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+	g_assert (pk_client_cache_lookup (filename, 2, key) == NULL);
+	g_variant_unref (pk_client_cache_lookup (filename, 2, key_other));
+
+	/* the oldest entries are dropped */
+	for (i = 0; i < 200; i++) {
+		_cleanup_free_ gchar *key_tmp = NULL;
+		key_tmp = g_strdup_printf ("key%u", i);
+		ret = pk_client_cache_add (filename, 2, key_tmp, signals, &error);
+		g_assert_no_error (error);
+		g_assert (ret);
+	}
+	g_assert (pk_client_cache_lookup (filename, 2, key_other) == NULL);
+	g_variant_unref (pk_client_cache_lookup (filename, 2, "key199"));
+
+	/* entries with signals that are never recorded are ignored */
+	g_variant_unref (signals);
+	g_variant_builder_init (&builder, G_VARIANT_TYPE ("a(sv)"));
+	g_variant_builder_add (&builder, "(sv)", "Finished",
+			       g_variant_new ("(uu)", PK_EXIT_ENUM_SUCCESS, 0));
+	signals = g_variant_ref_sink (g_variant_builder_end (&builder));
+	ret = pk_client_cache_add (filename, 2, key, signals, &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+	g_assert (pk_client_cache_lookup (filename, 2, key) == NULL);
+
+	/* and so are signals of the wrong type */
+	g_variant_unref (signals);
+	g_variant_builder_init (&builder, G_VARIANT_TYPE ("a(sv)"));
+	g_variant_builder_add (&builder, "(sv)", "Package",
+			       g_variant_new ("(us)", PK_INFO_ENUM_INSTALLED,
+					      "powertop;0.1.3;i386;installed"));
+	signals = g_variant_ref_sink (g_variant_builder_end (&builder));
+	ret = pk_client_cache_add (filename, 2, key, signals, &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+	g_assert (pk_client_cache_lookup (filename, 2, key) == NULL);
+
+	/* garbage is ignored */
+	ret = g_file_set_contents (filename, "hello", -1, &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+	g_assert (pk_client_cache_lookup (filename, 2, key) == NULL);
+	g_unlink (filename);
+}
+
 static void
 pk_test_package_func (void)
 {
@@ -597,7 +1141,418 @@ pk_test_package_func (void)
 	g_assert_cmpstr (text, ==, "gnome-power-manager;0.1.2;i386;fedora");
 	g_free (text);
 
+	/* get the split parts */
+	g_assert_cmpstr (pk_package_get_name (package), ==, "gnome-power-manager");
+	g_assert_cmpstr (pk_package_get_version (package), ==, "0.1.2");
+	g_assert_cmpstr (pk_package_get_arch (package), ==, "i386");
+	g_assert_cmpstr (pk_package_get_data (package), ==, "fedora");
+
+	/* update details are unset until used */
+	g_object_get (package, "update-text", &text, NULL);
+	g_assert_cmpstr (text, ==, NULL);
+	g_object_set (package, "update-text", "Fixes crash", NULL);
+	g_object_get (package, "update-text", &text, NULL);
+	g_assert_cmpstr (text, ==, "Fixes crash");
+	g_free (text);
+
+	g_object_unref (package);
+}
+
+static gboolean
+pk_test_package_sack_filter_cb (PkPackage *package, gpointer user_data)
+{
+	return g_strcmp0 (pk_package_get_arch (package), "i386") != 0;
+}
+
+static void
+pk_test_package_sack_func (void)
+{
+	gboolean ret;
+	guint i;
+	PkPackage *package;
+	GError *error = NULL;
+	_cleanup_object_unref_ PkPackageSack *sack = NULL;
+	_cleanup_object_unref_ PkPackageSack *filtered = NULL;
+	_cleanup_ptrarray_unref_ GPtrArray *array = NULL;
+	_cleanup_ptrarray_unref_ GPtrArray *installed = NULL;
+	const gchar *ids[] = { "kernel;3.16;x86_64;installed",
+			       "kernel;3.17;x86_64;installed",
+			       "kernel;3.18;x86_64;fedora",
+			       "glibc;2.20;i386;installed",
+			       "glibc;2.20;x86_64;installed",
+			       NULL };
+
+	sack = pk_package_sack_new ();
+	for (i = 0; ids[i] != NULL; i++) {
+		ret = pk_package_sack_add_package_by_id (sack, ids[i], &error);
+		g_assert_no_error (error);
+		g_assert (ret);
+	}
+	g_assert_cmpint (pk_package_sack_get_size (sack), ==, 5);
+
+	/* all versions by name */
+	array = pk_package_sack_find_by_name (sack, "kernel");
+	g_assert_cmpint (array->len, ==, 3);
+	for (i = 0; i < array->len; i++) {
+		package = g_ptr_array_index (array, i);
+		if (g_strcmp0 (pk_package_get_data (package), "installed") == 0)
+			pk_package_set_info (package, PK_INFO_ENUM_INSTALLED);
+	}
+	g_ptr_array_unref (array);
+	array = pk_package_sack_find_by_name (sack, "dave");
+	g_assert_cmpint (array->len, ==, 0);
+	g_ptr_array_unref (array);
+
+	/* the info index follows changes made on the package itself */
+	installed = pk_package_sack_find_by_info (sack, PK_INFO_ENUM_INSTALLED);
+	g_assert_cmpint (installed->len, ==, 2);
+	package = g_ptr_array_index (installed, 0);
+	g_assert_cmpstr (pk_package_get_version (package), ==, "3.16");
+	filtered = pk_package_sack_filter_by_info (sack, PK_INFO_ENUM_UNKNOWN);
+	g_assert_cmpint (pk_package_sack_get_size (filtered), ==, 3);
+
+	/* by name and arch */
+	array = pk_package_sack_find_by_name_arch (sack, "glibc", "i386");
+	g_assert_cmpint (array->len, ==, 1);
+	g_ptr_array_unref (array);
+	package = pk_package_sack_find_by_id_name_arch (sack, "kernel;0.1;x86_64;fedora");
+	g_assert (package != NULL);
+	g_assert_cmpstr (pk_package_get_version (package), ==, "3.16");
+	g_object_unref (package);
+
+	/* remove keeps every index consistent */
+	ret = pk_package_sack_remove_package_by_id (sack, "kernel;3.16;x86_64;installed");
+	g_assert (ret);
+	ret = pk_package_sack_remove_package_by_id (sack, "kernel;3.16;x86_64;installed");
+	g_assert (!ret);
+	package = pk_package_sack_find_by_id_name_arch (sack, "kernel;0.1;x86_64;fedora");
+	g_assert_cmpstr (pk_package_get_version (package), ==, "3.17");
 	g_object_unref (package);
+	g_ptr_array_unref (installed);
+	installed = pk_package_sack_find_by_info (sack, PK_INFO_ENUM_INSTALLED);
+	g_assert_cmpint (installed->len, ==, 1);
+
+	/* and so does filtering */
+	ret = pk_package_sack_remove_by_filter (sack, pk_test_package_sack_filter_cb, NULL);
+	g_assert (ret);
+	g_assert_cmpint (pk_package_sack_get_size (sack), ==, 3);
+	array = pk_package_sack_find_by_name (sack, "glibc");
+	g_assert_cmpint (array->len, ==, 1);
+	g_ptr_array_unref (array);
+	package = pk_package_sack_find_by_id (sack, "glibc;2.20;i386;installed");
+	g_assert (package == NULL);
+
+	/* and clearing */
+	pk_package_sack_clear (sack);
+	array = pk_package_sack_find_by_name (sack, "kernel");
+	g_assert_cmpint (array->len, ==, 0);
+
+	/* removing moves other packages about, which must still be found */
+	for (i = 0; i < 100; i++) {
+		_cleanup_free_ gchar *package_id = NULL;
+		package_id = g_strdup_printf ("pkg%02i;1.0;x86_64;fedora", i);
+		ret = pk_package_sack_add_package_by_id (sack, package_id, &error);
+		g_assert_no_error (error);
+		g_assert (ret);
+	}
+	for (i = 0; i < 100; i += 2) {
+		_cleanup_free_ gchar *package_id = NULL;
+		package_id = g_strdup_printf ("pkg%02i;1.0;x86_64;fedora", i);
+		ret = pk_package_sack_remove_package_by_id (sack, package_id);
+		g_assert (ret);
+	}
+	g_assert_cmpint (pk_package_sack_get_size (sack), ==, 50);
+	for (i = 1; i < 100; i += 2) {
+		_cleanup_free_ gchar *package_id = NULL;
+		package_id = g_strdup_printf ("pkg%02i;1.0;x86_64;fedora", i);
+		ret = pk_package_sack_remove_package_by_id (sack, package_id);
+		g_assert (ret);
+	}
+	g_assert_cmpint (pk_package_sack_get_size (sack), ==, 0);
+}
+
+/* a chunk the fake daemon has been sent but not answered yet */
+typedef struct {
+	GSimpleAsyncResult	*res;
+	GCancellable		*cancellable;
+	gchar			**package_ids;
+	guint			 number;
+} PkTestChunk;
+
+static GPtrArray *_chunks_pending = NULL;
+static GArray *_chunks_percentage = NULL;
+static guint _chunks_sent = 0;
+static guint _chunks_in_flight_max = 0;
+static guint _chunks_cancelled = 0;
+static guint _chunks_fail = 0;
+
+static gboolean
+pk_test_package_sack_chunk_reply_cb (gpointer user_data)
+{
+	PkTestChunk *chunk;
+	guint i;
+
+	/* answer in the order they were sent */
+	chunk = g_ptr_array_index (_chunks_pending, 0);
+	g_ptr_array_remove_index (_chunks_pending, 0);
+	if (g_cancellable_is_cancelled (chunk->cancellable)) {
+		_chunks_cancelled++;
+		g_simple_async_result_set_error (chunk->res, G_IO_ERROR,
+						 G_IO_ERROR_CANCELLED, "cancelled");
+	} else if (chunk->number == _chunks_fail) {
+		g_simple_async_result_set_error (chunk->res, PK_CLIENT_ERROR,
+						 PK_CLIENT_ERROR_FAILED,
+						 "chunk %u failed", chunk->number);
+	} else {
+		PkResults *results = pk_results_new ();
+		for (i = 0; chunk->package_ids[i] != NULL; i++) {
+			_cleanup_object_unref_ PkPackage *package = pk_package_new ();
+			pk_package_set_id (package, chunk->package_ids[i], NULL);
+			pk_package_set_info (package, PK_INFO_ENUM_AVAILABLE);
+			pk_package_set_summary (package, "resolved");
+			pk_results_add_package (results, package);
+		}
+		g_simple_async_result_set_op_res_gpointer (chunk->res, results, g_object_unref);
+	}
+	g_simple_async_result_complete (chunk->res);
+
+	g_object_unref (chunk->res);
+	g_object_unref (chunk->cancellable);
+	g_strfreev (chunk->package_ids);
+	g_free (chunk);
+	return FALSE;
+}
+
+static void
+pk_test_package_sack_chunk_func (PkClient *client,
+				 PkRoleEnum role,
+				 gchar **package_ids,
+				 GCancellable *cancellable,
+				 PkProgressCallback progress_callback,
+				 gpointer progress_user_data,
+				 GAsyncReadyCallback callback_ready,
+				 gpointer user_data)
+{
+	PkTestChunk *chunk;
+	_cleanup_object_unref_ PkProgress *progress = NULL;
+
+	g_assert_cmpint (role, ==, PK_ROLE_ENUM_RESOLVE);
+	g_assert_cmpint (g_strv_length (package_ids), <=, 3);
+
+	chunk = g_new0 (PkTestChunk, 1);
+	chunk->number = ++_chunks_sent;
+	chunk->res = g_simple_async_result_new (G_OBJECT (client), callback_ready, user_data,
+						pk_test_package_sack_chunk_func);
+	chunk->cancellable = g_object_ref (cancellable);
+	chunk->package_ids = g_strdupv (package_ids);
+	g_ptr_array_add (_chunks_pending, chunk);
+	_chunks_in_flight_max = MAX (_chunks_in_flight_max, _chunks_pending->len);
+
+	/* the percentage of one chunk must not reach the caller */
+	progress = pk_progress_new ();
+	pk_progress_set_percentage (progress, 50);
+	progress_callback (progress, PK_PROGRESS_TYPE_PERCENTAGE, progress_user_data);
+
+	g_idle_add (pk_test_package_sack_chunk_reply_cb, NULL);
+}
+
+static void
+pk_test_package_sack_chunked_progress_cb (PkProgress *progress, PkProgressType type, gpointer user_data)
+{
+	gint percentage;
+	if (type != PK_PROGRESS_TYPE_PERCENTAGE)
+		return;
+	percentage = pk_progress_get_percentage (progress);
+	g_array_append_val (_chunks_percentage, percentage);
+}
+
+static void
+pk_test_package_sack_chunked_finish_cb (GObject *object, GAsyncResult *res, gpointer user_data)
+{
+	GAsyncResult **result = (GAsyncResult **) user_data;
+	*result = g_object_ref (res);
+}
+
+static gboolean
+pk_test_package_sack_chunked_run (PkPackageSack *sack, guint fail, GError **error)
+{
+	_cleanup_object_unref_ GAsyncResult *res = NULL;
+
+	_chunks_sent = 0;
+	_chunks_in_flight_max = 0;
+	_chunks_cancelled = 0;
+	_chunks_fail = fail;
+	g_array_set_size (_chunks_percentage, 0);
+	pk_package_sack_resolve_async (sack, NULL,
+				       pk_test_package_sack_chunked_progress_cb, NULL,
+				       pk_test_package_sack_chunked_finish_cb, &res);
+	while (res == NULL)
+		g_main_context_iteration (NULL, TRUE);
+	g_assert_cmpint (_chunks_pending->len, ==, 0);
+	return pk_package_sack_merge_generic_finish (sack, res, error);
+}
+
+static void
+pk_test_package_sack_chunked_func (void)
+{
+	gboolean ret;
+	guint i;
+	GError *error = NULL;
+	_cleanup_object_unref_ PkPackageSack *sack = NULL;
+	_cleanup_ptrarray_unref_ GPtrArray *array = NULL;
+
+	_chunks_pending = g_ptr_array_new ();
+	_chunks_percentage = g_array_new (FALSE, FALSE, sizeof (gint));
+
+	sack = pk_package_sack_new ();
+	for (i = 0; i < 10; i++) {
+		_cleanup_free_ gchar *package_id = NULL;
+		package_id = g_strdup_printf ("pkg%02i;1.0;noarch;fedora", i);
+		ret = pk_package_sack_add_package_by_id (sack, package_id, &error);
+		g_assert_no_error (error);
+		g_assert (ret);
+	}
+	pk_package_sack_set_chunk_size (sack, 3, 2);
+	pk_package_sack_set_chunk_func (sack, pk_test_package_sack_chunk_func);
+
+	/* split into four chunks with never more than two in flight */
+	ret = pk_test_package_sack_chunked_run (sack, 0, &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+	g_assert_cmpint (_chunks_sent, ==, 4);
+	g_assert_cmpint (_chunks_in_flight_max, ==, 2);
+	g_assert_cmpint (_chunks_cancelled, ==, 0);
+
+	/* every chunk was merged */
+	array = pk_package_sack_get_array (sack);
+	g_assert_cmpint (array->len, ==, 10);
+	for (i = 0; i < array->len; i++) {
+		PkPackage *package = g_ptr_array_index (array, i);
+		g_assert_cmpint (pk_package_get_info (package), ==, PK_INFO_ENUM_AVAILABLE);
+		g_assert_cmpstr (pk_package_get_summary (package), ==, "resolved");
+	}
+
+	/* the percentage counts chunks, and never goes backwards */
+	g_assert_cmpint (_chunks_percentage->len, ==, 4);
+	g_assert_cmpint (g_array_index (_chunks_percentage, gint, 0), ==, 25);
+	g_assert_cmpint (g_array_index (_chunks_percentage, gint, 1), ==, 50);
+	g_assert_cmpint (g_array_index (_chunks_percentage, gint, 2), ==, 75);
+	g_assert_cmpint (g_array_index (_chunks_percentage, gint, 3), ==, 100);
+
+	/* a failed chunk cancels the one in flight and sends no more */
+	g_test_expect_message (G_LOG_DOMAIN, G_LOG_LEVEL_WARNING,
+			       "failed to resolve: chunk 2 failed");
+	ret = pk_test_package_sack_chunked_run (sack, 2, &error);
+	g_test_assert_expected_messages ();
+	g_assert_error (error, PK_CLIENT_ERROR, PK_CLIENT_ERROR_FAILED);
+	g_assert_cmpstr (error->message, ==, "chunk 2 failed");
+	g_assert (!ret);
+	g_clear_error (&error);
+	g_assert_cmpint (_chunks_sent, ==, 3);
+	g_assert_cmpint (_chunks_cancelled, ==, 1);
+
+	g_ptr_array_unref (_chunks_pending);
+	g_array_unref (_chunks_percentage);
+}
+
+/**
+ * pk_test_get_resident_size:
+ **/
+static gsize
+pk_test_get_resident_size (void)
+{
+	gsize resident = 0;
+	_cleanup_free_ gchar *data = NULL;
+	_cleanup_strv_free_ gchar **split = NULL;
+
+	if (!g_file_get_contents ("/proc/self/statm", &data, NULL, NULL))
+		return 0;
+	split = g_strsplit (data, " ", -1);
+	if (g_strv_length (split) < 2)
+		return 0;
+	resident = g_ascii_strtoull (split[1], NULL, 10);
+	return resident * sysconf (_SC_PAGESIZE);
+}
+
+static void
+pk_test_results_store_func (void)
+{
+	PkPackage *item;
+	const guint n_packages = 100000;
+	gsize rss_end;
+	gsize rss_start;
+	guint i;
+	_cleanup_object_unref_ PkResults *results = NULL;
+	_cleanup_object_unref_ PkPackage *detailed = NULL;
+	_cleanup_ptrarray_unref_ GPtrArray *objects = NULL;
+	_cleanup_ptrarray_unref_ GPtrArray *packages = NULL;
+
+	/* store 100k bare packages in the results */
+	rss_start = pk_test_get_resident_size ();
+	results = pk_results_new ();
+	for (i = 0; i < n_packages; i++) {
+		_cleanup_free_ gchar *package_id = NULL;
+		_cleanup_object_unref_ PkPackage *package = NULL;
+		package_id = g_strdup_printf ("package%05u;0.%u.%u;%s;fedora",
+					      i / 2, i % 10, i % 3,
+					      i % 2 == 0 ? "x86_64" : "i686");
+		package = pk_package_new ();
+		pk_package_set_id (package, package_id, NULL);
+		pk_package_set_info (package, PK_INFO_ENUM_AVAILABLE);
+		pk_package_set_summary (package, "Test package");
+		pk_results_add_package (results, package);
+	}
+	rss_end = pk_test_get_resident_size ();
+	if (g_test_perf ()) {
+		g_test_message ("PkResults with %u packages: %" G_GSIZE_FORMAT "kB",
+				n_packages, (rss_end - rss_start) / 1024);
+	}
+
+	/* the same packages as objects */
+	if (g_test_perf ()) {
+		rss_start = pk_test_get_resident_size ();
+		objects = g_ptr_array_new_with_free_func (g_object_unref);
+		for (i = 0; i < n_packages; i++) {
+			_cleanup_free_ gchar *package_id = NULL;
+			item = pk_package_new ();
+			package_id = g_strdup_printf ("package%05u;0.%u.%u;%s;fedora",
+						      i / 2, i % 10, i % 3,
+						      i % 2 == 0 ? "x86_64" : "i686");
+			pk_package_set_id (item, package_id, NULL);
+			pk_package_set_info (item, PK_INFO_ENUM_AVAILABLE);
+			pk_package_set_summary (item, "Test package");
+			g_ptr_array_add (objects, item);
+		}
+		rss_end = pk_test_get_resident_size ();
+		g_test_message ("%u PkPackage objects: %" G_GSIZE_FORMAT "kB",
+				n_packages, (rss_end - rss_start) / 1024);
+	}
+
+	/* packages with more than a summary are kept as they are */
+	detailed = pk_package_new ();
+	pk_package_set_id (detailed, "powertop;0.1.3;i386;fedora", NULL);
+	g_object_set (detailed,
+		      "info", PK_INFO_ENUM_INSTALLED,
+		      "license", "GPLv2",
+		      NULL);
+	pk_results_add_package (results, detailed);
+
+	/* objects are created when asked for */
+	packages = pk_results_get_package_array (results);
+	g_assert_cmpint (packages->len, ==, n_packages + 1);
+	item = g_ptr_array_index (packages, 1);
+	g_assert_cmpstr (pk_package_get_id (item), ==, "package00000;0.1.1;i686;fedora");
+	g_assert_cmpstr (pk_package_get_name (item), ==, "package00000");
+	g_assert_cmpstr (pk_package_get_summary (item), ==, "Test package");
+	g_assert_cmpint (pk_package_get_info (item), ==, PK_INFO_ENUM_AVAILABLE);
+	item = g_ptr_array_index (packages, n_packages);
+	g_assert (item == detailed);
+
+	/* the same objects are returned the next time */
+	g_ptr_array_unref (packages);
+	packages = pk_results_get_package_array (results);
+	g_assert (g_ptr_array_index (packages, n_packages) == detailed);
+	g_assert_cmpint (packages->len, ==, n_packages + 1);
 }
 
 static void
@@ -824,10 +1779,19 @@ main (int argc, char **argv)
 	g_test_add_func ("/packagekit-glib2/enum", pk_test_enum_func);
 	g_test_add_func ("/packagekit-glib2/bitfield", pk_test_bitfield_func);
 	g_test_add_func ("/packagekit-glib2/package-id", pk_test_package_id_func);
+	g_test_add_func ("/packagekit-glib2/package-id-view", pk_test_package_id_view_func);
 	g_test_add_func ("/packagekit-glib2/package-ids", pk_test_package_ids_func);
 	g_test_add_func ("/packagekit-glib2/progress", pk_test_progress_func);
+	g_test_add_func ("/packagekit-glib2/progress-coalesce", pk_test_progress_coalesce_func);
 	g_test_add_func ("/packagekit-glib2/results", pk_test_results_func);
+	g_test_add_func ("/packagekit-glib2/results-store", pk_test_results_store_func);
+	g_test_add_func ("/packagekit-glib2/client-replay", pk_test_client_replay_func);
+	g_test_add_func ("/packagekit-glib2/client-cache", pk_test_client_cache_func);
 	g_test_add_func ("/packagekit-glib2/package", pk_test_package_func);
+	g_test_add_func ("/packagekit-glib2/package-sack", pk_test_package_sack_func);
+	g_test_add_func ("/packagekit-glib2/package-sack-chunked", pk_test_package_sack_chunked_func);
+	g_test_add_func ("/packagekit-glib2/sync-loop", pk_test_sync_loop_func);
+	g_test_add_func ("/packagekit-glib2/client-idle", pk_test_client_idle_func);
 	g_test_add_func ("/packagekit-glib2/progress-bar", pk_test_progress_bar);
 	g_test_add_func ("/packagekit-glib2/offline", pk_test_offline_func);
 
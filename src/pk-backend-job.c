@@ -115,6 +115,8 @@ struct PkBackendJobPrivate
 	PkStatusEnum		 status;
 	GTimer			*timer;
 	gboolean		 started;
+	gpointer		 vfunc_queue;
+	GSource			*vfunc_source;
 };
 
 G_DEFINE_TYPE (PkBackendJob, pk_backend_job, G_TYPE_OBJECT)
@@ -599,12 +601,14 @@ pk_backend_job_get_is_error_set (PkBackendJob *job)
 }
 
 /* used to call vfuncs in the main daemon thread */
-typedef struct {
-	PkBackendJob		*job;
+typedef struct PkBackendJobVFuncHelper PkBackendJobVFuncHelper;
+struct PkBackendJobVFuncHelper {
+	PkBackendJobVFuncHelper	*next;
 	PkBackendJobSignal	 signal_kind;
-	GObject			*object;
+	gpointer		 object;
 	GDestroyNotify		 destroy_func;
-} PkBackendJobVFuncHelper;
+	gboolean		 superseded;
+};
 
 /**
  * pk_backend_job_signal_to_string:
@@ -656,32 +660,158 @@ pk_backend_job_signal_to_string (PkBackendJobSignal id)
 }
 
 /**
- * pk_backend_job_call_vfunc_idle_cb:
+ * pk_backend_job_vfunc_helper_free:
+ **/
+static void
+pk_backend_job_vfunc_helper_free (PkBackendJobVFuncHelper *helper)
+{
+	if (helper->destroy_func != NULL)
+		helper->destroy_func (helper->object);
+	g_free (helper);
+}
+
+/**
+ * pk_backend_job_vfunc_queue_steal:
+ *
+ * Atomically takes every queued event, newest first.
+ **/
+static PkBackendJobVFuncHelper *
+pk_backend_job_vfunc_queue_steal (PkBackendJob *job)
+{
+	PkBackendJobVFuncHelper *head;
+
+	do {
+		head = g_atomic_pointer_get (&job->priv->vfunc_queue);
+	} while (!g_atomic_pointer_compare_and_exchange (&job->priv->vfunc_queue,
+							 head, NULL));
+	return head;
+}
+
+/**
+ * pk_backend_job_vfunc_queue_coalesce:
+ *
+ * Marks the progress events that have a newer value later in the same
+ * batch, as there is no point sending them to the transaction at all.
+ * The list has to be ordered newest first.
+ **/
+static void
+pk_backend_job_vfunc_queue_coalesce (PkBackendJobVFuncHelper *head)
+{
+	PkBackendJobVFuncHelper *helper;
+	gboolean seen[PK_BACKEND_SIGNAL_LAST] = { FALSE };
+	const gchar *package_id;
+	gchar *key;
+	_cleanup_hashtable_unref_ GHashTable *item_progress = NULL;
+
+	for (helper = head; helper != NULL; helper = helper->next) {
+		switch (helper->signal_kind) {
+		case PK_BACKEND_SIGNAL_PERCENTAGE:
+		case PK_BACKEND_SIGNAL_SPEED:
+		case PK_BACKEND_SIGNAL_DOWNLOAD_SIZE_REMAINING:
+			helper->superseded = seen[helper->signal_kind];
+			seen[helper->signal_kind] = TRUE;
+			break;
+		case PK_BACKEND_SIGNAL_ITEM_PROGRESS:
+			/* only a newer percentage for the same package in the
+			 * same status replaces an update, as a client may want
+			 * to see every status a package goes through */
+			if (item_progress == NULL)
+				item_progress = g_hash_table_new_full (g_str_hash, g_str_equal,
+								       g_free, NULL);
+			package_id = pk_item_progress_get_package_id (helper->object);
+			if (package_id == NULL)
+				break;
+			key = g_strdup_printf ("%s;%s", package_id,
+					       pk_status_enum_to_string (pk_item_progress_get_status (helper->object)));
+			helper->superseded = !g_hash_table_add (item_progress, key);
+			break;
+		default:
+			break;
+		}
+	}
+}
+
+/**
+ * pk_backend_job_vfunc_queue_drain_cb:
+ *
+ * Called in the main thread when there is at least one event queued.
  **/
 static gboolean
-pk_backend_job_call_vfunc_idle_cb (gpointer user_data)
+pk_backend_job_vfunc_queue_drain_cb (gpointer user_data)
 {
-	PkBackendJobVFuncHelper *helper = (PkBackendJobVFuncHelper *) user_data;
+	PkBackendJob *job = PK_BACKEND_JOB (user_data);
+	PkBackendJobVFuncHelper *helper;
+	PkBackendJobVFuncHelper *next;
+	PkBackendJobVFuncHelper *head;
+	PkBackendJobVFuncHelper *fifo = NULL;
 	PkBackendJobVFuncItem *item;
 
-	/* call transaction vfunc on main thread */
-	item = &helper->job->priv->vfunc_items[helper->signal_kind];
-	if (item != NULL && item->vfunc != NULL) {
-		item->vfunc (helper->job, helper->object, item->user_data);
-	} else {
-		g_warning ("tried to do signal %s when no longer connected",
-			   pk_backend_job_signal_to_string (helper->signal_kind));
+	/* anything queued after we steal the list wakes us again */
+	g_source_set_ready_time (job->priv->vfunc_source, -1);
+	head = pk_backend_job_vfunc_queue_steal (job);
+	if (head == NULL)
+		return G_SOURCE_CONTINUE;
+	pk_backend_job_vfunc_queue_coalesce (head);
+
+	/* reverse so the vfuncs are called in the order they were sent */
+	for (helper = head; helper != NULL; helper = next) {
+		next = helper->next;
+		helper->next = fifo;
+		fifo = helper;
 	}
-	if (helper->destroy_func != NULL)
-		helper->destroy_func (helper->object);
-	return FALSE;
+
+	/* a vfunc may drop the last reference to the job */
+	g_object_ref (job);
+	for (helper = fifo; helper != NULL; helper = next) {
+		next = helper->next;
+		if (helper->superseded) {
+			pk_backend_job_vfunc_helper_free (helper);
+			continue;
+		}
+
+		/* call transaction vfunc on main thread */
+		item = &job->priv->vfunc_items[helper->signal_kind];
+		if (item->vfunc != NULL) {
+			item->vfunc (job, helper->object, item->user_data);
+		} else {
+			g_warning ("tried to do signal %s when no longer connected",
+				   pk_backend_job_signal_to_string (helper->signal_kind));
+		}
+		pk_backend_job_vfunc_helper_free (helper);
+	}
+	g_object_unref (job);
+	return G_SOURCE_CONTINUE;
 }
 
+/**
+ * pk_backend_job_vfunc_source_dispatch:
+ **/
+static gboolean
+pk_backend_job_vfunc_source_dispatch (GSource *source,
+				      GSourceFunc callback,
+				      gpointer user_data)
+{
+	return callback (user_data);
+}
+
+static GSourceFuncs pk_backend_job_vfunc_source_funcs = {
+	NULL,
+	NULL,
+	pk_backend_job_vfunc_source_dispatch,
+	NULL,
+	NULL,
+	NULL
+};
+
 /**
  * pk_backend_job_call_vfunc:
  *
  * This method can be called in any thread, and the vfunc is guaranteed
  * to be called idle in the main thread.
+ *
+ * Events are pushed onto a lock-free list and only the first event of
+ * each batch wakes up the main loop, which then handles everything that
+ * was queued in one go.
  **/
 static void
 pk_backend_job_call_vfunc (PkBackendJob *job,
@@ -690,27 +820,31 @@ pk_backend_job_call_vfunc (PkBackendJob *job,
 			   GDestroyNotify destroy_func)
 {
 	PkBackendJobVFuncHelper *helper;
+	PkBackendJobVFuncHelper *head;
 	PkBackendJobVFuncItem *item;
-	guint priority = G_PRIORITY_DEFAULT_IDLE;
 
 	/* call transaction vfunc if not disabled and set */
 	item = &job->priv->vfunc_items[signal_kind];
-	if (!item->enabled || item->vfunc == NULL)
+	if (!item->enabled || item->vfunc == NULL) {
+		if (destroy_func != NULL)
+			destroy_func (object);
 		return;
+	}
 
-	if (signal_kind == PK_BACKEND_SIGNAL_FINISHED)
-		priority = G_PRIORITY_LOW;
-
-	/* emit idle, TODO: do we ever need to cancel this? */
 	helper = g_new0 (PkBackendJobVFuncHelper, 1);
-	helper->job = job;
 	helper->signal_kind = signal_kind;
 	helper->object = object;
 	helper->destroy_func = destroy_func;
-	g_idle_add_full (priority,
-			 pk_backend_job_call_vfunc_idle_cb,
-			 helper,
-			 g_free);
+	do {
+		head = g_atomic_pointer_get (&job->priv->vfunc_queue);
+		helper->next = head;
+	} while (!g_atomic_pointer_compare_and_exchange (&job->priv->vfunc_queue,
+							 head, helper));
+
+	/* the main loop is already going to drain the queue */
+	if (head != NULL)
+		return;
+	g_source_set_ready_time (job->priv->vfunc_source, 0);
 }
 
 /**
@@ -1840,6 +1974,7 @@ static void
 pk_backend_job_finalize (GObject *object)
 {
 	PkBackendJob *job;
+	PkBackendJobVFuncHelper *helper;
 
 	g_return_if_fail (object != NULL);
 	g_return_if_fail (PK_IS_BACKEND_JOB (object));
@@ -1850,6 +1985,16 @@ pk_backend_job_finalize (GObject *object)
 		pk_backend_stop_job (job->priv->backend, job);
 	}
 
+	/* drop anything the main loop did not get to */
+	g_source_destroy (job->priv->vfunc_source);
+	g_source_unref (job->priv->vfunc_source);
+	helper = pk_backend_job_vfunc_queue_steal (job);
+	while (helper != NULL) {
+		PkBackendJobVFuncHelper *next = helper->next;
+		pk_backend_job_vfunc_helper_free (helper);
+		helper = next;
+	}
+
 	g_free (job->priv->proxy_http);
 	g_free (job->priv->proxy_https);
 	g_free (job->priv->proxy_ftp);
@@ -1893,6 +2038,14 @@ pk_backend_job_init (PkBackendJob *job)
 	job->priv->timer = g_timer_new ();
 	job->priv->cancellable = g_cancellable_new ();
 	job->priv->last_error_code = PK_ERROR_ENUM_UNKNOWN;
+	job->priv->vfunc_source = g_source_new (&pk_backend_job_vfunc_source_funcs,
+						sizeof (GSource));
+	g_source_set_priority (job->priv->vfunc_source, G_PRIORITY_DEFAULT_IDLE);
+	g_source_set_callback (job->priv->vfunc_source,
+			       pk_backend_job_vfunc_queue_drain_cb,
+			       job, NULL);
+	g_source_set_name (job->priv->vfunc_source, "[PkBackendJob] vfunc");
+	g_source_attach (job->priv->vfunc_source, NULL);
 	pk_backend_job_reset (job);
 }
 
@@ -55,6 +55,59 @@
 
 #define	PK_UNSAFE_DELIMITERS	"\\\f\r\t"
 
+/* the most sections any command has, which is updatedetail */
+#define PK_BACKEND_SPAWN_MAX_SECTIONS	13
+
+typedef enum {
+	PK_BACKEND_SPAWN_COMMAND_UNKNOWN,
+	PK_BACKEND_SPAWN_COMMAND_PACKAGE,
+	PK_BACKEND_SPAWN_COMMAND_DETAILS,
+	PK_BACKEND_SPAWN_COMMAND_FINISHED,
+	PK_BACKEND_SPAWN_COMMAND_FILES,
+	PK_BACKEND_SPAWN_COMMAND_REPO_DETAIL,
+	PK_BACKEND_SPAWN_COMMAND_UPDATEDETAIL,
+	PK_BACKEND_SPAWN_COMMAND_PERCENTAGE,
+	PK_BACKEND_SPAWN_COMMAND_ITEM_PROGRESS,
+	PK_BACKEND_SPAWN_COMMAND_ERROR,
+	PK_BACKEND_SPAWN_COMMAND_REQUIRERESTART,
+	PK_BACKEND_SPAWN_COMMAND_STATUS,
+	PK_BACKEND_SPAWN_COMMAND_SPEED,
+	PK_BACKEND_SPAWN_COMMAND_DOWNLOAD_SIZE_REMAINING,
+	PK_BACKEND_SPAWN_COMMAND_ALLOW_CANCEL,
+	PK_BACKEND_SPAWN_COMMAND_NO_PERCENTAGE_UPDATES,
+	PK_BACKEND_SPAWN_COMMAND_REPO_SIGNATURE_REQUIRED,
+	PK_BACKEND_SPAWN_COMMAND_EULA_REQUIRED,
+	PK_BACKEND_SPAWN_COMMAND_MEDIA_CHANGE_REQUIRED,
+	PK_BACKEND_SPAWN_COMMAND_DISTRO_UPGRADE,
+	PK_BACKEND_SPAWN_COMMAND_CATEGORY,
+	PK_BACKEND_SPAWN_COMMAND_LAST
+} PkBackendSpawnCommand;
+
+static const PkEnumMatch enum_command[] = {
+	{PK_BACKEND_SPAWN_COMMAND_UNKNOWN,	"unknown"},	/* fall though value */
+	{PK_BACKEND_SPAWN_COMMAND_PACKAGE,		"package"},
+	{PK_BACKEND_SPAWN_COMMAND_DETAILS,		"details"},
+	{PK_BACKEND_SPAWN_COMMAND_FINISHED,		"finished"},
+	{PK_BACKEND_SPAWN_COMMAND_FILES,		"files"},
+	{PK_BACKEND_SPAWN_COMMAND_REPO_DETAIL,		"repo-detail"},
+	{PK_BACKEND_SPAWN_COMMAND_UPDATEDETAIL,		"updatedetail"},
+	{PK_BACKEND_SPAWN_COMMAND_PERCENTAGE,		"percentage"},
+	{PK_BACKEND_SPAWN_COMMAND_ITEM_PROGRESS,	"item-progress"},
+	{PK_BACKEND_SPAWN_COMMAND_ERROR,		"error"},
+	{PK_BACKEND_SPAWN_COMMAND_REQUIRERESTART,	"requirerestart"},
+	{PK_BACKEND_SPAWN_COMMAND_STATUS,		"status"},
+	{PK_BACKEND_SPAWN_COMMAND_SPEED,		"speed"},
+	{PK_BACKEND_SPAWN_COMMAND_DOWNLOAD_SIZE_REMAINING,	"download-size-remaining"},
+	{PK_BACKEND_SPAWN_COMMAND_ALLOW_CANCEL,		"allow-cancel"},
+	{PK_BACKEND_SPAWN_COMMAND_NO_PERCENTAGE_UPDATES,	"no-percentage-updates"},
+	{PK_BACKEND_SPAWN_COMMAND_REPO_SIGNATURE_REQUIRED,	"repo-signature-required"},
+	{PK_BACKEND_SPAWN_COMMAND_EULA_REQUIRED,	"eula-required"},
+	{PK_BACKEND_SPAWN_COMMAND_MEDIA_CHANGE_REQUIRED,	"media-change-required"},
+	{PK_BACKEND_SPAWN_COMMAND_DISTRO_UPGRADE,	"distro-upgrade"},
+	{PK_BACKEND_SPAWN_COMMAND_CATEGORY,		"category"},
+	{0, NULL}
+};
+
 struct PkBackendSpawnPrivate
 {
 	PkSpawn			*spawn;
@@ -68,6 +121,7 @@ struct PkBackendSpawnPrivate
 	gboolean		 is_busy;
 	PkBackendSpawnFilterFunc stdout_func;
 	PkBackendSpawnFilterFunc stderr_func;
+	GString			*line_buf;
 };
 
 G_DEFINE_TYPE (PkBackendSpawn, pk_backend_spawn, G_TYPE_OBJECT)
@@ -149,6 +203,63 @@ pk_backend_spawn_start_kill_timer (PkBackendSpawn *backend_spawn)
 	g_source_set_name_by_id (priv->kill_id, "[PkBackendSpawn] exit");
 }
 
+/**
+ * pk_backend_spawn_tokenize:
+ * @line: the line to split, which is modified in place
+ * @sections: an array of %PK_BACKEND_SPAWN_MAX_SECTIONS pointers
+ *
+ * Splits the line on tabs without allocating, pointing each section into
+ * @line. Any sections after the maximum are counted but not stored.
+ *
+ * Return value: the number of sections in the line
+ **/
+static guint
+pk_backend_spawn_tokenize (gchar *line, gchar **sections)
+{
+	gchar *tab;
+	guint size = 0;
+
+	while (TRUE) {
+		if (size < PK_BACKEND_SPAWN_MAX_SECTIONS)
+			sections[size] = line;
+		size++;
+		tab = strchr (line, '\t');
+		if (tab == NULL)
+			break;
+		*tab = '\0';
+		line = tab + 1;
+	}
+	return size;
+}
+
+/**
+ * pk_backend_spawn_command_from_string:
+ *
+ * Looks up a command name using a hash built once for the whole process,
+ * rather than comparing the command against every name in turn.
+ **/
+static PkBackendSpawnCommand
+pk_backend_spawn_command_from_string (const gchar *command)
+{
+	static GHashTable *hash = NULL;
+	gpointer value;
+
+	if (g_once_init_enter (&hash)) {
+		GHashTable *tmp;
+		guint i;
+		tmp = g_hash_table_new (g_str_hash, g_str_equal);
+		for (i = 1; enum_command[i].string != NULL; i++) {
+			g_hash_table_insert (tmp,
+					     (gpointer) enum_command[i].string,
+					     GUINT_TO_POINTER (enum_command[i].value));
+		}
+		g_once_init_leave (&hash, tmp);
+	}
+	if (!g_hash_table_lookup_extended (hash, command, NULL, &value))
+		return PK_BACKEND_SPAWN_COMMAND_UNKNOWN;
+	return GPOINTER_TO_UINT (value);
+}
+
 /**
  * pk_backend_spawn_parse_stdout:
  **/
@@ -160,6 +271,7 @@ pk_backend_spawn_parse_stdout (PkBackendSpawn *backend_spawn,
 {
 	guint size;
 	gchar *command;
+	PkBackendSpawnCommand command_enum;
 	gchar *text;
 	guint64 speed;
 	guint64 download_size_remaining;
@@ -176,7 +288,7 @@ pk_backend_spawn_parse_stdout (PkBackendSpawn *backend_spawn,
 	PkMediaTypeEnum media_type_enum;
 	PkDistroUpgradeEnum distro_upgrade_enum;
 	PkBackendSpawnPrivate *priv = backend_spawn->priv;
-	_cleanup_strv_free_ gchar **sections = NULL;
+	gchar *sections[PK_BACKEND_SPAWN_MAX_SECTIONS];
 
 	g_return_val_if_fail (PK_IS_BACKEND_SPAWN (backend_spawn), FALSE);
 
@@ -184,14 +296,13 @@ pk_backend_spawn_parse_stdout (PkBackendSpawn *backend_spawn,
 	if (line == NULL)
 		return FALSE;
 
-	/* split by tab */
-	sections = g_strsplit (line, "\t", 0);
+	/* split by tab in a buffer we reuse for every line */
+	g_string_assign (priv->line_buf, line);
+	size = pk_backend_spawn_tokenize (priv->line_buf->str, sections);
 	command = sections[0];
+	command_enum = pk_backend_spawn_command_from_string (command);
 
-	/* get size */
-	size = g_strv_length (sections);
-
-	if (g_strcmp0 (command, "package") == 0) {
+	if (command_enum == PK_BACKEND_SPAWN_COMMAND_PACKAGE) {
 		if (size != 4) {
 			g_set_error (error, 1, 0, "invalid command'%s', size %i", command, size);
 			return FALSE;
@@ -213,7 +324,7 @@ pk_backend_spawn_parse_stdout (PkBackendSpawn *backend_spawn,
 			return FALSE;
 		}
 		pk_backend_job_package (job, info, sections[2], sections[3]);
-	} else if (g_strcmp0 (command, "details") == 0) {
+	} else if (command_enum == PK_BACKEND_SPAWN_COMMAND_DETAILS) {
 		if (size != 7 && size != 8) {
 			g_set_error (error, 1, 0, "invalid command'%s', size %i", command, size);
 			return FALSE;
@@ -239,7 +350,7 @@ pk_backend_spawn_parse_stdout (PkBackendSpawn *backend_spawn,
 		pk_backend_job_details (job, sections[1], size == 8 ? sections[7] : NULL, sections[2],
 					group, text, sections[5], package_size);
 		g_free (text);
-	} else if (g_strcmp0 (command, "finished") == 0) {
+	} else if (command_enum == PK_BACKEND_SPAWN_COMMAND_FINISHED) {
 		if (size != 1) {
 			g_set_error (error, 1, 0, "invalid command'%s', size %i", command, size);
 			return FALSE;
@@ -250,7 +361,7 @@ pk_backend_spawn_parse_stdout (PkBackendSpawn *backend_spawn,
 		/* from this point on, we can start the kill timer */
 		pk_backend_spawn_start_kill_timer (backend_spawn);
 
-	} else if (g_strcmp0 (command, "files") == 0) {
+	} else if (command_enum == PK_BACKEND_SPAWN_COMMAND_FILES) {
 		_cleanup_strv_free_ gchar **tmp = NULL;
 		if (size != 3) {
 			g_set_error (error, 1, 0, "invalid command'%s', size %i", command, size);
@@ -258,7 +369,7 @@ pk_backend_spawn_parse_stdout (PkBackendSpawn *backend_spawn,
 		}
 		tmp = g_strsplit (sections[2], ";", -1);
 		pk_backend_job_files (job, sections[1], tmp);
-	} else if (g_strcmp0 (command, "repo-detail") == 0) {
+	} else if (command_enum == PK_BACKEND_SPAWN_COMMAND_REPO_DETAIL) {
 		if (size != 4) {
 			g_set_error (error, 1, 0, "invalid command'%s', size %i", command, size);
 			return FALSE;
@@ -278,7 +389,7 @@ pk_backend_spawn_parse_stdout (PkBackendSpawn *backend_spawn,
 			g_set_error (error, 1, 0, "invalid qualifier '%s'", sections[3]);
 			return FALSE;
 		}
-	} else if (g_strcmp0 (command, "updatedetail") == 0) {
+	} else if (command_enum == PK_BACKEND_SPAWN_COMMAND_UPDATEDETAIL) {
 		_cleanup_strv_free_ gchar **updates = NULL;
 		_cleanup_strv_free_ gchar **obsoletes = NULL;
 		_cleanup_strv_free_ gchar **vendor_urls = NULL;
@@ -322,7 +433,7 @@ pk_backend_spawn_parse_stdout (PkBackendSpawn *backend_spawn,
 					  update_state_enum,
 					  sections[11],
 					  sections[12]);
-	} else if (g_strcmp0 (command, "percentage") == 0) {
+	} else if (command_enum == PK_BACKEND_SPAWN_COMMAND_PERCENTAGE) {
 		if (size != 2) {
 			g_set_error (error, 1, 0, "invalid command'%s', size %i", command, size);
 			return FALSE;
@@ -336,7 +447,7 @@ pk_backend_spawn_parse_stdout (PkBackendSpawn *backend_spawn,
 		} else {
 			pk_backend_job_set_percentage (job, percentage);
 		}
-	} else if (g_strcmp0 (command, "item-progress") == 0) {
+	} else if (command_enum == PK_BACKEND_SPAWN_COMMAND_ITEM_PROGRESS) {
 		if (size != 4) {
 			g_set_error (error, 1, 0, "invalid command'%s', size %i", command, size);
 			return FALSE;
@@ -362,7 +473,7 @@ pk_backend_spawn_parse_stdout (PkBackendSpawn *backend_spawn,
 						  sections[1],
 						  status_enum,
 						  percentage);
-	} else if (g_strcmp0 (command, "error") == 0) {
+	} else if (command_enum == PK_BACKEND_SPAWN_COMMAND_ERROR) {
 		if (size != 3) {
 			g_set_error (error, 1, 0, "invalid command'%s', size %i", command, size);
 			return FALSE;
@@ -383,7 +494,7 @@ pk_backend_spawn_parse_stdout (PkBackendSpawn *backend_spawn,
 
 		pk_backend_job_error_code (job, error_enum, "%s", text);
 		g_free (text);
-	} else if (g_strcmp0 (command, "requirerestart") == 0) {
+	} else if (command_enum == PK_BACKEND_SPAWN_COMMAND_REQUIRERESTART) {
 		if (size != 3) {
 			g_set_error (error, 1, 0, "invalid command'%s', size %i", command, size);
 			return FALSE;
@@ -398,7 +509,7 @@ pk_backend_spawn_parse_stdout (PkBackendSpawn *backend_spawn,
 			return FALSE;
 		}
 		pk_backend_job_require_restart (job, restart_enum, sections[2]);
-	} else if (g_strcmp0 (command, "status") == 0) {
+	} else if (command_enum == PK_BACKEND_SPAWN_COMMAND_STATUS) {
 		if (size != 2) {
 			g_set_error (error, 1, 0, "invalid command'%s', size %i", command, size);
 			return FALSE;
@@ -409,7 +520,7 @@ pk_backend_spawn_parse_stdout (PkBackendSpawn *backend_spawn,
 			return FALSE;
 		}
 		pk_backend_job_set_status (job, status_enum);
-	} else if (g_strcmp0 (command, "speed") == 0) {
+	} else if (command_enum == PK_BACKEND_SPAWN_COMMAND_SPEED) {
 		if (size != 2) {
 			g_set_error (error, 1, 0, "invalid command'%s', size %i", command, size);
 			return FALSE;
@@ -421,7 +532,7 @@ pk_backend_spawn_parse_stdout (PkBackendSpawn *backend_spawn,
 			return FALSE;
 		}
 		pk_backend_job_set_speed (job, speed);
-	} else if (g_strcmp0 (command, "download-size-remaining") == 0) {
+	} else if (command_enum == PK_BACKEND_SPAWN_COMMAND_DOWNLOAD_SIZE_REMAINING) {
 		if (size != 2) {
 			g_set_error (error, 1, 0, "invalid command'%s', size %i", command, size);
 			return FALSE;
@@ -433,7 +544,7 @@ pk_backend_spawn_parse_stdout (PkBackendSpawn *backend_spawn,
 			return FALSE;
 		}
 		pk_backend_job_set_download_size_remaining (job, download_size_remaining);
-	} else if (g_strcmp0 (command, "allow-cancel") == 0) {
+	} else if (command_enum == PK_BACKEND_SPAWN_COMMAND_ALLOW_CANCEL) {
 		if (size != 2) {
 			g_set_error (error, 1, 0, "invalid command'%s', size %i", command, size);
 			return FALSE;
@@ -446,13 +557,13 @@ pk_backend_spawn_parse_stdout (PkBackendSpawn *backend_spawn,
 			g_set_error (error, 1, 0, "invalid section '%s'", sections[1]);
 			return FALSE;
 		}
-	} else if (g_strcmp0 (command, "no-percentage-updates") == 0) {
+	} else if (command_enum == PK_BACKEND_SPAWN_COMMAND_NO_PERCENTAGE_UPDATES) {
 		if (size != 1) {
 			g_set_error (error, 1, 0, "invalid command'%s', size %i", command, size);
 			return FALSE;
 		}
 		pk_backend_job_set_percentage (job, PK_BACKEND_PERCENTAGE_INVALID);
-	} else if (g_strcmp0 (command, "repo-signature-required") == 0) {
+	} else if (command_enum == PK_BACKEND_SPAWN_COMMAND_REPO_SIGNATURE_REQUIRED) {
 
 		if (size != 9) {
 			g_set_error (error, 1, 0, "invalid command'%s', size %i", command, size);
@@ -477,7 +588,7 @@ pk_backend_spawn_parse_stdout (PkBackendSpawn *backend_spawn,
 		pk_backend_job_repo_signature_required (job, sections[1],
 							  sections[2], sections[3], sections[4],
 							  sections[5], sections[6], sections[7], sig_type);
-	} else if (g_strcmp0 (command, "eula-required") == 0) {
+	} else if (command_enum == PK_BACKEND_SPAWN_COMMAND_EULA_REQUIRED) {
 
 		if (size != 5) {
 			g_set_error (error, 1, 0, "invalid command'%s', size %i", command, size);
@@ -500,7 +611,7 @@ pk_backend_spawn_parse_stdout (PkBackendSpawn *backend_spawn,
 		}
 
 		pk_backend_job_eula_required (job, sections[1], sections[2], sections[3], sections[4]);
-	} else if (g_strcmp0 (command, "media-change-required") == 0) {
+	} else if (command_enum == PK_BACKEND_SPAWN_COMMAND_MEDIA_CHANGE_REQUIRED) {
 
 		if (size != 4) {
 			g_set_error (error, 1, 0, "invalid command'%s', size %i", command, size);
@@ -514,7 +625,7 @@ pk_backend_spawn_parse_stdout (PkBackendSpawn *backend_spawn,
 		}
 
 		pk_backend_job_media_change_required (job, media_type_enum, sections[2], sections[3]);
-	} else if (g_strcmp0 (command, "distro-upgrade") == 0) {
+	} else if (command_enum == PK_BACKEND_SPAWN_COMMAND_DISTRO_UPGRADE) {
 
 		if (size != 4) {
 			g_set_error (error, 1, 0, "invalid command'%s', size %i", command, size);
@@ -535,7 +646,7 @@ pk_backend_spawn_parse_stdout (PkBackendSpawn *backend_spawn,
 		}
 
 		pk_backend_job_distro_upgrade (job, distro_upgrade_enum, sections[2], sections[3]);
-	} else if (g_strcmp0 (command, "category") == 0) {
+	} else if (command_enum == PK_BACKEND_SPAWN_COMMAND_CATEGORY) {
 
 		if (size != 6) {
 			g_set_error (error, 1, 0, "invalid command'%s', size %i", command, size);
@@ -1109,6 +1220,7 @@ pk_backend_spawn_finalize (GObject *object)
 		g_source_remove (backend_spawn->priv->kill_id);
 
 	g_free (backend_spawn->priv->name);
+	g_string_free (backend_spawn->priv->line_buf, TRUE);
 	g_key_file_unref (backend_spawn->priv->conf);
 	g_object_unref (backend_spawn->priv->spawn);
 	if (backend_spawn->priv->backend != NULL)
@@ -1135,6 +1247,7 @@ static void
 pk_backend_spawn_init (PkBackendSpawn *backend_spawn)
 {
 	backend_spawn->priv = PK_BACKEND_SPAWN_GET_PRIVATE (backend_spawn);
+	backend_spawn->priv->line_buf = g_string_new (NULL);
 }
 
 /**
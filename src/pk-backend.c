@@ -68,6 +68,7 @@ typedef struct {
 	PkBitfield	(*get_provides)			(PkBackend	*backend);
 	gchar		**(*get_mime_types)		(PkBackend	*backend);
 	gboolean	(*supports_parallelization)	(PkBackend	*backend);
+	gchar		*(*get_database_stamp)		(PkBackend	*backend);
 	void		(*job_start)			(PkBackend	*backend,
 							 PkBackendJob	*job);
 	void		(*job_reset)			(PkBackend	*backend,
@@ -257,6 +258,24 @@ pk_backend_supports_parallelization (PkBackend	*backend)
 	return backend->priv->desc->supports_parallelization (backend);
 }
 
+/**
+ * pk_backend_get_database_stamp:
+ *
+ * Returns: (transfer full): a string that changes whenever the package
+ * database is changed, or %NULL if the backend can't tell
+ **/
+gchar *
+pk_backend_get_database_stamp (PkBackend *backend)
+{
+	g_return_val_if_fail (PK_IS_BACKEND (backend), NULL);
+	g_return_val_if_fail (backend->priv->loaded, NULL);
+
+	/* not compulsory */
+	if (backend->priv->desc->get_database_stamp == NULL)
+		return NULL;
+	return backend->priv->desc->get_database_stamp (backend);
+}
+
 /**
  * pk_backend_thread_start:
  **/
@@ -539,6 +558,7 @@ pk_backend_load (PkBackend *backend, GError **error)
 		g_module_symbol (handle, "pk_backend_get_groups", (gpointer *)&desc->get_groups);
 		g_module_symbol (handle, "pk_backend_get_mime_types", (gpointer *)&desc->get_mime_types);
 		g_module_symbol (handle, "pk_backend_supports_parallelization", (gpointer *)&desc->supports_parallelization);
+		g_module_symbol (handle, "pk_backend_get_database_stamp", (gpointer *)&desc->get_database_stamp);
 		g_module_symbol (handle, "pk_backend_get_packages", (gpointer *)&desc->get_packages);
 		g_module_symbol (handle, "pk_backend_get_repo_list", (gpointer *)&desc->get_repo_list);
 		g_module_symbol (handle, "pk_backend_required_by", (gpointer *)&desc->required_by);
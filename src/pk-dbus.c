@@ -42,12 +42,353 @@ struct PkDbusPrivate
 	GDBusProxy		*proxy_pid;
 	GDBusProxy		*proxy_uid;
 	GDBusProxy		*proxy_session;
+	GHashTable		*credentials;
+	GPtrArray		*requests;
+	guint			 name_owner_changed_id;
 };
 
+typedef struct {
+	guint			 uid;
+	guint			 pid;
+} PkDbusCredentials;
+
+typedef struct {
+	gchar			*sender;
+	guint			 uid;
+	gboolean		 vanished;
+} PkDbusRequest;
+
 static gpointer pk_dbus_object = NULL;
 
 G_DEFINE_TYPE (PkDbus, pk_dbus, G_TYPE_OBJECT)
 
+/**
+ * pk_dbus_credentials_new_from_variant:
+ *
+ * Parses the reply of GetConnectionCredentials.
+ **/
+static PkDbusCredentials *
+pk_dbus_credentials_new_from_variant (GVariant *value)
+{
+	PkDbusCredentials *cred;
+	_cleanup_variant_unref_ GVariant *dict = NULL;
+
+	cred = g_new0 (PkDbusCredentials, 1);
+	dict = g_variant_get_child_value (value, 0);
+	if (!g_variant_lookup (dict, "UnixUserID", "u", &cred->uid))
+		cred->uid = G_MAXUINT;
+	if (!g_variant_lookup (dict, "ProcessID", "u", &cred->pid))
+		cred->pid = G_MAXUINT;
+	return cred;
+}
+
+/**
+ * pk_dbus_credentials_new_legacy:
+ *
+ * Gets the credentials one at a time for message buses that are too old
+ * to support GetConnectionCredentials.
+ **/
+static PkDbusCredentials *
+pk_dbus_credentials_new_legacy (PkDbus *dbus, const gchar *sender, GError **error)
+{
+	PkDbusCredentials *cred;
+	_cleanup_variant_unref_ GVariant *value_uid = NULL;
+	_cleanup_variant_unref_ GVariant *value_pid = NULL;
+
+	value_uid = g_dbus_proxy_call_sync (dbus->priv->proxy_uid,
+					    "GetConnectionUnixUser",
+					    g_variant_new ("(s)", sender),
+					    G_DBUS_CALL_FLAGS_NONE,
+					    2000,
+					    NULL,
+					    error);
+	if (value_uid == NULL)
+		return NULL;
+	value_pid = g_dbus_proxy_call_sync (dbus->priv->proxy_pid,
+					    "GetConnectionUnixProcessID",
+					    g_variant_new ("(s)", sender),
+					    G_DBUS_CALL_FLAGS_NONE,
+					    2000,
+					    NULL,
+					    error);
+	if (value_pid == NULL)
+		return NULL;
+	cred = g_new0 (PkDbusCredentials, 1);
+	g_variant_get (value_uid, "(u)", &cred->uid);
+	g_variant_get (value_pid, "(u)", &cred->pid);
+	return cred;
+}
+
+/**
+ * pk_dbus_get_credentials:
+ *
+ * Gets the credentials for the sender, blocking on the bus if they are not
+ * already cached.
+ *
+ * Return value: the credentials owned by @dbus, or %NULL on error
+ **/
+static PkDbusCredentials *
+pk_dbus_get_credentials (PkDbus *dbus, const gchar *sender)
+{
+	PkDbusCredentials *cred;
+	_cleanup_error_free_ GError *error = NULL;
+	_cleanup_variant_unref_ GVariant *value = NULL;
+
+	/* already resolved */
+	cred = g_hash_table_lookup (dbus->priv->credentials, sender);
+	if (cred != NULL)
+		return cred;
+
+	/* no connection to DBus */
+	if (dbus->priv->proxy_uid == NULL)
+		return NULL;
+
+	value = g_dbus_proxy_call_sync (dbus->priv->proxy_uid,
+					"GetConnectionCredentials",
+					g_variant_new ("(s)", sender),
+					G_DBUS_CALL_FLAGS_NONE,
+					2000,
+					NULL,
+					&error);
+	if (value != NULL) {
+		cred = pk_dbus_credentials_new_from_variant (value);
+	} else if (g_error_matches (error, G_DBUS_ERROR, G_DBUS_ERROR_UNKNOWN_METHOD)) {
+		g_clear_error (&error);
+		cred = pk_dbus_credentials_new_legacy (dbus, sender, &error);
+	}
+	if (cred == NULL) {
+		g_warning ("Failed to get credentials for %s: %s",
+			   sender, error->message);
+		return NULL;
+	}
+	g_hash_table_insert (dbus->priv->credentials, g_strdup (sender), cred);
+	return cred;
+}
+
+/**
+ * pk_dbus_request_free:
+ **/
+static void
+pk_dbus_request_free (PkDbusRequest *request)
+{
+	g_free (request->sender);
+	g_free (request);
+}
+
+/**
+ * pk_dbus_get_credentials_return:
+ *
+ * Completes the task, saving the credentials unless the sender went away
+ * while they were being resolved.
+ **/
+static void
+pk_dbus_get_credentials_return (GTask *task, PkDbusCredentials *cred, GError *error)
+{
+	PkDbus *dbus = PK_DBUS (g_task_get_source_object (task));
+	PkDbusRequest *request = g_task_get_task_data (task);
+
+	g_ptr_array_remove (dbus->priv->requests, request);
+	if (cred == NULL) {
+		g_task_return_error (task, error);
+		g_object_unref (task);
+		return;
+	}
+
+	/* NameOwnerChanged arrived first, so nothing would remove the entry */
+	if (request->vanished) {
+		g_free (cred);
+		g_task_return_new_error (task, G_IO_ERROR, G_IO_ERROR_CLOSED,
+					 "%s disconnected", request->sender);
+		g_object_unref (task);
+		return;
+	}
+
+	/* another request may have beaten us to it */
+	if (g_hash_table_lookup (dbus->priv->credentials, request->sender) == NULL)
+		g_hash_table_insert (dbus->priv->credentials, g_strdup (request->sender), cred);
+	else
+		g_free (cred);
+	g_task_return_boolean (task, TRUE);
+	g_object_unref (task);
+}
+
+/**
+ * pk_dbus_get_credentials_pid_cb:
+ **/
+static void
+pk_dbus_get_credentials_pid_cb (GObject *source_object,
+				GAsyncResult *res,
+				gpointer user_data)
+{
+	GTask *task = G_TASK (user_data);
+	PkDbusCredentials *cred = NULL;
+	PkDbusRequest *request = g_task_get_task_data (task);
+	GError *error = NULL;
+	_cleanup_variant_unref_ GVariant *value = NULL;
+
+	value = g_dbus_proxy_call_finish (G_DBUS_PROXY (source_object), res, &error);
+	if (value != NULL) {
+		cred = g_new0 (PkDbusCredentials, 1);
+		cred->uid = request->uid;
+		g_variant_get (value, "(u)", &cred->pid);
+	}
+	pk_dbus_get_credentials_return (task, cred, error);
+}
+
+/**
+ * pk_dbus_get_credentials_uid_cb:
+ **/
+static void
+pk_dbus_get_credentials_uid_cb (GObject *source_object,
+				GAsyncResult *res,
+				gpointer user_data)
+{
+	GTask *task = G_TASK (user_data);
+	PkDbus *dbus = PK_DBUS (g_task_get_source_object (task));
+	PkDbusRequest *request = g_task_get_task_data (task);
+	GError *error = NULL;
+	_cleanup_variant_unref_ GVariant *value = NULL;
+
+	value = g_dbus_proxy_call_finish (G_DBUS_PROXY (source_object), res, &error);
+	if (value == NULL) {
+		pk_dbus_get_credentials_return (task, NULL, error);
+		return;
+	}
+	g_variant_get (value, "(u)", &request->uid);
+	g_dbus_proxy_call (dbus->priv->proxy_pid,
+			   "GetConnectionUnixProcessID",
+			   g_variant_new ("(s)", request->sender),
+			   G_DBUS_CALL_FLAGS_NONE,
+			   2000,
+			   g_task_get_cancellable (task),
+			   pk_dbus_get_credentials_pid_cb,
+			   task);
+}
+
+/**
+ * pk_dbus_get_credentials_cb:
+ **/
+static void
+pk_dbus_get_credentials_cb (GObject *source_object,
+			    GAsyncResult *res,
+			    gpointer user_data)
+{
+	GTask *task = G_TASK (user_data);
+	PkDbus *dbus = PK_DBUS (g_task_get_source_object (task));
+	PkDbusCredentials *cred = NULL;
+	PkDbusRequest *request = g_task_get_task_data (task);
+	GError *error = NULL;
+	_cleanup_variant_unref_ GVariant *value = NULL;
+
+	value = g_dbus_proxy_call_finish (G_DBUS_PROXY (source_object), res, &error);
+	if (value != NULL) {
+		cred = pk_dbus_credentials_new_from_variant (value);
+	} else if (g_error_matches (error, G_DBUS_ERROR, G_DBUS_ERROR_UNKNOWN_METHOD)) {
+		/* the bus is too old, get the credentials one at a time */
+		g_clear_error (&error);
+		g_dbus_proxy_call (dbus->priv->proxy_uid,
+				   "GetConnectionUnixUser",
+				   g_variant_new ("(s)", request->sender),
+				   G_DBUS_CALL_FLAGS_NONE,
+				   2000,
+				   g_task_get_cancellable (task),
+				   pk_dbus_get_credentials_uid_cb,
+				   task);
+		return;
+	}
+	pk_dbus_get_credentials_return (task, cred, error);
+}
+
+/**
+ * pk_dbus_get_credentials_async:
+ * @dbus: the #PkDbus instance
+ * @sender: the sender
+ * @cancellable: a #GCancellable or %NULL
+ * @callback: the function to run on completion
+ * @user_data: the data to pass to @callback
+ *
+ * Resolves the credentials of the sender using a single
+ * GetConnectionCredentials call without blocking the main loop. Once this
+ * completes the other pk_dbus_get_*() functions for @sender return without
+ * calling the bus, until the sender disconnects.
+ **/
+void
+pk_dbus_get_credentials_async (PkDbus *dbus,
+			       const gchar *sender,
+			       GCancellable *cancellable,
+			       GAsyncReadyCallback callback,
+			       gpointer user_data)
+{
+	GTask *task;
+	PkDbusRequest *request;
+
+	g_return_if_fail (PK_IS_DBUS (dbus));
+	g_return_if_fail (sender != NULL);
+
+	task = g_task_new (dbus, cancellable, callback, user_data);
+
+	/* set in the test suite, or already resolved */
+	if (g_strcmp0 (sender, ":org.freedesktop.PackageKit") == 0 ||
+	    g_hash_table_lookup (dbus->priv->credentials, sender) != NULL) {
+		g_task_return_boolean (task, TRUE);
+		g_object_unref (task);
+		return;
+	}
+
+	/* no connection to DBus */
+	if (dbus->priv->proxy_uid == NULL || dbus->priv->proxy_pid == NULL) {
+		g_task_return_new_error (task, G_IO_ERROR, G_IO_ERROR_NOT_CONNECTED,
+					 "no connection to the system bus");
+		g_object_unref (task);
+		return;
+	}
+
+	/* watched for NameOwnerChanged until the reply arrives */
+	request = g_new0 (PkDbusRequest, 1);
+	request->sender = g_strdup (sender);
+	g_task_set_task_data (task, request, (GDestroyNotify) pk_dbus_request_free);
+	g_ptr_array_add (dbus->priv->requests, request);
+
+	g_dbus_proxy_call (dbus->priv->proxy_uid,
+			   "GetConnectionCredentials",
+			   g_variant_new ("(s)", sender),
+			   G_DBUS_CALL_FLAGS_NONE,
+			   2000,
+			   cancellable,
+			   pk_dbus_get_credentials_cb,
+			   task);
+}
+
+/**
+ * pk_dbus_get_credentials_finish:
+ * @dbus: the #PkDbus instance
+ * @res: the #GAsyncResult
+ * @error: A #GError or %NULL
+ *
+ * Gets the result of pk_dbus_get_credentials_async().
+ *
+ * Return value: %TRUE if the credentials were resolved
+ **/
+gboolean
+pk_dbus_get_credentials_finish (PkDbus *dbus, GAsyncResult *res, GError **error)
+{
+	g_return_val_if_fail (PK_IS_DBUS (dbus), FALSE);
+	g_return_val_if_fail (g_task_is_valid (res, dbus), FALSE);
+	return g_task_propagate_boolean (G_TASK (res), error);
+}
+
+/**
+ * pk_dbus_get_cache_size:
+ *
+ * Return value: the number of senders with cached credentials
+ **/
+guint
+pk_dbus_get_cache_size (PkDbus *dbus)
+{
+	g_return_val_if_fail (PK_IS_DBUS (dbus), 0);
+	return g_hash_table_size (dbus->priv->credentials);
+}
+
 /**
  * pk_dbus_get_uid:
  * @dbus: the #PkDbus instance
@@ -60,9 +401,7 @@ G_DEFINE_TYPE (PkDbus, pk_dbus, G_TYPE_OBJECT)
 guint
 pk_dbus_get_uid (PkDbus *dbus, const gchar *sender)
 {
-	guint uid = G_MAXUINT;
-	_cleanup_error_free_ GError *error = NULL;
-	_cleanup_variant_unref_ GVariant *value = NULL;
+	PkDbusCredentials *cred;
 
 	g_return_val_if_fail (PK_IS_DBUS (dbus), G_MAXUINT);
 	g_return_val_if_fail (sender != NULL, G_MAXUINT);
@@ -72,21 +411,10 @@ pk_dbus_get_uid (PkDbus *dbus, const gchar *sender)
 		g_debug ("using self-check shortcut");
 		return 500;
 	}
-	value = g_dbus_proxy_call_sync (dbus->priv->proxy_uid,
-					"GetConnectionUnixUser",
-					g_variant_new ("(s)",
-						       sender),
-					G_DBUS_CALL_FLAGS_NONE,
-					2000,
-					NULL,
-					&error);
-	if (value == NULL) {
-		g_warning ("Failed to get uid for %s: %s",
-			   sender, error->message);
+	cred = pk_dbus_get_credentials (dbus, sender);
+	if (cred == NULL)
 		return G_MAXUINT;
-	}
-	g_variant_get (value, "(u)", &uid);
-	return uid;
+	return cred->uid;
 }
 
 /**
@@ -101,9 +429,7 @@ pk_dbus_get_uid (PkDbus *dbus, const gchar *sender)
 static guint
 pk_dbus_get_pid (PkDbus *dbus, const gchar *sender)
 {
-	guint pid = G_MAXUINT;
-	_cleanup_error_free_ GError *error = NULL;
-	_cleanup_variant_unref_ GVariant *value = NULL;
+	PkDbusCredentials *cred;
 
 	g_return_val_if_fail (PK_IS_DBUS (dbus), G_MAXUINT);
 	g_return_val_if_fail (sender != NULL, G_MAXUINT);
@@ -113,27 +439,10 @@ pk_dbus_get_pid (PkDbus *dbus, const gchar *sender)
 		g_debug ("using self-check shortcut");
 		return G_MAXUINT - 1;
 	}
-
-	/* no connection to DBus */
-	if (dbus->priv->proxy_pid == NULL)
+	cred = pk_dbus_get_credentials (dbus, sender);
+	if (cred == NULL)
 		return G_MAXUINT;
-
-	/* get pid from DBus */
-	value = g_dbus_proxy_call_sync (dbus->priv->proxy_pid,
-					"GetConnectionUnixProcessID",
-					g_variant_new ("(s)",
-						       sender),
-					G_DBUS_CALL_FLAGS_NONE,
-					2000,
-					NULL,
-					&error);
-	if (value == NULL) {
-		g_warning ("Failed to get pid for %s: %s",
-			   sender, error->message);
-		return G_MAXUINT;
-	}
-	g_variant_get (value, "(u)", &pid);
-	return pid;
+	return cred->pid;
 }
 
 /**
@@ -286,14 +595,58 @@ pk_dbus_finalize (GObject *object)
 	g_return_if_fail (PK_IS_DBUS (object));
 	dbus = PK_DBUS (object);
 
-	g_object_unref (dbus->priv->proxy_pid);
-	g_object_unref (dbus->priv->proxy_uid);
+	if (dbus->priv->name_owner_changed_id != 0) {
+		g_dbus_connection_signal_unsubscribe (dbus->priv->connection,
+						      dbus->priv->name_owner_changed_id);
+	}
+	if (dbus->priv->proxy_pid != NULL)
+		g_object_unref (dbus->priv->proxy_pid);
+	if (dbus->priv->proxy_uid != NULL)
+		g_object_unref (dbus->priv->proxy_uid);
 	if (dbus->priv->proxy_session != NULL)
 		g_object_unref (dbus->priv->proxy_session);
+	if (dbus->priv->connection != NULL)
+		g_object_unref (dbus->priv->connection);
+	g_hash_table_unref (dbus->priv->credentials);
+	g_ptr_array_unref (dbus->priv->requests);
 
 	G_OBJECT_CLASS (pk_dbus_parent_class)->finalize (object);
 }
 
+/**
+ * pk_dbus_name_owner_changed_cb:
+ *
+ * Forgets the credentials of a sender when it disconnects from the bus.
+ **/
+static void
+pk_dbus_name_owner_changed_cb (GDBusConnection *connection,
+			       const gchar *sender_name,
+			       const gchar *object_path,
+			       const gchar *interface_name,
+			       const gchar *signal_name,
+			       GVariant *parameters,
+			       gpointer user_data)
+{
+	PkDbus *dbus = PK_DBUS (user_data);
+	PkDbusRequest *request;
+	const gchar *name;
+	const gchar *old_owner;
+	const gchar *new_owner;
+	guint i;
+
+	g_variant_get (parameters, "(&s&s&s)", &name, &old_owner, &new_owner);
+	if (new_owner[0] != '\0')
+		return;
+	g_hash_table_remove (dbus->priv->credentials, name);
+
+	/* don't save what is still being resolved */
+	for (i = 0; i < dbus->priv->requests->len; i++) {
+		request = g_ptr_array_index (dbus->priv->requests, i);
+		if (g_strcmp0 (request->sender, name) == 0)
+			request->vanished = TRUE;
+	}
+}
+
 /**
  * pk_dbus_class_init:
  **/
@@ -318,6 +671,9 @@ pk_dbus_init (PkDbus *dbus)
 {
 	_cleanup_error_free_ GError *error = NULL;
 	dbus->priv = PK_DBUS_GET_PRIVATE (dbus);
+	dbus->priv->credentials = g_hash_table_new_full (g_str_hash, g_str_equal,
+							 g_free, g_free);
+	dbus->priv->requests = g_ptr_array_new ();
 
 	/* use the bus to get the uid */
 	dbus->priv->connection = g_bus_get_sync (G_BUS_TYPE_SYSTEM,
@@ -327,6 +683,20 @@ pk_dbus_init (PkDbus *dbus)
 		return;
 	}
 
+	/* unique names are never reused, so cached credentials only have
+	 * to be dropped when the sender goes away */
+	dbus->priv->name_owner_changed_id =
+		g_dbus_connection_signal_subscribe (dbus->priv->connection,
+						    "org.freedesktop.DBus",
+						    "org.freedesktop.DBus",
+						    "NameOwnerChanged",
+						    "/org/freedesktop/DBus",
+						    NULL,
+						    G_DBUS_SIGNAL_FLAGS_NONE,
+						    pk_dbus_name_owner_changed_cb,
+						    dbus,
+						    NULL);
+
 	/* connect to DBus so we can get the pid */
 	dbus->priv->proxy_pid =
 		g_dbus_proxy_new_sync (dbus->priv->connection,
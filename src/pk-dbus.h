@@ -23,6 +23,7 @@
 #define __PK_DBUS_H
 
 #include <glib-object.h>
+#include <gio/gio.h>
 
 G_BEGIN_DECLS
 
@@ -49,6 +50,15 @@ typedef struct
 GType		 pk_dbus_get_type		(void);
 PkDbus		*pk_dbus_new			(void);
 
+void		 pk_dbus_get_credentials_async	(PkDbus		*dbus,
+						 const gchar	*sender,
+						 GCancellable	*cancellable,
+						 GAsyncReadyCallback callback,
+						 gpointer	 user_data);
+gboolean	 pk_dbus_get_credentials_finish	(PkDbus		*dbus,
+						 GAsyncResult	*res,
+						 GError		**error);
+guint		 pk_dbus_get_cache_size		(PkDbus		*dbus);
 guint		 pk_dbus_get_uid		(PkDbus		*dbus,
 						 const gchar	*sender);
 gchar		*pk_dbus_get_cmdline		(PkDbus		*dbus,
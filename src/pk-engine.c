@@ -48,6 +48,7 @@
 #include "pk-engine.h"
 #include "pk-network.h"
 #include "pk-notify.h"
+#include "pk-results-cache.h"
 #include "pk-shared.h"
 #include "pk-transaction-db.h"
 #include "pk-transaction.h"
@@ -55,6 +56,9 @@
 
 static void     pk_engine_finalize	(GObject       *object);
 static void	pk_engine_set_locked (PkEngine *engine, gboolean is_locked);
+static void	pk_engine_emit_property_changed (PkEngine *engine,
+						 const gchar *property_name,
+						 GVariant *property_value);
 
 #define PK_ENGINE_GET_PRIVATE(o) (G_TYPE_INSTANCE_GET_PRIVATE ((o), PK_TYPE_ENGINE, PkEnginePrivate))
 
@@ -74,6 +78,7 @@ struct PkEnginePrivate
 	PkBackend		*backend;
 	PkNetwork		*network;
 	PkNotify		*notify;
+	PkResultsCache		*results_cache;
 	GKeyFile		*conf;
 	PkDbus			*dbus;
 	GFileMonitor		*monitor_conf;
@@ -184,6 +189,9 @@ pk_engine_transaction_list_changed_cb (PkScheduler *tlist, PkEngine *engine)
 				       g_variant_new ("(^a&s)",
 						      transaction_list),
 				       NULL);
+	pk_engine_emit_property_changed (engine,
+					 "SchedulerLanes",
+					 pk_scheduler_get_lanes (tlist));
 	pk_engine_reset_timer (engine);
 }
 
@@ -371,6 +379,24 @@ pk_engine_notify_updates_changed_cb (PkNotify *notify, PkEngine *engine)
 				       NULL);
 }
 
+/**
+ * pk_engine_results_cache_changed_cb:
+ **/
+static void
+pk_engine_results_cache_changed_cb (PkResultsCache *cache, PkEngine *engine)
+{
+	g_return_if_fail (PK_IS_ENGINE (engine));
+
+	/* the next instance of the daemon has to use a new generation too */
+	pk_transaction_db_set_cache_generation (engine->priv->transaction_db,
+						pk_results_cache_get_generation (cache));
+
+	/* clients keep their own copy of query results */
+	pk_engine_emit_property_changed (engine,
+					 "CacheGeneration",
+					 g_variant_new_uint64 (pk_results_cache_get_generation (cache)));
+}
+
 /**
  * pk_engine_state_changed_cb:
  *
@@ -931,6 +957,10 @@ pk_engine_setup_file_monitors (PkEngine *engine)
 gboolean
 pk_engine_load_backend (PkEngine *engine, GError **error)
 {
+	guint64 generation;
+	_cleanup_free_ gchar *stamp = NULL;
+	_cleanup_free_ gchar *stamp_saved = NULL;
+
 	/* load any backend init */
 	if (!pk_backend_load (engine->priv->backend, error))
 		return FALSE;
@@ -942,6 +972,23 @@ pk_engine_load_backend (PkEngine *engine, GError **error)
 	if (!pk_transaction_db_load (engine->priv->transaction_db, error))
 		return FALSE;
 
+	/* clients can keep their cached results across restarts, but only
+	 * if the packages were provably not changed while we were not
+	 * running, e.g. by dpkg or rpm directly */
+	generation = pk_transaction_db_get_cache_generation (engine->priv->transaction_db);
+	stamp = pk_backend_get_database_stamp (engine->priv->backend);
+	stamp_saved = pk_transaction_db_get_cache_stamp (engine->priv->transaction_db);
+	if (generation == 0) {
+		generation = pk_results_cache_get_generation (engine->priv->results_cache);
+	} else if (stamp == NULL || g_strcmp0 (stamp, stamp_saved) != 0) {
+		g_debug ("package database may have changed, new cache generation");
+		generation++;
+	}
+	pk_transaction_db_set_cache_generation (engine->priv->transaction_db, generation);
+	if (stamp != NULL)
+		pk_transaction_db_set_cache_stamp (engine->priv->transaction_db, stamp);
+	pk_results_cache_set_generation (engine->priv->results_cache, generation);
+
 	/* create a new backend so we can get the static stuff */
 	engine->priv->roles = pk_backend_get_roles (engine->priv->backend);
 	engine->priv->groups = pk_backend_get_groups (engine->priv->backend);
@@ -1042,6 +1089,10 @@ pk_engine_daemon_get_property (GDBusConnection *connection_, const gchar *sender
 		return g_variant_new_uint32 (engine->priv->network_state);
 	if (g_strcmp0 (property_name, "DistroId") == 0)
 		return _g_variant_new_maybe_string (engine->priv->distro_id);
+	if (g_strcmp0 (property_name, "SchedulerLanes") == 0)
+		return pk_scheduler_get_lanes (engine->priv->scheduler);
+	if (g_strcmp0 (property_name, "CacheGeneration") == 0)
+		return g_variant_new_uint64 (pk_results_cache_get_generation (engine->priv->results_cache));
 
 	/* return an error */
 	g_set_error (error,
@@ -1053,179 +1104,100 @@ pk_engine_daemon_get_property (GDBusConnection *connection_, const gchar *sender
 }
 
 /**
- * pk_engine_package_name_in_strv:
+ * pk_engine_get_package_history:
  **/
-static gboolean
-pk_engine_package_name_in_strv (gchar **strv, PkPackage *pkg)
+static GVariant *
+pk_engine_get_package_history (PkEngine *engine,
+			       gchar **package_names,
+			       guint max_size,
+			       GError **error)
 {
 	guint i;
-	for (i = 0; strv[i] != NULL; i++) {
-		if (g_strcmp0 (strv[i], pk_package_get_name (pkg)) == 0)
-			return TRUE;
+	guint found = 0;
+	GVariant *value;
+	GVariantBuilder builder;
+
+	/* we have an indexed history for each package name, where each
+	 * entry is a GVariant of type aa{sv} */
+	g_variant_builder_init (&builder, G_VARIANT_TYPE ("a{saa{sv}}"));
+	for (i = 0; package_names[i] != NULL; i++) {
+		value = pk_transaction_db_get_package_history (engine->priv->transaction_db,
+							       package_names[i],
+							       max_size);
+		if (value == NULL)
+			continue;
+		g_variant_builder_add (&builder, "{s@aa{sv}}", package_names[i], value);
+		found++;
 	}
-	return FALSE;
-}
 
-/**
- * pk_engine_get_package_history_pkg:
- *
- * Create a 'a{sv}' GVariant instance from all the PkTransactionPast data
- **/
-static GVariant *
-pk_engine_get_package_history_pkg (PkTransactionPast *item, PkPackage *pkg)
-{
-	GVariantBuilder builder;
-	g_variant_builder_init (&builder, G_VARIANT_TYPE_ARRAY);
-	g_variant_builder_add (&builder, "{sv}", "info",
-			       g_variant_new_uint32 (pk_package_get_info (pkg)));
-	g_variant_builder_add (&builder, "{sv}", "source",
-			       g_variant_new_string (pk_package_get_data (pkg)));
-	g_variant_builder_add (&builder, "{sv}", "version",
-			       g_variant_new_string (pk_package_get_version (pkg)));
-	g_variant_builder_add (&builder, "{sv}", "timestamp",
-			       g_variant_new_uint64 (pk_transaction_past_get_timestamp (item)));
-	g_variant_builder_add (&builder, "{sv}", "user-id",
-			       g_variant_new_uint32 (pk_transaction_past_get_uid (item)));
+	/* no history returns an empty array */
+	if (found == 0) {
+		g_variant_builder_clear (&builder);
+		return g_variant_new_array (G_VARIANT_TYPE ("{saa{sv}}"), NULL, 0);
+	}
 	return g_variant_builder_end (&builder);
 }
 
+typedef struct {
+	PkEngine		*engine;
+	GDBusMethodInvocation	*invocation;
+} PkEngineCreateTransactionHelper;
+
 /**
- * pk_engine_is_package_history_interesing:
+ * pk_engine_create_transaction_helper_new:
  **/
-static gboolean
-pk_engine_is_package_history_interesing (PkPackage *package)
+static PkEngineCreateTransactionHelper *
+pk_engine_create_transaction_helper_new (PkEngine *engine,
+					 GDBusMethodInvocation *invocation)
 {
-	gboolean ret;
-
-	switch (pk_package_get_info (package)) {
-	case PK_INFO_ENUM_INSTALLING:
-	case PK_INFO_ENUM_REMOVING:
-	case PK_INFO_ENUM_UPDATING:
-		ret = TRUE;
-		break;
-	default:
-		ret = FALSE;
-		break;
-	}
-	return ret;
+	PkEngineCreateTransactionHelper *helper;
+	helper = g_new0 (PkEngineCreateTransactionHelper, 1);
+	helper->engine = g_object_ref (engine);
+	helper->invocation = g_object_ref (invocation);
+	return helper;
 }
 
 /**
- * pk_engine_get_package_history:
+ * pk_engine_create_transaction_cb:
  **/
-static GVariant *
-pk_engine_get_package_history (PkEngine *engine,
-			       gchar **package_names,
-			       guint max_size,
-			       GError **error)
+static void
+pk_engine_create_transaction_cb (GObject *source_object,
+				 GAsyncResult *res,
+				 gpointer user_data)
 {
-	const gchar *data;
-	const gchar *pkgname;
-	gboolean ret;
-	gchar *key;
-	gint64 timestamp;
-	GList *l;
-	GList *list;
-	GPtrArray *array = NULL;
-	guint i;
-	GVariantBuilder builder;
-	GVariant *value = NULL;
-	PkTransactionPast *item;
-	_cleanup_hashtable_unref_ GHashTable *deduplicate_hash = NULL;
-	_cleanup_hashtable_unref_ GHashTable *pkgname_hash = NULL;
-	_cleanup_list_free_ GList *keys = NULL;
-	_cleanup_object_unref_ PkPackage *package_tmp = NULL;
-
-	list = pk_transaction_db_get_list (engine->priv->transaction_db, max_size);
-
-	/* simplify the loop */
-	if (max_size == 0)
-		max_size = G_MAXUINT;
-
-	pkgname_hash = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, (GDestroyNotify) g_ptr_array_unref);
-	deduplicate_hash = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
-	package_tmp = pk_package_new ();
-	for (l = list; l != NULL; l = l->next) {
-		_cleanup_strv_free_ gchar **package_lines = NULL;
-		item = PK_TRANSACTION_PAST (l->data);
-
-		/* ignore anything that failed */
-		if (!pk_transaction_past_get_succeeded (item))
-			continue;
+	PkEngineCreateTransactionHelper *helper = user_data;
+	PkEngine *engine = helper->engine;
+	const gchar *sender;
+	_cleanup_error_free_ GError *error = NULL;
+	_cleanup_free_ gchar *tid = NULL;
 
-		/* split up data */
-		data = pk_transaction_past_get_data (item);
-		if (data == NULL)
-			continue;
-		package_lines = g_strsplit (data, "\n", -1);
-		for (i = 0; package_lines[i] != NULL; i++) {
-			ret = pk_package_parse (package_tmp, package_lines[i], error);
-			g_assert (ret);
-
-			/* not the package we care about */
-			if (!pk_engine_package_name_in_strv (package_names, package_tmp))
-				continue;
-
-			/* not a state we care about */
-			if (!pk_engine_is_package_history_interesing (package_tmp))
-				continue;
-
-			/* transactions without a timestamp are not interesting */
-			timestamp = pk_transaction_past_get_timestamp (item);
-			if (timestamp == 0)
-				continue;
-
-			/* de-duplicate the entry, in the case of multiarch */
-			key = g_strdup_printf ("%s-%" G_GINT64_FORMAT,
-					       pk_package_get_name (package_tmp),
-					       timestamp);
-			if (g_hash_table_lookup (deduplicate_hash, key) != NULL) {
-				g_free (key);
-				continue;
-			}
-			g_hash_table_insert (deduplicate_hash, key, package_lines[i]);
-
-			/* get the blob for this data item */
-			value = pk_engine_get_package_history_pkg (item, package_tmp);
-			if (value == NULL)
-				continue;
-
-			/* find the array */
-			pkgname = pk_package_get_name (package_tmp);
-			array = g_hash_table_lookup (pkgname_hash, pkgname);
-			if (array == NULL) {
-				array = g_ptr_array_new ();
-				g_hash_table_insert (pkgname_hash,
-						     g_strdup (pkgname),
-						     array);
-			}
-			g_ptr_array_add (array, value);
-		}
+	/* if this failed then the transaction will refuse anything that
+	 * needs authorization, just as if the uid lookup failed */
+	if (!pk_dbus_get_credentials_finish (PK_DBUS (source_object), res, &error)) {
+		g_warning ("failed to get credentials: %s", error->message);
+		g_clear_error (&error);
 	}
 
-	/* no history returns an empty array */
-	if (g_hash_table_size (pkgname_hash) == 0) {
-		value = g_variant_new_array (G_VARIANT_TYPE ("{saa{sv}}"), NULL, 0);
+	sender = g_dbus_method_invocation_get_sender (helper->invocation);
+	tid = pk_transaction_db_generate_id (engine->priv->transaction_db);
+	g_assert (tid != NULL);
+	if (!pk_scheduler_create (engine->priv->scheduler, tid, sender, &error)) {
+		g_dbus_method_invocation_return_error (helper->invocation,
+						       PK_ENGINE_ERROR,
+						       PK_ENGINE_ERROR_CANNOT_CHECK_AUTH,
+						       "could not create transaction %s: %s",
+						       tid,
+						       error->message);
 		goto out;
 	}
 
-	/* we have a hash of pkgname:GPtrArray where the GPtrArray is an array
-	 * of GVariants of type a{sv} */
-	g_variant_builder_init (&builder, G_VARIANT_TYPE_ARRAY);
-	keys = g_hash_table_get_keys (pkgname_hash);
-	for (l = keys; l != NULL; l = l->next) {
-		pkgname = l->data;
-		array = g_hash_table_lookup (pkgname_hash, pkgname);
-		/* create aa{sv} */
-		value = g_variant_new_array (NULL,
-					     (GVariant * const *) array->pdata,
-					     MIN (array->len, max_size));
-		g_variant_builder_add (&builder, "{s@aa{sv}}", pkgname, value);
-	}
-	value = g_variant_builder_end (&builder);
+	g_debug ("sending object path: '%s'", tid);
+	g_dbus_method_invocation_return_value (helper->invocation,
+					       g_variant_new ("(o)", tid));
 out:
-	g_list_free_full (list, (GDestroyNotify) g_object_unref);
-	return value;
+	g_object_unref (helper->engine);
+	g_object_unref (helper->invocation);
+	g_free (helper);
 }
 
 /**
@@ -1238,7 +1210,6 @@ pk_engine_daemon_method_call (GDBusConnection *connection_, const gchar *sender,
 			      GDBusMethodInvocation *invocation, gpointer user_data)
 {
 	const gchar *tmp = NULL;
-	gboolean ret;
 	guint time_since;
 	GVariant *value = NULL;
 	GVariant *tuple = NULL;
@@ -1248,6 +1219,8 @@ pk_engine_daemon_method_call (GDBusConnection *connection_, const gchar *sender,
 	gchar **transaction_list;
 	gchar **package_names;
 	guint size;
+	guint64 cursor;
+	guint64 since;
 	gboolean is_priority = TRUE;
 	_cleanup_error_free_ GError *error = NULL;
 	_cleanup_free_ gchar *data = NULL;
@@ -1298,26 +1271,27 @@ pk_engine_daemon_method_call (GDBusConnection *connection_, const gchar *sender,
 		return;
 	}
 
+	if (g_strcmp0 (method_name, "GetPackageHistorySince") == 0) {
+		g_variant_get (parameters, "(ttu)", &since, &cursor, &size);
+		value = pk_transaction_db_get_history_since (engine->priv->transaction_db,
+							     since, cursor, size,
+							     &cursor);
+		tuple = g_variant_new ("(@aa{sv}t)", value, cursor);
+		g_dbus_method_invocation_return_value (invocation, tuple);
+		return;
+	}
+
 	if (g_strcmp0 (method_name, "CreateTransaction") == 0) {
 
 		g_debug ("CreateTransaction method called");
-		data = pk_transaction_db_generate_id (engine->priv->transaction_db);
-		g_assert (data != NULL);
-		ret = pk_scheduler_create (engine->priv->scheduler,
-					   data, sender, &error);
-		if (!ret) {
-			g_dbus_method_invocation_return_error (invocation,
-							       PK_ENGINE_ERROR,
-							       PK_ENGINE_ERROR_CANNOT_CHECK_AUTH,
-							       "could not create transaction %s: %s",
-							       data,
-							       error->message);
-			return;
-		}
 
-		g_debug ("sending object path: '%s'", data);
-		value = g_variant_new ("(o)", data);
-		g_dbus_method_invocation_return_value (invocation, value);
+		/* the transaction needs the caller uid, so resolve it
+		 * without blocking the daemon and continue when it arrives */
+		pk_dbus_get_credentials_async (engine->priv->dbus,
+					       sender,
+					       NULL,
+					       pk_engine_create_transaction_cb,
+					       pk_engine_create_transaction_helper_new (engine, invocation));
 		return;
 	}
 
@@ -1353,6 +1327,10 @@ pk_engine_daemon_method_call (GDBusConnection *connection_, const gchar *sender,
 
 	if (g_strcmp0 (method_name, "StateHasChanged") == 0) {
 
+		/* the packages may have changed already, so don't answer
+		 * queries from the cache until the delayed refresh */
+		pk_results_cache_invalidate (engine->priv->results_cache);
+
 		/* have we already scheduled priority? */
 		if (engine->priv->timeout_priority_id != 0) {
 			g_debug ("Already asked to refresh priority state less than %i seconds ago",
@@ -1752,6 +1730,11 @@ pk_engine_init (PkEngine *engine)
 	g_signal_connect (engine->priv->notify, "updates-changed",
 			  G_CALLBACK (pk_engine_notify_updates_changed_cb), engine);
 
+	/* keep query results alive between transactions */
+	engine->priv->results_cache = pk_results_cache_new ();
+	g_signal_connect (engine->priv->results_cache, "changed",
+			  G_CALLBACK (pk_engine_results_cache_changed_cb), engine);
+
 	/* setup file watches */
 	pk_engine_setup_file_monitors (engine);
 
@@ -1828,6 +1811,7 @@ pk_engine_finalize (GObject *object)
 	if (engine->priv->authority != NULL)
 		g_object_unref (engine->priv->authority);
 	g_object_unref (engine->priv->notify);
+	g_object_unref (engine->priv->results_cache);
 	g_object_unref (engine->priv->backend);
 	g_key_file_unref (engine->priv->conf);
 	g_object_unref (engine->priv->dbus);
@@ -0,0 +1,335 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: t; c-basic-offset: 8 -*-
+ *
+ * Copyright (C) 2014 Richard Hughes <richard@hughsie.com>
+ *
+ * Licensed under the GNU General Public License Version 2
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#  include <config.h>
+#endif
+
+#include <glib.h>
+
+#include "pk-cleanup.h"
+#include "pk-notify.h"
+#include "pk-results-cache.h"
+
+#define PK_RESULTS_CACHE_GET_PRIVATE(o) (G_TYPE_INSTANCE_GET_PRIVATE ((o), PK_TYPE_RESULTS_CACHE, PkResultsCachePrivate))
+
+/* the oldest entry is dropped when we get to this size */
+#define PK_RESULTS_CACHE_MAX_ITEMS	64
+
+struct PkResultsCachePrivate
+{
+	GHashTable		*hash;		/* key:PkResults */
+	GQueue			*keys;		/* oldest first */
+	PkNotify		*notify;
+	guint64			 generation;
+};
+
+enum {
+	PK_RESULTS_CACHE_CHANGED,
+	PK_RESULTS_CACHE_LAST_SIGNAL
+};
+
+static guint signals [PK_RESULTS_CACHE_LAST_SIGNAL] = { 0 };
+static gpointer pk_results_cache_object = NULL;
+
+G_DEFINE_TYPE (PkResultsCache, pk_results_cache, G_TYPE_OBJECT)
+
+/**
+ * pk_results_cache_role_is_cacheable:
+ *
+ * Only roles that never change the system and whose output only depends
+ * on the package database can be answered from the cache.
+ **/
+gboolean
+pk_results_cache_role_is_cacheable (PkRoleEnum role)
+{
+	return role == PK_ROLE_ENUM_RESOLVE ||
+	       role == PK_ROLE_ENUM_GET_UPDATES ||
+	       role == PK_ROLE_ENUM_GET_DETAILS;
+}
+
+/**
+ * pk_results_cache_role_invalidates:
+ *
+ * Return value: %TRUE if a successful transaction with this role changes
+ * the installed packages or the repository metadata.
+ **/
+gboolean
+pk_results_cache_role_invalidates (PkRoleEnum role)
+{
+	switch (role) {
+	case PK_ROLE_ENUM_INSTALL_FILES:
+	case PK_ROLE_ENUM_INSTALL_PACKAGES:
+	case PK_ROLE_ENUM_INSTALL_SIGNATURE:
+	case PK_ROLE_ENUM_REFRESH_CACHE:
+	case PK_ROLE_ENUM_REMOVE_PACKAGES:
+	case PK_ROLE_ENUM_REPO_ENABLE:
+	case PK_ROLE_ENUM_REPO_SET_DATA:
+	case PK_ROLE_ENUM_REPO_REMOVE:
+	case PK_ROLE_ENUM_UPDATE_PACKAGES:
+	case PK_ROLE_ENUM_REPAIR_SYSTEM:
+		return TRUE;
+	default:
+		break;
+	}
+	return FALSE;
+}
+
+/**
+ * pk_results_cache_get_key:
+ **/
+static gchar *
+pk_results_cache_get_key (PkRoleEnum role,
+			  PkBitfield filters,
+			  const gchar *locale,
+			  gchar **values)
+{
+	GString *key;
+	guint i;
+
+	key = g_string_new (pk_role_enum_to_string (role));
+	g_string_append_printf (key, "\n%" G_GUINT64_FORMAT "\n%s",
+				filters, locale != NULL ? locale : "C");
+	for (i = 0; values != NULL && values[i] != NULL; i++)
+		g_string_append_printf (key, "\n%s", values[i]);
+	return g_string_free (key, FALSE);
+}
+
+/**
+ * pk_results_cache_lookup:
+ * @cache: a #PkResultsCache
+ * @role: the transaction role
+ * @filters: the filters the transaction was started with
+ * @locale: the locale of the caller, or %NULL
+ * @values: (allow-none): the package IDs or names, or %NULL
+ *
+ * Return value: (transfer full): the cached results, or %NULL
+ **/
+PkResults *
+pk_results_cache_lookup (PkResultsCache *cache,
+			 PkRoleEnum role,
+			 PkBitfield filters,
+			 const gchar *locale,
+			 gchar **values)
+{
+	PkResults *results;
+	_cleanup_free_ gchar *key = NULL;
+
+	g_return_val_if_fail (PK_IS_RESULTS_CACHE (cache), NULL);
+
+	if (!pk_results_cache_role_is_cacheable (role))
+		return NULL;
+	key = pk_results_cache_get_key (role, filters, locale, values);
+	results = g_hash_table_lookup (cache->priv->hash, key);
+	if (results == NULL)
+		return NULL;
+	return g_object_ref (results);
+}
+
+/**
+ * pk_results_cache_add:
+ * @cache: a #PkResultsCache
+ * @role: the transaction role
+ * @filters: the filters the transaction was started with
+ * @locale: the locale of the caller, or %NULL
+ * @values: (allow-none): the package IDs or names, or %NULL
+ * @results: the results of a successful transaction
+ *
+ * Saves the results so that an identical query can be answered without
+ * starting a backend job. The results must not be modified afterwards.
+ **/
+void
+pk_results_cache_add (PkResultsCache *cache,
+		      PkRoleEnum role,
+		      PkBitfield filters,
+		      const gchar *locale,
+		      gchar **values,
+		      PkResults *results)
+{
+	PkResultsCachePrivate *priv = cache->priv;
+	gchar *key;
+	gchar *oldest;
+
+	g_return_if_fail (PK_IS_RESULTS_CACHE (cache));
+	g_return_if_fail (PK_IS_RESULTS (results));
+
+	if (!pk_results_cache_role_is_cacheable (role))
+		return;
+	if (pk_results_get_exit_code (results) != PK_EXIT_ENUM_SUCCESS)
+		return;
+
+	/* replace any existing entry */
+	key = pk_results_cache_get_key (role, filters, locale, values);
+	if (g_hash_table_contains (priv->hash, key)) {
+		g_hash_table_insert (priv->hash, key, g_object_ref (results));
+		return;
+	}
+
+	/* make room */
+	if (g_queue_get_length (priv->keys) >= PK_RESULTS_CACHE_MAX_ITEMS) {
+		oldest = g_queue_pop_head (priv->keys);
+		g_hash_table_remove (priv->hash, oldest);
+	}
+	g_hash_table_insert (priv->hash, key, g_object_ref (results));
+	g_queue_push_tail (priv->keys, key);
+}
+
+/**
+ * pk_results_cache_invalidate:
+ * @cache: a #PkResultsCache
+ *
+ * Drops all the cached results, e.g. when the package database changed.
+ * The generation always changes, as clients may still hold results that
+ * this cache has already dropped.
+ **/
+void
+pk_results_cache_invalidate (PkResultsCache *cache)
+{
+	g_return_if_fail (PK_IS_RESULTS_CACHE (cache));
+
+	cache->priv->generation++;
+	g_signal_emit (cache, signals [PK_RESULTS_CACHE_CHANGED], 0);
+	if (g_queue_is_empty (cache->priv->keys))
+		return;
+	g_debug ("invalidating %u cached results",
+		 g_queue_get_length (cache->priv->keys));
+	g_queue_clear (cache->priv->keys);
+	g_hash_table_remove_all (cache->priv->hash);
+}
+
+/**
+ * pk_results_cache_get_generation:
+ *
+ * Return value: a number that changes whenever the cached results are
+ * invalidated. It is seeded from the clock, and the engine saves it so
+ * that it only changes across restarts when something invalidated it.
+ **/
+guint64
+pk_results_cache_get_generation (PkResultsCache *cache)
+{
+	g_return_val_if_fail (PK_IS_RESULTS_CACHE (cache), 0);
+	return cache->priv->generation;
+}
+
+/**
+ * pk_results_cache_set_generation:
+ *
+ * Restores the generation saved by a previous instance of the daemon.
+ **/
+void
+pk_results_cache_set_generation (PkResultsCache *cache, guint64 generation)
+{
+	g_return_if_fail (PK_IS_RESULTS_CACHE (cache));
+	cache->priv->generation = generation;
+}
+
+/**
+ * pk_results_cache_get_size:
+ **/
+guint
+pk_results_cache_get_size (PkResultsCache *cache)
+{
+	g_return_val_if_fail (PK_IS_RESULTS_CACHE (cache), 0);
+	return g_hash_table_size (cache->priv->hash);
+}
+
+/**
+ * pk_results_cache_notify_changed_cb:
+ **/
+static void
+pk_results_cache_notify_changed_cb (PkNotify *notify, PkResultsCache *cache)
+{
+	pk_results_cache_invalidate (cache);
+}
+
+/**
+ * pk_results_cache_finalize:
+ **/
+static void
+pk_results_cache_finalize (GObject *object)
+{
+	PkResultsCache *cache;
+
+	g_return_if_fail (PK_IS_RESULTS_CACHE (object));
+	cache = PK_RESULTS_CACHE (object);
+
+	g_signal_handlers_disconnect_by_data (cache->priv->notify, cache);
+	g_object_unref (cache->priv->notify);
+	g_queue_free (cache->priv->keys);
+	g_hash_table_unref (cache->priv->hash);
+
+	G_OBJECT_CLASS (pk_results_cache_parent_class)->finalize (object);
+}
+
+/**
+ * pk_results_cache_class_init:
+ **/
+static void
+pk_results_cache_class_init (PkResultsCacheClass *klass)
+{
+	GObjectClass *object_class = G_OBJECT_CLASS (klass);
+	object_class->finalize = pk_results_cache_finalize;
+
+	signals [PK_RESULTS_CACHE_CHANGED] =
+		g_signal_new ("changed",
+			      G_TYPE_FROM_CLASS (object_class), G_SIGNAL_RUN_LAST,
+			      0, NULL, NULL, g_cclosure_marshal_VOID__VOID,
+			      G_TYPE_NONE, 0);
+
+	g_type_class_add_private (klass, sizeof (PkResultsCachePrivate));
+}
+
+/**
+ * pk_results_cache_init:
+ **/
+static void
+pk_results_cache_init (PkResultsCache *cache)
+{
+	cache->priv = PK_RESULTS_CACHE_GET_PRIVATE (cache);
+	cache->priv->hash = g_hash_table_new_full (g_str_hash, g_str_equal,
+						   g_free, g_object_unref);
+	cache->priv->keys = g_queue_new ();
+	cache->priv->generation = g_get_real_time ();
+
+	/* anything that makes the engine emit RepoListChanged or
+	 * UpdatesChanged also makes our results stale */
+	cache->priv->notify = pk_notify_new ();
+	g_signal_connect (cache->priv->notify, "repo-list-changed",
+			  G_CALLBACK (pk_results_cache_notify_changed_cb), cache);
+	g_signal_connect (cache->priv->notify, "updates-changed",
+			  G_CALLBACK (pk_results_cache_notify_changed_cb), cache);
+}
+
+/**
+ * pk_results_cache_new:
+ * Return value: A new results cache class instance.
+ **/
+PkResultsCache *
+pk_results_cache_new (void)
+{
+	if (pk_results_cache_object != NULL) {
+		g_object_ref (pk_results_cache_object);
+	} else {
+		pk_results_cache_object = g_object_new (PK_TYPE_RESULTS_CACHE, NULL);
+		g_object_add_weak_pointer (pk_results_cache_object, &pk_results_cache_object);
+	}
+	return PK_RESULTS_CACHE (pk_results_cache_object);
+}
@@ -0,0 +1,76 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: t; c-basic-offset: 8 -*-
+ *
+ * Copyright (C) 2014 Richard Hughes <richard@hughsie.com>
+ *
+ * Licensed under the GNU General Public License Version 2
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef __PK_RESULTS_CACHE_H
+#define __PK_RESULTS_CACHE_H
+
+#include <glib-object.h>
+#include <packagekit-glib2/pk-bitfield.h>
+#include <packagekit-glib2/pk-enum.h>
+#include <packagekit-glib2/pk-results.h>
+
+G_BEGIN_DECLS
+
+#define PK_TYPE_RESULTS_CACHE		(pk_results_cache_get_type ())
+#define PK_RESULTS_CACHE(o)		(G_TYPE_CHECK_INSTANCE_CAST ((o), PK_TYPE_RESULTS_CACHE, PkResultsCache))
+#define PK_RESULTS_CACHE_CLASS(k)	(G_TYPE_CHECK_CLASS_CAST((k), PK_TYPE_RESULTS_CACHE, PkResultsCacheClass))
+#define PK_IS_RESULTS_CACHE(o)		(G_TYPE_CHECK_INSTANCE_TYPE ((o), PK_TYPE_RESULTS_CACHE))
+#define PK_IS_RESULTS_CACHE_CLASS(k)	(G_TYPE_CHECK_CLASS_TYPE ((k), PK_TYPE_RESULTS_CACHE))
+#define PK_RESULTS_CACHE_GET_CLASS(o)	(G_TYPE_INSTANCE_GET_CLASS ((o), PK_TYPE_RESULTS_CACHE, PkResultsCacheClass))
+
+typedef struct PkResultsCachePrivate PkResultsCachePrivate;
+
+typedef struct
+{
+	GObject			 parent;
+	PkResultsCachePrivate	*priv;
+} PkResultsCache;
+
+typedef struct
+{
+	GObjectClass		 parent_class;
+} PkResultsCacheClass;
+
+GType		 pk_results_cache_get_type	(void);
+PkResultsCache	*pk_results_cache_new		(void);
+
+gboolean	 pk_results_cache_role_is_cacheable (PkRoleEnum	 role);
+gboolean	 pk_results_cache_role_invalidates (PkRoleEnum	 role);
+PkResults	*pk_results_cache_lookup	(PkResultsCache	*cache,
+						 PkRoleEnum	 role,
+						 PkBitfield	 filters,
+						 const gchar	*locale,
+						 gchar		**values);
+void		 pk_results_cache_add		(PkResultsCache	*cache,
+						 PkRoleEnum	 role,
+						 PkBitfield	 filters,
+						 const gchar	*locale,
+						 gchar		**values,
+						 PkResults	*results);
+void		 pk_results_cache_invalidate	(PkResultsCache	*cache);
+guint64		 pk_results_cache_get_generation (PkResultsCache	*cache);
+void		 pk_results_cache_set_generation (PkResultsCache	*cache,
+							 guint64	 generation);
+guint		 pk_results_cache_get_size	(PkResultsCache	*cache);
+
+G_END_DECLS
+
+#endif /* __PK_RESULTS_CACHE_H */
@@ -23,6 +23,8 @@
  * Transaction Commit Logic:
  *
  * State = COMMIT
+ * Put the transaction at the back of the queue for its priority and lane
+ * Run as many queued transactions as the lanes have room for
  * Transaction.Run()
  * WHEN transaction finished:
  * 	IF error = LOCK_REQUIRED
@@ -36,12 +38,18 @@
  * 			Leave transaction in the FIFO queue
  *	ELSE
  * 		State = Finished
- * 		IF Transaction.Exclusive
- * 			Take the first PK_TRANSACTION_STATE_READY transaction which has Transaction.Exclusive == TRUE
- * 			from the list and run it. If there's none, just do nothing
- * 		ELSE
- * 			Do nothing
+ * 		Release the lane the transaction was running in
+ * 		Run as many queued transactions as the lanes have room for
  * 		Transaction.Destroy()
+ *
+ * Lanes:
+ *
+ * Read-only queries run in the query lane, up to MaxParallelQueries at once.
+ * Every other role is exclusive and runs in the exclusive lane alongside
+ * it, which only ever runs one at a time. A query that locks the backend
+ * becomes exclusive too. If the backend does not support parallelization,
+ * every transaction is exclusive.
+ * Foreground transactions are always started before background ones.
 **/
 
 #include "config.h"
@@ -87,9 +95,27 @@ static void     pk_scheduler_finalize	(GObject	*object);
 /* maximum number of requests a given user is able to request and queue */
 #define PK_SCHEDULER_SIMULTANEOUS_TRANSACTIONS_FOR_UID	500
 
+/* default number of read-only queries that can run at the same time */
+#define PK_SCHEDULER_MAX_PARALLEL_QUERIES		4
+
+typedef enum {
+	PK_SCHEDULER_LANE_EXCLUSIVE,
+	PK_SCHEDULER_LANE_QUERY,
+	PK_SCHEDULER_LANE_LAST
+} PkSchedulerLane;
+
+typedef enum {
+	PK_SCHEDULER_PRIORITY_FOREGROUND,
+	PK_SCHEDULER_PRIORITY_BACKGROUND,
+	PK_SCHEDULER_PRIORITY_LAST
+} PkSchedulerPriority;
+
 struct PkSchedulerPrivate
 {
 	GPtrArray		*array;
+	GPtrArray		*running;
+	GQueue			*waiting[PK_SCHEDULER_PRIORITY_LAST][PK_SCHEDULER_LANE_LAST];
+	guint			 lane_max[PK_SCHEDULER_LANE_LAST];
 	guint			 unwedge_id;
 	GKeyFile		*conf;
 	PkBackend		*backend;
@@ -107,6 +133,9 @@ typedef struct {
 	gulong			 state_changed_id;
 	guint			 uid;
 	guint			 tries;
+	GQueue			*queue;
+	PkSchedulerLane		 lane;
+	gboolean		 running;
 } PkSchedulerItem;
 
 enum {
@@ -118,6 +147,12 @@ static guint signals [PK_SCHEDULER_LAST_SIGNAL] = { 0 };
 
 G_DEFINE_TYPE (PkScheduler, pk_scheduler, G_TYPE_OBJECT)
 
+static const gchar *pk_scheduler_lane_names[] = {
+	"exclusive",
+	"query",
+	NULL
+};
+
 /**
  * pk_scheduler_get_from_tid:
  **/
@@ -214,6 +249,32 @@ pk_scheduler_item_free (PkSchedulerItem *item)
 	g_free (item);
 }
 
+/**
+ * pk_scheduler_item_dequeue:
+ **/
+static void
+pk_scheduler_item_dequeue (PkSchedulerItem *item)
+{
+	if (item->queue == NULL)
+		return;
+	g_queue_remove (item->queue, item);
+	item->queue = NULL;
+}
+
+/**
+ * pk_scheduler_item_stopped:
+ *
+ * Releases the lane the item was running in.
+ **/
+static void
+pk_scheduler_item_stopped (PkScheduler *scheduler, PkSchedulerItem *item)
+{
+	if (!item->running)
+		return;
+	g_ptr_array_remove (scheduler->priv->running, item);
+	item->running = FALSE;
+}
+
 /**
  * pk_scheduler_remove_internal:
  **/
@@ -225,6 +286,10 @@ pk_scheduler_remove_internal (PkScheduler *scheduler, PkSchedulerItem *item)
 	g_return_val_if_fail (PK_IS_SCHEDULER (scheduler), FALSE);
 	g_return_val_if_fail (item != NULL, FALSE);
 
+	/* it is no longer waiting or running */
+	pk_scheduler_item_dequeue (item);
+	pk_scheduler_item_stopped (scheduler, item);
+
 	/* valid item */
 	ret = g_ptr_array_remove (scheduler->priv->array, item);
 	if (!ret) {
@@ -315,6 +380,11 @@ pk_scheduler_run_idle_cb (PkSchedulerItem *item)
 static void
 pk_scheduler_run_item (PkScheduler *scheduler, PkSchedulerItem *item)
 {
+	/* take a slot in the lane */
+	pk_scheduler_item_dequeue (item);
+	item->running = TRUE;
+	g_ptr_array_add (scheduler->priv->running, item);
+
 	/* we set this here so that we don't try starting more than one */
 	pk_transaction_set_state (item->transaction, PK_TRANSACTION_STATE_RUNNING);
 
@@ -323,34 +393,6 @@ pk_scheduler_run_item (PkScheduler *scheduler, PkSchedulerItem *item)
 	g_source_set_name_by_id (item->idle_id, "[PkScheduler] run");
 }
 
-/**
- * pk_scheduler_get_active_transactions:
- *
- **/
-static GPtrArray *
-pk_scheduler_get_active_transactions (PkScheduler *scheduler)
-{
-	guint i;
-	GPtrArray *array;
-	GPtrArray *res;
-	PkSchedulerItem *item;
-
-	g_return_val_if_fail (PK_IS_SCHEDULER (scheduler), NULL);
-
-	/* create array to store the results */
-	res = g_ptr_array_new ();
-
-	/* find the runner with the transaction ID */
-	array = scheduler->priv->array;
-	for (i = 0; i < array->len; i++) {
-		item = (PkSchedulerItem *) g_ptr_array_index (array, i);
-		if (pk_transaction_get_state (item->transaction) == PK_TRANSACTION_STATE_RUNNING)
-			g_ptr_array_add (res, item);
-	}
-
-	return res;
-}
-
 /**
  * pk_scheduler_get_exclusive_running:
  *
@@ -360,23 +402,16 @@ pk_scheduler_get_active_transactions (PkScheduler *scheduler)
 static guint
 pk_scheduler_get_exclusive_running (PkScheduler *scheduler)
 {
-	PkSchedulerItem *item = NULL;
+	PkSchedulerItem *item;
 	guint exclusive_running = 0;
 	guint i;
-	_cleanup_ptrarray_unref_ GPtrArray *array = NULL;
 
 	g_return_val_if_fail (PK_IS_SCHEDULER (scheduler), FALSE);
 
-	/* anything running? */
-	array = pk_scheduler_get_active_transactions (scheduler);
-	if (array->len == 0)
-		return 0;
-
-	/* check if we have any running locked (exclusive) transaction */
-	for (i = 0; i < array->len; i++) {
-		item = (PkSchedulerItem *) g_ptr_array_index (array, i);
-
-		/* check if a transaction is running in exclusive */
+	/* a query can become exclusive if it locks the backend, so check
+	 * every running transaction rather than just the exclusive lane */
+	for (i = 0; i < scheduler->priv->running->len; i++) {
+		item = (PkSchedulerItem *) g_ptr_array_index (scheduler->priv->running, i);
 		if (pk_transaction_is_exclusive (item->transaction)) {
 			/* should never be more that one, but we count them for sanity checks */
 			exclusive_running++;
@@ -385,6 +420,35 @@ pk_scheduler_get_exclusive_running (PkScheduler *scheduler)
 	return exclusive_running;
 }
 
+/**
+ * pk_scheduler_get_lane_running:
+ **/
+static guint
+pk_scheduler_get_lane_running (PkScheduler *scheduler, PkSchedulerLane lane)
+{
+	PkSchedulerItem *item;
+	guint i;
+	guint cnt = 0;
+
+	for (i = 0; i < scheduler->priv->running->len; i++) {
+		item = (PkSchedulerItem *) g_ptr_array_index (scheduler->priv->running, i);
+		if (item->lane == lane)
+			cnt++;
+	}
+	return cnt;
+}
+
+/**
+ * pk_scheduler_lane_has_room:
+ **/
+static gboolean
+pk_scheduler_lane_has_room (PkScheduler *scheduler, PkSchedulerLane lane)
+{
+	if (lane == PK_SCHEDULER_LANE_EXCLUSIVE)
+		return pk_scheduler_get_exclusive_running (scheduler) == 0;
+	return pk_scheduler_get_lane_running (scheduler, lane) < scheduler->priv->lane_max[lane];
+}
+
 /**
  * pk_scheduler_get_background_running:
  *
@@ -393,20 +457,14 @@ pk_scheduler_get_exclusive_running (PkScheduler *scheduler)
 static gboolean
 pk_scheduler_get_background_running (PkScheduler *scheduler)
 {
-	PkSchedulerItem *item = NULL;
+	PkSchedulerItem *item;
 	guint i;
-	_cleanup_ptrarray_unref_ GPtrArray *array = NULL;
 
 	g_return_val_if_fail (PK_IS_SCHEDULER (scheduler), FALSE);
 
-	/* anything running? */
-	array = pk_scheduler_get_active_transactions (scheduler);
-	if (array->len == 0)
-		return FALSE;
-
 	/* check if we have any running background transaction */
-	for (i = 0; i < array->len; i++) {
-		item = (PkSchedulerItem *) g_ptr_array_index (array, i);
+	for (i = 0; i < scheduler->priv->running->len; i++) {
+		item = (PkSchedulerItem *) g_ptr_array_index (scheduler->priv->running, i);
 		if (pk_transaction_get_background (item->transaction))
 			return TRUE;
 	}
@@ -414,58 +472,95 @@ pk_scheduler_get_background_running (PkScheduler *scheduler)
 }
 
 /**
- * pk_scheduler_get_next_item:
+ * pk_scheduler_role_is_query:
+ *
+ * Return value: %TRUE if the role only reads the package database
  **/
-static PkSchedulerItem *
-pk_scheduler_get_next_item (PkScheduler *scheduler)
+static gboolean
+pk_scheduler_role_is_query (PkRoleEnum role)
 {
-	PkSchedulerItem *item = NULL;
-	GPtrArray *array;
-	guint i;
-	PkTransactionState state;
-	gboolean exclusive_running;
-
-	array = scheduler->priv->array;
-
-	/* check for running exclusive transaction */
-	exclusive_running = pk_scheduler_get_exclusive_running (scheduler) > 0;
-
-	/* first try the waiting non-background transactions */
-	for (i = 0; i < array->len; i++) {
-		item = (PkSchedulerItem *) g_ptr_array_index (array, i);
-		state = pk_transaction_get_state (item->transaction);
-
-		if ((state == PK_TRANSACTION_STATE_READY) && (!pk_transaction_get_background (item->transaction))) {
-			/* check if we can run the transaction now or if we need to wait for lock release */
-			if (pk_transaction_is_exclusive (item->transaction)) {
-				if (!exclusive_running)
-					goto out;
-			} else {
-				goto out;
-			}
-		}
+	switch (role) {
+	case PK_ROLE_ENUM_DEPENDS_ON:
+	case PK_ROLE_ENUM_GET_CATEGORIES:
+	case PK_ROLE_ENUM_GET_DETAILS:
+	case PK_ROLE_ENUM_GET_DETAILS_LOCAL:
+	case PK_ROLE_ENUM_GET_DISTRO_UPGRADES:
+	case PK_ROLE_ENUM_GET_FILES:
+	case PK_ROLE_ENUM_GET_FILES_LOCAL:
+	case PK_ROLE_ENUM_GET_OLD_TRANSACTIONS:
+	case PK_ROLE_ENUM_GET_PACKAGES:
+	case PK_ROLE_ENUM_GET_REPO_LIST:
+	case PK_ROLE_ENUM_GET_UPDATE_DETAIL:
+	case PK_ROLE_ENUM_GET_UPDATES:
+	case PK_ROLE_ENUM_REQUIRED_BY:
+	case PK_ROLE_ENUM_RESOLVE:
+	case PK_ROLE_ENUM_SEARCH_DETAILS:
+	case PK_ROLE_ENUM_SEARCH_FILE:
+	case PK_ROLE_ENUM_SEARCH_GROUP:
+	case PK_ROLE_ENUM_SEARCH_NAME:
+	case PK_ROLE_ENUM_WHAT_PROVIDES:
+		return TRUE;
+	default:
+		return FALSE;
 	}
+}
 
-	/* then try the other waiting transactions (background tasks) */
-	for (i = 0; i < array->len; i++) {
-		item = (PkSchedulerItem *) g_ptr_array_index (array, i);
-		state = pk_transaction_get_state (item->transaction);
+/**
+ * pk_scheduler_enqueue:
+ *
+ * Puts the item at the back of the queue for its priority and lane.
+ **/
+static void
+pk_scheduler_enqueue (PkScheduler *scheduler, PkSchedulerItem *item)
+{
+	PkSchedulerPriority priority;
+
+	pk_scheduler_item_dequeue (item);
+	if (!pk_scheduler_role_is_query (pk_transaction_get_role (item->transaction)) ||
+	    pk_transaction_is_exclusive (item->transaction))
+		item->lane = PK_SCHEDULER_LANE_EXCLUSIVE;
+	else
+		item->lane = PK_SCHEDULER_LANE_QUERY;
+	if (pk_transaction_get_background (item->transaction))
+		priority = PK_SCHEDULER_PRIORITY_BACKGROUND;
+	else
+		priority = PK_SCHEDULER_PRIORITY_FOREGROUND;
+	item->queue = scheduler->priv->waiting[priority][item->lane];
+	g_queue_push_tail (item->queue, item);
+}
+
+/**
+ * pk_scheduler_run_pending:
+ *
+ * Starts as many waiting transactions as the lanes have room for,
+ * foreground transactions first.
+ **/
+static void
+pk_scheduler_run_pending (PkScheduler *scheduler)
+{
+	GQueue *queue;
+	guint lane;
+	guint priority;
+	PkSchedulerItem *item;
 
-		if (state == PK_TRANSACTION_STATE_READY) {
-			/* check if we can run the transaction now or if we need to wait for lock release */
-			if (pk_transaction_is_exclusive (item->transaction)) {
-				if (!exclusive_running)
-					goto out;
-			} else {
-				goto out;
+	for (priority = 0; priority < PK_SCHEDULER_PRIORITY_LAST; priority++) {
+		for (lane = 0; lane < PK_SCHEDULER_LANE_LAST; lane++) {
+			queue = scheduler->priv->waiting[priority][lane];
+			while (!g_queue_is_empty (queue) &&
+			       pk_scheduler_lane_has_room (scheduler, lane)) {
+				item = g_queue_peek_head (queue);
+
+				/* it may have been cancelled while waiting */
+				if (pk_transaction_get_state (item->transaction) != PK_TRANSACTION_STATE_READY) {
+					pk_scheduler_item_dequeue (item);
+					continue;
+				}
+				g_debug ("running %s in %s lane",
+					 item->tid, pk_scheduler_lane_names[lane]);
+				pk_scheduler_run_item (scheduler, item);
 			}
 		}
 	}
-
-	/* nothing to run */
-	item = NULL;
-out:
-	return item;
 }
 
 /**
@@ -485,8 +580,10 @@ pk_scheduler_commit (PkScheduler *scheduler, const gchar *tid)
 		return;
 	}
 
-	/* treat all transactions as exclusive if backend does not support parallelization */
-	if (!pk_backend_supports_parallelization (scheduler->priv->backend))
+	/* treat all transactions as exclusive if backend does not support
+	 * parallelization, and anything that is not a query always */
+	if (!pk_backend_supports_parallelization (scheduler->priv->backend) ||
+	    !pk_scheduler_role_is_query (pk_transaction_get_role (item->transaction)))
 		pk_transaction_make_exclusive (item->transaction);
 
 	/* we've been 'used' */
@@ -507,10 +604,9 @@ pk_scheduler_commit (PkScheduler *scheduler, const gchar *tid)
 		pk_scheduler_cancel_background (scheduler);
 	}
 
-	/* do the transaction now, if possible */
-	if (pk_transaction_is_exclusive (item->transaction) == FALSE ||
-	    pk_scheduler_get_exclusive_running (scheduler) == 0)
-		pk_scheduler_run_item (scheduler, item);
+	/* queue the transaction, and run it now if possible */
+	pk_scheduler_enqueue (scheduler, item);
+	pk_scheduler_run_pending (scheduler);
 }
 
 /**
@@ -558,6 +654,9 @@ pk_scheduler_transaction_finished_cb (PkTransaction *transaction,
 		return;
 	}
 
+	/* give up the lane, so that the next transaction can use it */
+	pk_scheduler_item_stopped (scheduler, item);
+
 	if (pk_transaction_is_finished_with_lock_required (item->transaction)) {
 		pk_transaction_reset_after_lock_error (item->transaction);
 
@@ -584,6 +683,7 @@ pk_scheduler_transaction_finished_cb (PkTransaction *transaction,
 			g_source_remove (item->commit_id);
 			item->commit_id = 0;
 		}
+		pk_scheduler_item_dequeue (item);
 		pk_transaction_set_state (item->transaction, PK_TRANSACTION_STATE_FINISHED);
 
 		/* give the client a few seconds to still query the runner */
@@ -593,12 +693,8 @@ pk_scheduler_transaction_finished_cb (PkTransaction *transaction,
 		g_source_set_name_by_id (item->remove_id, "[PkScheduler] remove");
 	}
 
-	/* try to run the next transaction, if possible */
-	item = pk_scheduler_get_next_item (scheduler);
-	if (item != NULL) {
-		g_debug ("running %s as previous one finished", item->tid);
-		pk_scheduler_run_item (scheduler, item);
-	}
+	/* try to run the next transactions, if possible */
+	pk_scheduler_run_pending (scheduler);
 
 	/* we have changed what is running */
 	g_signal_emit (scheduler, signals [PK_SCHEDULER_CHANGED], 0);
@@ -744,18 +840,12 @@ pk_scheduler_get_locked (PkScheduler *scheduler)
 	PkBackendJob *job;
 	PkSchedulerItem *item;
 	guint i;
-	_cleanup_ptrarray_unref_ GPtrArray *array = NULL;
 
 	g_return_val_if_fail (PK_IS_SCHEDULER (scheduler), FALSE);
 
-	/* anything running? */
-	array = pk_scheduler_get_active_transactions (scheduler);
-	if (array->len == 0)
-		return FALSE;
-
 	/* check if any backend in running transaction is locked at time */
-	for (i = 0; i < array->len; i++) {
-		item = (PkSchedulerItem *) g_ptr_array_index (array, i);
+	for (i = 0; i < scheduler->priv->running->len; i++) {
+		item = (PkSchedulerItem *) g_ptr_array_index (scheduler->priv->running, i);
 
 		job = pk_transaction_get_backend_job (item->transaction);
 		if (job == NULL)
@@ -861,6 +951,38 @@ pk_scheduler_get_size (PkScheduler *scheduler)
 	return scheduler->priv->array->len;
 }
 
+/**
+ * pk_scheduler_get_lanes:
+ *
+ * Gets how busy each lane is, for tuning MaxParallelQueries.
+ *
+ * Return value: a 'a{s(uuu)}' #GVariant of the lane name to the number of
+ * transactions running, the maximum that can run, and the number waiting
+ **/
+GVariant *
+pk_scheduler_get_lanes (PkScheduler *scheduler)
+{
+	guint lane;
+	guint priority;
+	guint waiting;
+	GVariantBuilder builder;
+
+	g_return_val_if_fail (PK_IS_SCHEDULER (scheduler), NULL);
+
+	g_variant_builder_init (&builder, G_VARIANT_TYPE ("a{s(uuu)}"));
+	for (lane = 0; lane < PK_SCHEDULER_LANE_LAST; lane++) {
+		waiting = 0;
+		for (priority = 0; priority < PK_SCHEDULER_PRIORITY_LAST; priority++)
+			waiting += g_queue_get_length (scheduler->priv->waiting[priority][lane]);
+		g_variant_builder_add (&builder, "{s(uuu)}",
+				       pk_scheduler_lane_names[lane],
+				       pk_scheduler_get_lane_running (scheduler, lane),
+				       scheduler->priv->lane_max[lane],
+				       waiting);
+	}
+	return g_variant_builder_end (&builder);
+}
+
 /**
  * pk_scheduler_get_state:
  **/
@@ -902,6 +1024,14 @@ pk_scheduler_get_state (PkScheduler *scheduler)
 					pk_transaction_get_background (item->transaction));
 	}
 
+	/* lane occupancy */
+	for (i = 0; i < PK_SCHEDULER_LANE_LAST; i++) {
+		g_string_append_printf (string, "lane[%s] running %i of %i\n",
+					pk_scheduler_lane_names[i],
+					pk_scheduler_get_lane_running (scheduler, i),
+					scheduler->priv->lane_max[i]);
+	}
+
 	/* nothing running */
 	if (waiting == length)
 		g_string_append_printf (string, "WARNING: everything is waiting!\n");
@@ -1054,8 +1184,18 @@ pk_scheduler_class_init (PkSchedulerClass *klass)
 static void
 pk_scheduler_init (PkScheduler *scheduler)
 {
+	guint i;
+	guint j;
+
 	scheduler->priv = PK_SCHEDULER_GET_PRIVATE (scheduler);
 	scheduler->priv->array = g_ptr_array_new ();
+	scheduler->priv->running = g_ptr_array_new ();
+	for (i = 0; i < PK_SCHEDULER_PRIORITY_LAST; i++) {
+		for (j = 0; j < PK_SCHEDULER_LANE_LAST; j++)
+			scheduler->priv->waiting[i][j] = g_queue_new ();
+	}
+	scheduler->priv->lane_max[PK_SCHEDULER_LANE_EXCLUSIVE] = 1;
+	scheduler->priv->lane_max[PK_SCHEDULER_LANE_QUERY] = PK_SCHEDULER_MAX_PARALLEL_QUERIES;
 	scheduler->priv->introspection = pk_load_introspection (PK_DBUS_INTERFACE_TRANSACTION ".xml",
 							    NULL);
 	scheduler->priv->unwedge_id = g_timeout_add_seconds (PK_TRANSACTION_WEDGE_CHECK,
@@ -1071,6 +1211,8 @@ static void
 pk_scheduler_finalize (GObject *object)
 {
 	PkScheduler *scheduler;
+	guint i;
+	guint j;
 
 	g_return_if_fail (PK_IS_SCHEDULER (object));
 
@@ -1083,6 +1225,11 @@ pk_scheduler_finalize (GObject *object)
 
 	g_ptr_array_foreach (scheduler->priv->array, (GFunc) pk_scheduler_item_free, NULL);
 	g_ptr_array_free (scheduler->priv->array, TRUE);
+	g_ptr_array_unref (scheduler->priv->running);
+	for (i = 0; i < PK_SCHEDULER_PRIORITY_LAST; i++) {
+		for (j = 0; j < PK_SCHEDULER_LANE_LAST; j++)
+			g_queue_free (scheduler->priv->waiting[i][j]);
+	}
 	g_dbus_node_info_unref (scheduler->priv->introspection);
 	g_key_file_unref (scheduler->priv->conf);
 	if (scheduler->priv->backend != NULL)
@@ -1099,8 +1246,14 @@ pk_scheduler_finalize (GObject *object)
 PkScheduler *
 pk_scheduler_new (GKeyFile *conf)
 {
+	gint max_queries;
 	PkScheduler *scheduler = PK_SCHEDULER (g_object_new (PK_TYPE_SCHEDULER, NULL));
 	scheduler->priv->conf = g_key_file_ref (conf);
+
+	/* allow the admin to tune how many queries run at once */
+	max_queries = g_key_file_get_integer (conf, "Daemon", "MaxParallelQueries", NULL);
+	if (max_queries > 0)
+		scheduler->priv->lane_max[PK_SCHEDULER_LANE_QUERY] = max_queries;
 	return scheduler;
 }
 
@@ -66,6 +66,7 @@ gchar		**pk_scheduler_get_array	(PkScheduler	*scheduler)
 						 G_GNUC_WARN_UNUSED_RESULT;
 gchar		*pk_scheduler_get_state		(PkScheduler	*scheduler)
 						 G_GNUC_WARN_UNUSED_RESULT;
+GVariant	*pk_scheduler_get_lanes		(PkScheduler	*scheduler);
 guint		 pk_scheduler_get_size		(PkScheduler	*scheduler);
 gboolean	 pk_scheduler_get_locked	(PkScheduler	*scheduler);
 PkTransaction	*pk_scheduler_get_transaction	(PkScheduler	*scheduler,
@@ -24,6 +24,8 @@
 #include <glib.h>
 #include <glib-object.h>
 #include <glib/gstdio.h>
+#include <unistd.h>
+#include <packagekit-glib2/pk-item-progress.h>
 
 #include "pk-cleanup.h"
 #include "pk-backend.h"
@@ -31,6 +33,7 @@
 #include "pk-dbus.h"
 #include "pk-engine.h"
 #include "pk-notify.h"
+#include "pk-results-cache.h"
 #include "pk-spawn.h"
 #include "pk-transaction-db.h"
 #include "pk-transaction.h"
@@ -325,6 +328,175 @@ pk_test_backend_func (void)
 	pk_backend_stop_job (backend, job);
 }
 
+#define PK_TEST_BACKEND_JOB_EVENTS	50000
+
+static guint _backend_job_number_packages = 0;
+static guint _backend_job_number_percentage = 0;
+static guint _backend_job_last_percentage = 0;
+
+static void
+pk_test_backend_job_func_events (PkBackendJob *job,
+				 GVariant *params,
+				 gpointer user_data)
+{
+	guint i;
+
+	for (i = 0; i < PK_TEST_BACKEND_JOB_EVENTS; i++) {
+		_cleanup_free_ gchar *package_id = NULL;
+		package_id = g_strdup_printf ("pkg%05u;1.0.0;x86_64;fedora", i);
+		pk_backend_job_package (job, PK_INFO_ENUM_AVAILABLE,
+					package_id, "summary");
+		pk_backend_job_set_percentage (job, i * 100 / PK_TEST_BACKEND_JOB_EVENTS);
+	}
+	pk_backend_job_set_percentage (job, 100);
+	pk_backend_job_finished (job);
+}
+
+/**
+ * pk_test_backend_job_package_cb:
+ **/
+static void
+pk_test_backend_job_package_cb (PkBackendJob *job, PkPackage *package, gpointer user_data)
+{
+	_backend_job_number_packages++;
+}
+
+/**
+ * pk_test_backend_job_percentage_cb:
+ **/
+static void
+pk_test_backend_job_percentage_cb (PkBackendJob *job, gpointer data, gpointer user_data)
+{
+	_backend_job_last_percentage = GPOINTER_TO_UINT (data);
+	_backend_job_number_percentage++;
+}
+
+static void
+pk_test_backend_job_func (void)
+{
+	gboolean ret;
+	gdouble elapsed;
+	_cleanup_error_free_ GError *error = NULL;
+	_cleanup_keyfile_unref_ GKeyFile *conf = NULL;
+	_cleanup_object_unref_ PkBackend *backend = NULL;
+	_cleanup_object_unref_ PkBackendJob *job = NULL;
+	_cleanup_timer_destroy_ GTimer *timer = NULL;
+
+	/* load the dummy backend */
+	conf = g_key_file_new ();
+	g_key_file_set_string (conf, "Daemon", "DefaultBackend", "dummy");
+	backend = pk_backend_new (conf);
+	ret = pk_backend_load (backend, &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+
+	/* connect */
+	job = pk_backend_job_new (conf);
+	pk_backend_job_set_backend (job, backend);
+	pk_backend_job_set_vfunc (job,
+				  PK_BACKEND_SIGNAL_PACKAGE,
+				  (PkBackendJobVFunc) pk_test_backend_job_package_cb,
+				  NULL);
+	pk_backend_job_set_vfunc (job,
+				  PK_BACKEND_SIGNAL_PERCENTAGE,
+				  (PkBackendJobVFunc) pk_test_backend_job_percentage_cb,
+				  NULL);
+	pk_backend_job_set_vfunc (job,
+				  PK_BACKEND_SIGNAL_FINISHED,
+				  (PkBackendJobVFunc) pk_test_backend_finished_cb,
+				  NULL);
+
+	/* send lots of events from a worker thread */
+	timer = g_timer_new ();
+	ret = pk_backend_job_thread_create (job,
+					    pk_test_backend_job_func_events,
+					    NULL,
+					    NULL);
+	g_assert (ret);
+	_g_test_loop_run_with_timeout (10000);
+	elapsed = g_timer_elapsed (timer, NULL);
+	g_debug ("%u events in %.3fs: %.0f events/s",
+		 PK_TEST_BACKEND_JOB_EVENTS, elapsed,
+		 (gdouble) PK_TEST_BACKEND_JOB_EVENTS / elapsed);
+
+	/* every package arrived, but superseded percentages were dropped */
+	g_assert_cmpint (_backend_job_number_packages, ==, PK_TEST_BACKEND_JOB_EVENTS);
+	g_assert_cmpint (_backend_job_number_percentage, <=, 101);
+	g_assert_cmpint (_backend_job_last_percentage, ==, 100);
+
+	ret = pk_backend_unload (backend);
+	g_assert (ret);
+}
+
+static GPtrArray *_backend_job_item_progress = NULL;
+
+/**
+ * pk_test_backend_job_item_progress_cb:
+ **/
+static void
+pk_test_backend_job_item_progress_cb (PkBackendJob *job, PkItemProgress *item, gpointer user_data)
+{
+	g_ptr_array_add (_backend_job_item_progress, g_object_ref (item));
+}
+
+static void
+pk_test_backend_job_coalesce_func (void)
+{
+	guint i;
+	PkItemProgress *item;
+	_cleanup_keyfile_unref_ GKeyFile *conf = NULL;
+	_cleanup_object_unref_ PkBackendJob *job = NULL;
+
+	conf = g_key_file_new ();
+	job = pk_backend_job_new (conf);
+	pk_backend_job_set_vfunc (job,
+				  PK_BACKEND_SIGNAL_PERCENTAGE,
+				  (PkBackendJobVFunc) pk_test_backend_job_percentage_cb,
+				  NULL);
+	pk_backend_job_set_vfunc (job,
+				  PK_BACKEND_SIGNAL_ITEM_PROGRESS,
+				  (PkBackendJobVFunc) pk_test_backend_job_item_progress_cb,
+				  NULL);
+	_backend_job_number_percentage = 0;
+	_backend_job_item_progress = g_ptr_array_new_with_free_func (g_object_unref);
+
+	/* nothing is delivered before the main loop runs, so this is all
+	 * one batch */
+	for (i = 1; i < 100; i++) {
+		pk_backend_job_set_percentage (job, i);
+		pk_backend_job_set_item_progress (job, "foo;1.0;i386;fedora",
+						  PK_STATUS_ENUM_DOWNLOAD, i);
+	}
+	for (i = 1; i < 100; i++) {
+		pk_backend_job_set_item_progress (job, "foo;1.0;i386;fedora",
+						  PK_STATUS_ENUM_INSTALL, i);
+	}
+	pk_backend_job_set_item_progress (job, "bar;1.0;i386;fedora",
+					  PK_STATUS_ENUM_DOWNLOAD, 50);
+	while (g_main_context_iteration (NULL, FALSE));
+
+	/* only the newest percentage */
+	g_assert_cmpint (_backend_job_number_percentage, ==, 1);
+	g_assert_cmpint (_backend_job_last_percentage, ==, 99);
+
+	/* the newest item progress for each package in each status */
+	g_assert_cmpint (_backend_job_item_progress->len, ==, 3);
+	item = g_ptr_array_index (_backend_job_item_progress, 0);
+	g_assert_cmpstr (pk_item_progress_get_package_id (item), ==, "foo;1.0;i386;fedora");
+	g_assert_cmpint (pk_item_progress_get_status (item), ==, PK_STATUS_ENUM_DOWNLOAD);
+	g_assert_cmpint (pk_item_progress_get_percentage (item), ==, 99);
+	item = g_ptr_array_index (_backend_job_item_progress, 1);
+	g_assert_cmpstr (pk_item_progress_get_package_id (item), ==, "foo;1.0;i386;fedora");
+	g_assert_cmpint (pk_item_progress_get_status (item), ==, PK_STATUS_ENUM_INSTALL);
+	g_assert_cmpint (pk_item_progress_get_percentage (item), ==, 99);
+	item = g_ptr_array_index (_backend_job_item_progress, 2);
+	g_assert_cmpstr (pk_item_progress_get_package_id (item), ==, "bar;1.0;i386;fedora");
+	g_assert_cmpint (pk_item_progress_get_status (item), ==, PK_STATUS_ENUM_DOWNLOAD);
+	g_assert_cmpint (pk_item_progress_get_percentage (item), ==, 50);
+
+	g_ptr_array_unref (_backend_job_item_progress);
+}
+
 static guint _backend_spawn_number_packages = 0;
 
 /**
@@ -509,13 +681,162 @@ pk_test_backend_spawn_func (void)
 	g_object_unref (backend_spawn);
 }
 
+#define PK_TEST_BACKEND_SPAWN_REPLAY_LINES	100000
+
+static guint _backend_spawn_replay_packages = 0;
+
+/**
+ * pk_test_backend_spawn_replay_package_cb:
+ **/
+static void
+pk_test_backend_spawn_replay_package_cb (PkBackendJob *job, PkPackage *package, gpointer user_data)
+{
+	if (++_backend_spawn_replay_packages == PK_TEST_BACKEND_SPAWN_REPLAY_LINES)
+		_g_test_loop_quit ();
+}
+
+/**
+ * pk_test_backend_spawn_replay_stdout_cb:
+ **/
+static void
+pk_test_backend_spawn_replay_stdout_cb (PkSpawn *spawn, const gchar *line, PkBackendJob *job)
+{
+	gboolean ret;
+	_cleanup_error_free_ GError *error = NULL;
+	PkBackendSpawn *backend_spawn = g_object_get_data (G_OBJECT (job), "backend-spawn");
+
+	ret = pk_backend_spawn_inject_data (backend_spawn, job, line, &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+}
+
+static void
+pk_test_backend_spawn_replay_func (void)
+{
+	gboolean ret;
+	gdouble elapsed;
+	guint i;
+	_cleanup_error_free_ GError *error = NULL;
+	_cleanup_free_ gchar *filename = NULL;
+	_cleanup_keyfile_unref_ GKeyFile *conf = NULL;
+	_cleanup_object_unref_ PkBackendJob *job = NULL;
+	_cleanup_object_unref_ PkBackendSpawn *backend_spawn = NULL;
+	_cleanup_object_unref_ PkSpawn *spawn = NULL;
+	_cleanup_string_free_ GString *transcript = NULL;
+	_cleanup_strv_free_ gchar **argv = NULL;
+	_cleanup_timer_destroy_ GTimer *timer = NULL;
+
+	/* write the sort of transcript a helper produces for GetPackages */
+	transcript = g_string_new ("");
+	for (i = 0; i < PK_TEST_BACKEND_SPAWN_REPLAY_LINES; i++) {
+		g_string_append_printf (transcript,
+					"package\t%s\tpackage%06u;1.%u-1.fc21;x86_64;fedora\t"
+					"The summary text for package %u\n",
+					i % 2 ? "available" : "installed", i, i % 17, i);
+	}
+	filename = g_build_filename (g_get_tmp_dir (), "pk-self-test-transcript", NULL);
+	ret = g_file_set_contents (filename, transcript->str, transcript->len, &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+
+	conf = g_key_file_new ();
+	backend_spawn = pk_backend_spawn_new (conf);
+	job = pk_backend_job_new (conf);
+	g_object_set_data (G_OBJECT (job), "backend-spawn", backend_spawn);
+	pk_backend_job_set_vfunc (job,
+				  PK_BACKEND_SIGNAL_PACKAGE,
+				  (PkBackendJobVFunc) pk_test_backend_spawn_replay_package_cb,
+				  NULL);
+
+	/* replay it through the pipe reader and the parser */
+	spawn = pk_spawn_new (conf);
+	g_signal_connect (spawn, "stdout",
+			  G_CALLBACK (pk_test_backend_spawn_replay_stdout_cb), job);
+	argv = g_new0 (gchar *, 3);
+	argv[0] = g_strdup ("cat");
+	argv[1] = g_strdup (filename);
+	timer = g_timer_new ();
+	ret = pk_spawn_argv (spawn, argv, NULL, PK_SPAWN_ARGV_FLAGS_NONE, &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+	_g_test_loop_run_with_timeout (60000);
+	elapsed = g_timer_elapsed (timer, NULL);
+	g_debug ("replayed %u lines in %.3fs: %.0f lines/s",
+		 PK_TEST_BACKEND_SPAWN_REPLAY_LINES, elapsed,
+		 (gdouble) PK_TEST_BACKEND_SPAWN_REPLAY_LINES / elapsed);
+	g_assert_cmpint (_backend_spawn_replay_packages, ==, PK_TEST_BACKEND_SPAWN_REPLAY_LINES);
+
+	g_unlink (filename);
+}
+
+static void
+pk_test_dbus_credentials_cb (GObject *source_object, GAsyncResult *res, gpointer user_data)
+{
+	gboolean *ret = (gboolean *) user_data;
+	_cleanup_error_free_ GError *error = NULL;
+
+	*ret = pk_dbus_get_credentials_finish (PK_DBUS (source_object), res, &error);
+	g_assert_no_error (error);
+	_g_test_loop_quit ();
+}
+
 static void
 pk_test_dbus_func (void)
 {
+	const gchar *sender;
+	gboolean ret = FALSE;
+	guint i;
+	_cleanup_error_free_ GError *error = NULL;
+	_cleanup_free_ gchar *address = NULL;
+	_cleanup_object_unref_ GDBusConnection *connection = NULL;
 	_cleanup_object_unref_ PkDbus *dbus = NULL;
 
 	dbus = pk_dbus_new ();
 	g_assert (dbus != NULL);
+
+	/* resolve the credentials without blocking */
+	pk_dbus_get_credentials_async (dbus, ":org.freedesktop.PackageKit", NULL,
+				       pk_test_dbus_credentials_cb, &ret);
+	_g_test_loop_run_with_timeout (5000);
+	g_assert (ret);
+	g_assert_cmpint (pk_dbus_get_uid (dbus, ":org.freedesktop.PackageKit"), ==, 500);
+
+	/* use a connection of our own as a sender we can disconnect */
+	address = g_dbus_address_get_for_bus_sync (G_BUS_TYPE_SYSTEM, NULL, &error);
+	if (address != NULL) {
+		connection = g_dbus_connection_new_for_address_sync (address,
+								     G_DBUS_CONNECTION_FLAGS_AUTHENTICATION_CLIENT |
+								     G_DBUS_CONNECTION_FLAGS_MESSAGE_BUS_CONNECTION,
+								     NULL, NULL, &error);
+	}
+	if (connection == NULL) {
+		g_debug ("no system bus, skipping: %s", error->message);
+		return;
+	}
+	sender = g_dbus_connection_get_unique_name (connection);
+	ret = FALSE;
+	pk_dbus_get_credentials_async (dbus, sender, NULL,
+				       pk_test_dbus_credentials_cb, &ret);
+	_g_test_loop_run_with_timeout (5000);
+	g_assert (ret);
+	g_assert_cmpint (pk_dbus_get_cache_size (dbus), ==, 1);
+	g_assert_cmpint (pk_dbus_get_uid (dbus, sender), ==, getuid ());
+
+	/* a second request is answered from the cache */
+	ret = FALSE;
+	pk_dbus_get_credentials_async (dbus, sender, NULL,
+				       pk_test_dbus_credentials_cb, &ret);
+	_g_test_loop_run_with_timeout (5000);
+	g_assert (ret);
+	g_assert_cmpint (pk_dbus_get_cache_size (dbus), ==, 1);
+
+	/* the credentials are dropped when the sender disconnects */
+	ret = g_dbus_connection_close_sync (connection, NULL, &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+	for (i = 0; i < 50 && pk_dbus_get_cache_size (dbus) > 0; i++)
+		_g_test_loop_wait (100);
+	g_assert_cmpint (pk_dbus_get_cache_size (dbus), ==, 0);
 }
 
 PkSpawnExitType mexit = PK_SPAWN_EXIT_TYPE_UNKNOWN;
@@ -755,6 +1076,56 @@ pk_test_spawn_func (void)
 	g_assert (!ret);
 }
 
+static guint _spawn_latency_count = 0;
+static gint64 _spawn_latency_max = 0;
+
+/**
+ * pk_test_spawn_latency_stdout_cb:
+ **/
+static void
+pk_test_spawn_latency_stdout_cb (PkSpawn *spawn, const gchar *line, gpointer user_data)
+{
+	gint64 latency;
+
+	if (!g_str_has_prefix (line, "timestamp\t"))
+		return;
+	latency = g_get_real_time () - g_ascii_strtoll (line + 10, NULL, 10);
+	g_debug ("line processed after %" G_GINT64_FORMAT "us", latency);
+	_spawn_latency_max = MAX (_spawn_latency_max, latency);
+	_spawn_latency_count++;
+}
+
+static void
+pk_test_spawn_latency_func (void)
+{
+	gboolean ret;
+	_cleanup_error_free_ GError *error = NULL;
+	_cleanup_keyfile_unref_ GKeyFile *conf = NULL;
+	_cleanup_object_unref_ PkSpawn *spawn = NULL;
+	_cleanup_strv_free_ gchar **argv = NULL;
+
+	conf = g_key_file_new ();
+	spawn = pk_spawn_new (conf);
+	g_signal_connect (spawn, "exit",
+			  G_CALLBACK (pk_test_exit_cb), NULL);
+	g_signal_connect (spawn, "stdout",
+			  G_CALLBACK (pk_test_spawn_latency_stdout_cb), NULL);
+
+	/* the helper writes one timestamped line every 100ms */
+	mexit = PK_SPAWN_EXIT_TYPE_UNKNOWN;
+	argv = g_strsplit (TESTDATADIR "/pk-spawn-test-latency.sh", " ", 0);
+	ret = pk_spawn_argv (spawn, argv, NULL, PK_SPAWN_ARGV_FLAGS_NONE, &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+	_g_test_loop_run_with_timeout (5000);
+
+	/* every line arrived before the exit was noticed */
+	g_assert_cmpint (mexit, ==, PK_SPAWN_EXIT_TYPE_SUCCESS);
+	g_assert_cmpint (_spawn_latency_count, ==, 10);
+	g_debug ("maximum latency %" G_GINT64_FORMAT "us", _spawn_latency_max);
+	g_assert_cmpint (_spawn_latency_max, <, G_USEC_PER_SEC);
+}
+
 static void
 pk_test_transaction_func (void)
 {
@@ -787,17 +1158,83 @@ pk_test_transaction_func (void)
 	g_dbus_node_info_unref (introspection);
 }
 
+static void
+pk_test_results_cache_func (void)
+{
+	PkBitfield filters;
+	guint64 generation;
+	_cleanup_strv_free_ gchar **names = NULL;
+	_cleanup_strv_free_ gchar **other = NULL;
+	_cleanup_object_unref_ PkNotify *notify = NULL;
+	_cleanup_object_unref_ PkResults *cached = NULL;
+	_cleanup_object_unref_ PkResults *failed = NULL;
+	_cleanup_object_unref_ PkResults *results = NULL;
+	_cleanup_object_unref_ PkResultsCache *cache = NULL;
+
+	cache = pk_results_cache_new ();
+	g_assert (cache != NULL);
+	names = g_strsplit ("powertop", ";", -1);
+	other = g_strsplit ("colord", ";", -1);
+	g_assert (pk_results_cache_role_is_cacheable (PK_ROLE_ENUM_RESOLVE));
+	g_assert (!pk_results_cache_role_is_cacheable (PK_ROLE_ENUM_INSTALL_PACKAGES));
+	g_assert (pk_results_cache_role_invalidates (PK_ROLE_ENUM_REFRESH_CACHE));
+	g_assert (!pk_results_cache_role_invalidates (PK_ROLE_ENUM_GET_DETAILS));
+
+	/* only successful queries are saved */
+	filters = pk_filter_bitfield_from_string ("installed");
+	failed = pk_results_new ();
+	pk_results_set_exit_code (failed, PK_EXIT_ENUM_FAILED);
+	pk_results_cache_add (cache, PK_ROLE_ENUM_RESOLVE, filters, "C", names, failed);
+	g_assert_cmpint (pk_results_cache_get_size (cache), ==, 0);
+	results = pk_results_new ();
+	pk_results_set_exit_code (results, PK_EXIT_ENUM_SUCCESS);
+	pk_results_cache_add (cache, PK_ROLE_ENUM_INSTALL_PACKAGES, filters, "C", names, results);
+	g_assert_cmpint (pk_results_cache_get_size (cache), ==, 0);
+	pk_results_cache_add (cache, PK_ROLE_ENUM_RESOLVE, filters, "C", names, results);
+	g_assert_cmpint (pk_results_cache_get_size (cache), ==, 1);
+
+	/* the key includes the role, filters, locale and values */
+	cached = pk_results_cache_lookup (cache, PK_ROLE_ENUM_RESOLVE, filters, "C", names);
+	g_assert (cached == results);
+	g_assert (pk_results_cache_lookup (cache, PK_ROLE_ENUM_GET_DETAILS, filters, "C", names) == NULL);
+	g_assert (pk_results_cache_lookup (cache, PK_ROLE_ENUM_RESOLVE, 0, "C", names) == NULL);
+	g_assert (pk_results_cache_lookup (cache, PK_ROLE_ENUM_RESOLVE, filters, "en_GB", names) == NULL);
+	g_assert (pk_results_cache_lookup (cache, PK_ROLE_ENUM_RESOLVE, filters, "C", other) == NULL);
+
+	/* the package database changed */
+	generation = pk_results_cache_get_generation (cache);
+	notify = pk_notify_new ();
+	pk_notify_updates_changed (notify);
+	g_assert_cmpint (pk_results_cache_get_size (cache), ==, 0);
+	g_assert_cmpuint (pk_results_cache_get_generation (cache), >, generation);
+	pk_results_cache_add (cache, PK_ROLE_ENUM_GET_UPDATES, 0, NULL, NULL, results);
+	g_assert_cmpint (pk_results_cache_get_size (cache), ==, 1);
+	pk_notify_repo_list_changed (notify);
+	g_assert_cmpint (pk_results_cache_get_size (cache), ==, 0);
+
+	/* clients may hold results even when we have nothing cached */
+	generation = pk_results_cache_get_generation (cache);
+	pk_results_cache_invalidate (cache);
+	g_assert_cmpuint (pk_results_cache_get_generation (cache), >, generation);
+}
+
 static void
 pk_test_transaction_db_func (void)
 {
 	guint value;
 	gchar *tid;
+	const gchar *tmp;
+	GList *list;
+	GVariant *entry;
+	GVariant *history;
 	gboolean ret;
 	gdouble ms;
+	guint64 cursor;
 	GError *error = NULL;
 	_cleanup_object_unref_ PkTransactionDb *db = NULL;
 	_cleanup_free_ gchar *proxy_http = NULL;
 	_cleanup_free_ gchar *proxy_ftp = NULL;
+	_cleanup_free_ gchar *stamp = NULL;
 
 	/* remove the self check file */
 #if PK_BUILD_LOCAL
@@ -831,6 +1268,18 @@ pk_test_transaction_db_func (void)
 	value = pk_transaction_db_action_time_since (db, PK_ROLE_ENUM_REFRESH_CACHE);
 	g_assert_cmpint (value, ==, G_MAXUINT);
 
+	/* the results cache generation is saved */
+	ret = pk_transaction_db_set_cache_generation (db, G_GUINT64_CONSTANT (0x1234567890));
+	g_assert (ret);
+	g_assert_cmpuint (pk_transaction_db_get_cache_generation (db), ==,
+			  G_GUINT64_CONSTANT (0x1234567890));
+
+	/* and so is the package database stamp it was checked against */
+	ret = pk_transaction_db_set_cache_stamp (db, "1414141414.5:1414141415.6");
+	g_assert (ret);
+	stamp = pk_transaction_db_get_cache_stamp (db);
+	g_assert_cmpstr (stamp, ==, "1414141414.5:1414141415.6");
+
 	/* get an tid object */
 	g_test_timer_start ();
 	tid = pk_transaction_db_generate_id (db);
@@ -858,6 +1307,92 @@ pk_test_transaction_db_func (void)
 	g_assert_cmpint (value, >, 1);
 	g_assert_cmpint (value, <=, 4);
 
+	/* metadata is only written when the transaction finishes */
+	ret = pk_transaction_db_add (db, "/1_dave");
+	g_assert (ret);
+	ret = pk_transaction_db_set_role (db, "/1_dave", PK_ROLE_ENUM_INSTALL_PACKAGES);
+	g_assert (ret);
+	ret = pk_transaction_db_set_uid (db, "/1_dave", 500);
+	g_assert (ret);
+	ret = pk_transaction_db_set_data (db, "/1_dave",
+					  "installing\tpowertop;1.8-1.fc8;i386;fedora\tPower consumption monitor\n"
+					  "installing\tpowertop;1.8-1.fc8;x86_64;fedora\tPower consumption monitor\n"
+					  "downloading\tcolord;1.0.0-1.fc8;i386;fedora\tColor daemon");
+	g_assert (ret);
+	list = pk_transaction_db_get_list (db, 0);
+	g_assert_cmpint (g_list_length (list), ==, 0);
+	ret = pk_transaction_db_set_finished (db, "/1_dave", TRUE, 1234);
+	g_assert (ret);
+
+	/* a transaction that never finished is not saved */
+	ret = pk_transaction_db_add (db, "/4_dave");
+	g_assert (ret);
+	pk_transaction_db_remove (db, "/4_dave");
+	ret = pk_transaction_db_set_finished (db, "/4_dave", TRUE, 1234);
+	g_assert (!ret);
+	list = pk_transaction_db_get_list (db, 0);
+	g_assert_cmpint (g_list_length (list), ==, 1);
+	g_assert_cmpstr (pk_transaction_past_get_id (list->data), ==, "/1_dave");
+	g_assert_cmpint (pk_transaction_past_get_role (list->data), ==, PK_ROLE_ENUM_INSTALL_PACKAGES);
+	g_assert_cmpint (pk_transaction_past_get_uid (list->data), ==, 500);
+	g_assert_cmpint (pk_transaction_past_get_duration (list->data), ==, 1234);
+	g_assert (pk_transaction_past_get_succeeded (list->data));
+	g_list_free_full (list, (GDestroyNotify) g_object_unref);
+
+	/* the package history is indexed by name, ignoring multiarch */
+	history = pk_transaction_db_get_package_history (db, "powertop", 0);
+	g_assert (history != NULL);
+	g_assert_cmpint (g_variant_n_children (history), ==, 1);
+	g_variant_unref (history);
+	history = pk_transaction_db_get_package_history (db, "colord", 0);
+	g_assert (history == NULL);
+
+	/* page through all the history one entry at a time */
+	history = pk_transaction_db_get_history_since (db, 0, 0, 1, &cursor);
+	g_assert_cmpint (g_variant_n_children (history), ==, 1);
+	entry = g_variant_get_child_value (history, 0);
+	g_assert (g_variant_lookup (entry, "arch", "&s", &tmp));
+	g_assert_cmpstr (tmp, ==, "i386");
+	g_variant_unref (entry);
+	g_variant_unref (history);
+	history = pk_transaction_db_get_history_since (db, 0, cursor, 1, &cursor);
+	g_assert_cmpint (g_variant_n_children (history), ==, 1);
+	g_variant_unref (history);
+	history = pk_transaction_db_get_history_since (db, 0, cursor, 1, &cursor);
+	g_assert_cmpint (g_variant_n_children (history), ==, 0);
+	g_variant_unref (history);
+
+	/* only new history is returned when polling with the cursor */
+	ret = pk_transaction_db_add (db, "/3_dave");
+	g_assert (ret);
+	ret = pk_transaction_db_set_data (db, "/3_dave",
+					  "removing\tcolord;1.0.0-1.fc8;i386;fedora\tColor daemon");
+	g_assert (ret);
+	ret = pk_transaction_db_set_finished (db, "/3_dave", TRUE, 1234);
+	g_assert (ret);
+	history = pk_transaction_db_get_history_since (db, 0, cursor, 0, &cursor);
+	g_assert_cmpint (g_variant_n_children (history), ==, 1);
+	entry = g_variant_get_child_value (history, 0);
+	g_assert (g_variant_lookup (entry, "name", "&s", &tmp));
+	g_assert_cmpstr (tmp, ==, "colord");
+	g_variant_unref (entry);
+	g_variant_unref (history);
+
+	/* nothing is newer than the future */
+	history = pk_transaction_db_get_history_since (db, G_MAXINT64, 0, 0, &cursor);
+	g_assert_cmpint (g_variant_n_children (history), ==, 0);
+	g_variant_unref (history);
+	history = pk_transaction_db_get_history_since (db, G_MAXUINT64, 0, 0, &cursor);
+	g_assert_cmpint (g_variant_n_children (history), ==, 0);
+	g_variant_unref (history);
+	history = pk_transaction_db_get_history_since (db, 0, G_MAXUINT64, 0, &cursor);
+	g_assert_cmpint (g_variant_n_children (history), ==, 0);
+	g_variant_unref (history);
+
+	/* finishing an unknown transaction does not write anything */
+	ret = pk_transaction_db_set_finished (db, "/2_dave", TRUE, 1234);
+	g_assert (!ret);
+
 	/* can we set the proxies */
 	ret = pk_transaction_db_set_proxy (db, 500, "session1",
 					   "127.0.0.1:80",
@@ -1260,7 +1795,13 @@ pk_test_scheduler_parallel_func (void)
 	guint size;
 	gboolean ret;
 	guint i;
+	guint running;
+	guint lane_max;
+	guint waiting;
+	const gchar *lane;
 	gchar **array;
+	GVariant *lanes;
+	GVariantIter iter;
 	PkTransaction *transaction1;
 	PkTransaction *transaction2;
 	PkTransaction *transaction3;
@@ -1374,6 +1915,26 @@ pk_test_scheduler_parallel_func (void)
 	g_assert_cmpint (size, ==, 4);
 	g_strfreev (array);
 
+	/* every committed transaction is either running or waiting in a lane */
+	lanes = pk_scheduler_get_lanes (tlist);
+	g_assert_cmpint (g_variant_n_children (lanes), ==, 2);
+	g_variant_iter_init (&iter, lanes);
+	size = 0;
+	while (g_variant_iter_next (&iter, "{&s(uuu)}", &lane, &running, &lane_max, &waiting)) {
+		g_assert_cmpint (running, <=, lane_max);
+		size += running + waiting;
+	}
+	g_assert_cmpint (size, ==, 4);
+	g_variant_unref (lanes);
+
+	/* installing is exclusive by role, so the second install waits even
+	 * before the first one has locked the backend */
+	transaction1 = pk_scheduler_get_transaction (tlist, tid_item4);
+	g_assert (pk_transaction_is_exclusive (transaction1));
+	g_assert_cmpint (pk_transaction_get_state (transaction1), ==, PK_TRANSACTION_STATE_READY);
+	transaction1 = pk_scheduler_get_transaction (tlist, tid_item3);
+	g_assert (!pk_transaction_is_exclusive (transaction1));
+
 	/* wait for one action to complete */
 	_g_test_loop_run_with_timeout (10000);
 
@@ -1482,7 +2043,9 @@ main (int argc, char **argv)
 	/* components */
 	g_test_add_func ("/packagekit/dbus", pk_test_dbus_func);
 	g_test_add_func ("/packagekit/spawn", pk_test_spawn_func);
+	g_test_add_func ("/packagekit/spawn-latency", pk_test_spawn_latency_func);
 	g_test_add_func ("/packagekit/transaction", pk_test_transaction_func);
+	g_test_add_func ("/packagekit/results-cache", pk_test_results_cache_func);
 	g_test_add_func ("/packagekit/scheduler", pk_test_scheduler_func);
 	g_test_add_func ("/packagekit/scheduler-parallel", pk_test_scheduler_parallel_func);
 	g_test_add_func ("/packagekit/transaction-db", pk_test_transaction_db_func);
@@ -1490,6 +2053,9 @@ main (int argc, char **argv)
 	/* backend stuff */
 	g_test_add_func ("/packagekit/backend", pk_test_backend_func);
 	g_test_add_func ("/packagekit/backend_spawn", pk_test_backend_spawn_func);
+	g_test_add_func ("/packagekit/backend-spawn-replay", pk_test_backend_spawn_replay_func);
+	g_test_add_func ("/packagekit/backend-job", pk_test_backend_job_func);
+	g_test_add_func ("/packagekit/backend-job-coalesce", pk_test_backend_job_coalesce_func);
 
 	return g_test_run ();
 }
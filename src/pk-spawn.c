@@ -37,8 +37,12 @@
 
 #include <sys/wait.h>
 #include <fcntl.h>
+#ifdef __linux__
+#include <sys/syscall.h>
+#endif
 
 #include <glib/gi18n.h>
+#include <glib-unix.h>
 
 #include "pk-cleanup.h"
 #include "pk-spawn.h"
@@ -58,7 +62,11 @@ struct PkSpawnPrivate
 	gint			 stdin_fd;
 	gint			 stdout_fd;
 	gint			 stderr_fd;
+	gint			 pid_fd;
 	guint			 poll_id;
+	guint			 stdout_id;
+	guint			 stderr_id;
+	guint			 exit_id;
 	guint			 kill_id;
 	gboolean		 finished;
 	gboolean		 background;
@@ -67,6 +75,7 @@ struct PkSpawnPrivate
 	gboolean		 allow_sigkill;
 	PkSpawnExitType		 exit;
 	GString			*stdout_buf;
+	gsize			 stdout_scanned;
 	GString			*stderr_buf;
 	gchar			*last_argv0;
 	gchar			**last_envp;
@@ -93,55 +102,59 @@ G_DEFINE_TYPE (PkSpawn, pk_spawn, G_TYPE_OBJECT)
 
 /**
  * pk_spawn_read_fd_into_buffer:
+ *
+ * Reads directly into the spare space at the end of the buffer so the
+ * data is only ever copied once.
  **/
 static gboolean
 pk_spawn_read_fd_into_buffer (gint fd, GString *string)
 {
-	gint bytes_read;
-	gchar buffer[BUFSIZ];
+	gssize bytes_read;
+	gsize len;
 
-	/* ITS4: ignore, we manually NULL terminate and GString cannot overflow */
-	while ((bytes_read = read (fd, buffer, BUFSIZ-1)) > 0) {
-		buffer[bytes_read] = '\0';
-		g_string_append (string, buffer);
-	}
+	do {
+		len = string->len;
+		g_string_set_size (string, len + BUFSIZ);
+		bytes_read = read (fd, string->str + len, BUFSIZ);
+		g_string_set_size (string, len + MAX (bytes_read, 0));
+	} while (bytes_read > 0);
 
 	return TRUE;
 }
 
 /**
  * pk_spawn_emit_whole_lines:
+ *
+ * Emits each complete line in the buffer without copying it, by
+ * terminating it in place. Only the trailing partial line is kept, and
+ * we remember how much of it has already been searched for a newline.
  **/
 static gboolean
 pk_spawn_emit_whole_lines (PkSpawn *spawn, GString *string)
 {
-	guint i;
-	guint size;
-	guint bytes_processed;
-	_cleanup_strv_free_ gchar **lines = NULL;
-
-	/* if nothing then don't emit */
-	if (pk_strzero (string->str))
-		return FALSE;
+	gchar *line;
+	gchar *eol;
+	gchar *end;
 
-	/* split into lines - the last line may be incomplete */
-	lines = g_strsplit (string->str, "\n", 0);
-	if (lines == NULL)
+	/* nothing new since last time */
+	if (string->len <= spawn->priv->stdout_scanned)
 		return FALSE;
 
-	/* find size */
-	size = g_strv_length (lines);
-
-	bytes_processed = 0;
-	/* we only emit n-1 strings */
-	for (i = 0; i < (size-1); i++) {
-		g_signal_emit (spawn, signals [SIGNAL_STDOUT], 0, lines[i]);
-		/* ITS4: ignore, g_strsplit always NULL terminates */
-		bytes_processed += strlen (lines[i]) + 1;
-	}
-
-	/* remove the text we've processed */
-	g_string_erase (string, 0, bytes_processed);
+	line = string->str;
+	end = string->str + string->len;
+	eol = memchr (line + spawn->priv->stdout_scanned, '\n',
+		      string->len - spawn->priv->stdout_scanned);
+	while (eol != NULL) {
+		*eol = '\0';
+		g_signal_emit (spawn, signals [SIGNAL_STDOUT], 0, line);
+		line = eol + 1;
+		eol = memchr (line, '\n', end - line);
+	}
+
+	/* remove the text we've processed, which only moves the partial line */
+	if (line != string->str)
+		g_string_erase (string, 0, line - string->str);
+	spawn->priv->stdout_scanned = string->len;
 	return TRUE;
 }
 
@@ -166,8 +179,65 @@ pk_spawn_exit_type_enum_to_string (PkSpawnExitType type)
 	return "unknown";
 }
 
+/**
+ * pk_spawn_read_stdout:
+ **/
+static void
+pk_spawn_read_stdout (PkSpawn *spawn)
+{
+	/* all usual output goes on standard out, only bad libraries bitch to stderr */
+	pk_spawn_read_fd_into_buffer (spawn->priv->stdout_fd, spawn->priv->stdout_buf);
+	pk_spawn_emit_whole_lines (spawn, spawn->priv->stdout_buf);
+}
+
+/**
+ * pk_spawn_read_stderr:
+ **/
+static void
+pk_spawn_read_stderr (PkSpawn *spawn)
+{
+	pk_spawn_read_fd_into_buffer (spawn->priv->stderr_fd, spawn->priv->stderr_buf);
+
+	/* emit all lines on standard out in one callback, as it's all probably
+	* related to the error that just happened */
+	if (spawn->priv->stderr_buf->len != 0) {
+		g_signal_emit (spawn, signals [SIGNAL_STDERR], 0, spawn->priv->stderr_buf->str);
+		g_string_set_size (spawn->priv->stderr_buf, 0);
+	}
+}
+
+/**
+ * pk_spawn_remove_sources:
+ **/
+static void
+pk_spawn_remove_sources (PkSpawn *spawn)
+{
+	if (spawn->priv->poll_id != 0) {
+		g_source_remove (spawn->priv->poll_id);
+		spawn->priv->poll_id = 0;
+	}
+	if (spawn->priv->stdout_id != 0) {
+		g_source_remove (spawn->priv->stdout_id);
+		spawn->priv->stdout_id = 0;
+	}
+	if (spawn->priv->stderr_id != 0) {
+		g_source_remove (spawn->priv->stderr_id);
+		spawn->priv->stderr_id = 0;
+	}
+	if (spawn->priv->exit_id != 0) {
+		g_source_remove (spawn->priv->exit_id);
+		spawn->priv->exit_id = 0;
+	}
+	if (spawn->priv->pid_fd != -1) {
+		close (spawn->priv->pid_fd);
+		spawn->priv->pid_fd = -1;
+	}
+}
+
 /**
  * pk_spawn_check_child:
+ *
+ * Return value: %TRUE if the child is still running
  **/
 static gboolean
 pk_spawn_check_child (PkSpawn *spawn)
@@ -175,31 +245,16 @@ pk_spawn_check_child (PkSpawn *spawn)
 	pid_t pid;
 	int status;
 	gint retval;
-	static guint limit_printing = 0;
 
 	/* this shouldn't happen */
 	if (spawn->priv->finished) {
 		g_warning ("finished twice!");
-		spawn->priv->poll_id = 0;
 		return FALSE;
 	}
 
-	pk_spawn_read_fd_into_buffer (spawn->priv->stdout_fd, spawn->priv->stdout_buf);
-	pk_spawn_read_fd_into_buffer (spawn->priv->stderr_fd, spawn->priv->stderr_buf);
-
-	/* emit all lines on standard out in one callback, as it's all probably
-	* related to the error that just happened */
-	if (spawn->priv->stderr_buf->len != 0) {
-		g_signal_emit (spawn, signals [SIGNAL_STDERR], 0, spawn->priv->stderr_buf->str);
-		g_string_set_size (spawn->priv->stderr_buf, 0);
-	}
-
-	/* all usual output goes on standard out, only bad libraries bitch to stderr */
-	pk_spawn_emit_whole_lines (spawn, spawn->priv->stdout_buf);
-
-	/* Only print one in twenty times to avoid filling the screen */
-	if (limit_printing++ % 20 == 0)
-		g_debug ("polling child_pid=%ld (1/20)", (long)spawn->priv->child_pid);
+	/* get anything that was written before the child exited */
+	pk_spawn_read_stderr (spawn);
+	pk_spawn_read_stdout (spawn);
 
 	/* check if the child exited */
 	pid = waitpid (spawn->priv->child_pid, &status, WNOHANG);
@@ -217,11 +272,8 @@ pk_spawn_check_child (PkSpawn *spawn)
 		return TRUE;
 	}
 
-	/* disconnect the poll as there will be no more updates */
-	if (spawn->priv->poll_id > 0) {
-		g_source_remove (spawn->priv->poll_id);
-		spawn->priv->poll_id = 0;
-	}
+	/* disconnect the watches as there will be no more updates */
+	pk_spawn_remove_sources (spawn);
 
 	/* child exited, close resources */
 	close (spawn->priv->stdin_fd);
@@ -286,9 +338,101 @@ pk_spawn_check_child (PkSpawn *spawn)
 	/* don't emit if we just closed an invalid dispatcher */
 	g_debug ("emitting exit %s", pk_spawn_exit_type_enum_to_string (spawn->priv->exit));
 	g_signal_emit (spawn, signals [SIGNAL_EXIT], 0, spawn->priv->exit);
+	return FALSE;
+}
 
+/**
+ * pk_spawn_poll_cb:
+ *
+ * Only used when we cannot be told when the child exits.
+ **/
+static gboolean
+pk_spawn_poll_cb (gpointer user_data)
+{
+	PkSpawn *spawn = PK_SPAWN (user_data);
+
+	if (pk_spawn_check_child (spawn))
+		return G_SOURCE_CONTINUE;
 	spawn->priv->poll_id = 0;
-	return FALSE;
+	return G_SOURCE_REMOVE;
+}
+
+/**
+ * pk_spawn_poll_start:
+ **/
+static void
+pk_spawn_poll_start (PkSpawn *spawn)
+{
+	if (spawn->priv->poll_id != 0)
+		return;
+	spawn->priv->poll_id = g_timeout_add (PK_SPAWN_POLL_DELAY, pk_spawn_poll_cb, spawn);
+	g_source_set_name_by_id (spawn->priv->poll_id, "[PkSpawn] exit poll");
+}
+
+/**
+ * pk_spawn_exit_cb:
+ *
+ * Called when the pidfd becomes readable, i.e. the child has exited.
+ **/
+static gboolean
+pk_spawn_exit_cb (gint fd, GIOCondition condition, gpointer user_data)
+{
+	PkSpawn *spawn = PK_SPAWN (user_data);
+
+	spawn->priv->exit_id = 0;
+	if (pk_spawn_check_child (spawn))
+		pk_spawn_poll_start (spawn);
+	return G_SOURCE_REMOVE;
+}
+
+/**
+ * pk_spawn_stdout_cb:
+ **/
+static gboolean
+pk_spawn_stdout_cb (gint fd, GIOCondition condition, gpointer user_data)
+{
+	PkSpawn *spawn = PK_SPAWN (user_data);
+
+	pk_spawn_read_stdout (spawn);
+	if ((condition & (G_IO_HUP | G_IO_ERR)) == 0)
+		return G_SOURCE_CONTINUE;
+
+	/* the child closed stdout, so has probably just exited */
+	spawn->priv->stdout_id = 0;
+	if (pk_spawn_check_child (spawn) && spawn->priv->exit_id == 0)
+		pk_spawn_poll_start (spawn);
+	return G_SOURCE_REMOVE;
+}
+
+/**
+ * pk_spawn_stderr_cb:
+ **/
+static gboolean
+pk_spawn_stderr_cb (gint fd, GIOCondition condition, gpointer user_data)
+{
+	PkSpawn *spawn = PK_SPAWN (user_data);
+
+	pk_spawn_read_stderr (spawn);
+	if ((condition & (G_IO_HUP | G_IO_ERR)) == 0)
+		return G_SOURCE_CONTINUE;
+	spawn->priv->stderr_id = 0;
+	return G_SOURCE_REMOVE;
+}
+
+/**
+ * pk_spawn_pidfd_open:
+ *
+ * Return value: a file descriptor that becomes readable when @pid exits,
+ * or -1 if the kernel does not support this.
+ **/
+static gint
+pk_spawn_pidfd_open (pid_t pid)
+{
+#ifdef SYS_pidfd_open
+	return syscall (SYS_pidfd_open, pid, 0);
+#else
+	return -1;
+#endif
 }
 
 /**
@@ -578,11 +722,8 @@ pk_spawn_argv (PkSpawn *spawn, gchar **argv, gchar **envp,
 		ret = pk_spawn_exit (spawn);
 		if (!ret) {
 			g_warning ("failed to exit previous instance");
-			/* remove poll, as we can't reply on pk_spawn_check_child() */
-			if (spawn->priv->poll_id != 0) {
-				g_source_remove (spawn->priv->poll_id);
-				spawn->priv->poll_id = 0;
-			}
+			/* remove watches, as we can't reply on pk_spawn_check_child() */
+			pk_spawn_remove_sources (spawn);
 		}
 		spawn->priv->is_changing_dispatcher = FALSE;
 	}
@@ -644,14 +785,33 @@ pk_spawn_argv (PkSpawn *spawn, gchar **argv, gchar **envp,
 	}
 
 	/* sanity check */
-	if (spawn->priv->poll_id != 0) {
-		g_warning ("trying to set timeout when already set");
-		g_source_remove (spawn->priv->poll_id);
+	if (spawn->priv->stdout_id != 0 || spawn->priv->exit_id != 0 ||
+	    spawn->priv->poll_id != 0) {
+		g_warning ("trying to add watches when already set");
+		pk_spawn_remove_sources (spawn);
+	}
+
+	/* process output as soon as the child writes it */
+	spawn->priv->stdout_id = g_unix_fd_add (spawn->priv->stdout_fd,
+						G_IO_IN | G_IO_HUP | G_IO_ERR,
+						pk_spawn_stdout_cb, spawn);
+	g_source_set_name_by_id (spawn->priv->stdout_id, "[PkSpawn] stdout");
+	spawn->priv->stderr_id = g_unix_fd_add (spawn->priv->stderr_fd,
+						G_IO_IN | G_IO_HUP | G_IO_ERR,
+						pk_spawn_stderr_cb, spawn);
+	g_source_set_name_by_id (spawn->priv->stderr_id, "[PkSpawn] stderr");
+
+	/* get woken when the child exits, even if something it spawned
+	 * still holds stdout open, otherwise fall back to polling */
+	spawn->priv->pid_fd = pk_spawn_pidfd_open (spawn->priv->child_pid);
+	if (spawn->priv->pid_fd != -1) {
+		spawn->priv->exit_id = g_unix_fd_add (spawn->priv->pid_fd,
+						      G_IO_IN,
+						      pk_spawn_exit_cb, spawn);
+		g_source_set_name_by_id (spawn->priv->exit_id, "[PkSpawn] exit");
+	} else {
+		pk_spawn_poll_start (spawn);
 	}
-
-	/* poll quickly */
-	spawn->priv->poll_id = g_timeout_add (PK_SPAWN_POLL_DELAY, (GSourceFunc) pk_spawn_check_child, spawn);
-	g_source_set_name_by_id (spawn->priv->poll_id, "[PkSpawn] main poll");
 out:
 	return ret;
 }
@@ -738,11 +898,13 @@ pk_spawn_class_init (PkSpawnClass *klass)
 			      G_TYPE_FROM_CLASS (object_class), G_SIGNAL_RUN_LAST,
 			      0, NULL, NULL, g_cclosure_marshal_VOID__INT,
 			      G_TYPE_NONE, 1, G_TYPE_INT);
+	/* the line is only valid for the duration of the signal, so
+	 * handlers have to copy it if they want to keep it */
 	signals [SIGNAL_STDOUT] =
 		g_signal_new ("stdout",
 			      G_TYPE_FROM_CLASS (object_class), G_SIGNAL_RUN_LAST,
 			      0, NULL, NULL, g_cclosure_marshal_VOID__STRING,
-			      G_TYPE_NONE, 1, G_TYPE_STRING);
+			      G_TYPE_NONE, 1, G_TYPE_STRING | G_SIGNAL_TYPE_STATIC_SCOPE);
 	signals [SIGNAL_STDERR] =
 		g_signal_new ("stderr",
 			      G_TYPE_FROM_CLASS (object_class), G_SIGNAL_RUN_LAST,
@@ -765,6 +927,7 @@ pk_spawn_init (PkSpawn *spawn)
 	spawn->priv->stdout_fd = -1;
 	spawn->priv->stderr_fd = -1;
 	spawn->priv->stdin_fd = -1;
+	spawn->priv->pid_fd = -1;
 	spawn->priv->poll_id = 0;
 	spawn->priv->kill_id = 0;
 	spawn->priv->finished = FALSE;
@@ -796,11 +959,8 @@ pk_spawn_finalize (GObject *object)
 
 	g_return_if_fail (spawn->priv != NULL);
 
-	/* disconnect the poll in case we were cancelled before completion */
-	if (spawn->priv->poll_id != 0) {
-		g_source_remove (spawn->priv->poll_id);
-		spawn->priv->poll_id = 0;
-	}
+	/* disconnect the watches in case we were cancelled before completion */
+	pk_spawn_remove_sources (spawn);
 
 	/* disconnect the SIGKILL check */
 	if (spawn->priv->kill_id != 0) {
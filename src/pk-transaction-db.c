@@ -39,6 +39,7 @@
 #include <packagekit-glib2/pk-enum.h>
 #include <packagekit-glib2/pk-results.h>
 #include <packagekit-glib2/pk-common.h>
+#include <packagekit-glib2/pk-package-id.h>
 
 #include "pk-shared.h"
 
@@ -49,12 +50,51 @@ static void     pk_transaction_db_finalize	(GObject        *object);
 
 #define PK_TRANSACTION_DB_GET_PRIVATE(o) (G_TYPE_INSTANCE_GET_PRIVATE ((o), PK_TYPE_TRANSACTION_DB, PkTransactionDbPrivate))
 
+/* the most history entries returned by one pk_transaction_db_get_history_since() */
+#define PK_TRANSACTION_DB_HISTORY_PAGE_MAX	1000
+
+typedef enum {
+	PK_TRANSACTION_DB_STMT_ACTION_TIME_SINCE,
+	PK_TRANSACTION_DB_STMT_ACTION_TIME_RESET,
+	PK_TRANSACTION_DB_STMT_ADD,
+	PK_TRANSACTION_DB_STMT_JOB_COUNT,
+	PK_TRANSACTION_DB_STMT_GET_PROXY,
+	PK_TRANSACTION_DB_STMT_ADD_PACKAGE_HISTORY,
+	PK_TRANSACTION_DB_STMT_GET_PACKAGE_HISTORY,
+	PK_TRANSACTION_DB_STMT_GET_HISTORY_SINCE,
+	PK_TRANSACTION_DB_STMT_GET_CONFIG,
+	PK_TRANSACTION_DB_STMT_SET_CONFIG,
+	PK_TRANSACTION_DB_STMT_LAST
+} PkTransactionDbStmt;
+
+static const gchar *pk_transaction_db_stmt_sql[] = {
+	"SELECT timespec FROM last_action WHERE role = ?",
+	"INSERT OR REPLACE INTO last_action (role, timespec) VALUES (?, ?)",
+	"INSERT OR REPLACE INTO transactions (transaction_id, timespec, role, uid, "
+	"cmdline, data, succeeded, duration) VALUES (?, ?, ?, ?, ?, ?, ?, ?)",
+	"UPDATE config SET value = ? WHERE key = 'job_count'",
+	"SELECT proxy_http, proxy_https, proxy_ftp, proxy_socks, no_proxy, pac "
+	"FROM proxy WHERE uid = ? AND session = ? LIMIT 1",
+	"INSERT INTO package_history (name, package_id, info, timestamp, tid, uid) "
+	"VALUES (?, ?, ?, ?, ?, ?)",
+	"SELECT package_id, info, timestamp, uid FROM package_history "
+	"WHERE name = ? ORDER BY timestamp DESC, rowid ASC",
+	"SELECT rowid, name, package_id, info, timestamp, tid, uid FROM package_history "
+	"WHERE rowid > ? AND timestamp >= ? AND info IN (?, ?, ?) "
+	"ORDER BY rowid ASC LIMIT ?",
+	"SELECT value FROM config WHERE key = ?",
+	"INSERT OR REPLACE INTO config (key, value) VALUES (?, ?)",
+	NULL
+};
+
 struct PkTransactionDbPrivate
 {
 	gboolean		 loaded;
 	sqlite3			*db;
 	guint			 job_count;
 	guint			 database_save_id;
+	sqlite3_stmt		*stmts[PK_TRANSACTION_DB_STMT_LAST];
+	GHashTable		*pending;
 };
 
 G_DEFINE_TYPE (PkTransactionDb, pk_transaction_db, G_TYPE_OBJECT)
@@ -69,6 +109,65 @@ typedef struct {
 	gboolean	set;
 } PkTransactionDbProxyItem;
 
+typedef struct {
+	gchar		*timespec;
+	PkRoleEnum	 role;
+	guint		 uid;
+	gchar		*cmdline;
+	gchar		*data;
+} PkTransactionDbItem;
+
+/**
+ * pk_transaction_db_item_free:
+ **/
+static void
+pk_transaction_db_item_free (PkTransactionDbItem *item)
+{
+	g_free (item->timespec);
+	g_free (item->cmdline);
+	g_free (item->data);
+	g_free (item);
+}
+
+/**
+ * pk_transaction_db_get_stmt:
+ *
+ * Gets a cached prepared statement, which is reset and ready to have new
+ * values bound to it.
+ *
+ * Return value: the statement, or %NULL if it could not be prepared
+ **/
+static sqlite3_stmt *
+pk_transaction_db_get_stmt (PkTransactionDb *tdb, PkTransactionDbStmt stmt)
+{
+	gint rc;
+	PkTransactionDbPrivate *priv = tdb->priv;
+
+	if (priv->stmts[stmt] != NULL) {
+		sqlite3_reset (priv->stmts[stmt]);
+		sqlite3_clear_bindings (priv->stmts[stmt]);
+		return priv->stmts[stmt];
+	}
+	rc = sqlite3_prepare_v2 (priv->db,
+				 pk_transaction_db_stmt_sql[stmt],
+				 -1, &priv->stmts[stmt], NULL);
+	if (rc != SQLITE_OK) {
+		g_warning ("failed to prepare statement: %s", sqlite3_errmsg (priv->db));
+		priv->stmts[stmt] = NULL;
+		return NULL;
+	}
+	return priv->stmts[stmt];
+}
+
+/**
+ * pk_transaction_db_get_item:
+ **/
+static PkTransactionDbItem *
+pk_transaction_db_get_item (PkTransactionDb *tdb, const gchar *tid)
+{
+	return g_hash_table_lookup (tdb->priv->pending, tid);
+}
+
 /**
  * pk_transaction_sqlite_transaction_cb:
  **/
@@ -159,28 +258,6 @@ pk_transaction_db_sql_statement (PkTransactionDb *tdb, const gchar *sql)
 	return TRUE;
 }
 
-/**
- * pk_time_action_sqlite_callback:
- **/
-static gint
-pk_time_action_sqlite_callback (void *data, gint argc, gchar **argv, gchar **col_name)
-{
-	gint i;
-	gchar *col;
-	gchar *value;
-	gchar **timespec = (gchar**) data;
-
-	for (i = 0; i < argc; i++) {
-		col = col_name[i];
-		value = argv[i];
-		if (g_strcmp0 (col, "timespec") == 0)
-			*timespec = g_strdup (value);
-		else
-			g_warning ("%s = %s", col, value);
-	}
-	return 0;
-}
-
 /**
  * pk_transaction_db_iso8601_difference:
  * @isodate: The ISO8601 date to compare
@@ -217,25 +294,23 @@ pk_transaction_db_iso8601_difference (const gchar *isodate)
 guint
 pk_transaction_db_action_time_since (PkTransactionDb *tdb, PkRoleEnum role)
 {
-	gchar *error_msg = NULL;
 	gint rc;
-	const gchar *role_text;
-	_cleanup_free_ gchar *statement = NULL;
+	sqlite3_stmt *statement;
 	_cleanup_free_ gchar *timespec = NULL;
 
 	g_return_val_if_fail (PK_IS_TRANSACTION_DB (tdb), 0);
 	g_return_val_if_fail (tdb->priv->db != NULL, 0);
 
-	role_text = pk_role_enum_to_string (role);
-
-	statement = g_strdup_printf ("SELECT timespec FROM last_action WHERE role = '%s'", role_text);
-	rc = sqlite3_exec (tdb->priv->db, statement,
-			   pk_time_action_sqlite_callback, &timespec, &error_msg);
-	if (rc != SQLITE_OK) {
-		g_warning ("SQL error: %s", error_msg);
-		sqlite3_free (error_msg);
+	statement = pk_transaction_db_get_stmt (tdb, PK_TRANSACTION_DB_STMT_ACTION_TIME_SINCE);
+	if (statement == NULL)
 		return G_MAXUINT;
-	}
+	sqlite3_bind_text (statement, 1, pk_role_enum_to_string (role), -1, SQLITE_STATIC);
+	rc = sqlite3_step (statement);
+	if (rc == SQLITE_ROW)
+		timespec = g_strdup ((const gchar *) sqlite3_column_text (statement, 0));
+	else if (rc != SQLITE_DONE)
+		g_warning ("SQL error: %s", sqlite3_errmsg (tdb->priv->db));
+	sqlite3_reset (statement);
 	if (timespec == NULL)
 		return G_MAXUINT;
 
@@ -243,38 +318,145 @@ pk_transaction_db_action_time_since (PkTransactionDb *tdb, PkRoleEnum role)
 	return pk_transaction_db_iso8601_difference (timespec);
 }
 
+/**
+ * pk_transaction_db_get_config:
+ *
+ * Return value: (transfer full): the value saved for @key, or %NULL
+ **/
+static gchar *
+pk_transaction_db_get_config (PkTransactionDb *tdb, const gchar *key)
+{
+	gint rc;
+	gchar *value = NULL;
+	sqlite3_stmt *statement;
+
+	statement = pk_transaction_db_get_stmt (tdb, PK_TRANSACTION_DB_STMT_GET_CONFIG);
+	if (statement == NULL)
+		return NULL;
+	sqlite3_bind_text (statement, 1, key, -1, SQLITE_STATIC);
+	rc = sqlite3_step (statement);
+	if (rc == SQLITE_ROW)
+		value = g_strdup ((const gchar *) sqlite3_column_text (statement, 0));
+	else if (rc != SQLITE_DONE)
+		g_warning ("SQL error: %s", sqlite3_errmsg (tdb->priv->db));
+	sqlite3_reset (statement);
+	return value;
+}
+
+/**
+ * pk_transaction_db_set_config:
+ **/
+static gboolean
+pk_transaction_db_set_config (PkTransactionDb *tdb, const gchar *key, const gchar *value)
+{
+	gint rc;
+	sqlite3_stmt *statement;
+
+	statement = pk_transaction_db_get_stmt (tdb, PK_TRANSACTION_DB_STMT_SET_CONFIG);
+	if (statement == NULL)
+		return FALSE;
+	sqlite3_bind_text (statement, 1, key, -1, SQLITE_STATIC);
+	sqlite3_bind_text (statement, 2, value, -1, SQLITE_STATIC);
+	rc = sqlite3_step (statement);
+	sqlite3_reset (statement);
+	if (rc != SQLITE_DONE) {
+		g_warning ("failed to save %s: %s", key, sqlite3_errmsg (tdb->priv->db));
+		return FALSE;
+	}
+	return TRUE;
+}
+
+/**
+ * pk_transaction_db_get_cache_generation:
+ *
+ * Return value: the saved generation of the results cache, or 0 if none
+ **/
+guint64
+pk_transaction_db_get_cache_generation (PkTransactionDb *tdb)
+{
+	_cleanup_free_ gchar *text = NULL;
+
+	g_return_val_if_fail (PK_IS_TRANSACTION_DB (tdb), 0);
+	g_return_val_if_fail (tdb->priv->db != NULL, 0);
+
+	text = pk_transaction_db_get_config (tdb, "cache_generation");
+	if (text == NULL)
+		return 0;
+	return g_ascii_strtoull (text, NULL, 10);
+}
+
+/**
+ * pk_transaction_db_set_cache_generation:
+ *
+ * Saves the generation of the results cache, so that clients can keep
+ * their cached results when the daemon is restarted.
+ **/
+gboolean
+pk_transaction_db_set_cache_generation (PkTransactionDb *tdb, guint64 generation)
+{
+	_cleanup_free_ gchar *text = NULL;
+
+	g_return_val_if_fail (PK_IS_TRANSACTION_DB (tdb), FALSE);
+	g_return_val_if_fail (tdb->priv->db != NULL, FALSE);
+
+	text = g_strdup_printf ("%" G_GUINT64_FORMAT, generation);
+	return pk_transaction_db_set_config (tdb, "cache_generation", text);
+}
+
+/**
+ * pk_transaction_db_get_cache_stamp:
+ *
+ * Return value: (transfer full): the package database stamp the saved
+ * generation was checked against, or %NULL if none
+ **/
+gchar *
+pk_transaction_db_get_cache_stamp (PkTransactionDb *tdb)
+{
+	g_return_val_if_fail (PK_IS_TRANSACTION_DB (tdb), NULL);
+	g_return_val_if_fail (tdb->priv->db != NULL, NULL);
+	return pk_transaction_db_get_config (tdb, "cache_stamp");
+}
+
+/**
+ * pk_transaction_db_set_cache_stamp:
+ *
+ * Saves the package database stamp, so that the next instance of the
+ * daemon can tell if the packages were changed while it was not running.
+ **/
+gboolean
+pk_transaction_db_set_cache_stamp (PkTransactionDb *tdb, const gchar *stamp)
+{
+	g_return_val_if_fail (PK_IS_TRANSACTION_DB (tdb), FALSE);
+	g_return_val_if_fail (tdb->priv->db != NULL, FALSE);
+	g_return_val_if_fail (stamp != NULL, FALSE);
+	return pk_transaction_db_set_config (tdb, "cache_stamp", stamp);
+}
+
 /**
  * pk_transaction_db_action_time_reset:
  **/
 gboolean
 pk_transaction_db_action_time_reset (PkTransactionDb *tdb, PkRoleEnum role)
 {
-	gchar *error_msg = NULL;
 	gint rc;
-	const gchar *role_text;
-	guint since;
-	_cleanup_free_ gchar *statement = NULL;
+	sqlite3_stmt *statement;
 	_cleanup_free_ gchar *timespec = NULL;
 
 	g_return_val_if_fail (PK_IS_TRANSACTION_DB (tdb), FALSE);
 	g_return_val_if_fail (tdb->priv->db != NULL, FALSE);
 
-	timespec = pk_iso8601_present ();
-	role_text = pk_role_enum_to_string (role);
-
-	/* get the previous entry */
-	since = pk_transaction_db_action_time_since (tdb, role);
-	if (since == G_MAXUINT) {
-		statement = g_strdup_printf ("INSERT INTO last_action (role, timespec) VALUES ('%s', '%s')", role_text, timespec);
-	} else {
-		statement = g_strdup_printf ("UPDATE last_action SET timespec = '%s' WHERE role = '%s'", timespec, role_text);
-	}
+	statement = pk_transaction_db_get_stmt (tdb, PK_TRANSACTION_DB_STMT_ACTION_TIME_RESET);
+	if (statement == NULL)
+		return FALSE;
 
 	/* update or insert the entry */
-	rc = sqlite3_exec (tdb->priv->db, statement, NULL, NULL, &error_msg);
-	if (rc != SQLITE_OK) {
-		g_warning ("SQL error: %s", error_msg);
-		sqlite3_free (error_msg);
+	timespec = pk_iso8601_present ();
+	sqlite3_bind_text (statement, 1, pk_role_enum_to_string (role), -1, SQLITE_STATIC);
+	sqlite3_bind_text (statement, 2, timespec, -1, SQLITE_STATIC);
+	rc = sqlite3_step (statement);
+	sqlite3_reset (statement);
+	if (rc != SQLITE_DONE) {
+		g_warning ("SQL error: %s", sqlite3_errmsg (tdb->priv->db));
 		return FALSE;
 	}
 	return TRUE;
@@ -314,37 +496,143 @@ out:
 	return list;
 }
 
+/**
+ * pk_transaction_db_timespec_to_unix:
+ **/
+static gint64
+pk_transaction_db_timespec_to_unix (const gchar *timespec)
+{
+	GDateTime *datetime;
+	gint64 timestamp;
+
+	if (timespec == NULL)
+		return 0;
+	datetime = pk_iso8601_to_datetime (timespec);
+	if (datetime == NULL)
+		return 0;
+	timestamp = g_date_time_to_unix (datetime);
+	g_date_time_unref (datetime);
+	return timestamp;
+}
+
+/**
+ * pk_transaction_db_add_package_history:
+ * @data: the package list saved with pk_transaction_db_set_data()
+ *
+ * Adds one row to the package_history table for each line of @data, which
+ * is in the form "info\tpackage_id\tsummary". The caller should wrap this
+ * in a transaction.
+ **/
+static gboolean
+pk_transaction_db_add_package_history (PkTransactionDb *tdb,
+				       const gchar *tid,
+				       const gchar *data,
+				       gint64 timestamp,
+				       guint uid)
+{
+	gchar *line;
+	gchar *next;
+	gchar *package_id;
+	gchar *tmp;
+	gint rc;
+	sqlite3_stmt *statement;
+	_cleanup_free_ gchar *data_copy = NULL;
+
+	statement = pk_transaction_db_get_stmt (tdb, PK_TRANSACTION_DB_STMT_ADD_PACKAGE_HISTORY);
+	if (statement == NULL)
+		return FALSE;
+
+	data_copy = g_strdup (data);
+	for (line = data_copy; line != NULL; line = next) {
+		next = strchr (line, '\n');
+		if (next != NULL)
+			*next++ = '\0';
+
+		/* info */
+		package_id = strchr (line, '\t');
+		if (package_id == NULL)
+			continue;
+		*package_id++ = '\0';
+
+		/* package_id, discarding the summary */
+		tmp = strchr (package_id, '\t');
+		if (tmp != NULL)
+			*tmp = '\0';
+
+		/* name */
+		tmp = strchr (package_id, ';');
+		if (tmp == NULL)
+			continue;
+
+		sqlite3_reset (statement);
+		sqlite3_bind_text (statement, 1, package_id, tmp - package_id, SQLITE_STATIC);
+		sqlite3_bind_text (statement, 2, package_id, -1, SQLITE_STATIC);
+		sqlite3_bind_int (statement, 3, pk_info_enum_from_string (line));
+		sqlite3_bind_int64 (statement, 4, timestamp);
+		sqlite3_bind_text (statement, 5, tid, -1, SQLITE_STATIC);
+		sqlite3_bind_int (statement, 6, uid);
+		rc = sqlite3_step (statement);
+		if (rc != SQLITE_DONE) {
+			g_warning ("failed to execute statement: %s", sqlite3_errmsg (tdb->priv->db));
+			sqlite3_reset (statement);
+			return FALSE;
+		}
+	}
+	sqlite3_reset (statement);
+	return TRUE;
+}
+
 /**
  * pk_transaction_db_add:
+ *
+ * Starts recording a transaction. Nothing is written to the database until
+ * pk_transaction_db_set_finished() is called, so that all the metadata is
+ * saved in one write.
  **/
 gboolean
 pk_transaction_db_add (PkTransactionDb *tdb, const gchar *tid)
 {
-	_cleanup_free_ gchar *timespec = NULL;
-	_cleanup_free_ gchar *statement = NULL;
+	PkTransactionDbItem *item;
 
 	g_return_val_if_fail (PK_IS_TRANSACTION_DB (tdb), FALSE);
+	g_return_val_if_fail (tid != NULL, FALSE);
 
-	timespec = pk_iso8601_present ();
-	statement = g_strdup_printf ("INSERT INTO transactions (transaction_id, timespec) VALUES ('%s', '%s')", tid, timespec);
-	pk_transaction_db_sql_statement (tdb, statement);
+	item = g_new0 (PkTransactionDbItem, 1);
+	item->timespec = pk_iso8601_present ();
+	g_hash_table_insert (tdb->priv->pending, g_strdup (tid), item);
 	return TRUE;
 }
 
+/**
+ * pk_transaction_db_remove:
+ *
+ * Stops recording a transaction that will never finish, e.g. because
+ * it was destroyed before it was run.
+ **/
+void
+pk_transaction_db_remove (PkTransactionDb *tdb, const gchar *tid)
+{
+	g_return_if_fail (PK_IS_TRANSACTION_DB (tdb));
+	g_return_if_fail (tid != NULL);
+
+	if (g_hash_table_remove (tdb->priv->pending, tid))
+		g_debug ("%s never finished, not saving it", tid);
+}
+
 /**
  * pk_transaction_db_set_role:
  **/
 gboolean
 pk_transaction_db_set_role (PkTransactionDb *tdb, const gchar *tid, PkRoleEnum role)
 {
-	const gchar *role_text;
-	_cleanup_free_ gchar *statement = NULL;
+	PkTransactionDbItem *item;
 
 	g_return_val_if_fail (PK_IS_TRANSACTION_DB (tdb), FALSE);
 
-	role_text = pk_role_enum_to_string (role);
-	statement = g_strdup_printf ("UPDATE transactions SET role = '%s' WHERE transaction_id = '%s'", role_text, tid);
-	pk_transaction_db_sql_statement (tdb, statement);
+	item = pk_transaction_db_get_item (tdb, tid);
+	if (item == NULL)
+		return FALSE;
+	item->role = role;
 	return TRUE;
 }
 
@@ -354,12 +642,14 @@ pk_transaction_db_set_role (PkTransactionDb *tdb, const gchar *tid, PkRoleEnum r
 gboolean
 pk_transaction_db_set_uid (PkTransactionDb *tdb, const gchar *tid, guint uid)
 {
-	_cleanup_free_ gchar *statement = NULL;
+	PkTransactionDbItem *item;
 
 	g_return_val_if_fail (PK_IS_TRANSACTION_DB (tdb), FALSE);
 
-	statement = g_strdup_printf ("UPDATE transactions SET uid = '%i' WHERE transaction_id = '%s'", uid, tid);
-	pk_transaction_db_sql_statement (tdb, statement);
+	item = pk_transaction_db_get_item (tdb, tid);
+	if (item == NULL)
+		return FALSE;
+	item->uid = uid;
 	return TRUE;
 }
 
@@ -369,12 +659,15 @@ pk_transaction_db_set_uid (PkTransactionDb *tdb, const gchar *tid, guint uid)
 gboolean
 pk_transaction_db_set_cmdline (PkTransactionDb *tdb, const gchar *tid, const gchar *cmdline)
 {
-	_cleanup_free_ gchar *statement = NULL;
+	PkTransactionDbItem *item;
 
 	g_return_val_if_fail (PK_IS_TRANSACTION_DB (tdb), FALSE);
 
-	statement = g_strdup_printf ("UPDATE transactions SET cmdline = '%s' WHERE transaction_id = '%s'", cmdline, tid);
-	pk_transaction_db_sql_statement (tdb, statement);
+	item = pk_transaction_db_get_item (tdb, tid);
+	if (item == NULL)
+		return FALSE;
+	g_free (item->cmdline);
+	item->cmdline = g_strdup (cmdline);
 	return TRUE;
 }
 
@@ -384,14 +677,15 @@ pk_transaction_db_set_cmdline (PkTransactionDb *tdb, const gchar *tid, const gch
 gboolean
 pk_transaction_db_set_data (PkTransactionDb *tdb, const gchar *tid, const gchar *data)
 {
-	_cleanup_free_ gchar *statement = NULL;
+	PkTransactionDbItem *item;
 
 	g_return_val_if_fail (PK_IS_TRANSACTION_DB (tdb), FALSE);
 
-	/* TODO: we have to be careful of SQL injection attacks */
-	statement = g_strdup_printf ("UPDATE transactions SET data = \"%s\" WHERE transaction_id = '%s'",
-				     data, tid);
-	pk_transaction_db_sql_statement (tdb, statement);
+	item = pk_transaction_db_get_item (tdb, tid);
+	if (item == NULL)
+		return FALSE;
+	g_free (item->data);
+	item->data = g_strdup (data);
 	return TRUE;
 }
 
@@ -399,18 +693,249 @@ pk_transaction_db_set_data (PkTransactionDb *tdb, const gchar *tid, const gchar
  * pk_transaction_db_set_finished:
  * @runtime: time in ms
  *
+ * Writes the transaction and everything set on it since
+ * pk_transaction_db_add() in one database transaction, along with the
+ * package history if it succeeded. Transactions that were never added are
+ * ignored.
  **/
 gboolean
 pk_transaction_db_set_finished (PkTransactionDb *tdb, const gchar *tid, gboolean success, guint runtime)
 {
-	_cleanup_free_ gchar *statement = NULL;
+	gboolean ret = FALSE;
+	gint rc;
+	PkTransactionDbItem *item;
+	sqlite3_stmt *statement;
 
 	g_return_val_if_fail (PK_IS_TRANSACTION_DB (tdb), FALSE);
 
-	statement = g_strdup_printf ("UPDATE transactions SET succeeded = %i, duration = %i WHERE transaction_id = '%s'",
-				     success, runtime, tid);
-	pk_transaction_db_sql_statement (tdb, statement);
-	return TRUE;
+	item = pk_transaction_db_get_item (tdb, tid);
+	if (item == NULL)
+		return FALSE;
+
+	statement = pk_transaction_db_get_stmt (tdb, PK_TRANSACTION_DB_STMT_ADD);
+	if (statement == NULL) {
+		g_hash_table_remove (tdb->priv->pending, tid);
+		return FALSE;
+	}
+
+	/* bind data, so that the freeform text cannot be used to inject SQL */
+	sqlite3_bind_text (statement, 1, tid, -1, SQLITE_STATIC);
+	sqlite3_bind_text (statement, 2, item->timespec, -1, SQLITE_STATIC);
+	if (item->role != PK_ROLE_ENUM_UNKNOWN)
+		sqlite3_bind_text (statement, 3, pk_role_enum_to_string (item->role), -1, SQLITE_STATIC);
+	sqlite3_bind_int (statement, 4, item->uid);
+	sqlite3_bind_text (statement, 5, item->cmdline, -1, SQLITE_STATIC);
+	sqlite3_bind_text (statement, 6, item->data, -1, SQLITE_STATIC);
+	sqlite3_bind_int (statement, 7, success);
+	sqlite3_bind_int (statement, 8, runtime);
+	sqlite3_exec (tdb->priv->db, "BEGIN", NULL, NULL, NULL);
+	rc = sqlite3_step (statement);
+	sqlite3_reset (statement);
+	if (rc != SQLITE_DONE) {
+		g_warning ("failed to execute statement: %s", sqlite3_errmsg (tdb->priv->db));
+		goto out;
+	}
+
+	/* only successful transactions are part of the package history */
+	if (success && item->data != NULL) {
+		if (!pk_transaction_db_add_package_history (tdb, tid, item->data,
+							    pk_transaction_db_timespec_to_unix (item->timespec),
+							    item->uid))
+			goto out;
+	}
+	ret = TRUE;
+out:
+	sqlite3_exec (tdb->priv->db, ret ? "COMMIT" : "ROLLBACK", NULL, NULL, NULL);
+	g_hash_table_remove (tdb->priv->pending, tid);
+	return ret;
+}
+
+/**
+ * pk_transaction_db_get_package_history:
+ * @tdb: the #PkTransactionDb instance
+ * @name: the package name, e.g. "colord"
+ * @max_size: the maximum number of entries to return, or 0 for no limit
+ *
+ * Gets the packages installed, removed or updated with the given name,
+ * most recent first. Multiarch packages changed in the same transaction
+ * are only returned once.
+ *
+ * Return value: a 'aa{sv}' #GVariant, or %NULL if there is no history
+ **/
+GVariant *
+pk_transaction_db_get_package_history (PkTransactionDb *tdb,
+				       const gchar *name,
+				       guint max_size)
+{
+	const gchar *package_id;
+	gint64 timestamp;
+	gint64 timestamp_last = 0;
+	gint rc;
+	guint size = 0;
+	GVariantBuilder builder;
+	PkInfoEnum info;
+	sqlite3_stmt *statement;
+
+	g_return_val_if_fail (PK_IS_TRANSACTION_DB (tdb), NULL);
+	g_return_val_if_fail (name != NULL, NULL);
+
+	statement = pk_transaction_db_get_stmt (tdb, PK_TRANSACTION_DB_STMT_GET_PACKAGE_HISTORY);
+	if (statement == NULL)
+		return NULL;
+
+	/* simplify the loop */
+	if (max_size == 0)
+		max_size = G_MAXUINT;
+
+	g_variant_builder_init (&builder, G_VARIANT_TYPE ("aa{sv}"));
+	sqlite3_bind_text (statement, 1, name, -1, SQLITE_STATIC);
+	while (size < max_size) {
+		_cleanup_strv_free_ gchar **split = NULL;
+
+		rc = sqlite3_step (statement);
+		if (rc != SQLITE_ROW) {
+			if (rc != SQLITE_DONE)
+				g_warning ("SQL error: %s", sqlite3_errmsg (tdb->priv->db));
+			break;
+		}
+
+		/* not a state we care about */
+		info = sqlite3_column_int (statement, 1);
+		if (info != PK_INFO_ENUM_INSTALLING &&
+		    info != PK_INFO_ENUM_REMOVING &&
+		    info != PK_INFO_ENUM_UPDATING)
+			continue;
+
+		/* transactions without a timestamp are not interesting, and
+		 * de-duplicate the entry in the case of multiarch */
+		timestamp = sqlite3_column_int64 (statement, 2);
+		if (timestamp == 0 || timestamp == timestamp_last)
+			continue;
+		timestamp_last = timestamp;
+
+		package_id = (const gchar *) sqlite3_column_text (statement, 0);
+		split = pk_package_id_split (package_id);
+		if (split == NULL)
+			continue;
+
+		g_variant_builder_open (&builder, G_VARIANT_TYPE ("a{sv}"));
+		g_variant_builder_add (&builder, "{sv}", "info",
+				       g_variant_new_uint32 (info));
+		g_variant_builder_add (&builder, "{sv}", "source",
+				       g_variant_new_string (split[PK_PACKAGE_ID_DATA]));
+		g_variant_builder_add (&builder, "{sv}", "version",
+				       g_variant_new_string (split[PK_PACKAGE_ID_VERSION]));
+		g_variant_builder_add (&builder, "{sv}", "timestamp",
+				       g_variant_new_uint64 (timestamp));
+		g_variant_builder_add (&builder, "{sv}", "user-id",
+				       g_variant_new_uint32 (sqlite3_column_int (statement, 3)));
+		g_variant_builder_close (&builder);
+		size++;
+	}
+	sqlite3_reset (statement);
+
+	/* nothing found */
+	if (size == 0) {
+		g_variant_builder_clear (&builder);
+		return NULL;
+	}
+	return g_variant_builder_end (&builder);
+}
+
+/**
+ * pk_transaction_db_variant_new_field:
+ **/
+static GVariant *
+pk_transaction_db_variant_new_field (const PkPackageIdView *view, guint field)
+{
+	GVariant *value;
+	gchar *tmp;
+
+	tmp = pk_package_id_view_dup_field (view, field);
+	value = g_variant_new_string (tmp);
+	g_free (tmp);
+	return value;
+}
+
+/**
+ * pk_transaction_db_get_history_since:
+ * @tdb: the #PkTransactionDb instance
+ * @since: the oldest timestamp to return, or 0 for all history
+ * @cursor: the value returned in @cursor_next by the previous call, or 0
+ * @limit: the maximum number of entries to return, or 0 for the most allowed
+ * @cursor_next: (out): the cursor to use for the next page
+ *
+ * Gets one page of the packages installed, removed or updated with any
+ * name, in the order they were saved. The cursor is the row number of the
+ * last entry returned rather than a timestamp, so transactions that were
+ * started first but finished last are not skipped by callers polling for
+ * new history.
+ *
+ * Return value: a 'aa{sv}' #GVariant, which may be empty
+ **/
+GVariant *
+pk_transaction_db_get_history_since (PkTransactionDb *tdb,
+				     guint64 since,
+				     guint64 cursor,
+				     guint limit,
+				     guint64 *cursor_next)
+{
+	const gchar *package_id;
+	gint rc;
+	GVariantBuilder builder;
+	PkPackageIdView view;
+	sqlite3_stmt *statement;
+
+	g_return_val_if_fail (PK_IS_TRANSACTION_DB (tdb), NULL);
+	g_return_val_if_fail (cursor_next != NULL, NULL);
+
+	*cursor_next = cursor;
+	g_variant_builder_init (&builder, G_VARIANT_TYPE ("aa{sv}"));
+	statement = pk_transaction_db_get_stmt (tdb, PK_TRANSACTION_DB_STMT_GET_HISTORY_SINCE);
+	if (statement == NULL)
+		return g_variant_builder_end (&builder);
+
+	if (limit == 0 || limit > PK_TRANSACTION_DB_HISTORY_PAGE_MAX)
+		limit = PK_TRANSACTION_DB_HISTORY_PAGE_MAX;
+
+	/* sqlite integers are signed, and nothing is past G_MAXINT64 */
+	sqlite3_bind_int64 (statement, 1, MIN (cursor, (guint64) G_MAXINT64));
+	sqlite3_bind_int64 (statement, 2, MIN (since, (guint64) G_MAXINT64));
+	sqlite3_bind_int (statement, 3, PK_INFO_ENUM_INSTALLING);
+	sqlite3_bind_int (statement, 4, PK_INFO_ENUM_REMOVING);
+	sqlite3_bind_int (statement, 5, PK_INFO_ENUM_UPDATING);
+	sqlite3_bind_int (statement, 6, limit);
+	while ((rc = sqlite3_step (statement)) == SQLITE_ROW) {
+
+		/* skip over rows we cannot parse too */
+		*cursor_next = sqlite3_column_int64 (statement, 0);
+		package_id = (const gchar *) sqlite3_column_text (statement, 2);
+		if (!pk_package_id_view_init (&view, package_id))
+			continue;
+
+		g_variant_builder_open (&builder, G_VARIANT_TYPE ("a{sv}"));
+		g_variant_builder_add (&builder, "{sv}", "name",
+				       g_variant_new_string ((const gchar *) sqlite3_column_text (statement, 1)));
+		g_variant_builder_add (&builder, "{sv}", "info",
+				       g_variant_new_uint32 (sqlite3_column_int (statement, 3)));
+		g_variant_builder_add (&builder, "{sv}", "source",
+				       pk_transaction_db_variant_new_field (&view, PK_PACKAGE_ID_DATA));
+		g_variant_builder_add (&builder, "{sv}", "version",
+				       pk_transaction_db_variant_new_field (&view, PK_PACKAGE_ID_VERSION));
+		g_variant_builder_add (&builder, "{sv}", "arch",
+				       pk_transaction_db_variant_new_field (&view, PK_PACKAGE_ID_ARCH));
+		g_variant_builder_add (&builder, "{sv}", "timestamp",
+				       g_variant_new_uint64 (sqlite3_column_int64 (statement, 4)));
+		g_variant_builder_add (&builder, "{sv}", "transaction-id",
+				       g_variant_new_string ((const gchar *) sqlite3_column_text (statement, 5)));
+		g_variant_builder_add (&builder, "{sv}", "user-id",
+				       g_variant_new_uint32 (sqlite3_column_int (statement, 6)));
+		g_variant_builder_close (&builder);
+	}
+	if (rc != SQLITE_DONE)
+		g_warning ("SQL error: %s", sqlite3_errmsg (tdb->priv->db));
+	sqlite3_reset (statement);
+	return g_variant_builder_end (&builder);
 }
 
 /**
@@ -490,9 +1015,8 @@ pk_transaction_db_get_random_hex_string (guint length)
 static gboolean
 pk_transaction_db_defer_write_job_count_cb (PkTransactionDb *tdb)
 {
-	gchar *error_msg = NULL;
 	gint rc;
-	_cleanup_free_ gchar *statement = NULL;
+	sqlite3_stmt *statement;
 
 	/* not loaded! */
 	if (tdb->priv->db == NULL) {
@@ -500,21 +1024,18 @@ pk_transaction_db_defer_write_job_count_cb (PkTransactionDb *tdb)
 		goto out;
 	}
 
-	/* force fsync as we don't want to repeat this number */
-	sqlite3_exec (tdb->priv->db, "PRAGMA synchronous=ON", NULL, NULL, NULL);
-
-	/* save the job count */
-	statement = g_strdup_printf ("UPDATE config SET value = '%i' WHERE key = 'job_count'",
-				     tdb->priv->job_count);
-	rc = sqlite3_exec (tdb->priv->db, statement, NULL, NULL, &error_msg);
-	if (rc != SQLITE_OK) {
-		g_warning ("failed to set job id: %s", error_msg);
-		sqlite3_free (error_msg);
+	/* save the job count, making sure it hits the disk as a transaction
+	 * ID must never be reused, even after a power loss */
+	statement = pk_transaction_db_get_stmt (tdb, PK_TRANSACTION_DB_STMT_JOB_COUNT);
+	if (statement == NULL)
 		goto out;
-	}
-
-	/* turn off fsync */
-	sqlite3_exec (tdb->priv->db, "PRAGMA synchronous=OFF", NULL, NULL, NULL);
+	sqlite3_exec (tdb->priv->db, "PRAGMA synchronous=FULL", NULL, NULL, NULL);
+	sqlite3_bind_int (statement, 1, tdb->priv->job_count);
+	rc = sqlite3_step (statement);
+	sqlite3_reset (statement);
+	if (rc != SQLITE_DONE)
+		g_warning ("failed to set job id: %s", sqlite3_errmsg (tdb->priv->db));
+	sqlite3_exec (tdb->priv->db, "PRAGMA synchronous=NORMAL", NULL, NULL, NULL);
 out:
 	tdb->priv->database_save_id = 0;
 	return FALSE;
@@ -548,43 +1069,6 @@ pk_transaction_db_generate_id (PkTransactionDb *tdb)
 	return tid;
 }
 
-/**
- * pk_transaction_sqlite_proxy_cb:
- **/
-static gint
-pk_transaction_sqlite_proxy_cb (void *data, gint argc, gchar **argv, gchar **col_name)
-{
-	PkTransactionDbProxyItem *item = (PkTransactionDbProxyItem *) data;
-	gint i;
-
-	g_return_val_if_fail (item != NULL, 0);
-
-	for (i = 0; i < argc; i++) {
-		if (g_strcmp0 (col_name[i], "proxy_http") == 0) {
-			item->proxy_http = g_strdup (argv[i]);
-			item->set = TRUE;
-		} else if (g_strcmp0 (col_name[i], "proxy_https") == 0) {
-			item->proxy_https = g_strdup (argv[i]);
-			item->set = TRUE;
-		} else if (g_strcmp0 (col_name[i], "proxy_ftp") == 0) {
-			item->proxy_ftp = g_strdup (argv[i]);
-			item->set = TRUE;
-		} else if (g_strcmp0 (col_name[i], "proxy_socks") == 0) {
-			item->proxy_socks = g_strdup (argv[i]);
-			item->set = TRUE;
-		} else if (g_strcmp0 (col_name[i], "no_proxy") == 0) {
-			item->no_proxy = g_strdup (argv[i]);
-			item->set = TRUE;
-		} else if (g_strcmp0 (col_name[i], "pac") == 0) {
-			item->pac = g_strdup (argv[i]);
-			item->set = TRUE;
-		} else {
-			g_warning ("%s = %s", col_name[i], argv[i]);
-		}
-	}
-	return 0;
-}
-
 /**
  * pk_transaction_db_proxy_item_free:
  **/
@@ -623,28 +1107,34 @@ pk_transaction_db_get_proxy (PkTransactionDb *tdb, guint uid, const gchar *sessi
 			     gchar **no_proxy,
 			     gchar **pac)
 {
-	gchar *error_msg = NULL;
 	gboolean ret = FALSE;
 	gint rc;
 	PkTransactionDbProxyItem *item;
-	_cleanup_free_ gchar *statement = NULL;
+	sqlite3_stmt *statement;
 
 	g_return_val_if_fail (PK_IS_TRANSACTION_DB (tdb), FALSE);
 	g_return_val_if_fail (uid != G_MAXUINT, FALSE);
 
 	/* get existing data */
 	item = g_new0 (PkTransactionDbProxyItem, 1);
-	statement = g_strdup_printf ("SELECT proxy_http, proxy_https, proxy_ftp, proxy_socks, no_proxy, pac FROM proxy WHERE uid = '%i' AND session = '%s' LIMIT 1",
-				     uid, session);
-	rc = sqlite3_exec (tdb->priv->db, statement,
-			   pk_transaction_sqlite_proxy_cb,
-			   item,
-			   &error_msg);
-	if (rc != SQLITE_OK) {
-		g_warning ("SQL error: %s", error_msg);
-		sqlite3_free (error_msg);
+	statement = pk_transaction_db_get_stmt (tdb, PK_TRANSACTION_DB_STMT_GET_PROXY);
+	if (statement == NULL)
 		goto out;
+	sqlite3_bind_int (statement, 1, uid);
+	sqlite3_bind_text (statement, 2, session, -1, SQLITE_STATIC);
+	rc = sqlite3_step (statement);
+	if (rc == SQLITE_ROW) {
+		item->proxy_http = g_strdup ((const gchar *) sqlite3_column_text (statement, 0));
+		item->proxy_https = g_strdup ((const gchar *) sqlite3_column_text (statement, 1));
+		item->proxy_ftp = g_strdup ((const gchar *) sqlite3_column_text (statement, 2));
+		item->proxy_socks = g_strdup ((const gchar *) sqlite3_column_text (statement, 3));
+		item->no_proxy = g_strdup ((const gchar *) sqlite3_column_text (statement, 4));
+		item->pac = g_strdup ((const gchar *) sqlite3_column_text (statement, 5));
+		item->set = TRUE;
+	} else if (rc != SQLITE_DONE) {
+		g_warning ("SQL error: %s", sqlite3_errmsg (tdb->priv->db));
 	}
+	sqlite3_reset (statement);
 
 	/* nothing matched */
 	if (!item->set)
@@ -842,6 +1332,56 @@ pk_transaction_db_execute (PkTransactionDb *tdb,
 	return ret;
 }
 
+/**
+ * pk_transaction_db_migrate_package_history:
+ *
+ * Fills the package_history table from the transactions saved before it
+ * existed.
+ **/
+static gboolean
+pk_transaction_db_migrate_package_history (PkTransactionDb *tdb, GError **error)
+{
+	gboolean ret = TRUE;
+	gint rc;
+	sqlite3_stmt *statement = NULL;
+
+	rc = sqlite3_prepare_v2 (tdb->priv->db,
+				 "SELECT transaction_id, timespec, uid, data FROM transactions "
+				 "WHERE succeeded = 1 AND data IS NOT NULL",
+				 -1, &statement, NULL);
+	if (rc != SQLITE_OK) {
+		g_set_error (error, 1, 0,
+			     "failed to prepare statement: %s",
+			     sqlite3_errmsg (tdb->priv->db));
+		return FALSE;
+	}
+
+	sqlite3_exec (tdb->priv->db, "BEGIN", NULL, NULL, NULL);
+	while ((rc = sqlite3_step (statement)) == SQLITE_ROW) {
+		gint64 timestamp;
+		timestamp = pk_transaction_db_timespec_to_unix ((const gchar *) sqlite3_column_text (statement, 1));
+		ret = pk_transaction_db_add_package_history (tdb,
+							     (const gchar *) sqlite3_column_text (statement, 0),
+							     (const gchar *) sqlite3_column_text (statement, 3),
+							     timestamp,
+							     sqlite3_column_int (statement, 2));
+		if (!ret)
+			break;
+	}
+	if (ret && rc != SQLITE_DONE) {
+		g_set_error (error, 1, 0,
+			     "failed to migrate package history: %s",
+			     sqlite3_errmsg (tdb->priv->db));
+		ret = FALSE;
+	} else if (!ret) {
+		g_set_error_literal (error, 1, 0,
+				     "failed to migrate package history");
+	}
+	sqlite3_finalize (statement);
+	sqlite3_exec (tdb->priv->db, ret ? "COMMIT" : "ROLLBACK", NULL, NULL, NULL);
+	return ret;
+}
+
 /**
  * pk_transaction_db_load:
  **/
@@ -872,8 +1412,11 @@ pk_transaction_db_load (PkTransactionDb *tdb, GError **error)
 		return FALSE;
 	}
 
-	/* we don't need to keep doing fsync */
-	if (!pk_transaction_db_execute (tdb, "PRAGMA synchronous=OFF", error))
+	/* use a write-ahead log so each commit is an append, and only fsync
+	 * when the log is checkpointed rather than on every write */
+	if (!pk_transaction_db_execute (tdb, "PRAGMA journal_mode=WAL", error))
+		return FALSE;
+	if (!pk_transaction_db_execute (tdb, "PRAGMA synchronous=NORMAL", error))
 		return FALSE;
 
 	/* check transactions */
@@ -939,6 +1482,19 @@ pk_transaction_db_load (PkTransactionDb *tdb, GError **error)
 			return FALSE;
 	}
 
+	/* per-package history (since 1.0.1) */
+	if (!pk_transaction_db_execute (tdb, "SELECT * FROM package_history LIMIT 1", &error_local)) {
+		g_debug ("adding table package_history: %s", error_local->message);
+		g_clear_error (&error_local);
+		statement = "CREATE TABLE package_history (name TEXT, package_id TEXT, info INTEGER, "
+			    "timestamp INTEGER, tid TEXT, uid INTEGER DEFAULT 0);"
+			    "CREATE INDEX package_history_name ON package_history (name);";
+		if (!pk_transaction_db_execute (tdb, statement, error))
+			return FALSE;
+		if (!pk_transaction_db_migrate_package_history (tdb, error))
+			return FALSE;
+	}
+
 	/* try to set correct permissions */
 	g_chmod (PK_DB_DIR "/transactions.db", 0644);
 
@@ -954,6 +1510,8 @@ static void
 pk_transaction_db_init (PkTransactionDb *tdb)
 {
 	tdb->priv = PK_TRANSACTION_DB_GET_PRIVATE (tdb);
+	tdb->priv->pending = g_hash_table_new_full (g_str_hash, g_str_equal,
+						    g_free, (GDestroyNotify) pk_transaction_db_item_free);
 }
 
 /**
@@ -964,6 +1522,7 @@ static void
 pk_transaction_db_finalize (GObject *object)
 {
 	PkTransactionDb *tdb;
+	guint i;
 	g_return_if_fail (PK_IS_TRANSACTION_DB (object));
 	tdb = PK_TRANSACTION_DB (object);
 	g_return_if_fail (tdb->priv != NULL);
@@ -975,7 +1534,12 @@ pk_transaction_db_finalize (GObject *object)
 	}
 
 	/* close the database */
+	for (i = 0; i < PK_TRANSACTION_DB_STMT_LAST; i++) {
+		if (tdb->priv->stmts[i] != NULL)
+			sqlite3_finalize (tdb->priv->stmts[i]);
+	}
 	sqlite3_close (tdb->priv->db);
+	g_hash_table_unref (tdb->priv->pending);
 
 	G_OBJECT_CLASS (pk_transaction_db_parent_class)->finalize (object);
 }
@@ -54,6 +54,8 @@ gboolean	 pk_transaction_db_load			(PkTransactionDb	*tdb,
 gboolean	 pk_transaction_db_empty		(PkTransactionDb	*tdb);
 gboolean	 pk_transaction_db_add			(PkTransactionDb	*tdb,
 							 const gchar		*tid);
+void		 pk_transaction_db_remove		(PkTransactionDb	*tdb,
+							 const gchar		*tid);
 gboolean	 pk_transaction_db_print		(PkTransactionDb	*tdb);
 gboolean	 pk_transaction_db_set_role		(PkTransactionDb	*tdb,
 							 const gchar		*tid,
@@ -73,6 +75,21 @@ gboolean	 pk_transaction_db_set_data		(PkTransactionDb	*tdb,
 							 const gchar		*data);
 GList		*pk_transaction_db_get_list		(PkTransactionDb	*tdb,
 							 guint			 limit);
+GVariant	*pk_transaction_db_get_package_history	(PkTransactionDb	*tdb,
+							 const gchar		*name,
+							 guint			 max_size);
+GVariant	*pk_transaction_db_get_history_since	(PkTransactionDb	*tdb,
+							 guint64		 since,
+							 guint64		 cursor,
+							 guint			 limit,
+							 guint64		*cursor_next);
+guint64		 pk_transaction_db_get_cache_generation	(PkTransactionDb	*tdb);
+gboolean	 pk_transaction_db_set_cache_generation	(PkTransactionDb	*tdb,
+							 guint64		 generation);
+gchar		*pk_transaction_db_get_cache_stamp	(PkTransactionDb	*tdb)
+							 G_GNUC_WARN_UNUSED_RESULT;
+gboolean	 pk_transaction_db_set_cache_stamp	(PkTransactionDb	*tdb,
+							 const gchar		*stamp);
 gboolean	 pk_transaction_db_action_time_reset	(PkTransactionDb	*tdb,
 							 PkRoleEnum		 role);
 guint		 pk_transaction_db_action_time_since	(PkTransactionDb	*tdb,
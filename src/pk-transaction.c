@@ -52,6 +52,7 @@
 #include "pk-backend.h"
 #include "pk-dbus.h"
 #include "pk-notify.h"
+#include "pk-results-cache.h"
 #include "pk-shared.h"
 #include "pk-transaction-db.h"
 #include "pk-transaction.h"
@@ -75,6 +76,11 @@ static gboolean pk_transaction_is_supported_content_type (PkTransaction *transac
 /* maximum number of packages that can be processed in one go */
 #define PK_TRANSACTION_MAX_PACKAGES_TO_PROCESS	5200
 
+/* when the client asked for batched Package signals, flush after this many
+ * packages have been queued, or after this long, whichever is first */
+#define PK_TRANSACTION_PACKAGES_BATCH_MAX	500
+#define PK_TRANSACTION_PACKAGES_BATCH_TIMEOUT	50 /* ms */
+
 struct PkTransactionPrivate
 {
 	PkRoleEnum		 role;
@@ -94,6 +100,10 @@ struct PkTransactionPrivate
 	gboolean		 exclusive;
 	gboolean		 background;
 	gboolean		 interactive;
+	gboolean		 batch_packages;
+	GVariantBuilder		 packages_builder;
+	guint			 packages_queued;
+	guint			 packages_flush_id;
 	gchar			*locale;
 	gchar			*frontend_socket;
 	guint			 cache_age;
@@ -103,6 +113,9 @@ struct PkTransactionPrivate
 	PkBackendJob		*job;
 	GKeyFile		*conf;
 	PkNotify		*notify;
+	PkResultsCache		*results_cache;
+	gboolean		 results_from_cache;
+	guint64			 results_cache_generation;
 	PkDbus			*dbus;
 	PolkitAuthority		*authority;
 	PolkitSubject		*subject;
@@ -298,6 +311,13 @@ pk_transaction_finish_invalidate_caches (PkTransaction *transaction)
 	if (pk_bitfield_contain (transaction->priv->cached_transaction_flags,
 				  PK_TRANSACTION_FLAG_ENUM_ONLY_DOWNLOAD))
 		goto out;
+
+	/* the package database changed, so drop the cached query results
+	 * now rather than after the delayed ::updates-changed as another
+	 * query might already be queued */
+	if (pk_results_cache_role_invalidates (priv->role))
+		pk_results_cache_invalidate (priv->results_cache);
+
 	if (priv->role == PK_ROLE_ENUM_UPDATE_PACKAGES ||
 	    priv->role == PK_ROLE_ENUM_REMOVE_PACKAGES ||
 	    priv->role == PK_ROLE_ENUM_REPO_ENABLE ||
@@ -313,6 +333,80 @@ out:
 	return TRUE;
 }
 
+/**
+ * pk_transaction_packages_flush:
+ *
+ * Emits any queued packages as one ::Packages signal. This has to be called
+ * before any other signal is sent so the client sees events in order.
+ **/
+static void
+pk_transaction_packages_flush (PkTransaction *transaction)
+{
+	PkTransactionPrivate *priv = transaction->priv;
+
+	if (priv->packages_flush_id != 0) {
+		g_source_remove (priv->packages_flush_id);
+		priv->packages_flush_id = 0;
+	}
+	if (priv->packages_queued == 0)
+		return;
+
+	g_debug ("emitting %u batched packages", priv->packages_queued);
+	g_dbus_connection_emit_signal (priv->connection,
+				       NULL,
+				       priv->tid,
+				       PK_DBUS_INTERFACE_TRANSACTION,
+				       "Packages",
+				       g_variant_new ("(a(uss))",
+						      &priv->packages_builder),
+				       NULL);
+	priv->packages_queued = 0;
+}
+
+/**
+ * pk_transaction_packages_flush_cb:
+ **/
+static gboolean
+pk_transaction_packages_flush_cb (gpointer user_data)
+{
+	PkTransaction *transaction = PK_TRANSACTION (user_data);
+	transaction->priv->packages_flush_id = 0;
+	pk_transaction_packages_flush (transaction);
+	return G_SOURCE_REMOVE;
+}
+
+/**
+ * pk_transaction_packages_queue:
+ **/
+static void
+pk_transaction_packages_queue (PkTransaction *transaction,
+			       PkInfoEnum info,
+			       const gchar *package_id,
+			       const gchar *summary)
+{
+	PkTransactionPrivate *priv = transaction->priv;
+
+	if (priv->packages_queued == 0)
+		g_variant_builder_init (&priv->packages_builder,
+					G_VARIANT_TYPE ("a(uss)"));
+	g_variant_builder_add (&priv->packages_builder, "(uss)",
+			       info, package_id, summary);
+
+	/* flush on size, otherwise make sure we flush soon */
+	if (++priv->packages_queued >= PK_TRANSACTION_PACKAGES_BATCH_MAX) {
+		pk_transaction_packages_flush (transaction);
+		return;
+	}
+	if (priv->packages_flush_id == 0) {
+		priv->packages_flush_id =
+			g_timeout_add (PK_TRANSACTION_PACKAGES_BATCH_TIMEOUT,
+				       pk_transaction_packages_flush_cb,
+				       transaction);
+		g_source_set_name_by_id (priv->packages_flush_id,
+					 "[PkTransaction] packages-flush");
+	}
+}
+
 /**
  * pk_transaction_emit_property_changed:
  **/
@@ -331,6 +425,7 @@ pk_transaction_emit_property_changed (PkTransaction *transaction,
 			       "{sv}",
 			       property_name,
 			       property_value);
+	pk_transaction_packages_flush (transaction);
 	g_dbus_connection_emit_signal (transaction->priv->connection,
 				       NULL,
 				       transaction->priv->tid,
@@ -424,6 +519,7 @@ pk_transaction_finished_emit (PkTransaction *transaction,
 	g_debug ("emitting finished '%s', %i",
 		 pk_exit_enum_to_string (exit_enum),
 		 time_ms);
+	pk_transaction_packages_flush (transaction);
 	g_dbus_connection_emit_signal (transaction->priv->connection,
 				       NULL,
 				       transaction->priv->tid,
@@ -449,6 +545,7 @@ pk_transaction_error_code_emit (PkTransaction *transaction,
 	g_debug ("emitting error-code %s, '%s'",
 		 pk_error_enum_to_string (error_enum),
 		 details);
+	pk_transaction_packages_flush (transaction);
 	g_dbus_connection_emit_signal (transaction->priv->connection,
 				       NULL,
 				       transaction->priv->tid,
@@ -542,6 +639,7 @@ pk_transaction_details_cb (PkBackendJob *job,
 		g_variant_builder_add (&builder, "{sv}", "size",
 				       g_variant_new_uint64 (size));
 
+	pk_transaction_packages_flush (transaction);
 	g_dbus_connection_emit_signal (transaction->priv->connection,
 				       NULL,
 				       transaction->priv->tid,
@@ -627,6 +725,7 @@ pk_transaction_files_cb (PkBackendJob *job,
 
 	/* emit */
 	g_debug ("emitting files %s", package_id);
+	pk_transaction_packages_flush (transaction);
 	g_dbus_connection_emit_signal (transaction->priv->connection,
 				       NULL,
 				       transaction->priv->tid,
@@ -669,6 +768,7 @@ pk_transaction_category_cb (PkBackendJob *job,
 
 	/* emit */
 	g_debug ("emitting category %s, %s, %s, %s, %s ", parent_id, cat_id, name, summary, icon);
+	pk_transaction_packages_flush (transaction);
 	g_dbus_connection_emit_signal (transaction->priv->connection,
 				       NULL,
 				       transaction->priv->tid,
@@ -699,6 +799,7 @@ pk_transaction_item_progress_cb (PkBackendJob *job,
 		 pk_item_progress_get_package_id (item_progress),
 		 pk_status_enum_to_string (pk_item_progress_get_status (item_progress)),
 		 pk_item_progress_get_percentage (item_progress));
+	pk_transaction_packages_flush (transaction);
 	g_dbus_connection_emit_signal (transaction->priv->connection,
 				       NULL,
 				       transaction->priv->tid,
@@ -740,6 +841,7 @@ pk_transaction_distro_upgrade_cb (PkBackendJob *job,
 	g_debug ("emitting distro-upgrade %s, %s, %s",
 		 pk_distro_upgrade_enum_to_string (state),
 		 name, summary);
+	pk_transaction_packages_flush (transaction);
 	g_dbus_connection_emit_signal (transaction->priv->connection,
 				       NULL,
 				       transaction->priv->tid,
@@ -1120,6 +1222,20 @@ pk_transaction_finished_cb (PkBackendJob *job, PkExitEnum exit_enum, PkTransacti
 	if (exit_enum == PK_EXIT_ENUM_SUCCESS)
 		pk_transaction_finish_invalidate_caches (transaction);
 
+	/* save queries so that identical ones can skip the backend, unless
+	 * a write finished while this one was running */
+	if (exit_enum == PK_EXIT_ENUM_SUCCESS &&
+	    !transaction->priv->results_from_cache &&
+	    transaction->priv->results_cache_generation ==
+	    pk_results_cache_get_generation (transaction->priv->results_cache)) {
+		pk_results_cache_add (transaction->priv->results_cache,
+				      transaction->priv->role,
+				      transaction->priv->cached_filters,
+				      transaction->priv->locale,
+				      transaction->priv->cached_package_ids,
+				      transaction->priv->results);
+	}
+
 	/* find the length of time we have been running */
 	time_ms = pk_transaction_get_runtime (transaction);
 	g_debug ("backend was running for %i ms", time_ms);
@@ -1194,8 +1310,9 @@ pk_transaction_finished_cb (PkBackendJob *job, PkExitEnum exit_enum, PkTransacti
 			time_ms);
 	}
 
-	/* destroy the job */
-	pk_backend_stop_job (transaction->priv->backend, transaction->priv->job);
+	/* destroy the job, which was never started if we used the cache */
+	if (!transaction->priv->results_from_cache)
+		pk_backend_stop_job (transaction->priv->backend, transaction->priv->job);
 	g_object_unref (transaction->priv->job);
 	transaction->priv->job = NULL;
 
@@ -1274,6 +1391,15 @@ pk_transaction_package_cb (PkBackend *backend,
 			 package_id,
 			 summary);
 	}
+
+	/* the client can handle these in batches */
+	if (transaction->priv->batch_packages) {
+		pk_transaction_packages_queue (transaction,
+					       info,
+					       package_id,
+					       summary ? summary : "");
+		return;
+	}
 	g_dbus_connection_emit_signal (transaction->priv->connection,
 				       NULL,
 				       transaction->priv->tid,
@@ -1309,6 +1435,7 @@ pk_transaction_repo_detail_cb (PkBackend *backend,
 	description = pk_repo_detail_get_description (item);
 	enabled = pk_repo_detail_get_enabled (item);
 	g_debug ("emitting repo-detail %s, %s, %i", repo_id, description, enabled);
+	pk_transaction_packages_flush (transaction);
 	g_dbus_connection_emit_signal (transaction->priv->connection,
 				       NULL,
 				       transaction->priv->tid,
@@ -1361,6 +1488,7 @@ pk_transaction_repo_signature_required_cb (PkBackend *backend,
 		 package_id, repository_name, key_url, key_userid, key_id,
 		 key_fingerprint, key_timestamp,
 		 pk_sig_type_enum_to_string (type));
+	pk_transaction_packages_flush (transaction);
 	g_dbus_connection_emit_signal (transaction->priv->connection,
 				       NULL,
 				       transaction->priv->tid,
@@ -1411,6 +1539,7 @@ pk_transaction_eula_required_cb (PkBackend *backend,
 	/* emit */
 	g_debug ("emitting eula-required %s, %s, %s, %s",
 		   eula_id, package_id, vendor_name, license_agreement);
+	pk_transaction_packages_flush (transaction);
 	g_dbus_connection_emit_signal (transaction->priv->connection,
 				       NULL,
 				       transaction->priv->tid,
@@ -1457,6 +1586,7 @@ pk_transaction_media_change_required_cb (PkBackend *backend,
 		 pk_media_type_enum_to_string (media_type),
 		 media_id,
 		 media_text);
+	pk_transaction_packages_flush (transaction);
 	g_dbus_connection_emit_signal (transaction->priv->connection,
 				       NULL,
 				       transaction->priv->tid,
@@ -1525,6 +1655,7 @@ pk_transaction_require_restart_cb (PkBackend *backend,
 	g_debug ("emitting require-restart %s, '%s'",
 		 pk_restart_enum_to_string (restart),
 		 package_id);
+	pk_transaction_packages_flush (transaction);
 	g_dbus_connection_emit_signal (transaction->priv->connection,
 				       NULL,
 				       transaction->priv->tid,
@@ -1599,6 +1730,7 @@ pk_transaction_update_detail_cb (PkBackend *backend,
 	issued = pk_update_detail_get_issued (item);
 	updated = pk_update_detail_get_updated (item);
 	g_debug ("emitting update-detail for %s", package_id);
+	pk_transaction_packages_flush (transaction);
 	g_dbus_connection_emit_signal (transaction->priv->connection,
 				       NULL,
 				       transaction->priv->tid,
@@ -1723,6 +1855,46 @@ pk_transaction_percentage_cb (PkBackendJob *job,
 					      g_variant_new_uint32 (percentage));
 }
 
+/**
+ * pk_transaction_replay_results:
+ *
+ * Sends the results of an earlier identical query as if the backend had
+ * just emitted them, so clients cannot tell the difference.
+ **/
+static void
+pk_transaction_replay_results (PkTransaction *transaction, PkResults *results)
+{
+	PkBackendJob *job = transaction->priv->job;
+	PkDetails *details;
+	PkPackage *package;
+	guint i;
+	_cleanup_ptrarray_unref_ GPtrArray *packages = NULL;
+	_cleanup_ptrarray_unref_ GPtrArray *details_array = NULL;
+
+	pk_backend_job_set_status (job, PK_STATUS_ENUM_QUERY);
+	packages = pk_results_get_package_array (results);
+	for (i = 0; i < packages->len; i++) {
+		package = g_ptr_array_index (packages, i);
+		pk_backend_job_package (job,
+					pk_package_get_info (package),
+					pk_package_get_id (package),
+					pk_package_get_summary (package));
+	}
+	details_array = pk_results_get_details_array (results);
+	for (i = 0; i < details_array->len; i++) {
+		details = g_ptr_array_index (details_array, i);
+		pk_backend_job_details (job,
+					pk_details_get_package_id (details),
+					pk_details_get_summary (details),
+					pk_details_get_license (details),
+					pk_details_get_group (details),
+					pk_details_get_description (details),
+					pk_details_get_url (details),
+					pk_details_get_size (details));
+	}
+	pk_backend_job_finished (job);
+}
+
 /**
  * pk_transaction_run:
  */
@@ -1732,6 +1904,7 @@ pk_transaction_run (PkTransaction *transaction)
 	GError *error = NULL;
 	PkExitEnum exit_status;
 	PkTransactionPrivate *priv = PK_TRANSACTION_GET_PRIVATE (transaction);
+	_cleanup_object_unref_ PkResults *cached = NULL;
 
 	g_return_val_if_fail (PK_IS_TRANSACTION (transaction), FALSE);
 	g_return_val_if_fail (priv->tid != NULL, FALSE);
@@ -1774,20 +1947,36 @@ pk_transaction_run (PkTransaction *transaction)
 		return TRUE;
 	}
 
-	/* run the job */
-	pk_backend_start_job (priv->backend, priv->job);
-
-	/* is an error code set? */
-	if (pk_backend_job_get_is_error_set (priv->job)) {
-		exit_status = pk_backend_job_get_exit_code (priv->job);
-		pk_transaction_finished_emit (transaction, exit_status, 0);
-		/* do not fail the transaction */
-	}
+	/* an identical query has already been answered since the last
+	 * time the package database changed, so don't start the backend */
+	cached = pk_results_cache_lookup (priv->results_cache,
+					  priv->role,
+					  priv->cached_filters,
+					  priv->locale,
+					  priv->cached_package_ids);
+	if (cached != NULL) {
+		g_debug ("using cached results for %s", priv->tid);
+		priv->results_from_cache = TRUE;
+	} else {
+		/* the results are only worth saving if nothing changed the
+		 * package database while the backend was running */
+		priv->results_cache_generation = pk_results_cache_get_generation (priv->results_cache);
+
+		/* run the job */
+		pk_backend_start_job (priv->backend, priv->job);
+
+		/* is an error code set? */
+		if (pk_backend_job_get_is_error_set (priv->job)) {
+			exit_status = pk_backend_job_get_exit_code (priv->job);
+			pk_transaction_finished_emit (transaction, exit_status, 0);
+			/* do not fail the transaction */
+		}
 
-	/* check if we should skip this transaction */
-	if (pk_backend_job_get_exit_code (priv->job) == PK_EXIT_ENUM_SKIP_TRANSACTION) {
-		pk_transaction_finished_emit (transaction, PK_EXIT_ENUM_SUCCESS, 0);
-		/* do not fail the transaction */
+		/* check if we should skip this transaction */
+		if (pk_backend_job_get_exit_code (priv->job) == PK_EXIT_ENUM_SKIP_TRANSACTION) {
+			pk_transaction_finished_emit (transaction, PK_EXIT_ENUM_SUCCESS, 0);
+			/* do not fail the transaction */
+		}
 	}
 
 	/* set the role */
@@ -1884,6 +2073,12 @@ pk_transaction_run (PkTransaction *transaction)
 				  (PkBackendJobVFunc) pk_transaction_category_cb,
 				  transaction);
 
+	/* replay the saved results through the job */
+	if (cached != NULL) {
+		pk_transaction_replay_results (transaction, cached);
+		return TRUE;
+	}
+
 	/* do the correct action with the cached parameters */
 	switch (priv->role) {
 	case PK_ROLE_ENUM_DEPENDS_ON:
@@ -4750,6 +4945,23 @@ pk_transaction_set_hint (PkTransaction *transaction,
 		return TRUE;
 	}
 
+	/* batch-packages=true */
+	if (g_strcmp0 (key, "batch-packages") == 0) {
+		if (g_strcmp0 (value, "true") == 0) {
+			priv->batch_packages = TRUE;
+		} else if (g_strcmp0 (value, "false") == 0) {
+			pk_transaction_packages_flush (transaction);
+			priv->batch_packages = FALSE;
+		} else {
+			g_set_error (error,
+				     PK_TRANSACTION_ERROR,
+				     PK_TRANSACTION_ERROR_NOT_SUPPORTED,
+				      "batch-packages hint expects true or false, not %s", value);
+			return FALSE;
+		}
+		return TRUE;
+	}
+
 	/* cache-age=<time-in-seconds> */
 	if (g_strcmp0 (key, "cache-age") == 0) {
 		if (!pk_strtouint (value, &priv->cache_age)) {
@@ -5320,6 +5532,7 @@ pk_transaction_init (PkTransaction *transaction)
 	transaction->priv->percentage = PK_BACKEND_PERCENTAGE_INVALID;
 	transaction->priv->state = PK_TRANSACTION_STATE_UNKNOWN;
 	transaction->priv->notify = pk_notify_new ();
+	transaction->priv->results_cache = pk_results_cache_new ();
 	transaction->priv->dbus = pk_dbus_new ();
 	transaction->priv->results = pk_results_new ();
 	transaction->priv->supported_content_types = g_ptr_array_new_with_free_func (g_free);
@@ -5354,6 +5567,12 @@ pk_transaction_dispose (GObject *object)
 		pk_transaction_finished_emit (transaction, PK_EXIT_ENUM_FAILED, 0);
 	}
 
+	/* never fire after we are gone */
+	if (transaction->priv->packages_flush_id != 0) {
+		g_source_remove (transaction->priv->packages_flush_id);
+		transaction->priv->packages_flush_id = 0;
+	}
+
 	if (transaction->priv->registration_id > 0) {
 		g_dbus_connection_unregister_object (transaction->priv->connection,
 						     transaction->priv->registration_id);
@@ -5403,10 +5622,16 @@ pk_transaction_finalize (GObject *object)
 	g_free (transaction->priv->cached_repo_id);
 	g_free (transaction->priv->cached_parameter);
 	g_free (transaction->priv->cached_value);
+
+	/* a transaction destroyed before it finished is not saved */
+	if (transaction->priv->tid != NULL)
+		pk_transaction_db_remove (transaction->priv->transaction_db, transaction->priv->tid);
 	g_free (transaction->priv->tid);
 	g_free (transaction->priv->sender);
 	g_free (transaction->priv->cmdline);
 	g_ptr_array_unref (transaction->priv->supported_content_types);
+	if (transaction->priv->packages_queued > 0)
+		g_variant_builder_clear (&transaction->priv->packages_builder);
 
 	if (transaction->priv->connection != NULL)
 		g_object_unref (transaction->priv->connection);
@@ -5419,6 +5644,7 @@ pk_transaction_finalize (GObject *object)
 		g_object_unref (transaction->priv->backend);
 	g_object_unref (transaction->priv->transaction_db);
 	g_object_unref (transaction->priv->notify);
+	g_object_unref (transaction->priv->results_cache);
 	g_object_unref (transaction->priv->results);
 //	g_object_unref (transaction->priv->authority);
 	g_object_unref (transaction->priv->cancellable);